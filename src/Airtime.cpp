@@ -0,0 +1,64 @@
+#include "Airtime.h"
+#include <math.h>
+
+uint32_t Airtime::timeOnAirUs(const LoRaParams &p, size_t len)
+{
+    double tSym = (double)(1UL << p.sf) / (p.bwKHz * 1000.0);   // seconds
+    // Low data rate optimisation kicks in above 16 ms symbols
+    int de = tSym > 0.016 ? 1 : 0;
+    int ih = p.explicitHeader ? 0 : 1;
+    int crc = p.crc ? 1 : 0;
+
+    double num = 8.0 * len - 4.0 * p.sf + 28 + 16 * crc - 20 * ih;
+    double den = 4.0 * (p.sf - 2 * de);
+    double payloadSym = 8 + fmax(ceil(num / den) * p.cr, 0.0);
+    double tPreamble = (p.preamble + 4.25) * tSym;
+
+    return (uint32_t)lround((tPreamble + payloadSym * tSym) * 1e6);
+}
+
+float Airtime::sensitivityDbm(uint8_t sf, float bwKHz)
+{
+    static const float bw125[] = { -124.0f, -127.0f, -129.5f, -133.0f, -135.5f, -137.0f };
+    if (sf < 7) sf = 7;
+    if (sf > 12) sf = 12;
+    // Noise floor rises 3 dB per bandwidth doubling
+    return bw125[sf - 7] + 10.0f * log10f(bwKHz / 125.0f);
+}
+
+float Airtime::requiredSnrDb(uint8_t sf)
+{
+    if (sf < 7) sf = 7;
+    if (sf > 12) sf = 12;
+    return -7.5f - 2.5f * (sf - 7);
+}
+
+void ChannelLoad::add(uint32_t airUs, uint32_t nowMs)
+{
+    uint32_t elapsed = nowMs - startMs;
+    if (elapsed >= 2 * CHANNEL_WINDOW_MS) {
+        prevUs = 0;
+        curUs = 0;
+        startMs = nowMs;
+    } else if (elapsed >= CHANNEL_WINDOW_MS) {
+        prevUs = curUs;
+        curUs = 0;
+        startMs += CHANNEL_WINDOW_MS;
+    }
+    curUs += airUs;
+}
+
+uint8_t ChannelLoad::percent(uint32_t nowMs) const
+{
+    uint32_t elapsed = nowMs - startMs;
+    uint64_t cur = curUs, prev = prevUs;
+    if (elapsed >= 2 * CHANNEL_WINDOW_MS) return 0;
+    if (elapsed >= CHANNEL_WINDOW_MS) {
+        prev = cur;
+        cur = 0;
+        elapsed -= CHANNEL_WINDOW_MS;
+    }
+    uint64_t us = cur + prev * (CHANNEL_WINDOW_MS - elapsed) / CHANNEL_WINDOW_MS;
+    uint64_t pct = us / (CHANNEL_WINDOW_MS * 10);   // us * 100 / (window in us)
+    return pct > 100 ? 100 : (uint8_t)pct;
+}
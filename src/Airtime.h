@@ -0,0 +1,51 @@
+#pragma once
+
+// LoRa time-on-air and link budget figures for the SX126x (Semtech
+// AN1200.13 / SX1261/2 datasheet), and how busy the channel has been.
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct LoRaParams {
+    uint8_t sf;          // spreading factor 7..12
+    float bwKHz;         // 125, 250, 500
+    uint8_t cr;          // coding rate denominator 5..8 (4/5..4/8)
+    uint16_t preamble;   // preamble symbols
+    bool crc;
+    bool explicitHeader;
+};
+
+// What setupLoRa() gets from radio.begin(915.0): SF9, BW125, CR4/7, 8 sym preamble
+#define LORA_DEFAULT_PARAMS { 9, 125.0f, 7, 8, true, true }
+
+#define CHANNEL_WINDOW_MS 60000UL
+#define CHANNEL_BUSY_PCT  15      // ChannelLoad above which control traffic holds back
+
+class Airtime {
+public:
+    // Microseconds on air for a payload of len bytes
+    static uint32_t timeOnAirUs(const LoRaParams &p, size_t len);
+
+    // Receiver sensitivity (dBm) at BW125; scaled for wider bandwidths
+    static float sensitivityDbm(uint8_t sf, float bwKHz);
+
+    // Minimum SNR (dB) the demodulator needs at this SF
+    static float requiredSnrDb(uint8_t sf);
+};
+
+// Share of the last CHANNEL_WINDOW_MS the channel carried frames we sent or
+// could demodulate. Collided frames go unseen, so this reads low on a
+// crowded channel. The previous window is weighted by how much of it is
+// still inside the last CHANNEL_WINDOW_MS.
+class ChannelLoad {
+public:
+    ChannelLoad() : startMs(0), curUs(0), prevUs(0) {}
+
+    void add(uint32_t airUs, uint32_t nowMs);
+    uint8_t percent(uint32_t nowMs) const;
+
+private:
+    uint32_t startMs;   // start of the current window
+    uint32_t curUs;
+    uint32_t prevUs;
+};
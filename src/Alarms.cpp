@@ -0,0 +1,28 @@
+#include "Alarms.h"
+
+bool Alarms::isDaytime(time_t t)
+{
+    struct tm tmNow;
+    localtime_r(&t, &tmNow);
+    return tmNow.tm_hour >= 8 && tmNow.tm_hour < 20;
+}
+
+void Alarms::evaluate(const Roster &roster, const NodeTable &table,
+                      const std::string &self, time_t now, uint32_t listenedSecs,
+                      bool probeDisconnected, bool silenced,
+                      AlarmStatus &out)
+{
+    out.downNodes.clear();
+    out.reportedDown.clear();
+    out.probeDisconnected = probeDisconnected;
+    out.silenced = silenced;
+    out.daytime = isDaytime(now);
+
+    for (const auto &nid : roster.ids()) {
+        if (nid == self) continue;
+        const NodeTemp *n = table.find(nid);
+        if (n ? now - n->lastUpdate >= NODE_DOWN_SECS : listenedSecs >= NODE_DOWN_SECS) {
+            out.downNodes.push_back(nid);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Node-down / probe alarm evaluation, independent of buzzer and display.
+
+#include <time.h>
+#include <string>
+#include <vector>
+#include "NodeTable.h"
+#include "Trend.h"
+
+// A peer that has not reported for this long is considered down
+#define NODE_DOWN_SECS 300
+
+struct AlarmStatus {
+    std::vector<std::string> downNodes;
+    // Down by a peer's ALARM while we last heard it less than
+    // NODE_DOWN_SECS ago; shown, but not sounded
+    std::vector<std::string> reportedDown;
+    // Channels warming towards the trend limit; shown, but not sounded
+    std::vector<TrendWarning> rising;
+    bool probeDisconnected;
+    bool silenced;
+    bool daytime;
+
+    // True if anything should be shown / sounded right now
+    bool active() const {
+        return !silenced && (probeDisconnected || !downNodes.empty());
+    }
+    // Buzzer only sounds during the day
+    bool audible() const { return active() && daytime; }
+};
+
+class Alarms {
+public:
+    // 8:00-20:00 local time
+    static bool isDaytime(time_t t);
+
+    // listenedSecs: how long we have been receiving. A roster peer not
+    // heard yet only counts as down once that reaches NODE_DOWN_SECS, so a
+    // node that has just booted doesn't alarm on the whole roster.
+    static void evaluate(const Roster &roster, const NodeTable &table,
+                         const std::string &self, time_t now, uint32_t listenedSecs,
+                         bool probeDisconnected, bool silenced,
+                         AlarmStatus &out);
+};
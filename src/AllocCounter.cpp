@@ -0,0 +1,47 @@
+#include "AllocCounter.h"
+
+#ifdef KIC_COUNT_ALLOCS
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<uint32_t> allocCount(0);
+static std::atomic<uint32_t> freeCount(0);
+static std::atomic<uint32_t> allocBytes(0);
+
+void *operator new(size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) abort();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p) return;
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+    free(p);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+#endif
+
+bool AllocCounter::enabled() { return true; }
+uint32_t AllocCounter::allocs() { return allocCount.load(std::memory_order_relaxed); }
+uint32_t AllocCounter::frees() { return freeCount.load(std::memory_order_relaxed); }
+uint32_t AllocCounter::bytes() { return allocBytes.load(std::memory_order_relaxed); }
+
+#else
+
+bool AllocCounter::enabled() { return false; }
+uint32_t AllocCounter::allocs() { return 0; }
+uint32_t AllocCounter::frees() { return 0; }
+uint32_t AllocCounter::bytes() { return 0; }
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// Counts C++ heap allocations (operator new) when built with
+// -DKIC_COUNT_ALLOCS. Arduino String uses malloc directly and is not seen.
+
+#include <stdint.h>
+
+class AllocCounter {
+public:
+    static bool enabled();
+    static uint32_t allocs();
+    static uint32_t frees();
+    static uint32_t bytes();
+};
@@ -0,0 +1,126 @@
+#include "Backfill.h"
+#include <algorithm>
+
+void Backlog::push(uint32_t epoch, float temp)
+{
+    size_t tail = (head + count) % BACKFILL_MAX_SAMPLES;
+    ring[tail].epoch = epoch;
+    ring[tail].temp = temp;
+    if (count < BACKFILL_MAX_SAMPLES) count++;
+    else head = (head + 1) % BACKFILL_MAX_SAMPLES;
+}
+
+size_t Backlog::collect(uint32_t from, uint32_t to, LogSample *out, size_t max) const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count && n < max; i++) {
+        const LogSample &s = ring[(head + i) % BACKFILL_MAX_SAMPLES];
+        if (s.epoch >= from && s.epoch <= to) out[n++] = s;
+    }
+    return n;
+}
+
+uint32_t Backlog::paceMs(uint32_t airUs)
+{
+    // airtime / (airtime + gap) = duty
+    return (uint32_t)((uint64_t)airUs * (100 - BACKFILL_DUTY_PCT) / BACKFILL_DUTY_PCT / 1000);
+}
+
+void BackfillGaps::missed(const std::string &id, uint32_t epoch)
+{
+    for (auto &g : gaps) {
+        if (g.id != id) continue;
+        if (epoch <= g.until()) return;
+        // The peer can't serve more than its own backlog
+        if (g.slots.size() >= BACKFILL_MAX_SAMPLES) g.slots.erase(g.slots.begin());
+        g.slots.push_back(epoch);
+        g.live = false;
+        g.tries = 0;
+        return;
+    }
+    BackfillGap g = {id, std::vector<uint32_t>(1, epoch), 0, 0, false};
+    gaps.push_back(g);
+}
+
+void BackfillGaps::heard(const std::string &id)
+{
+    for (auto &g : gaps) {
+        if (g.id == id) g.live = true;
+    }
+}
+
+const BackfillGap *BackfillGaps::due(uint32_t nowMs) const
+{
+    for (const auto &g : gaps) {
+        if (!g.live || g.tries >= BACKFILL_TRIES) continue;
+        if (g.tries == 0 || nowMs - g.askedMs >= BACKFILL_RETRY_MS) return &g;
+    }
+    return nullptr;
+}
+
+void BackfillGaps::asked(const std::string &id, uint32_t since, uint32_t until, uint32_t nowMs)
+{
+    for (auto &g : gaps) {
+        if (g.id != id || since > g.since() || until < g.until()) continue;
+        g.askedMs = nowMs;
+        g.tries++;
+    }
+}
+
+bool BackfillGaps::wants(const std::string &id, uint32_t epoch) const
+{
+    for (const auto &g : gaps) {
+        if (g.id == id) return std::binary_search(g.slots.begin(), g.slots.end(), epoch);
+    }
+    return false;
+}
+
+void BackfillGaps::filled(const std::string &id, uint32_t from, uint32_t to, uint32_t nowMs)
+{
+    for (size_t i = 0; i < gaps.size(); i++) {
+        BackfillGap &g = gaps[i];
+        if (g.id != id) continue;
+        auto lo = std::lower_bound(g.slots.begin(), g.slots.end(), from);
+        auto hi = std::upper_bound(lo, g.slots.end(), to);
+        if (lo == hi) return;
+        g.slots.erase(lo, hi);
+        if (g.slots.empty()) {
+            gaps.erase(gaps.begin() + i);
+        } else {
+            // More batches may be on their way; only retry if they stop
+            g.askedMs = nowMs;
+        }
+        return;
+    }
+}
+
+void BackfillGaps::expire(uint32_t nowMs)
+{
+    for (size_t i = 0; i < gaps.size();) {
+        const BackfillGap &g = gaps[i];
+        if (g.tries >= BACKFILL_TRIES && nowMs - g.askedMs >= BACKFILL_RETRY_MS) {
+            gaps.erase(gaps.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+bool BackfillMerge::add(const std::string &id, const LogSample &s)
+{
+    for (const auto &r : rows) {
+        if (r.s.epoch == s.epoch && r.id == id) return false;
+    }
+    if (rows.size() >= BACKFILL_MERGE_MAX) return false;
+    BackfillRow r = {id, s};
+    rows.push_back(r);
+    return true;
+}
+
+void BackfillMerge::take(std::vector<BackfillRow> &out)
+{
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const BackfillRow &a, const BackfillRow &b) { return a.s.epoch < b.s.epoch; });
+    out.swap(rows);
+    rows.clear();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Store-and-forward of quarter-hour samples across link outages.
+//
+// Every node keeps its own recent samples in a Backlog. A receiver that
+// skips a peer's row because the peer has gone quiet (NODE_DOWN_SECS)
+// records the slot in its BackfillGaps. Once the peer is heard again the
+// receiver asks for the missing range (BKR). The peer answers with its
+// samples, oldest first, in BKF frames of up to BACKFILL_BATCH. It spaces
+// those frames so backfill adds at most BACKFILL_DUTY_PCT of airtime.
+// A gap closes when its samples arrive; an unanswered request is repeated
+// up to BACKFILL_TRIES times. Other receivers overhear the BKF frames and
+// fill their own gaps from them; an overheard request for the same range
+// stands in for their own.
+//
+// Receivers collect backfilled samples in a BackfillMerge and write them,
+// in time order, ahead of the rows of their next quarter-hour log.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Protocol.h"
+
+#define BACKFILL_MAX_SAMPLES  96        // 24 h of quarter-hour samples
+#define BACKFILL_MERGE_MAX    192
+#define BACKFILL_BATCH        8
+#define BACKFILL_DUTY_PCT     1
+#define BACKFILL_RETRY_MS     300000UL
+#define BACKFILL_TRIES        3
+
+// Our own recent samples, for peers that missed them
+class Backlog {
+public:
+    Backlog() : head(0), count(0) {}
+
+    // Append; when full the oldest sample is overwritten
+    void push(uint32_t epoch, float temp);
+    // Up to max samples with from <= epoch <= to, oldest first
+    size_t collect(uint32_t from, uint32_t to, LogSample *out, size_t max) const;
+    size_t size() const { return count; }
+
+    // Wait after sending a frame of airUs so backfill stays within
+    // BACKFILL_DUTY_PCT of the channel
+    static uint32_t paceMs(uint32_t airUs);
+
+private:
+    LogSample ring[BACKFILL_MAX_SAMPLES];
+    size_t head;    // index of the oldest sample
+    size_t count;
+};
+
+struct BackfillGap {
+    std::string id;
+    std::vector<uint32_t> slots;    // missing slot epochs, oldest first
+    uint32_t askedMs;   // last request, or last batch received
+    uint8_t tries;
+    bool live;          // heard from since the last missed slot
+
+    uint32_t since() const { return slots.front(); }
+    uint32_t until() const { return slots.back(); }
+};
+
+// Peers' log slots we skipped and still want
+class BackfillGaps {
+public:
+    // We had nothing fresh from id for the slot at epoch
+    void missed(const std::string &id, uint32_t epoch);
+    // A report from id: it can hear a request again
+    void heard(const std::string &id);
+    // The first gap worth asking for now, if any
+    const BackfillGap *due(uint32_t nowMs) const;
+    // A request for this gap went out (ours or a peer's covering it)
+    void asked(const std::string &id, uint32_t since, uint32_t until, uint32_t nowMs);
+    // Whether the sample from id for this slot is one we missed
+    bool wants(const std::string &id, uint32_t epoch) const;
+    // Samples from..to arrived from id
+    void filled(const std::string &id, uint32_t from, uint32_t to, uint32_t nowMs);
+    // Drop gaps that have had all their tries
+    void expire(uint32_t nowMs);
+
+    size_t size() const { return gaps.size(); }
+
+private:
+    std::vector<BackfillGap> gaps;
+};
+
+struct BackfillRow {
+    std::string id;
+    LogSample s;
+};
+
+// Peers' backfilled samples waiting for the next log write
+class BackfillMerge {
+public:
+    // Add one sample from node id, ignoring duplicates; false if it was
+    // a duplicate or the buffer is full
+    bool add(const std::string &id, const LogSample &s);
+    // Move every pending row into out, sorted by time
+    void take(std::vector<BackfillRow> &out);
+    size_t size() const { return rows.size(); }
+
+private:
+    std::vector<BackfillRow> rows;
+};
@@ -0,0 +1,47 @@
+#include "Bench.h"
+#include <stdio.h>
+#include <algorithm>
+
+volatile uint32_t benchSink = 0;
+
+void Bench::summarize(uint64_t *samples, uint32_t n, BenchResult &r)
+{
+    if (n == 0) {
+        r.min = r.median = r.p99 = 0;
+        return;
+    }
+    std::sort(samples, samples + n);
+    r.min = samples[0];
+    r.median = samples[n / 2];
+    // Nearest-rank 99th percentile
+    uint32_t rank = (uint32_t)((99ULL * n + 99) / 100);
+    r.p99 = samples[(rank ? rank : 1) - 1];
+}
+
+void Bench::header(const char *target, const char *build)
+{
+    char line[160];
+    snprintf(line, sizeof(line),
+             "{\"target\":\"%s\",\"build\":\"%s\",\"unit\":\"%s\",\"alloc_counting\":%s}",
+             target, build, unit, AllocCounter::enabled() ? "true" : "false");
+    out(line);
+}
+
+void Bench::report(const BenchResult &r)
+{
+    char allocs[16], bytes[16];
+    if (AllocCounter::enabled()) {
+        snprintf(allocs, sizeof(allocs), "%.2f", r.allocsPerOp);
+        snprintf(bytes, sizeof(bytes), "%.1f", r.bytesPerOp);
+    } else {
+        snprintf(allocs, sizeof(allocs), "null");
+        snprintf(bytes, sizeof(bytes), "null");
+    }
+    char line[224];
+    snprintf(line, sizeof(line),
+             "{\"bench\":\"%s\",\"unit\":\"%s\",\"iters\":%lu,\"min\":%llu,"
+             "\"median\":%llu,\"p99\":%llu,\"allocs_per_op\":%s,\"bytes_per_op\":%s}",
+             r.name, unit, (unsigned long)r.iters, (unsigned long long)r.min,
+             (unsigned long long)r.median, (unsigned long long)r.p99, allocs, bytes);
+    out(line);
+}
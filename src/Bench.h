@@ -0,0 +1,72 @@
+#pragma once
+
+// Micro-benchmark harness shared by the on-target (cycle counter) and
+// host (nanosecond clock) runners. Each case is timed per iteration and
+// reported as one JSON object per line:
+//
+//   {"bench":"crypto.aes_encrypt","unit":"cycles","iters":200,
+//    "min":..,"median":..,"p99":..,"allocs_per_op":0.00,"bytes_per_op":0.0}
+//
+// allocs_per_op/bytes_per_op are null unless built with KIC_COUNT_ALLOCS.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "AllocCounter.h"
+
+typedef uint64_t (*BenchClockFn)();
+typedef void (*BenchWriteFn)(const char *line);
+
+struct BenchResult {
+    const char *name;
+    uint32_t iters;
+    uint64_t min;
+    uint64_t median;
+    uint64_t p99;
+    float allocsPerOp;
+    float bytesPerOp;
+};
+
+class Bench {
+public:
+    Bench(BenchClockFn clock, const char *unit, BenchWriteFn out)
+        : clock(clock), unit(unit), out(out) {}
+
+    // First line of a run: where and how it was measured
+    void header(const char *target, const char *build);
+
+    template <typename F>
+    BenchResult run(const char *name, uint32_t iters, F fn) {
+        samples.assign(iters, 0);
+        fn();   // warm caches and lazy statics outside the measurement
+        uint32_t a0 = AllocCounter::allocs();
+        uint32_t b0 = AllocCounter::bytes();
+        for (uint32_t i = 0; i < iters; i++) {
+            uint64_t t0 = clock();
+            fn();
+            samples[i] = clock() - t0;
+        }
+        BenchResult r;
+        r.name = name;
+        r.iters = iters;
+        r.allocsPerOp = (float)(AllocCounter::allocs() - a0) / iters;
+        r.bytesPerOp = (float)(AllocCounter::bytes() - b0) / iters;
+        summarize(samples.data(), iters, r);
+        report(r);
+        return r;
+    }
+
+    // Sorts samples in place and fills min/median/p99
+    static void summarize(uint64_t *samples, uint32_t n, BenchResult &r);
+
+private:
+    void report(const BenchResult &r);
+
+    BenchClockFn clock;
+    const char *unit;
+    BenchWriteFn out;
+    std::vector<uint64_t> samples;
+};
+
+// Sink that defeats dead-code elimination of benchmarked results
+extern volatile uint32_t benchSink;
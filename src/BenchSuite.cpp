@@ -0,0 +1,168 @@
+#include "BenchSuite.h"
+#include "CryptoHelper.h"
+#include "KicNode.h"
+#include "Protocol.h"
+#include "TempLog.h"
+#include "Gateway.h"
+#include "Trend.h"
+#include <math.h>
+#include <string.h>
+#include <map>
+
+// Hardware-free HAL so the node paths run without touching the radio/NVS
+class BenchClock : public Clock {
+public:
+    uint32_t ms = 0;
+    uint32_t millis() override { return ms; }
+    time_t now() override { return 1757599200; }
+    void setTime(time_t) override {}
+    uint32_t random(uint32_t max) override { return max ? 1234 % max : 0; }
+};
+
+class CaptureRadio : public Radio {
+public:
+    uint8_t last[MAX_FRAME_LEN];
+    size_t lastLen = 0;
+    int16_t transmit(const uint8_t *data, size_t len) override {
+        memcpy(last, data, len);
+        lastLen = len;
+        return 0;
+    }
+};
+
+class MemStore : public KeyValueStore {
+public:
+    std::map<std::string, std::string> strings;
+    std::string getString(const char *key, const char *def) override {
+        auto it = strings.find(key);
+        return it == strings.end() ? def : it->second;
+    }
+    void putString(const char *key, const std::string &value) override { strings[key] = value; }
+    uint32_t getULong(const char *, uint32_t def) override { return def; }
+    void putULong(const char *, uint32_t) override {}
+};
+
+class NullLog : public LogStore {
+public:
+    bool append(const char *, size_t) override { return true; }
+};
+
+class FixedSensor : public TempSensor {
+public:
+    void requestConversion() override {}
+    float readC(uint8_t index) override { return index == 0 ? -18.25f : NAN; }
+};
+
+#define BENCH_PEERS 10
+
+void BenchSuite::run(Bench &bench, LogStore &log, uint32_t iters)
+{
+    const char *pass = "bowman#1";
+    uint8_t key[32];
+    CryptoHelper::deriveKey(pass, strlen(pass), key);
+
+    const char *kic = "KIC,A1B2C3,-18.25,nan,nan,1757599200,1";
+    size_t kicLen = strlen(kic);
+    uint8_t enc[MAX_FRAME_LEN], dec[MAX_FRAME_LEN];
+    size_t encLen = 0, decLen = 0;
+    CryptoHelper::aesEncrypt(key, (const uint8_t *)kic, kicLen, enc, encLen);
+
+    // ----- Crypto -----
+    bench.run("crypto.derive_key", iters, [&]() {
+        CryptoHelper::deriveKey(pass, strlen(pass), key);
+        benchSink += key[0];
+    });
+    bench.run("crypto.aes_encrypt", iters, [&]() {
+        size_t n = 0;
+        CryptoHelper::aesEncrypt(key, (const uint8_t *)kic, kicLen, enc, n);
+        benchSink += (uint32_t)n;
+    });
+    CryptoHelper::aesEncrypt(key, (const uint8_t *)kic, kicLen, enc, encLen);
+    bench.run("crypto.aes_decrypt", iters, [&]() {
+        benchSink += CryptoHelper::aesDecrypt(key, enc, encLen, dec, decLen);
+    });
+
+    // ----- Packet codec -----
+    KicReport report = {"A1B2C3", -18.25f, NAN, NAN, 1757599200UL, true, 0, 0, 0};
+    char text[MAX_FRAME_LEN];
+    bench.run("codec.format_kic", iters, [&]() {
+        benchSink += (uint32_t)Protocol::formatKic(report, text, sizeof(text));
+    });
+    Message msg;
+    bench.run("codec.parse_kic", iters, [&]() {
+        benchSink += Protocol::parse(kic, kicLen, msg);
+    });
+    // One gateway record: fixed-point fields, CRC, COBS, ring push
+    GatewayStream gateway;
+    uint8_t gwOut[GATEWAY_FRAME_MAX];
+    bench.run("codec.gateway_record", iters, [&]() {
+        GatewayRecord g = GatewayRecord::make(GatewayKind::Report, "A1B2C3", 1000, 1757599200UL);
+        g.temp[0] = GatewayRecord::fixed(-18.25f, 100.0f);
+        gateway.push(g);
+        benchSink += (uint32_t)gateway.drain(gwOut, sizeof(gwOut));
+    });
+
+    // One reading into the trend windows of a full peer table, then the
+    // warning check over all of them
+    TrendTracker trends;
+    trends.setLimit(-10.0f, TREND_HORIZON_MIN);
+    char trendIds[BENCH_PEERS][8];
+    for (int i = 0; i < BENCH_PEERS; i++) snprintf(trendIds[i], sizeof(trendIds[i]), "%06X", 0x100000 + i);
+    std::vector<TrendWarning> rising;
+    time_t trendT = 1757599200;
+    int trendPeer = 0;
+    bench.run("alarm.trend_sample", iters, [&]() {
+        float temps[TREND_CHANNELS] = {-18.0f + (trendPeer & 7) * 0.01f, NAN, NAN};
+        trends.add(trendIds[trendPeer], temps, trendT);
+        if (++trendPeer == BENCH_PEERS) {
+            trendPeer = 0;
+            trendT += TREND_STEP_SECS;
+        }
+        trends.evaluate(trendT, rising);
+        benchSink += (uint32_t)rising.size();
+    });
+
+    // ----- Node send/receive with a full peer table -----
+    BenchClock clock;
+    CaptureRadio radio;
+    MemStore prefs;
+    NullLog nullLog;
+    FixedSensor sensor;
+    KicNode node(clock, radio, prefs, nullLog, sensor);
+    node.begin("A1B2C3", true, pass);
+    for (int i = 0; i < BENCH_PEERS; i++) {
+        char id[12];
+        snprintf(id, sizeof(id), "%06X", 0x100000 + i);
+        node.table().update(id, 4.0f, NAN, NAN, clock.now(), true);
+    }
+    bench.run("node.broadcast_kic", iters, [&]() {
+        benchSink += node.broadcastKIC();
+    });
+
+    KicNode peer(clock, radio, prefs, nullLog, sensor);
+    peer.begin("100005", true, pass);
+    peer.broadcastKIC();
+    uint8_t frame[MAX_FRAME_LEN];
+    size_t frameLen = radio.lastLen;
+    memcpy(frame, radio.last, frameLen);
+    bench.run("node.rx_frame", iters, [&]() {
+        benchSink += (uint32_t)node.onRadioFrame(frame, frameLen);
+    });
+
+    // ----- Log: one quarter-hour batch for every known node -----
+    char block[BENCH_PEERS * 64 + 128];
+    size_t blockLen = 0;
+    bench.run("log.format_rows", iters, [&]() {
+        char tstamp[24];
+        TempLog::formatTimestamp(clock.now(), tstamp, sizeof(tstamp));
+        blockLen = 0;
+        for (const auto &n : node.table()) {
+            blockLen += TempLog::formatRow(tstamp, n.id, n.temp1, n.temp2, n.temp3,
+                                           block + blockLen, sizeof(block) - blockLen);
+        }
+        benchSink += (uint32_t)blockLen;
+    });
+    bench.run("log.append", iters, [&]() {
+        benchSink += log.append(block, blockLen);
+    });
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// The standard benchmark cases: crypto, packet codec, node receive/send
+// paths and log writes. Shared by the on-target and host runners so the
+// numbers are comparable between builds.
+
+#include "Bench.h"
+#include "Hal.h"
+
+class BenchSuite {
+public:
+    // log receives the log append case; pass a scratch file, not the real log
+    static void run(Bench &bench, LogStore &log, uint32_t iters);
+};
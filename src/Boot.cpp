@@ -0,0 +1,76 @@
+#include "Boot.h"
+#include <stdio.h>
+#include <string.h>
+
+BootSequence::BootSequence(const BootStage *stages, size_t count, Clock &clock)
+    : table(stages), count(count < BOOT_STAGES_MAX ? count : BOOT_STAGES_MAX),
+      clock(clock), next(0), reportUs(0), doneUs(0)
+{
+    memset(start, 0, sizeof(start));
+    memset(took, 0, sizeof(took));
+}
+
+void BootSequence::runNext()
+{
+    uint32_t t0 = clock.micros();
+    table[next].run();
+    uint32_t t1 = clock.micros();
+    start[next] = t0;
+    took[next] = t1 - t0;
+    next++;
+    if (next == count) doneUs = t1;
+}
+
+void BootSequence::runImmediate()
+{
+    while (next < count && !table[next].deferred) runNext();
+}
+
+bool BootSequence::runDeferred()
+{
+    if (!reported() || finished()) return false;
+    runNext();
+    return true;
+}
+
+void BootSequence::reportSent()
+{
+    if (reportUs) return;
+    uint32_t us = clock.micros();
+    reportUs = us ? us : 1;
+}
+
+// Seconds with microsecond digits, like the histogram sums
+static void emitSeconds(MetricsWriteFn out, void *ctx, const char *name,
+                        const char *label, uint32_t us)
+{
+    char line[96];
+    int n = snprintf(line, sizeof(line), "%s%s %lu.%06lu\n", name, label,
+                     (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+    if (n > 0) out(ctx, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+void BootSequence::render(MetricsWriteFn out, void *ctx) const
+{
+    static const char stageHead[] =
+        "# HELP kic_boot_stage_seconds Duration of each boot stage\n"
+        "# TYPE kic_boot_stage_seconds gauge\n";
+    out(ctx, stageHead, sizeof(stageHead) - 1);
+    char label[40];
+    for (size_t i = 0; i < next; i++) {
+        snprintf(label, sizeof(label), "{stage=\"%s\"}", table[i].name);
+        emitSeconds(out, ctx, "kic_boot_stage_seconds", label, took[i]);
+    }
+
+    static const char reportHead[] =
+        "# HELP kic_boot_first_report_seconds Time from start to the first report sent\n"
+        "# TYPE kic_boot_first_report_seconds gauge\n";
+    out(ctx, reportHead, sizeof(reportHead) - 1);
+    emitSeconds(out, ctx, "kic_boot_first_report_seconds", "", reportUs);
+
+    static const char doneHead[] =
+        "# HELP kic_boot_finished_seconds Time from start to the last boot stage done\n"
+        "# TYPE kic_boot_finished_seconds gauge\n";
+    out(ctx, doneHead, sizeof(doneHead) - 1);
+    emitSeconds(out, ctx, "kic_boot_finished_seconds", "", doneUs);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Staged boot with per-stage timing.
+//
+// main.cpp lists its boot stages in a table. setup() runs the immediate
+// ones, the few the node needs to report (time, radio, node state,
+// sensor), and returns. The deferred ones (display, WiFi, web server,
+// DNS, uplink) wait until the first report has gone out, then loop()
+// runs one per pass, so none of them holds the radio back.
+//
+//   immediate:  power  time  radio  node  sensor  storage
+//   first report on air  (KicNode::join(), a few hundred ms later)
+//   deferred:   display  wifi  web  dns  uplink
+//
+// Each stage's start and duration are kept from the Clock's micros()
+// and rendered as gauges next to the other metrics:
+//
+//   kic_boot_stage_seconds{stage="radio"} 0.041233
+//   kic_boot_first_report_seconds 0.652118
+//
+// Times count from when the application starts, so the ROM and second
+// stage bootloader (a few hundred ms) are not included.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Hal.h"
+#include "Metrics.h"
+
+#define BOOT_STAGES_MAX 16
+
+struct BootStage {
+    const char *name;
+    void (*run)();
+    bool deferred;      // may wait until after the first report
+};
+
+class BootSequence {
+public:
+    BootSequence(const BootStage *stages, size_t count, Clock &clock);
+
+    // Run stages in table order up to the first deferred one
+    void runImmediate();
+    // Once reported(): the next deferred stage, one per call; false if
+    // there was nothing to run
+    bool runDeferred();
+    // The first report has been sent (later calls are ignored)
+    void reportSent();
+
+    bool reported() const { return reportUs != 0; }
+    bool finished() const { return next == count; }
+    size_t stages() const { return count; }
+    const char *name(size_t i) const { return table[i].name; }
+    // Start (since boot) and duration of stage i, 0 if it hasn't run
+    uint32_t startUs(size_t i) const { return start[i]; }
+    uint32_t durationUs(size_t i) const { return took[i]; }
+    uint32_t firstReportUs() const { return reportUs; }
+    uint32_t finishedUs() const { return doneUs; }
+
+    void render(MetricsWriteFn out, void *ctx) const;
+
+private:
+    void runNext();
+
+    const BootStage *table;
+    size_t count;
+    Clock &clock;
+    size_t next;
+    uint32_t start[BOOT_STAGES_MAX];
+    uint32_t took[BOOT_STAGES_MAX];
+    uint32_t reportUs;
+    uint32_t doneUs;
+};
@@ -0,0 +1,58 @@
+#include "CaptiveDns.h"
+#include <string.h>
+
+#define DNS_TYPE_A    1
+#define DNS_CLASS_IN  1
+
+CaptiveDns::CaptiveDns()
+{
+    static const uint8_t none[4] = {0, 0, 0, 0};
+    setAddress(none);
+}
+
+void CaptiveDns::setAddress(const uint8_t ip[4])
+{
+    const uint8_t head[] = {
+        0xC0, DNS_HEADER_LEN,                 // name: pointer to the question
+        0, DNS_TYPE_A, 0, DNS_CLASS_IN,
+        (uint8_t)(DNS_TTL_SECS >> 24), (uint8_t)(DNS_TTL_SECS >> 16),
+        (uint8_t)(DNS_TTL_SECS >> 8), (uint8_t)DNS_TTL_SECS,
+        0, 4
+    };
+    memcpy(record, head, sizeof(head));
+    memcpy(record + sizeof(head), ip, 4);
+}
+
+size_t CaptiveDns::answer(const uint8_t *query, size_t len, uint8_t *out, size_t outMax) const
+{
+    if (len < DNS_HEADER_LEN || len > DNS_PACKET_MAX) return 0;
+    // A query (QR clear), standard opcode, exactly one question
+    if ((query[2] & 0x80) || (query[2] & 0x78)) return 0;
+    if (query[4] != 0 || query[5] != 1) return 0;
+
+    // Walk the question name; compression is not valid here
+    size_t p = DNS_HEADER_LEN;
+    while (p < len && query[p] != 0) {
+        if (query[p] & 0xC0) return 0;
+        p += query[p] + 1;
+    }
+    if (p + 5 > len) return 0;
+    p++;
+    uint16_t qtype = (uint16_t)(query[p] << 8 | query[p + 1]);
+    uint16_t qclass = (uint16_t)(query[p + 2] << 8 | query[p + 3]);
+    p += 4;
+
+    bool withA = qtype == DNS_TYPE_A && qclass == DNS_CLASS_IN;
+    size_t n = p + (withA ? DNS_ANSWER_LEN : 0);
+    if (n > outMax) return 0;
+
+    // Header and question as asked; any EDNS additional record is left off
+    memcpy(out, query, p);
+    out[2] = 0x84 | (query[2] & 0x01);    // response, authoritative, RD echoed
+    out[3] = 0x00;                        // no recursion, NOERROR
+    out[6] = 0;
+    out[7] = withA ? 1 : 0;
+    memset(out + 8, 0, 4);
+    if (withA) memcpy(out + p, record, DNS_ANSWER_LEN);
+    return n;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Captive-portal DNS answers for the setup AP.
+//
+// Every A query gets the AP's own address, so a phone joining the AP opens
+// the web UI. main.cpp calls answer() from an AsyncUDP packet callback,
+// which runs in the network stack's task rather than the loop, so replies
+// don't wait behind sensor reads, the buzzer or flash writes.
+//
+// The answer record is built once by setAddress(); answer() only copies
+// the query's header and question and appends it. Other query types (AAAA,
+// HTTPS, ...) get an empty NOERROR reply so clients fall back to A at once.
+// Anything that isn't a single-question standard query is dropped.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DNS_PORT        53
+#define DNS_PACKET_MAX  512      // plain UDP DNS
+#define DNS_TTL_SECS    60
+#define DNS_HEADER_LEN  12
+#define DNS_ANSWER_LEN  16       // name pointer, type, class, TTL, length, IPv4
+
+class CaptiveDns {
+public:
+    CaptiveDns();
+
+    void setAddress(const uint8_t ip[4]);
+
+    // Reply to query in out; 0 if the packet should be ignored
+    size_t answer(const uint8_t *query, size_t len, uint8_t *out, size_t outMax) const;
+
+private:
+    uint8_t record[DNS_ANSWER_LEN];
+};
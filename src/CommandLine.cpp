@@ -0,0 +1,75 @@
+#include "CommandLine.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+bool LineAssembler::feed(char c)
+{
+    if (ready) {
+        len = 0;
+        ready = false;
+        lastOverflow = false;
+    }
+    if (c == '\r') return false;
+    if (c != '\n') {
+        if (len < CMD_LINE_MAX - 1) buf[len++] = c;
+        else overflow = true;
+        return false;
+    }
+
+    ready = true;
+    lastOverflow = overflow;
+    overflow = false;
+    if (lastOverflow) len = 0;
+    // Trim, like the old String::trim()
+    while (len > 0 && isspace((unsigned char)buf[len - 1])) len--;
+    buf[len] = 0;
+    size_t lead = 0;
+    while (lead < len && isspace((unsigned char)buf[lead])) lead++;
+    if (lead) {
+        memmove(buf, buf + lead, len - lead + 1);
+        len -= lead;
+    }
+    return true;
+}
+
+CommandResult CommandLine::dispatch(const Command *table, size_t count, char *line)
+{
+    if (!line[0]) return CommandResult::Empty;
+    size_t n = strcspn(line, ": ");
+    char *args = line + n;
+    if (*args) *args++ = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (strcasecmp(table[i].name, line) == 0) {
+            table[i].run(args);
+            return CommandResult::Ran;
+        }
+    }
+    return CommandResult::Unknown;
+}
+
+size_t CommandLine::split(char *s, char sep, char **fields, size_t max)
+{
+    if (max == 0) return 0;
+    size_t n = 0;
+    fields[n++] = s;
+    while (n < max) {
+        char *p = strchr(s, sep);
+        if (!p) break;
+        *p = 0;
+        s = p + 1;
+        fields[n++] = s;
+    }
+    return n;
+}
+
+bool CommandLine::toInt(const char *s, long lo, long hi, long &out)
+{
+    if (!*s) return false;
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (*end || v < lo || v > hi) return false;
+    out = v;
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Serial console input without blocking or heap use.
+//
+// main.cpp feeds whatever bytes Serial has buffered into a LineAssembler,
+// which collects them in a fixed buffer until a newline. A complete line
+// goes to dispatch(), which looks its first word up in a table of
+// commands and hands the handler the rest of the line, split in place.
+//
+//   SETTIME:2025,09,11,14,00    name "SETTIME", args "2025,09,11,14,00"
+//   ROSTER                      name "ROSTER", args ""
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CMD_LINE_MAX 128
+
+// Handler for one command; args is the text after "NAME:" or "NAME ",
+// writable so it can be split in place
+typedef void (*CommandFn)(char *args);
+
+struct Command {
+    const char *name;
+    CommandFn run;
+    const char *usage;   // for HELP
+};
+
+enum class CommandResult : uint8_t {
+    Ran,
+    Empty,
+    Unknown
+};
+
+class LineAssembler {
+public:
+    LineAssembler() : len(0), ready(false), overflow(false), lastOverflow(false) {}
+
+    // Take one byte; true when a line is complete. The line is then in
+    // line(), trimmed, until the next feed(). \r is ignored; a line longer
+    // than CMD_LINE_MAX - 1 comes back empty with overflowed() set.
+    bool feed(char c);
+    char *line() { return buf; }
+    bool overflowed() const { return lastOverflow; }
+
+private:
+    char buf[CMD_LINE_MAX];
+    size_t len;
+    bool ready;
+    bool overflow;
+    bool lastOverflow;
+};
+
+class CommandLine {
+public:
+    // Run the table entry matching line's first word (case-insensitive)
+    static CommandResult dispatch(const Command *table, size_t count, char *line);
+
+    // Split s in place at sep into at most max fields; the last field keeps
+    // any further separators (a WiFi password may contain commas)
+    static size_t split(char *s, char sep, char **fields, size_t max);
+    // Whole decimal number in [lo, hi]
+    static bool toInt(const char *s, long lo, long hi, long &out);
+};
@@ -0,0 +1,315 @@
+#include "ConfigChange.h"
+#include "LinkAdapt.h"
+#include "Uplink.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum class ValueKind : uint8_t {
+    Text,
+    Flag,
+    Number,
+    NumberOrNull
+};
+
+static const struct {
+    const char *name;
+    uint32_t field;
+    ValueKind kind;
+} configKeys[] = {
+    {"nodeid", CfgNodeId, ValueKind::Text},
+    {"ap_ssid", CfgApSsid, ValueKind::Text},
+    {"ap_pass", CfgApPass, ValueKind::Text},
+    {"sta_ssid", CfgStaSsid, ValueKind::Text},
+    {"sta_pass", CfgStaPass, ValueKind::Text},
+    {"sta_only", CfgStaOnly, ValueKind::Flag},
+    {"uplink", CfgUplink, ValueKind::Text},
+    {"roster", CfgRoster, ValueKind::Text},
+    {"trend_limit", CfgTrendLimit, ValueKind::NumberOrNull},
+    {"trend_horizon", CfgTrendHorizon, ValueKind::Number},
+    {"time", CfgTime, ValueKind::Number},
+    {"max_dbm", CfgMaxDbm, ValueKind::Number},
+};
+
+ConfigChange::ConfigChange()
+    : fields(0), staOnly(false), trendLimit(NAN), trendHorizon(0), time(0), maxDbm(0)
+{
+}
+
+static bool fail(ConfigError &err, const char *key, const char *reason)
+{
+    // The key is echoed back in the JSON reply; keep it to plain characters
+    size_t n = 0;
+    for (; key[n] && n < sizeof(err.key) - 1; n++) {
+        char c = key[n];
+        err.key[n] = isalnum((unsigned char)c) || c == '_' ? c : '?';
+    }
+    err.key[n] = '\0';
+    err.reason = reason;
+    return false;
+}
+
+static bool isNodeId(const char *s, size_t n)
+{
+    if (n != 6) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (!isalnum((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+// id,id,... : each a node id, each once; empty clears the roster
+static bool validRoster(const std::string &csv)
+{
+    if (csv.empty()) return true;
+    const char *ids[CONFIG_ROSTER_MAX];
+    size_t n = 0;
+    size_t start = 0;
+    do {
+        size_t comma = csv.find(',', start);
+        if (comma == std::string::npos) comma = csv.size();
+        const char *id = csv.c_str() + start;
+        if (!isNodeId(id, comma - start) || n == CONFIG_ROSTER_MAX) return false;
+        for (size_t i = 0; i < n; i++) {
+            if (strncmp(ids[i], id, 6) == 0) return false;
+        }
+        ids[n++] = id;
+        start = comma + 1;
+    } while (start <= csv.size());
+    return true;
+}
+
+bool ConfigChange::validate(ConfigError &err) const
+{
+    if (has(CfgNodeId) && !isNodeId(nodeId.data(), nodeId.size())) {
+        return fail(err, "nodeid", "must be 6 letters or digits");
+    }
+    if (has(CfgApSsid) && (apSsid.empty() || apSsid.size() > 32)) {
+        return fail(err, "ap_ssid", "must be 1-32 characters");
+    }
+    if (has(CfgApPass) && (apPass.size() < 8 || apPass.size() > 63)) {
+        return fail(err, "ap_pass", "must be 8-63 characters");
+    }
+    if (has(CfgStaSsid) && staSsid.size() > 32) {
+        return fail(err, "sta_ssid", "must be at most 32 characters");
+    }
+    if (has(CfgStaPass) && !staPass.empty() && (staPass.size() < 8 || staPass.size() > 63)) {
+        return fail(err, "sta_pass", "must be empty or 8-63 characters");
+    }
+    UplinkTarget target;
+    if (has(CfgUplink) && !uplink.empty() && !UplinkTarget::parse(uplink, target)) {
+        return fail(err, "uplink", "must be empty or an http:// or mqtt:// URL");
+    }
+    if (has(CfgRoster) && !validRoster(roster)) {
+        return fail(err, "roster", "must be empty or up to 24 different 6-character ids, comma-separated");
+    }
+    if (has(CfgTrendLimit) && !isnan(trendLimit) && (trendLimit < -50.0f || trendLimit > 50.0f)) {
+        return fail(err, "trend_limit", "must be -50 to 50 C, or null for off");
+    }
+    if (has(CfgTrendHorizon) && (trendHorizon < 1 || trendHorizon > 1440)) {
+        return fail(err, "trend_horizon", "must be 1-1440 minutes");
+    }
+    if (has(CfgTime) && time < CONFIG_TIME_MIN) {
+        return fail(err, "time", "must be epoch seconds after 2020");
+    }
+    if (has(CfgMaxDbm) && (maxDbm < ADR_MIN_DBM || maxDbm > ADR_MAX_DBM)) {
+        return fail(err, "max_dbm", "out of the radio's power range");
+    }
+    return true;
+}
+
+void ConfigChange::names(TextBuf &out) const
+{
+    bool first = true;
+    for (const auto &k : configKeys) {
+        if (!has(k.field)) continue;
+        out.printf(first ? "\"%s\"" : ",\"%s\"", k.name);
+        first = false;
+    }
+}
+
+// ----- JSON -----
+// Just enough for one flat object: string, number, true/false and null
+// values, no nesting
+
+struct JsonIn {
+    const char *p;
+    const char *end;
+};
+
+static void skipSpace(JsonIn &j)
+{
+    while (j.p < j.end && (*j.p == ' ' || *j.p == '\t' || *j.p == '\r' || *j.p == '\n')) j.p++;
+}
+
+static bool eat(JsonIn &j, char c)
+{
+    skipSpace(j);
+    if (j.p == j.end || *j.p != c) return false;
+    j.p++;
+    return true;
+}
+
+static bool word(JsonIn &j, const char *w)
+{
+    size_t n = strlen(w);
+    if ((size_t)(j.end - j.p) < n || strncmp(j.p, w, n) != 0) return false;
+    j.p += n;
+    return true;
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Escapes are decoded; \u only below 0x80, which is all a setting needs
+static bool parseString(JsonIn &j, std::string &out)
+{
+    if (!eat(j, '"')) return false;
+    out.clear();
+    while (j.p < j.end) {
+        char c = *j.p++;
+        if (c == '"') return true;
+        if ((unsigned char)c < 0x20) return false;
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (j.p == j.end) return false;
+        c = *j.p++;
+        switch (c) {
+        case '"': case '\\': case '/': out += c; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            if (j.end - j.p < 4) return false;
+            int v = 0;
+            for (int i = 0; i < 4; i++) {
+                int d = hexDigit(j.p[i]);
+                if (d < 0) return false;
+                v = v * 16 + d;
+            }
+            if (v == 0 || v >= 0x80) return false;
+            out += (char)v;
+            j.p += 4;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool parseNumber(JsonIn &j, double &v)
+{
+    skipSpace(j);
+    char num[32];
+    size_t n = 0;
+    while (j.p < j.end && n < sizeof(num) - 1 && strchr("0123456789+-.eE", *j.p)) num[n++] = *j.p++;
+    num[n] = '\0';
+    if (n == 0) return false;
+    char *end;
+    v = strtod(num, &end);
+    return *end == '\0' && isfinite(v);
+}
+
+static bool whole(double v, double lo, double hi)
+{
+    return v == floor(v) && v >= lo && v <= hi;
+}
+
+// Store a number in its field; false if it can't be the right type
+static bool setNumber(ConfigChange &c, uint32_t field, double v)
+{
+    switch (field) {
+    case CfgTrendLimit:
+        c.trendLimit = (float)v;
+        return true;
+    case CfgTrendHorizon:
+        if (!whole(v, 0, 4294967295.0)) return false;
+        c.trendHorizon = (uint32_t)v;
+        return true;
+    case CfgTime:
+        if (!whole(v, 0, 4294967295.0)) return false;
+        c.time = (uint32_t)v;
+        return true;
+    case CfgMaxDbm:
+        if (!whole(v, -128, 127)) return false;
+        c.maxDbm = (int8_t)v;
+        return true;
+    }
+    return false;
+}
+
+static std::string *textField(ConfigChange &c, uint32_t field)
+{
+    switch (field) {
+    case CfgNodeId: return &c.nodeId;
+    case CfgApSsid: return &c.apSsid;
+    case CfgApPass: return &c.apPass;
+    case CfgStaSsid: return &c.staSsid;
+    case CfgStaPass: return &c.staPass;
+    case CfgUplink: return &c.uplink;
+    case CfgRoster: return &c.roster;
+    }
+    return nullptr;
+}
+
+bool ConfigChange::parse(const char *json, size_t len, ConfigChange &out, ConfigError &err)
+{
+    out = ConfigChange();
+    JsonIn j = {json, json + len};
+    if (!eat(j, '{')) return fail(err, "", "expected a JSON object");
+    if (!eat(j, '}')) {
+        std::string key;
+        do {
+            skipSpace(j);
+            if (!parseString(j, key)) return fail(err, "", "expected a key");
+            if (!eat(j, ':')) return fail(err, key.c_str(), "expected ':'");
+            size_t k = 0;
+            while (k < sizeof(configKeys) / sizeof(configKeys[0]) && key != configKeys[k].name) k++;
+            if (k == sizeof(configKeys) / sizeof(configKeys[0])) return fail(err, key.c_str(), "unknown key");
+            uint32_t field = configKeys[k].field;
+            if (out.has(field)) return fail(err, key.c_str(), "repeated key");
+            out.fields |= field;
+
+            skipSpace(j);
+            double v;
+            switch (configKeys[k].kind) {
+            case ValueKind::Text:
+                if (!parseString(j, *textField(out, field))) return fail(err, key.c_str(), "expected a string");
+                break;
+            case ValueKind::Flag:
+                if (word(j, "true")) out.staOnly = true;
+                else if (word(j, "false")) out.staOnly = false;
+                else return fail(err, key.c_str(), "expected true or false");
+                break;
+            case ValueKind::NumberOrNull:
+                if (word(j, "null")) {
+                    out.trendLimit = NAN;
+                    break;
+                }
+                // fall through
+            case ValueKind::Number:
+                if (!parseNumber(j, v) || !setNumber(out, field, v)) {
+                    return fail(err, key.c_str(), "expected a number");
+                }
+                break;
+            }
+        } while (eat(j, ','));
+        if (!eat(j, '}')) return fail(err, "", "expected ',' or '}'");
+    }
+    skipSpace(j);
+    if (j.p != j.end) return fail(err, "", "unexpected data after the object");
+    return true;
+}
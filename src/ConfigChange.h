@@ -0,0 +1,90 @@
+#pragma once
+
+// A batch of settings for POST /api/config and the settings forms.
+//
+//   {"roster":"A1B2C3,B2C3D4","trend_limit":-12.5,"max_dbm":14}
+//
+// The whole batch is parsed and validated before any of it is applied. One
+// bad key fails the request, and nothing changes. main.cpp hands a
+// validated change to loop(), which applies it in one pass and writes
+// only the NVS keys whose values differ. Everything takes effect at once
+// except the site WiFi and uplink, which are set up at boot; a change to
+// those schedules a restart after the reply has gone out.
+//
+//   key            type            restart
+//   nodeid         6 letters/digits
+//   ap_ssid        1-32 chars       (AP restarted, radio and log keep going)
+//   ap_pass        8-63 chars
+//   sta_ssid       0-32 chars       yes
+//   sta_pass       "" or 8-63 chars yes
+//   sta_only       true/false       yes
+//   uplink         "" or URL        yes
+//   roster         id,id,... or ""  (NODELIST sent)
+//   trend_limit    C or null (off)
+//   trend_horizon  1-1440 minutes
+//   time           epoch seconds
+//   max_dbm        TX power cap, ADR_MIN_DBM..ADR_MAX_DBM
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "TextBuf.h"
+
+#define CONFIG_ROSTER_MAX 24            // ids; a NODELIST must fit one frame
+#define CONFIG_TIME_MIN   1577836800UL  // 2020-01-01, anything earlier is a mistake
+
+// Settings a change carries, as bits of ConfigChange::fields
+enum ConfigField : uint32_t {
+    CfgNodeId       = 1u << 0,
+    CfgApSsid       = 1u << 1,
+    CfgApPass       = 1u << 2,
+    CfgStaSsid      = 1u << 3,
+    CfgStaPass      = 1u << 4,
+    CfgStaOnly      = 1u << 5,
+    CfgUplink       = 1u << 6,
+    CfgRoster       = 1u << 7,
+    CfgTrendLimit   = 1u << 8,
+    CfgTrendHorizon = 1u << 9,
+    CfgTime         = 1u << 10,
+    CfgMaxDbm       = 1u << 11,
+};
+
+// Set up at boot only
+#define CONFIG_RESTART_FIELDS (CfgStaSsid | CfgStaPass | CfgStaOnly | CfgUplink)
+
+struct ConfigError {
+    char key[24];           // empty if the JSON itself is malformed
+    const char *reason;
+};
+
+struct ConfigChange {
+    uint32_t fields;
+    std::string nodeId;
+    std::string apSsid;
+    std::string apPass;
+    std::string staSsid;
+    std::string staPass;
+    bool staOnly;
+    std::string uplink;
+    std::string roster;
+    float trendLimit;       // NAN: off
+    uint32_t trendHorizon;
+    uint32_t time;
+    int8_t maxDbm;
+
+    ConfigChange();
+
+    bool has(uint32_t f) const { return (fields & f) != 0; }
+    bool needsRestart() const { return has(CONFIG_RESTART_FIELDS); }
+
+    // Check every field present. On failure, err names the first bad key.
+    bool validate(ConfigError &err) const;
+    // The fields present as JSON strings: "roster","time"
+    void names(TextBuf &out) const;
+
+    // Read a flat JSON object of the keys above into out. Returns false
+    // on malformed JSON, an unknown or repeated key, or a value of the
+    // wrong type; err says which. Values are not range-checked here:
+    // call validate().
+    static bool parse(const char *json, size_t len, ConfigChange &out, ConfigError &err);
+};
@@ -1,6 +1,9 @@
 #include "CryptoHelper.h"
 #include <mbedtls/aes.h>
-#include <Arduino.h>
+#include <string.h>
+#ifndef ARDUINO
+#include <random>
+#endif
 
 // --------------------- SHA-256 wrapper ---------------------
 #if defined(mbedtls_sha256_starts_ret)
@@ -13,13 +16,25 @@
 #define SHA256_FINISH(ctx, out) mbedtls_sha256_finish(ctx, out)
 #endif
 
-void CryptoHelper::deriveKey(const String &pass, uint8_t *hash)
+// IV source: hardware RNG on the ESP32, a PRNG seeded once from
+// std::random_device on the host
+static uint8_t randomByte()
+{
+#ifdef ARDUINO
+    return (uint8_t)random(0, 256);
+#else
+    static std::mt19937 gen{std::random_device{}()};
+    return (uint8_t)(gen() & 0xFF);
+#endif
+}
+
+void CryptoHelper::deriveKey(const char *pass, size_t len, uint8_t *hash)
 {
     mbedtls_sha256_context ctx;
     mbedtls_sha256_init(&ctx);
 
     SHA256_START(&ctx, 0);  // 0 = SHA-256, not SHA-224
-    SHA256_UPDATE(&ctx, (const unsigned char*)pass.c_str(), pass.length());
+    SHA256_UPDATE(&ctx, (const unsigned char*)pass, len);
     SHA256_FINISH(&ctx, hash);
 
     mbedtls_sha256_free(&ctx);
@@ -51,7 +66,7 @@ void CryptoHelper::aesEncrypt(const uint8_t *key,
     // Generate random IV
     uint8_t randIV[16];
     for (int i = 0; i < 16; i++) {
-        randIV[i] = (uint8_t)random(0, 256);
+        randIV[i] = randomByte();
     }
 
     // Copy IV to output first
@@ -1,13 +1,22 @@
 #pragma once
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <stddef.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/aes.h>
 
 class CryptoHelper {
 public:
     // Derive SHA-256 hash from a passphrase string
-    static void deriveKey(const String &pass, uint8_t *hash);
+    static void deriveKey(const char *pass, size_t len, uint8_t *hash);
+#ifdef ARDUINO
+    static void deriveKey(const String &pass, uint8_t *hash) {
+        deriveKey(pass.c_str(), pass.length(), hash);
+    }
+#endif
 
     // AES-128-CBC encryption with PKCS7 padding
     static void aesEncrypt(const uint8_t *key,   
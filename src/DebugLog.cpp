@@ -0,0 +1,120 @@
+#include "DebugLog.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+#define LOG_LOCK()   portENTER_CRITICAL(&logMux)
+#define LOG_UNLOCK() portEXIT_CRITICAL(&logMux)
+#else
+#include <mutex>
+static std::mutex logMutex;
+#define LOG_LOCK()   logMutex.lock()
+#define LOG_UNLOCK() logMutex.unlock()
+#endif
+
+static LogRing ring;
+static LogClockFn logClock = nullptr;
+static uint32_t droppedLines = 0;
+
+static const char levelChar[] = {'-', 'E', 'W', 'I', 'D', 'V'};
+
+// ----- LogRing -----
+bool LogRing::push(const char *data, size_t len)
+{
+    if (len > space()) return false;
+    for (size_t i = 0; i < len; i++) {
+        buf[(head + i) % LOG_RING_SIZE] = data[i];
+    }
+    head += len;
+    return true;
+}
+
+size_t LogRing::pop(char *out, size_t cap)
+{
+    size_t n = used() < cap ? used() : cap;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = buf[(tail + i) % LOG_RING_SIZE];
+    }
+    tail += n;
+    return n;
+}
+
+// ----- LogLimit -----
+bool LogLimit::allow(uint32_t nowMs, uint16_t &suppressedOut)
+{
+    suppressedOut = 0;
+    if (nowMs - windowStart >= LOG_RATE_WINDOW_MS) {
+        windowStart = nowMs;
+        suppressedOut = suppressed;
+        sent = 0;
+        suppressed = 0;
+    }
+    if (sent >= LOG_RATE_BURST) {
+        if (suppressed < 0xFFFF) suppressed++;
+        return false;
+    }
+    sent++;
+    return true;
+}
+
+// ----- DebugLog -----
+void DebugLog::begin(LogClockFn clock)
+{
+    logClock = clock;
+}
+
+void DebugLog::write(uint8_t level, LogLimit &limit, const char *fmt, ...)
+{
+    uint32_t ms = logClock ? logClock() : 0;
+    uint16_t suppressed;
+    if (!limit.allow(ms, suppressed)) return;
+
+    char line[LOG_LINE_MAX];
+    int n = snprintf(line, sizeof(line), "[%lu] %c: ", (unsigned long)ms,
+                     levelChar[level <= LOG_LEVEL_VERBOSE ? level : 0]);
+    va_list args;
+    va_start(args, fmt);
+    int m = vsnprintf(line + n, sizeof(line) - n, fmt, args);
+    va_end(args);
+    size_t len = m < 0 ? n : n + m;
+    if (suppressed && len < sizeof(line)) {
+        len += snprintf(line + len, sizeof(line) - len, " (+%u suppressed)", suppressed);
+    }
+    // Truncated lines still end in a newline
+    if (len > sizeof(line) - 2) len = sizeof(line) - 2;
+    line[len++] = '\n';
+
+    LOG_LOCK();
+    bool ok = ring.push(line, len);
+    if (!ok) droppedLines++;
+    LOG_UNLOCK();
+}
+
+size_t DebugLog::drain(char *out, size_t cap)
+{
+    LOG_LOCK();
+    size_t n = ring.pop(out, cap);
+    LOG_UNLOCK();
+    return n;
+}
+
+uint32_t DebugLog::dropped()
+{
+    return droppedLines;
+}
+
+const char *DebugLog::hex(const uint8_t *data, size_t len, char *out, size_t cap)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    size_t pos = 0;
+    for (size_t i = 0; i < len && pos + 3 < cap; i++) {
+        out[pos++] = digits[data[i] >> 4];
+        out[pos++] = digits[data[i] & 0x0F];
+        out[pos++] = ' ';
+    }
+    if (pos > 0) pos--;   // drop the trailing space
+    if (cap > 0) out[pos] = 0;
+    return out;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Levelled diagnostic logging that never blocks the caller.
+//
+// LOG_E/W/I/D/V(fmt, ...) format one line into a RAM ring buffer; a
+// low-priority task (see main.cpp) drains it to Serial. Levels above
+// KIC_LOG_LEVEL compile to nothing, each call site is rate limited to
+// LOG_RATE_BURST lines per LOG_RATE_WINDOW_MS, and a full ring drops the
+// line (counted) rather than waiting for the UART.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_ERROR   1
+#define LOG_LEVEL_WARN    2
+#define LOG_LEVEL_INFO    3
+#define LOG_LEVEL_DEBUG   4
+#define LOG_LEVEL_VERBOSE 5
+
+// Release builds keep INFO and up; build with -DKIC_LOG_LEVEL=4 for debug
+#ifndef KIC_LOG_LEVEL
+#define KIC_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE      2048
+#define LOG_LINE_MAX       160
+#define LOG_RATE_WINDOW_MS 1000UL
+#define LOG_RATE_BURST     5
+
+typedef uint32_t (*LogClockFn)();
+
+// Byte ring of whole lines; not thread-safe on its own
+class LogRing {
+public:
+    LogRing() : head(0), tail(0) {}
+    // All or nothing: false if the line doesn't fit
+    bool push(const char *data, size_t len);
+    // Copy out up to cap bytes; returns the count
+    size_t pop(char *out, size_t cap);
+    size_t used() const { return head - tail; }
+    size_t space() const { return LOG_RING_SIZE - used(); }
+
+private:
+    char buf[LOG_RING_SIZE];
+    size_t head;   // free-running write index
+    size_t tail;   // free-running read index
+};
+
+// Per-call-site token window
+struct LogLimit {
+    uint32_t windowStart;
+    uint16_t sent;
+    uint16_t suppressed;
+
+    // True if this call may log; suppressedOut is set to the number of
+    // lines dropped in the previous window when a new one opens
+    bool allow(uint32_t nowMs, uint16_t &suppressedOut);
+};
+
+class DebugLog {
+public:
+    static void begin(LogClockFn clock);
+    static void write(uint8_t level, LogLimit &limit, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+    // Drain for the output task; safe against concurrent write()
+    static size_t drain(char *out, size_t cap);
+    static uint32_t dropped();
+
+    // "A1 B2 .." into out; for LOG_HEX_D
+    static const char *hex(const uint8_t *data, size_t len, char *out, size_t cap);
+};
+
+#define KIC_LOG_AT(level, ...) do {                 \
+        static LogLimit kicLogLimit_ = {0, 0, 0};   \
+        DebugLog::write(level, kicLogLimit_, __VA_ARGS__); \
+    } while (0)
+
+#if KIC_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) KIC_LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_E(...) do {} while (0)
+#endif
+
+#if KIC_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) KIC_LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_W(...) do {} while (0)
+#endif
+
+#if KIC_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) KIC_LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_I(...) do {} while (0)
+#endif
+
+#if KIC_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) KIC_LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+// Hex dump of a frame, clipped to one line
+#define LOG_HEX_D(label, data, len) do {                                  \
+        char kicLogHex_[LOG_LINE_MAX];                                    \
+        LOG_D("%s (%u bytes): %s", label, (unsigned)(len),                \
+              DebugLog::hex(data, len, kicLogHex_, sizeof(kicLogHex_)));  \
+    } while (0)
+#else
+#define LOG_D(...) do {} while (0)
+#define LOG_HEX_D(label, data, len) do {} while (0)
+#endif
+
+#if KIC_LOG_LEVEL >= LOG_LEVEL_VERBOSE
+#define LOG_V(...) KIC_LOG_AT(LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#else
+#define LOG_V(...) do {} while (0)
+#endif
@@ -0,0 +1,195 @@
+#include "EspHal.h"
+#include "DebugLog.h"
+#include <TimeLib.h>
+#include <LittleFS.h>
+
+// ----- Clock -----
+uint32_t EspClock::millis()
+{
+    return ::millis();
+}
+
+uint32_t EspClock::micros()
+{
+    return ::micros();
+}
+
+time_t EspClock::now()
+{
+    return ::now();
+}
+
+void EspClock::setTime(time_t epoch)
+{
+    ::setTime(epoch);
+}
+
+uint32_t EspClock::random(uint32_t max)
+{
+    return max ? esp_random() % max : 0;
+}
+
+// ----- Radio -----
+int16_t EspRadio::transmit(const uint8_t *data, size_t len)
+{
+    int16_t state = radio.transmit(data, len);
+    if (state == RADIOLIB_ERR_NONE) {
+        LOG_HEX_D("tx", data, len);
+    } else {
+        LOG_W("tx failed: %d", state);
+    }
+
+    // Ensure we always go back into RX mode
+    listen();
+    return state;
+}
+
+int16_t EspRadio::setRate(uint8_t sf, int8_t txDbm)
+{
+    int16_t state = radio.setSpreadingFactor(sf);
+    if (state == RADIOLIB_ERR_NONE) state = radio.setOutputPower(txDbm);
+    if (state == RADIOLIB_ERR_NONE) {
+        LOG_I("rate now SF%u %d dBm", sf, txDbm);
+    } else {
+        LOG_W("rate change to SF%u %d dBm failed: %d", sf, txDbm, state);
+    }
+    listen();
+    return state;
+}
+
+int16_t EspRadio::listen()
+{
+    if (sniffPreamble) return radio.startReceiveDutyCycleAuto(sniffPreamble);
+    return radio.startReceive();
+}
+
+// ----- Preferences -----
+std::string PreferencesStore::getString(const char *key, const char *def)
+{
+    prefs.begin("probe", false);
+    String v = prefs.getString(key, def);
+    prefs.end();
+    return std::string(v.c_str(), v.length());
+}
+
+void PreferencesStore::putString(const char *key, const std::string &value)
+{
+    prefs.begin("probe", false);
+    prefs.putString(key, value.c_str());
+    prefs.end();
+    writeCount++;
+}
+
+uint32_t PreferencesStore::getULong(const char *key, uint32_t def)
+{
+    prefs.begin("probe", false);
+    uint32_t v = prefs.getULong(key, def);
+    prefs.end();
+    return v;
+}
+
+void PreferencesStore::putULong(const char *key, uint32_t value)
+{
+    prefs.begin("probe", false);
+    prefs.putULong(key, value);
+    prefs.end();
+    writeCount++;
+}
+
+// ----- Log file -----
+bool LittleFsLogStore::begin(const char *header)
+{
+    Serial.println("Mounting LittleFS...");
+    if (!LittleFS.begin(true)) {
+        Serial.println("LittleFS Mount Failed");
+        return false;
+    }
+    if (!LittleFS.exists(path)) {
+        File file = LittleFS.open(path, "w");
+        if (file) {
+            file.print(header);
+            file.close();
+        }
+    }
+    return true;
+}
+
+size_t LittleFsLogStore::size() const
+{
+    File f = LittleFS.open(path, "r");
+    if (!f) return 0;
+    size_t n = f.size();
+    f.close();
+    return n;
+}
+
+bool LittleFsLogStore::append(const char *data, size_t len)
+{
+    File f = LittleFS.open(path, FILE_APPEND);
+    if (!f) return false;
+    size_t written = f.write((const uint8_t *)data, len);
+    f.close();
+    return written == len;
+}
+
+// ----- DS18B20 -----
+void DallasSensor::requestConversion()
+{
+    sensors.requestTemperatures();
+}
+
+float DallasSensor::readC(uint8_t index)
+{
+    float t = sensors.getTempCByIndex(index);
+    return t == DEVICE_DISCONNECTED_C ? NAN : t;
+}
+
+void DallasSensor::setResolution(uint8_t bits)
+{
+    // Scratchpad only: the probe's EEPROM isn't worn by every change, and
+    // a power cycle starts it at its stored 12 bits again
+    sensors.setAutoSaveScratchPad(false);
+    sensors.setResolution(bits);
+}
+
+// ----- Uplink -----
+bool HttpUplink::publish(const char *data, size_t len)
+{
+    if (WiFi.status() != WL_CONNECTED) return false;
+    http.setReuse(true);
+    http.setTimeout(UPLINK_TIMEOUT_MS);
+    if (!http.begin(client, target.host.c_str(), target.port, target.path.c_str())) return false;
+    http.addHeader("Content-Type", "application/json");
+    int code = http.POST((uint8_t *)data, len);
+    http.end();   // keeps the socket for the next batch
+    if (code < 200 || code >= 300) {
+        LOG_W("uplink POST failed: %d", code);
+        return false;
+    }
+    return true;
+}
+
+MqttUplink::MqttUplink(const UplinkTarget &target, const std::string &clientId)
+    : target(target), clientId(clientId)
+{
+    mqtt.setClient(client);
+    // PubSubClient keeps the pointer; target is ours for good
+    mqtt.setServer(this->target.host.c_str(), this->target.port);
+    mqtt.setBufferSize(UPLINK_MQTT_BUFFER);
+    mqtt.setSocketTimeout(UPLINK_TIMEOUT_MS / 1000);
+}
+
+bool MqttUplink::publish(const char *data, size_t len)
+{
+    if (WiFi.status() != WL_CONNECTED) return false;
+    if (!mqtt.connected() && !mqtt.connect(clientId.c_str())) {
+        LOG_W("uplink MQTT connect failed: %d", mqtt.state());
+        return false;
+    }
+    return mqtt.publish(target.path.c_str(), (const uint8_t *)data, len, false);
+}
+
+void MqttUplink::poll()
+{
+    if (mqtt.connected()) mqtt.loop();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// ESP32/Arduino implementations of the HAL interfaces in Hal.h.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <RadioLib.h>
+#include <DallasTemperature.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <PubSubClient.h>
+#include "Hal.h"
+#include "Uplink.h"
+
+class EspClock : public Clock {
+public:
+    uint32_t millis() override;
+    uint32_t micros() override;
+    time_t now() override;
+    void setTime(time_t epoch) override;
+    uint32_t random(uint32_t max) override;
+};
+
+// SX1262 transmit that always drops back into RX afterwards
+class EspRadio : public Radio {
+public:
+    explicit EspRadio(SX1262 &radio) : radio(radio), sniffPreamble(0) {}
+    int16_t transmit(const uint8_t *data, size_t len) override;
+    int16_t setRate(uint8_t sf, int8_t txDbm) override;
+
+    // (Re)enter receive: continuous, or preamble-sniffing duty cycle
+    int16_t listen();
+    // Duty-cycle RX sized for senders using this preamble length; 0 = continuous
+    void setDutyCycle(uint16_t senderPreamble) { sniffPreamble = senderPreamble; }
+
+private:
+    SX1262 &radio;
+    uint16_t sniffPreamble;
+};
+
+// NVS "probe" namespace
+class PreferencesStore : public KeyValueStore {
+public:
+    explicit PreferencesStore(Preferences &prefs) : prefs(prefs), writeCount(0) {}
+    std::string getString(const char *key, const char *def) override;
+    void putString(const char *key, const std::string &value) override;
+    uint32_t getULong(const char *key, uint32_t def) override;
+    void putULong(const char *key, uint32_t value) override;
+    // put* calls since boot, for the NVS wear metric
+    uint32_t writes() const { return writeCount; }
+
+private:
+    Preferences &prefs;
+    uint32_t writeCount;
+};
+
+// Temperature log file on LittleFS
+class LittleFsLogStore : public LogStore {
+public:
+    explicit LittleFsLogStore(const char *path) : path(path) {}
+    // Mount LittleFS (formatting if needed) and create the file with
+    // header if it doesn't exist
+    bool begin(const char *header);
+    bool append(const char *data, size_t len) override;
+    size_t size() const;
+
+private:
+    const char *path;
+};
+
+class DallasSensor : public TempSensor {
+public:
+    explicit DallasSensor(DallasTemperature &sensors) : sensors(sensors) {}
+    // Don't wait for conversions: readC() then returns the previous
+    // conversion and the CPU can sleep through the 750 ms instead
+    void setAsync(bool async) { sensors.setWaitForConversion(!async); }
+    void requestConversion() override;
+    float readC(uint8_t index) override;
+    void setResolution(uint8_t bits) override;
+
+private:
+    DallasTemperature &sensors;
+};
+
+#define UPLINK_TIMEOUT_MS   2000
+#define UPLINK_MQTT_BUFFER  2048    // a full batch plus MQTT headers
+
+// POST each batch as application/json; the connection is kept open
+// between batches (HTTP/1.1 keep-alive)
+class HttpUplink : public UplinkTransport {
+public:
+    explicit HttpUplink(const UplinkTarget &target) : target(target) {}
+    bool publish(const char *data, size_t len) override;
+
+private:
+    UplinkTarget target;
+    WiFiClient client;
+    HTTPClient http;
+};
+
+// Publish each batch (QoS 0) on the target topic over one persistent
+// broker connection
+class MqttUplink : public UplinkTransport {
+public:
+    MqttUplink(const UplinkTarget &target, const std::string &clientId);
+    bool publish(const char *data, size_t len) override;
+    void poll() override;
+
+private:
+    UplinkTarget target;
+    std::string clientId;
+    WiFiClient client;
+    PubSubClient mqtt;
+};
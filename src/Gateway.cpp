@@ -0,0 +1,178 @@
+#include "Gateway.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE gatewayMux = portMUX_INITIALIZER_UNLOCKED;
+#define GATEWAY_LOCK()   portENTER_CRITICAL(&gatewayMux)
+#define GATEWAY_UNLOCK() portEXIT_CRITICAL(&gatewayMux)
+#else
+#include <mutex>
+static std::mutex gatewayMutex;
+#define GATEWAY_LOCK()   gatewayMutex.lock()
+#define GATEWAY_UNLOCK() gatewayMutex.unlock()
+#endif
+
+// ----- GatewayRecord -----
+GatewayRecord GatewayRecord::make(GatewayKind kind, const char *id, uint32_t ms, uint32_t epoch)
+{
+    GatewayRecord r;
+    memset(&r, 0, sizeof(r));
+    r.kind = kind;
+    r.ms = ms;
+    r.epoch = epoch;
+    size_t n = strlen(id);
+    memcpy(r.id, id, n < GATEWAY_ID_LEN ? n : GATEWAY_ID_LEN);
+    for (int i = 0; i < 3; i++) r.temp[i] = GATEWAY_NO_VALUE;
+    r.rssi = GATEWAY_NO_VALUE;
+    r.snr = GATEWAY_NO_VALUE;
+    return r;
+}
+
+int16_t GatewayRecord::fixed(float v, float scale)
+{
+    if (isnan(v)) return GATEWAY_NO_VALUE;
+    float x = roundf(v * scale);
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x <= INT16_MIN) return INT16_MIN + 1;
+    return (int16_t)x;
+}
+
+// ----- Gateway -----
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get32(const uint8_t *p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+uint16_t Gateway::crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t Gateway::cobsEncode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code = 0;    // where the current block's length byte goes
+    size_t o = 1;
+    uint8_t run = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[o++] = in[i];
+            run++;
+        }
+        if (in[i] == 0 || run == 0xFF) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    return o;
+}
+
+size_t Gateway::cobsDecode(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < len;) {
+        uint8_t run = in[i++];
+        if (run == 0 || i + run - 1 > len) return 0;
+        for (uint8_t k = 1; k < run; k++) {
+            if (o >= cap || in[i] == 0) return 0;
+            out[o++] = in[i++];
+        }
+        // A short block stands for a zero, except at the very end
+        if (run < 0xFF && i < len) {
+            if (o >= cap) return 0;
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+size_t Gateway::encode(const GatewayRecord &r, uint8_t *out, size_t cap)
+{
+    if (cap < GATEWAY_FRAME_MAX) return 0;
+    uint8_t p[GATEWAY_PAYLOAD_LEN + 2];
+    p[0] = GATEWAY_VERSION;
+    p[1] = (uint8_t)r.kind;
+    put16(p + 2, r.seq);
+    put32(p + 4, r.ms);
+    put32(p + 8, r.epoch);
+    memcpy(p + 12, r.id, GATEWAY_ID_LEN);
+    for (int i = 0; i < 3; i++) put16(p + 18 + 2 * i, (uint16_t)r.temp[i]);
+    put16(p + 24, (uint16_t)r.rssi);
+    put16(p + 26, (uint16_t)r.snr);
+    p[28] = r.sf;
+    p[29] = (uint8_t)r.txDbm;
+    put16(p + GATEWAY_PAYLOAD_LEN, crc16(p, GATEWAY_PAYLOAD_LEN));
+
+    out[0] = 0;
+    size_t n = 1 + cobsEncode(p, sizeof(p), out + 1);
+    out[n++] = 0;
+    return n;
+}
+
+bool Gateway::decode(const uint8_t *seg, size_t len, GatewayRecord &out)
+{
+    uint8_t p[GATEWAY_PAYLOAD_LEN + 2];
+    if (cobsDecode(seg, len, p, sizeof(p)) != sizeof(p)) return false;
+    if (get16(p + GATEWAY_PAYLOAD_LEN) != crc16(p, GATEWAY_PAYLOAD_LEN)) return false;
+    if (p[0] != GATEWAY_VERSION) return false;
+
+    out.kind = (GatewayKind)p[1];
+    out.seq = get16(p + 2);
+    out.ms = get32(p + 4);
+    out.epoch = get32(p + 8);
+    memcpy(out.id, p + 12, GATEWAY_ID_LEN);
+    for (int i = 0; i < 3; i++) out.temp[i] = (int16_t)get16(p + 18 + 2 * i);
+    out.rssi = (int16_t)get16(p + 24);
+    out.snr = (int16_t)get16(p + 26);
+    out.sf = p[28];
+    out.txDbm = (int8_t)p[29];
+    return true;
+}
+
+// ----- GatewayStream -----
+bool GatewayStream::push(GatewayRecord r)
+{
+    // Single writer: only the ring is shared with the output task
+    uint8_t frame[GATEWAY_FRAME_MAX];
+    r.seq = nextSeq++;
+    size_t n = Gateway::encode(r, frame, sizeof(frame));
+
+    GATEWAY_LOCK();
+    bool ok = ring.push((const char *)frame, n);
+    if (!ok) droppedCount++;
+    GATEWAY_UNLOCK();
+    return ok;
+}
+
+size_t GatewayStream::drain(uint8_t *out, size_t cap)
+{
+    GATEWAY_LOCK();
+    size_t n = ring.pop((char *)out, cap);
+    GATEWAY_UNLOCK();
+    return n;
+}
+
+// ----- GatewayReader -----
+GatewayReader::Result GatewayReader::feed(uint8_t b, GatewayRecord &out)
+{
+    if (b != 0) {
+        if (len < sizeof(seg)) seg[len++] = b;
+        else overflow = true;
+        return None;
+    }
+    if (len == 0 && !overflow) return None;
+    bool ok = !overflow && Gateway::decode(seg, len, out);
+    len = 0;
+    overflow = false;
+    return ok ? Record : Junk;
+}
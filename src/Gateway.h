@@ -0,0 +1,99 @@
+#pragma once
+
+// Binary reading stream for a gateway node on USB serial.
+//
+// A gateway (build flag KIC_GATEWAY) emits one record per reading: its own
+// sensor reads, every peer's KIC report and every backfilled sample. Each
+// record is a fixed little-endian payload plus a CRC-16/CCITT, COBS-encoded
+// and framed by 0x00 on both sides. Debug text on the same port contains no
+// zero bytes, so a reader skips it as segments that fail to decode, and a
+// frame cut by a stray print is lost alone.
+//
+// push() encodes into a RAM ring (reusing LogRing) and never waits; the
+// log output task drains it to the UART with the debug lines. Every record
+// takes a sequence number, including ones dropped on a full ring, so the
+// host can count what it lost.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "DebugLog.h"
+
+#define GATEWAY_BAUD         921600
+#define GATEWAY_VERSION      1
+#define GATEWAY_ID_LEN       6
+#define GATEWAY_PAYLOAD_LEN  30                     // without CRC
+#define GATEWAY_FRAME_MAX    (GATEWAY_PAYLOAD_LEN + 2 + 3)   // CRC, COBS, delimiters
+#define GATEWAY_NO_VALUE     INT16_MIN              // missing temp/RSSI/SNR
+
+enum class GatewayKind : uint8_t {
+    Local = 1,      // our own sensor read
+    Report = 2,     // a peer's KIC report, with link quality
+    Backfill = 3    // a peer's quarter-hour sample received late
+};
+
+struct GatewayRecord {
+    GatewayKind kind;
+    uint16_t seq;       // set by GatewayStream::push()
+    uint32_t ms;        // gateway uptime when the reading arrived
+    uint32_t epoch;     // the reading's own timestamp
+    char id[GATEWAY_ID_LEN];   // node id, not terminated
+    int16_t temp[3];    // centi-degrees C
+    int16_t rssi;       // tenths of a dBm (reports only)
+    int16_t snr;        // tenths of a dB (reports only)
+    uint8_t sf;         // sender's announced SF, 0 if unknown
+    int8_t txDbm;
+
+    // A record with every value missing
+    static GatewayRecord make(GatewayKind kind, const char *id, uint32_t ms, uint32_t epoch);
+    // v * scale, rounded and clamped; NaN -> GATEWAY_NO_VALUE
+    static int16_t fixed(float v, float scale);
+};
+
+class Gateway {
+public:
+    // Payload + CRC, COBS-encoded between 0x00 delimiters; returns the
+    // length (0 if cap is too small)
+    static size_t encode(const GatewayRecord &r, uint8_t *out, size_t cap);
+    // One segment between delimiters (no zeros); false unless it is a
+    // well-formed record of this version with a good CRC
+    static bool decode(const uint8_t *seg, size_t len, GatewayRecord &out);
+
+    static size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+    // 0 on a malformed block
+    static size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
+    // CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+    static uint16_t crc16(const uint8_t *data, size_t len);
+};
+
+// The gateway node's outgoing ring. push() runs on the loop task, drain()
+// on the output task.
+class GatewayStream {
+public:
+    GatewayStream() : nextSeq(0), droppedCount(0) {}
+
+    // Number and queue a record; false if the ring was full
+    bool push(GatewayRecord r);
+    size_t drain(uint8_t *out, size_t cap);
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    LogRing ring;
+    uint16_t nextSeq;
+    uint32_t droppedCount;
+};
+
+// Splits a byte stream into segments at 0x00 for the host collector
+class GatewayReader {
+public:
+    enum Result : uint8_t { None, Record, Junk };
+
+    GatewayReader() : len(0), overflow(false) {}
+    // Feed one byte; at a delimiter ending a non-empty segment, returns
+    // Record (out filled) or Junk (debug text, or a damaged frame)
+    Result feed(uint8_t b, GatewayRecord &out);
+
+private:
+    uint8_t seg[GATEWAY_FRAME_MAX];
+    size_t len;
+    bool overflow;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+// Thin hardware abstraction used by the portable node logic.
+// The ESP32 build implements these in EspHal.cpp; host tests and tools
+// provide their own fakes.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+
+class Clock {
+public:
+    virtual ~Clock() {}
+    // Milliseconds since boot (wraps like Arduino millis())
+    virtual uint32_t millis() = 0;
+    // Microseconds since boot (wraps); only used for timing metrics
+    virtual uint32_t micros() { return millis() * 1000UL; }
+    // Wall-clock epoch seconds
+    virtual time_t now() = 0;
+    virtual void setTime(time_t epoch) = 0;
+    // Uniform random number in [0, max)
+    virtual uint32_t random(uint32_t max) = 0;
+};
+
+class Radio {
+public:
+    virtual ~Radio() {}
+    // Send one frame; returns 0 on success or a RadioLib-style error code
+    virtual int16_t transmit(const uint8_t *data, size_t len) = 0;
+    // Switch spreading factor and TX power (LinkAdapt); fixed-rate radios ignore it
+    virtual int16_t setRate(uint8_t sf, int8_t txDbm) { (void)sf; (void)txDbm; return 0; }
+};
+
+class KeyValueStore {
+public:
+    virtual ~KeyValueStore() {}
+    virtual std::string getString(const char *key, const char *def) = 0;
+    virtual void putString(const char *key, const std::string &value) = 0;
+    virtual uint32_t getULong(const char *key, uint32_t def) = 0;
+    virtual void putULong(const char *key, uint32_t value) = 0;
+};
+
+class LogStore {
+public:
+    virtual ~LogStore() {}
+    // Append raw bytes to the temperature log; false if storage failed
+    virtual bool append(const char *data, size_t len) = 0;
+};
+
+class TempSensor {
+public:
+    virtual ~TempSensor() {}
+    // Start a conversion on all probes (blocking on DS18B20 defaults)
+    virtual void requestConversion() = 0;
+    // Last converted value for probe index, NAN if disconnected
+    virtual float readC(uint8_t index) = 0;
+    // Conversion resolution for later reads, 9-12 bits; fixed-resolution
+    // sensors ignore it
+    virtual void setResolution(uint8_t bits) { (void)bits; }
+};
+
+class UplinkTransport {
+public:
+    virtual ~UplinkTransport() {}
+    // Deliver one batch to the site collector; false to retry it later
+    virtual bool publish(const char *data, size_t len) = 0;
+    // Between batches: keep a persistent connection alive
+    virtual void poll() {}
+};
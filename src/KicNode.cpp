@@ -0,0 +1,667 @@
+#include "KicNode.h"
+#include "CryptoHelper.h"
+#include "TempLog.h"
+#include "Airtime.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+KicNode::KicNode(Clock &clock, Radio &radio, KeyValueStore &prefs,
+                 LogStore &log, TempSensor &sensors)
+    : clock(clock), radio(radio), prefs(prefs), log(log), sensors(sensors),
+      rtc(false), needTime(false), localTemp(NAN), probeDown(false),
+      probeBits(SENSOR_BITS_FINE), logFormat(LogFormat::Csv),
+      lastTxStatus(0), adaptive(false),
+      serving(false), serveFrom(0), serveTo(0), backfillSentMs(0), backfillGapMs(0),
+      gateway(nullptr),
+      readTimer(SENSOR_INTERVAL_MS), sendTimer(SEND_INTERVAL_MS, SEND_JITTER_MS),
+      nextLog(0), startMs(0), silenceUntilMs(0), lastCheckinMs(0)
+{
+    memset(key, 0, sizeof(key));
+}
+
+void KicNode::begin(const std::string &id, bool hasRtc, const char *passphrase)
+{
+    nodeID = id;
+    rtc = hasRtc;
+    needTime = !hasRtc;
+    startMs = clock.millis();
+    CryptoHelper::deriveKey(passphrase, strlen(passphrase), key);
+
+    nodeRoster.set(prefs.getString("nodelist", ""));
+    if (nodeRoster.str().empty()) nodeRoster.set(nodeID);
+    silenceUntilMs = prefs.getULong("silenceUntil", 0);
+    lastCheckinMs = prefs.getULong("lastWebCheckin", 0);
+    std::string limit = prefs.getString("trendLimit", "");
+    trends.setLimit(limit.empty() ? NAN : strtof(limit.c_str(), nullptr),
+                    prefs.getULong("trendHorizon", TREND_HORIZON_MIN));
+    // Receivers remember our sequence numbers across our reboots
+    outbox.setNextSeq((uint8_t)prefs.getULong("relSeq", 0));
+    // A cap below the boot power applies before the first report
+    if (link.setMaxDbm((int8_t)prefs.getULong("loraMaxDbm", ADR_MAX_DBM))) {
+        radio.setRate(link.sf(), link.txDbm());
+    }
+
+    // Add self to the node table
+    nodes.update(nodeID, NAN, NAN, NAN, clock.now(), rtc);
+    sendTimer.restart(0, clock.random(SEND_JITTER_MS));
+}
+
+void KicNode::join()
+{
+    // A coarse conversion takes a quarter of the time; the filter asks
+    // for full resolution again on the next read
+    probeBits = SENSOR_BITS_STABLE;
+    sensors.setResolution(probeBits);
+    readSensors();
+    uint32_t ms = clock.millis();
+    readTimer.restart(ms);
+    // Due once the jitter has passed, so nodes powered up together don't
+    // all transmit at once
+    sendTimer.restart(ms - SEND_INTERVAL_MS + clock.random(JOIN_JITTER_MS));
+}
+
+void KicNode::setAdaptiveRate(bool on)
+{
+    adaptive = on;
+    if (!on) return;
+    uint32_t sf = prefs.getULong("loraSf", ADR_BASE_SF);
+    if (sf == ADR_BASE_SF) return;
+    link.resume((uint8_t)sf, clock.millis());
+    radio.setRate(link.sf(), link.txDbm());
+}
+
+LoopEvents KicNode::loop()
+{
+    LoopEvents ev = {false, false, false};
+    uint32_t ms = clock.millis();
+
+    // Read DS18B20 every 5s
+    if (readTimer.due(ms)) {
+        readSensors();
+        readTimer.restart(ms);
+        ev.sensorRead = true;
+        announceDown();
+    }
+
+    // Send report every ~30s, jittered to spread nodes apart
+    if (sendTimer.due(ms)) {
+        broadcastKIC();
+        // Piggy-back on the jittered report slot so requesters spread out
+        // and can overhear each other's BKR
+        requestBackfill();
+        sendTimer.restart(clock.millis(), clock.random(SEND_JITTER_MS));
+        ev.sent = true;
+    }
+
+    logTick(clock.now(), ev);
+
+    if (serving && ms - backfillSentMs >= backfillGapMs) sendBackfill();
+    reliableTick(clock.millis());
+
+    if (adaptive) {
+        uint8_t sf = link.sf();
+        size_t others = nodeRoster.ids().size();
+        if (others > 0 && nodeRoster.contains(nodeID)) others--;
+        if (link.update(ms, others)) radio.setRate(link.sf(), link.txDbm());
+        // Flash only sees SF changes, a handful a day at most
+        if (link.sf() != sf) prefs.putULong("loraSf", link.sf());
+    }
+    return ev;
+}
+
+uint32_t KicNode::msUntilNextEvent()
+{
+    uint32_t ms = clock.millis();
+    uint32_t wait = readTimer.msUntilDue(ms);
+    uint32_t send = sendTimer.msUntilDue(ms);
+    if (send < wait) wait = send;
+
+    uint32_t retry = outbox.msUntilDue(ms);
+    if (retry < wait) wait = retry;
+
+    if (serving) {
+        uint32_t elapsed = ms - backfillSentMs;
+        uint32_t bkf = elapsed >= backfillGapMs ? 0 : backfillGapMs - elapsed;
+        if (bkf < wait) wait = bkf;
+    }
+
+    if (nextLog == 0) return 0;
+    time_t t = clock.now();
+    uint32_t logWait = t >= nextLog ? 0 : (uint32_t)(nextLog - t) * 1000UL;
+    return logWait < wait ? logWait : wait;
+}
+
+float KicNode::sampleProbe()
+{
+    float raw;
+    {
+        MetricScope timing(stats, clock, MetricTimer::Sensor);
+        sensors.requestConversion();
+        raw = sensors.readC(0);
+    }
+    float t = probe.update(raw);
+    if (probe.glitch()) stats.count(MetricCounter::SensorGlitches);
+    // Only on a change: each one is a write to the probe's scratchpad
+    if (probe.bits() != probeBits) {
+        probeBits = probe.bits();
+        sensors.setResolution(probeBits);
+    }
+    return t;
+}
+
+void KicNode::readSensors()
+{
+    localTemp = sampleProbe();
+    probeDown = isnan(localTemp);
+    nodes.update(nodeID, localTemp, NAN, NAN, clock.now(), rtc);
+    float temps[TREND_CHANNELS] = {localTemp, NAN, NAN};
+    trends.add(nodeID, temps, clock.now());
+
+    if (gateway) {
+        GatewayRecord g = GatewayRecord::make(GatewayKind::Local, nodeID.c_str(),
+                                              clock.millis(), (uint32_t)clock.now());
+        g.temp[0] = GatewayRecord::fixed(localTemp, 100.0f);
+        toGateway(g);
+    }
+}
+
+void KicNode::toGateway(const GatewayRecord &r)
+{
+    stats.count(gateway->push(r) ? MetricCounter::GatewayRecords
+                                 : MetricCounter::GatewayDropped);
+}
+
+void KicNode::logTick(time_t t, LoopEvents &ev)
+{
+    if (nextLog == 0) nextLog = TempLog::nextLogEpoch(t);
+    if (t < nextLog) return;
+
+    // Log a fresh reading for ourselves, the last report for everyone else
+    float temp = sampleProbe();
+
+    // Keyed by the slot, not the wake time, so every node names a sample
+    // the same way
+    uint32_t slot = (uint32_t)nextLog;
+    history.push(slot, temp);
+
+    // Backfilled samples that arrived since the last write go first, in
+    // time order. They are older than rows already in the file, which
+    // LogBlockMerger puts back in time order for /log, as long as none
+    // trails the newest row by more than LOGBLOCK_MAX_LATE_SECS
+    std::vector<BackfillRow> &backfilled = logLate;
+    late.take(backfilled);
+    std::vector<LogRow> &rows = logRows;
+    rows.clear();
+    rows.reserve(backfilled.size() + nodes.size());
+    for (const auto &r : backfilled) {
+        if (logFormat == LogFormat::Blocks && r.s.epoch + LOGBLOCK_MAX_LATE_SECS < blocks.latest()) continue;
+        LogRow lr = {r.s.epoch, r.id.c_str(), {r.s.temp, NAN, NAN}};
+        rows.push_back(lr);
+    }
+
+    for (const auto &n : nodes) {
+        // A silent peer's last report is stale; ask for its own sample
+        // for this slot once it is back
+        if (n.id != nodeID && t - n.lastUpdate > NODE_DOWN_SECS) {
+            gaps.missed(n.id, slot);
+            continue;
+        }
+        float t1 = n.id == nodeID ? temp : n.temp1;
+        LogRow lr = {(uint32_t)t, n.id.c_str(), {t1, n.temp2, n.temp3}};
+        rows.push_back(lr);
+    }
+    gaps.expire(clock.millis());
+
+    std::string &out = logText;
+    out.clear();
+    if (logFormat == LogFormat::Blocks) {
+        // One group per distinct timestamp
+        for (size_t i = 0, j; i < rows.size(); i = j) {
+            for (j = i + 1; j < rows.size() && rows[j].epoch == rows[i].epoch; j++) {}
+            blocks.add(rows[i].epoch, &rows[i], j - i, out);
+        }
+    } else {
+        char tstamp[24];
+        char row[96];
+        for (const auto &r : rows) {
+            TempLog::formatTimestamp((time_t)r.epoch, tstamp, sizeof(tstamp));
+            out.append(row, TempLog::formatRow(tstamp, r.id, r.temp[0], r.temp[1], r.temp[2],
+                                               row, sizeof(row)));
+        }
+    }
+    {
+        MetricScope timing(stats, clock, MetricTimer::LogWrite);
+        ev.logged = log.append(out.data(), out.size());
+    }
+    stats.count(ev.logged ? MetricCounter::LogWrites : MetricCounter::LogFailed);
+
+    // Schedule next log
+    nextLog = TempLog::nextLogEpoch(t);
+}
+
+int16_t KicNode::sendEncrypted(const char *msg, size_t len)
+{
+    uint8_t output[MAX_FRAME_LEN];
+    size_t outLen = 0;
+    CryptoHelper::aesEncrypt(key, (const uint8_t *)msg, len, output, outLen);
+    if (outLen == 0) return lastTxStatus = -1;
+    {
+        MetricScope timing(stats, clock, MetricTimer::RadioTx);
+        lastTxStatus = radio.transmit(output, outLen);
+    }
+    stats.count(lastTxStatus == 0 ? MetricCounter::TxFrames : MetricCounter::TxFailed);
+    if (lastTxStatus == 0) chanLoad.add(airtimeUs(outLen), clock.millis());
+    return lastTxStatus;
+}
+
+uint32_t KicNode::airtimeUs(size_t frameLen) const
+{
+    LoRaParams lp = LORA_DEFAULT_PARAMS;
+    lp.sf = link.sf();
+    return Airtime::timeOnAirUs(lp, frameLen);
+}
+
+int16_t KicNode::broadcastKIC()
+{
+    const NodeTemp *nt = nodes.find(nodeID);
+    if (!nt) return -1;   // safety check
+
+    KicReport r = {nt->id, nt->temp1, nt->temp2, nt->temp3,
+                   (uint32_t)nt->lastUpdate, nt->hasrtc, 0, 0, 0};
+    RelAck acks[REL_MAX_ACKS];
+    size_t nAcks = inbox.acks(acks, REL_MAX_ACKS, clock.millis());
+    if (adaptive) {
+        // Fixed-rate nodes skip the tail; peers assume the base rate
+        r.sf = link.sf();
+        r.txDbm = link.txDbm();
+        r.wantSf = link.wantSf();
+    }
+    char msg[MAX_FRAME_LEN];
+    size_t len = Protocol::formatKic(r, msg, sizeof(msg), acks, nAcks);
+    if (len == 0) return -1;
+    inbox.reported(acks, nAcks);
+    return sendEncrypted(msg, len);
+}
+
+int16_t KicNode::sendBackfill()
+{
+    LogSample batch[BACKFILL_BATCH];
+    size_t n = serving ? history.collect(serveFrom, serveTo, batch, BACKFILL_BATCH) : 0;
+    if (n < BACKFILL_BATCH) serving = false;
+    if (n == 0) return -1;
+    serveFrom = batch[n - 1].epoch + 1;
+
+    char msg[MAX_FRAME_LEN];
+    size_t len = Protocol::formatBackfill(nodeID, batch, n, msg, sizeof(msg));
+    if (len == 0) return -1;
+    int16_t status = sendEncrypted(msg, len);
+
+    // Pace on what went on air: IV plus padded ciphertext
+    size_t frameLen = 16 + (len / 16 + 1) * 16;
+    backfillSentMs = clock.millis();
+    backfillGapMs = Backlog::paceMs(airtimeUs(frameLen));
+    stats.count(MetricCounter::BackfillSent, n);
+    return status;
+}
+
+int16_t KicNode::requestBackfill()
+{
+    uint32_t ms = clock.millis();
+    const BackfillGap *g = gaps.due(ms);
+    if (!g) return -1;
+
+    char msg[MAX_FRAME_LEN];
+    size_t len = Protocol::formatBackfillRequest(nodeID, g->id, g->since(), g->until(),
+                                                 msg, sizeof(msg));
+    if (len == 0) return -1;
+    gaps.asked(g->id, g->since(), g->until(), ms);
+    stats.count(MetricCounter::BackfillRequests);
+    return sendEncrypted(msg, len);
+}
+
+int16_t KicNode::broadcastNodeList()
+{
+    char msg[MAX_FRAME_LEN];
+    size_t len = Protocol::formatNodeList(nodeRoster.str(), msg, sizeof(msg));
+    if (len == 0) return -1;
+    return sendReliable(msg, len);
+}
+
+int16_t KicNode::broadcastAlarm(const std::string &downNodeID)
+{
+    char msg[MAX_FRAME_LEN];
+    size_t len = Protocol::formatAlarm(nodeID, downNodeID, msg, sizeof(msg));
+    if (len == 0) return -1;
+    alarmOnAir(nodeID, downNodeID);
+    return sendReliable(msg, len);
+}
+
+void KicNode::alarmOnAir(const std::string &from, const std::string &down)
+{
+    uint32_t ms = clock.millis();
+    for (auto &a : alarmsOnAir) {
+        if (a.down != down) continue;
+        a.from = from;
+        a.ms = ms;
+        return;
+    }
+    PeerAlarm a = {from, down, ms};
+    alarmsOnAir.push_back(a);
+}
+
+int16_t KicNode::sendReliable(const char *msg, size_t len)
+{
+    // Wait for acks from the peers that are on the air right now; a down
+    // node would only run the retries out
+    std::vector<std::string> peers;
+    time_t now = clock.now();
+    for (const auto &nid : nodeRoster.ids()) {
+        const NodeTemp *n = nodes.find(nid);
+        if (nid != nodeID && n && now - n->lastUpdate < NODE_DOWN_SECS) peers.push_back(nid);
+    }
+
+    char frame[MAX_FRAME_LEN];
+    uint8_t seq = outbox.peekSeq();
+    size_t flen = Protocol::formatReliable(nodeID, seq, msg, len, frame, sizeof(frame));
+    if (flen == 0) return -1;
+    outbox.post(std::string(frame, flen), peers, clock.millis());
+    prefs.putULong("relSeq", outbox.peekSeq());
+
+    int16_t status = sendEncrypted(frame, flen);
+    outbox.sent(seq, clock.millis(), clock.random(REL_RETRY_JITTER_MS));
+    stats.count(MetricCounter::ReliableSent);
+    return status;
+}
+
+void KicNode::reliableTick(uint32_t ms)
+{
+    ReliableMsg *m = outbox.due(ms);
+    if (m && chanLoad.percent(ms) >= CHANNEL_BUSY_PCT) {
+        // Retries on a crowded channel collide with the reports that carry
+        // the acks, and make the next node miss more of them. Let the try
+        // pass unsent; the message expires on its usual schedule.
+        outbox.sent(m->seq, ms, clock.random(REL_RETRY_JITTER_MS));
+        stats.count(MetricCounter::ReliableHeld);
+    } else if (m) {
+        uint8_t seq = m->seq;
+        sendEncrypted(m->frame.data(), m->frame.size());
+        outbox.sent(seq, clock.millis(), clock.random(REL_RETRY_JITTER_MS));
+        stats.count(MetricCounter::ReliableRetries);
+    }
+    size_t gaveUp = outbox.expire(ms);
+    if (gaveUp) stats.count(MetricCounter::ReliableExpired, gaveUp);
+}
+
+void KicNode::announceDown()
+{
+    AlarmStatus s;
+    Alarms::evaluate(nodeRoster, nodes, nodeID, clock.now(), listenedSecs(), false, false, s);
+    uint32_t ms = clock.millis();
+
+    for (size_t i = 0; i < alarmsOnAir.size();) {
+        if (ms - alarmsOnAir[i].ms >= ALARM_REPEAT_MS) alarmsOnAir.erase(alarmsOnAir.begin() + i);
+        else i++;
+    }
+
+    for (size_t i = 0; i < notices.size();) {
+        bool still = false;
+        for (const auto &d : s.downNodes) still = still || d == notices[i].id;
+        if (still) i++;
+        else notices.erase(notices.begin() + i);
+    }
+    for (const auto &d : s.downNodes) {
+        // Not yet heard since boot is not "went down"
+        if (!nodes.find(d)) continue;
+        bool known = false;
+        for (const auto &n : notices) known = known || n.id == d;
+        if (known) continue;
+        // Everyone notices at about the same time; a random hold-off lets
+        // the first ALARM stand in for the rest
+        DownNotice n = {d, ms + clock.random(ALARM_HOLDOFF_MS), false};
+        notices.push_back(n);
+    }
+    bool busy = chanLoad.percent(ms) >= CHANNEL_BUSY_PCT;
+    for (auto &n : notices) {
+        if (n.sent || (int32_t)(ms - n.atMs) < 0) continue;
+        // On a busy channel the missed reports are as likely collisions;
+        // give the node longer to turn up before adding to them
+        if (busy && ms - n.atMs < ALARM_BUSY_WAIT_MS) continue;
+        n.sent = true;
+        // Someone (maybe us, before the node last came back) has already
+        // raised it within ALARM_REPEAT_MS: a flapping link would
+        // otherwise cost an ALARM and its retries every time
+        bool reported = false;
+        for (const auto &a : alarmsOnAir) reported = reported || a.down == n.id;
+        if (!reported) broadcastAlarm(n.id);
+    }
+}
+
+RxResult KicNode::onRadioFrame(const uint8_t *data, size_t len, float rssiDbm, float snrDb)
+{
+    MetricScope timing(stats, clock, MetricTimer::RadioRx);
+    chanLoad.add(airtimeUs(len), clock.millis());
+    uint8_t decrypted[MAX_FRAME_LEN];
+    size_t decLen = 0;
+    if (len > sizeof(decrypted) ||
+        !CryptoHelper::aesDecrypt(key, data, len, decrypted, decLen)) {
+        stats.count(MetricCounter::RxDecryptFailed);
+        return RxResult::DecryptFailed;
+    }
+    stats.count(MetricCounter::RxFrames);
+    RxResult res = handleMessage((const char *)decrypted, decLen, rssiDbm, snrDb);
+    if (res == RxResult::Unknown) stats.count(MetricCounter::RxUnknown);
+    else if (res == RxResult::Own) stats.count(MetricCounter::RxOwn);
+    return res;
+}
+
+RxResult KicNode::handleMessage(const char *msg, size_t len, float rssiDbm, float snrDb)
+{
+    Message &m = rx;
+    if (!Protocol::parse(msg, len, m)) return RxResult::Unknown;
+
+    if (m.reliable) {
+        if (m.sender == nodeID) return RxResult::Own;
+        // A repeat only needs acking, which our next report does anyway
+        if (!inbox.accept(m.sender, m.seq, clock.millis())) return RxResult::Handled;
+    }
+
+    switch (m.type) {
+    case MsgType::NodeList:
+        if (nodeRoster.str() != m.arg) setNodeList(m.arg);
+        break;
+    case MsgType::Kic: {
+        // ignore the local node for updating data
+        if (m.kic.id == nodeID) return RxResult::Own;
+        const KicReport &r = m.kic;
+        nodes.update(r.id, r.temp1, r.temp2, r.temp3, (time_t)r.lastUpdate, r.hasrtc);
+        gaps.heard(r.id);
+        // Our clock, not the report's: peers without an RTC drift
+        float temps[TREND_CHANNELS] = {r.temp1, r.temp2, r.temp3};
+        trends.add(r.id, temps, clock.now());
+        for (size_t i = 0; i < peerAlarms.size();) {
+            if (peerAlarms[i].down == r.id) peerAlarms.erase(peerAlarms.begin() + i);
+            else i++;
+        }
+        for (const auto &a : m.acks) {
+            if (a.origin != nodeID) continue;
+            uint32_t before = outbox.acked();
+            outbox.acked(r.id, a.top, a.seen, clock.millis());
+            if (outbox.acked() > before) stats.count(MetricCounter::ReliableAcked, outbox.acked() - before);
+        }
+        if (!isnan(rssiDbm) && !isnan(snrDb)) {
+            link.onFrame(r.id, rssiDbm, snrDb, r.sf, r.txDbm, r.wantSf, clock.millis());
+        }
+        if (gateway) {
+            GatewayRecord g = GatewayRecord::make(GatewayKind::Report, r.id.c_str(),
+                                                  clock.millis(), r.lastUpdate);
+            g.temp[0] = GatewayRecord::fixed(r.temp1, 100.0f);
+            g.temp[1] = GatewayRecord::fixed(r.temp2, 100.0f);
+            g.temp[2] = GatewayRecord::fixed(r.temp3, 100.0f);
+            g.rssi = GatewayRecord::fixed(rssiDbm, 10.0f);
+            g.snr = GatewayRecord::fixed(snrDb, 10.0f);
+            g.sf = r.sf;
+            g.txDbm = r.txDbm;
+            toGateway(g);
+        }
+
+        // if a remote node has RTC and we don't, update time sync
+        if (r.hasrtc && !rtc && needTime) {
+            clock.setTime((time_t)r.lastUpdate);
+            clockChanged();
+            needTime = false;
+        }
+        break;
+    }
+    case MsgType::Backfill:
+        if (m.sender == nodeID) return RxResult::Own;
+        // Only what we skipped; overheard answers to other nodes' requests
+        // mostly repeat rows we already have
+        for (const auto &smp : m.samples) {
+            if (gaps.wants(m.sender, smp.epoch) && late.add(m.sender, smp)) {
+                stats.count(MetricCounter::BackfillMerged);
+                if (gateway) {
+                    GatewayRecord g = GatewayRecord::make(GatewayKind::Backfill, m.sender.c_str(),
+                                                          clock.millis(), smp.epoch);
+                    g.temp[0] = GatewayRecord::fixed(smp.temp, 100.0f);
+                    toGateway(g);
+                }
+            }
+        }
+        gaps.filled(m.sender, m.samples.front().epoch, m.samples.back().epoch,
+                    clock.millis());
+        break;
+    case MsgType::BackfillRequest:
+        if (m.arg == nodeID) {
+            // Serve the union of everything asked for; a repeat restarts
+            // from the earliest slot
+            if (!serving || m.since < serveFrom) serveFrom = m.since;
+            if (!serving || m.until > serveTo) serveTo = m.until;
+            serving = true;
+        } else {
+            gaps.asked(m.arg, m.since, m.until, clock.millis());
+        }
+        break;
+    case MsgType::Alarm: {
+        if (m.arg == nodeID) break;   // evidently not
+        bool known = false;
+        for (auto &p : peerAlarms) {
+            if (p.down != m.arg) continue;
+            p.from = m.sender;
+            p.ms = clock.millis();
+            known = true;
+        }
+        if (!known) {
+            PeerAlarm p = {m.sender, m.arg, clock.millis()};
+            peerAlarms.push_back(p);
+        }
+        alarmOnAir(m.sender, m.arg);
+        break;
+    }
+    default:
+        // TEMP/HEARTBEAT are legacy
+        break;
+    }
+    return RxResult::Handled;
+}
+
+void KicNode::evaluateAlarms(AlarmStatus &out)
+{
+    Alarms::evaluate(nodeRoster, nodes, nodeID, clock.now(), listenedSecs(),
+                     probeDown, silenced(), out);
+    trends.evaluate(clock.now(), out.rising);
+
+    uint32_t ms = clock.millis();
+    for (size_t i = 0; i < peerAlarms.size();) {
+        if (ms - peerAlarms[i].ms > PEER_ALARM_HOLD_MS) {
+            peerAlarms.erase(peerAlarms.begin() + i);
+            continue;
+        }
+        bool ours = false;
+        for (const auto &d : out.downNodes) ours = ours || d == peerAlarms[i].down;
+        if (!ours) out.reportedDown.push_back(peerAlarms[i].down);
+        i++;
+    }
+}
+
+void KicNode::silence(uint32_t ms)
+{
+    silenceUntilMs = clock.millis() + ms;
+    prefs.putULong("silenceUntil", silenceUntilMs);
+}
+
+void KicNode::setTrendLimit(float limitC, uint32_t horizonMin)
+{
+    trends.setLimit(limitC, horizonMin);
+    char buf[16] = "";
+    if (!isnan(limitC)) snprintf(buf, sizeof(buf), "%.1f", limitC);
+    prefs.putString("trendLimit", buf);
+    prefs.putULong("trendHorizon", horizonMin);
+}
+
+void KicNode::setMaxTxDbm(int8_t dbm)
+{
+    if (link.setMaxDbm(dbm)) radio.setRate(link.sf(), link.txDbm());
+    prefs.putULong("loraMaxDbm", (uint32_t)link.maxTxDbm());
+}
+
+void KicNode::clockChanged()
+{
+    // Set back, the slot we were waiting for could be days away; set far
+    // forward, it would be written under a time long gone. A slot that a
+    // small step forward made due is still written.
+    if (nextLog == 0) return;   // nothing scheduled yet
+    time_t t = clock.now();
+    time_t next = TempLog::nextLogEpoch(t);
+    if (nextLog > next || nextLog + LOG_INTERVAL_SECS < t) nextLog = next;
+}
+
+void KicNode::setLogFormat(LogFormat f, size_t fileBytes, const uint8_t *last, size_t lastLen)
+{
+    logFormat = f;
+    blocks.begin(fileBytes, last, lastLen);
+}
+
+bool KicNode::silenced()
+{
+    return clock.millis() < silenceUntilMs;
+}
+
+void KicNode::webCheckin()
+{
+    lastCheckinMs = clock.millis();
+    prefs.putULong("lastWebCheckin", lastCheckinMs);
+}
+
+bool KicNode::setNodeId(const std::string &id)
+{
+    if (id == nodeID) return false;
+    std::string was = nodeID;
+    nodeID = id;
+    nodes.rename(was, id);
+
+    bool listed = nodeRoster.contains(id);
+    std::string list;
+    for (const auto &nid : nodeRoster.ids()) {
+        if (nid == was && listed) continue;
+        if (!list.empty()) list += ",";
+        list += nid == was ? id : nid;
+    }
+    if (list == nodeRoster.str()) return false;
+    setNodeList(list);
+    return true;
+}
+
+void KicNode::setNodeList(const std::string &list)
+{
+    nodeRoster.set(list);
+    prefs.putString("nodelist", list);
+}
+
+bool KicNode::addNode(const std::string &id)
+{
+    if (!nodeRoster.add(id)) return false;
+    prefs.putString("nodelist", nodeRoster.str());
+    return true;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+// Hardware-independent node logic: sensor sampling, KIC report
+// broadcast, packet handling, alarm evaluation and the quarter-hour log.
+// main.cpp drives one instance against the ESP32 HAL; host tests drive
+// it against fakes.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <math.h>
+#include <string>
+#include "Hal.h"
+#include "NodeTable.h"
+#include "Protocol.h"
+#include "Alarms.h"
+#include "Scheduler.h"
+#include "Metrics.h"
+#include "LinkAdapt.h"
+#include "Airtime.h"
+#include "Backfill.h"
+#include "Reliable.h"
+#include "Gateway.h"
+#include "SensorFilter.h"
+#include "TempLog.h"
+#include "LogBlock.h"
+
+#define SENSOR_INTERVAL_MS 5000UL
+#define SEND_INTERVAL_MS   30000UL
+#define SEND_JITTER_MS     5000UL
+#define JOIN_JITTER_MS     250UL      // first report after join(), spread over this
+#define MAX_FRAME_LEN      256
+#define PEER_ALARM_HOLD_MS 600000UL   // show a peer's node-down ALARM this long
+#define ALARM_HOLDOFF_MS   30000UL    // random wait before our own ALARM
+#define ALARM_REPEAT_MS    PEER_ALARM_HOLD_MS  // one ALARM per down node per this, fleet-wide
+#define ALARM_BUSY_WAIT_MS (NODE_DOWN_SECS * 1000UL)  // extra wait on a busy channel
+
+enum class RxResult : uint8_t {
+    Handled,
+    DecryptFailed,
+    Own,        // our own KIC report echoed back
+    Unknown
+};
+
+// What happened during one loop() call
+struct LoopEvents {
+    bool sensorRead;
+    bool sent;
+    bool logged;
+};
+
+class KicNode {
+public:
+    KicNode(Clock &clock, Radio &radio, KeyValueStore &prefs,
+            LogStore &log, TempSensor &sensors);
+
+    // Load persisted roster/silence state and register ourselves
+    void begin(const std::string &id, bool hasRtc, const char *passphrase);
+
+    // Right after boot: take a quick first reading and send the first
+    // report within JOIN_JITTER_MS instead of a full interval from now
+    void join();
+
+    LoopEvents loop();
+    // Time until loop() has timed work to do; lets a driver sleep until then
+    uint32_t msUntilNextEvent();
+
+    // Encrypted frame from the radio; pass the frame's RSSI/SNR to feed
+    // the link-rate controller
+    RxResult onRadioFrame(const uint8_t *data, size_t len,
+                          float rssiDbm = NAN, float snrDb = NAN);
+    // Decrypted plaintext message
+    RxResult handleMessage(const char *msg, size_t len,
+                           float rssiDbm = NAN, float snrDb = NAN);
+
+    // Let LinkAdapt change SF/power (off: stay at the base rate). Call
+    // after begin(); picks up the SF saved before the last reboot.
+    void setAdaptiveRate(bool on);
+    // Copy every reading (own, peers' reports, backfill) to a gateway
+    // stream; nullptr turns it off
+    void setGateway(GatewayStream *g) { gateway = g; }
+
+    int16_t broadcastKIC();
+    // Control messages, acknowledged and retried; see Reliable.h
+    int16_t broadcastNodeList();
+    int16_t broadcastAlarm(const std::string &downNodeID);
+    // Next batch for an outstanding BKR, and our own request for the
+    // first due gap; see Backfill.h. -1 if there was nothing to send.
+    int16_t sendBackfill();
+    int16_t requestBackfill();
+
+    void evaluateAlarms(AlarmStatus &out);
+    void silence(uint32_t ms);
+    // Encoding of the quarter-hour log (CSV by default); fileBytes is the
+    // current size of the log, which Blocks continues at a block boundary;
+    // last/lastLen: the log's last block, see LogBlockWriter::begin
+    void setLogFormat(LogFormat f, size_t fileBytes, const uint8_t *last = nullptr,
+                      size_t lastLen = 0);
+    // Rising-trend warning limit (NAN: off) and horizon, kept in NVS
+    void setTrendLimit(float limitC, uint32_t horizonMin);
+    // Cap on TX power, kept in NVS; a lower cap applies at once
+    void setMaxTxDbm(int8_t dbm);
+    // The clock was set: reschedule the quarter-hour log from the new time
+    void clockChanged();
+    bool silenced();
+    void webCheckin();
+
+    // Renames self in the node table and the roster (kept in NVS), so the
+    // old ID doesn't go on to look like a peer that stopped reporting.
+    // Returns true if the roster changed and should be sent to peers.
+    bool setNodeId(const std::string &id);
+    void setNodeList(const std::string &list);
+    bool addNode(const std::string &id);
+
+    const std::string &id() const { return nodeID; }
+    float myTemp() const { return localTemp; }
+    bool hasRtc() const { return rtc; }
+    bool probeDisconnected() const { return probeDown; }
+    uint8_t sensorBits() const { return probeBits; }
+    uint32_t silenceUntil() const { return silenceUntilMs; }
+    uint32_t lastWebCheckin() const { return lastCheckinMs; }
+    time_t nextLogEpoch() const { return nextLog; }
+    int16_t lastRadioStatus() const { return lastTxStatus; }
+    NodeTable &table() { return nodes; }
+    const Roster &roster() const { return nodeRoster; }
+    Metrics &metrics() { return stats; }
+    const LinkAdapt &linkAdapt() const { return link; }
+    const Backlog &backlog() const { return history; }
+    const BackfillGaps &backfillGaps() const { return gaps; }
+    const ReliableOutbox &reliableOutbox() const { return outbox; }
+    uint8_t channelLoad() { return chanLoad.percent(clock.millis()); }
+    const TrendTracker &trend() const { return trends; }
+
+private:
+    void readSensors();
+    float sampleProbe();
+    void logTick(time_t t, LoopEvents &ev);
+    void announceDown();
+    void alarmOnAir(const std::string &from, const std::string &down);
+    void reliableTick(uint32_t ms);
+    int16_t sendReliable(const char *msg, size_t len);
+    int16_t sendEncrypted(const char *msg, size_t len);
+    uint32_t airtimeUs(size_t frameLen) const;
+    uint32_t listenedSecs() const { return (clock.millis() - startMs) / 1000; }
+    void toGateway(const GatewayRecord &r);
+
+    Clock &clock;
+    Radio &radio;
+    KeyValueStore &prefs;
+    LogStore &log;
+    TempSensor &sensors;
+
+    std::string nodeID;
+    uint8_t key[32];
+    bool rtc;
+    bool needTime;
+    float localTemp;
+    bool probeDown;
+    SensorFilter probe;
+    uint8_t probeBits;
+    TrendTracker trends;
+    LogFormat logFormat;
+    LogBlockWriter blocks;
+    int16_t lastTxStatus;
+
+    NodeTable nodes;
+    Roster nodeRoster;
+    Metrics stats;
+    LinkAdapt link;
+    bool adaptive;
+
+    Backlog history;
+    BackfillGaps gaps;
+    BackfillMerge late;
+    bool serving;            // a BKR for our samples is being answered
+    uint32_t serveFrom;
+    uint32_t serveTo;
+    uint32_t backfillSentMs;
+    uint32_t backfillGapMs;
+
+    struct PeerAlarm {
+        std::string from;
+        std::string down;
+        uint32_t ms;
+    };
+    ReliableOutbox outbox;
+    ReliableInbox inbox;
+    struct DownNotice {
+        std::string id;
+        uint32_t atMs;       // ALARM due, unless a peer's arrives first
+        bool sent;
+    };
+    std::vector<DownNotice> notices;
+    std::vector<PeerAlarm> peerAlarms;
+    std::vector<PeerAlarm> alarmsOnAir;   // last ALARM per down node, ours included
+    ChannelLoad chanLoad;
+
+    GatewayStream *gateway;
+
+    // Kept between calls so receiving and logging reuse their storage
+    // instead of allocating for every frame and every log slot
+    Message rx;
+    std::vector<BackfillRow> logLate;
+    std::vector<LogRow> logRows;
+    std::string logText;
+
+    Interval readTimer;
+    Interval sendTimer;
+    time_t nextLog;
+    uint32_t startMs;        // begin(): alarm grace for peers not yet heard
+
+    uint32_t silenceUntilMs;
+    uint32_t lastCheckinMs;
+};
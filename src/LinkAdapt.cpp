@@ -0,0 +1,223 @@
+#include "LinkAdapt.h"
+#include "Airtime.h"
+#include <math.h>
+
+#define ADR_BW_KHZ       125.0f
+#define ADR_DBM_DOWN_DB  3    // only lower power for a real improvement
+#define ADR_FRAME_BYTES  64   // encrypted KIC report
+
+LinkAdapt::LinkAdapt() : maxDbm(ADR_MAX_DBM)
+{
+    reset();
+}
+
+void LinkAdapt::reset()
+{
+    peers.clear();
+    gone.clear();
+    curSf = ADR_BASE_SF;
+    curDbm = ADR_BASE_DBM < maxDbm ? ADR_BASE_DBM : maxDbm;
+    want = ADR_BASE_SF;
+    lastWant = want;
+    wantSinceMs = 0;
+    lastHeardMs = 0;
+    hunting = false;
+    huntFrom = ADR_BASE_SF;
+    huntStep = 0;
+    lowerSinceMs = 0;
+    lowerPending = false;
+}
+
+void LinkAdapt::onFrame(const std::string &id, float rssi, float snr,
+                        uint8_t peerSf, int8_t peerDbm, uint8_t peerWantSf, uint32_t nowMs)
+{
+    lastHeardMs = nowMs;
+    hunting = false;
+    int8_t dbm = peerSf ? peerDbm : ADR_BASE_DBM;
+    for (auto &p : peers) {
+        if (p.id != id) continue;
+        // Re-reference the average if the peer changed power
+        float step = (float)(dbm - p.txDbm);
+        p.rssi += ADR_EMA_ALPHA * (rssi - (p.rssi + step)) + step;
+        p.snr += ADR_EMA_ALPHA * (snr - (p.snr + step)) + step;
+        p.txDbm = dbm;
+        p.wantSf = peerWantSf;
+        p.heardMs = nowMs;
+        p.sf = peerSf;
+        return;
+    }
+    for (size_t i = 0; i < gone.size(); i++) {
+        if (gone[i].id != id) continue;
+        gone.erase(gone.begin() + i);
+        break;
+    }
+    PeerLink p = {id, rssi, snr, dbm, peerWantSf, nowMs, peerSf};
+    peers.push_back(p);
+}
+
+void LinkAdapt::resume(uint8_t sf, uint32_t nowMs)
+{
+    reset();
+    if (sf < ADR_MIN_SF || sf > ADR_MAX_SF) return;
+    curSf = sf;
+    curDbm = maxDbm;
+    lastHeardMs = nowMs;
+}
+
+bool LinkAdapt::setMaxDbm(int8_t dbm)
+{
+    if (dbm < ADR_MIN_DBM) dbm = ADR_MIN_DBM;
+    if (dbm > ADR_MAX_DBM) dbm = ADR_MAX_DBM;
+    maxDbm = dbm;
+    if (curDbm <= maxDbm) return false;
+    curDbm = maxDbm;
+    return true;
+}
+
+uint8_t LinkAdapt::maxSf(size_t nodes)
+{
+    LoRaParams lp = LORA_DEFAULT_PARAMS;
+    uint8_t sf = ADR_MAX_SF;
+    for (; sf > ADR_MIN_SF; sf--) {
+        lp.sf = sf;
+        uint64_t busyUs = (uint64_t)nodes * Airtime::timeOnAirUs(lp, ADR_FRAME_BYTES);
+        if (busyUs * 100 <= (uint64_t)ADR_REPORT_MS * 1000 * ADR_MAX_LOAD_PCT) break;
+    }
+    return sf;
+}
+
+const PeerLink *LinkAdapt::find(const std::string &id) const
+{
+    for (const auto &p : peers) {
+        if (p.id == id) return &p;
+    }
+    return nullptr;
+}
+
+float LinkAdapt::margin(const PeerLink &p, uint8_t sf, int8_t ourDbm)
+{
+    float offset = (float)(ourDbm - p.txDbm);
+    float rssiMargin = p.rssi + offset - Airtime::sensitivityDbm(sf, ADR_BW_KHZ);
+    float snrMargin = p.snr + offset - Airtime::requiredSnrDb(sf);
+    // SNR saturates on strong links, RSSI hides interference; trust the worse
+    return rssiMargin < snrMargin ? rssiMargin : snrMargin;
+}
+
+bool LinkAdapt::update(uint32_t nowMs, size_t rosterPeers)
+{
+    uint8_t oldSf = curSf;
+    int8_t oldDbm = curDbm;
+
+    for (size_t i = 0; i < peers.size();) {
+        if (nowMs - peers[i].heardMs <= ADR_PEER_TTL_MS) { i++; continue; }
+        // Still on the SF we left it on, or quiet on ours (sf 0 from here)
+        PeerLink p = peers[i];
+        if (p.sf <= curSf) p.sf = 0;
+        gone.push_back(p);
+        peers.erase(peers.begin() + i);
+    }
+    // Roster nodes we have never heard since (re)joining
+    size_t known = peers.size() + gone.size();
+    size_t missing = rosterPeers > known ? rosterPeers - known : 0;
+
+    // Heard nobody on this SF for a while: try the neighbouring SFs, nearest
+    // first (up, down, two up, ...), loudly. The old links were measured on
+    // a rate we've lost, so start afresh.
+    if (rosterPeers > 0 && nowMs - lastHeardMs > ADR_HUNT_MS) {
+        peers.clear();
+        gone.clear();
+        if (!hunting) {
+            hunting = true;
+            huntFrom = curSf;
+            huntStep = 0;
+        }
+        // 0, +1, -1, +2, -2, ... around huntFrom, skipping what's out of range
+        int sf;
+        do {
+            huntStep = (uint8_t)((huntStep + 1) % (2 * (ADR_MAX_SF - ADR_MIN_SF) + 1));
+            int d = (huntStep + 1) / 2;
+            sf = huntFrom + (huntStep & 1 ? d : -d);
+        } while (sf < ADR_MIN_SF || sf > ADR_MAX_SF);
+        curSf = (uint8_t)sf;
+        curDbm = maxDbm;
+        lastHeardMs = nowMs;
+        lowerPending = false;
+    }
+    if (peers.empty()) {
+        want = ADR_BASE_SF;
+        return curSf != oldSf || curDbm != oldDbm;
+    }
+
+    // Lowest SF at which full (allowed) power covers every link with margin
+    want = ADR_MAX_SF;
+    for (uint8_t sf = ADR_MIN_SF; sf <= ADR_MAX_SF; sf++) {
+        bool ok = true;
+        for (const auto &p : peers) {
+            if (margin(p, sf, maxDbm) < ADR_MARGIN_DB) { ok = false; break; }
+        }
+        if (ok) { want = sf; break; }
+    }
+
+    // Past the load cap a higher SF loses more to collisions than it gains
+    // in range
+    uint8_t cap = maxSf(rosterPeers + 1);
+    if (want > cap) want = cap;
+
+    // Our own need only counts once a report has carried it; moving first
+    // would leave everyone else behind on the old SF
+    if (want != lastWant) {
+        lastWant = want;
+        wantSinceMs = nowMs;
+    }
+    uint8_t target = nowMs - wantSinceMs >= ADR_ANNOUNCE_MS ? want : ADR_MIN_SF;
+    for (const auto &p : peers) {
+        if (p.wantSf > target && p.wantSf <= cap) target = p.wantSf;
+    }
+    // Left behind on a higher SF: still counts for what it asked, and if
+    // it hasn't followed by now the fleet has split; go back up to it
+    for (const auto &p : gone) {
+        if (p.sf == 0) continue;
+        if (p.wantSf > target && p.wantSf <= cap) target = p.wantSf;
+        bool split = nowMs - p.heardMs >= ADR_REJOIN_MS;
+        if (split && p.sf > target && p.sf <= cap) target = p.sf;
+    }
+
+    if (target > curSf) {
+        curSf = target;
+        lowerPending = false;
+    } else if (target < curSf && missing > 0) {
+        // Someone is missing; they may need this SF to get back in
+        lowerPending = false;
+    } else if (target < curSf) {
+        if (!lowerPending) {
+            lowerPending = true;
+            lowerSinceMs = nowMs;
+        } else if (nowMs - lowerSinceMs >= ADR_DOWN_HOLD_MS) {
+            curSf = target;
+            lowerPending = false;
+        }
+    } else {
+        lowerPending = false;
+    }
+
+    // Least power that keeps the margin on the weakest link at this SF
+    float need = -1000.0f;
+    for (const auto &p : peers) {
+        float n = ADR_MARGIN_DB - margin(p, curSf, 0);
+        if (n > need) need = n;
+    }
+    int dbm = (int)ceilf(need);
+    if (dbm < ADR_MIN_DBM) dbm = ADR_MIN_DBM;
+    if (dbm > maxDbm) dbm = maxDbm;
+    // A node we have never heard may only hear us at full power
+    if (missing > 0) dbm = maxDbm;
+    if (dbm > curDbm || dbm <= curDbm - ADR_DBM_DOWN_DB) curDbm = (int8_t)dbm;
+
+    // Back on (or past) a left-behind peer's SF: if it doesn't show up
+    // here either, it is just quiet
+    for (auto &p : gone) {
+        if (p.sf <= curSf) p.sf = 0;
+    }
+
+    return curSf != oldSf || curDbm != oldDbm;
+}
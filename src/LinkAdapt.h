@@ -0,0 +1,111 @@
+#pragma once
+
+// Adaptive data rate for the broadcast network.
+//
+// Every KIC report announces the sender's SF, TX power and the SF its own
+// worst link needs. From the RSSI/SNR of received reports each node works
+// out the path loss to every peer, then picks
+//   - the lowest TX power that leaves ADR_MARGIN_DB on its weakest link, and
+//   - the network SF: the highest SF any live node asks for, capped so the
+//     roster's reports fit in ADR_MAX_LOAD_PCT of the channel.
+// All nodes must share one SF to hear each other, so the SF rises as soon
+// as anyone has announced a need for it and falls only after every peer
+// has asked for the lower SF for ADR_DOWN_HOLD_MS, with no roster node
+// still unheard. Nodes do not all lower at the same moment. A peer we
+// moved away from is remembered on the SF it last announced. If it has
+// not followed within ADR_REJOIN_MS, the fleet has split and we go back
+// to its SF: the highest SF wins. A peer that goes quiet on our own SF is
+// most likely down and changes neither the SF nor the power.
+// A node that hears nothing for ADR_HUNT_MS (missed a change, or rebooted
+// onto a stale rate) tries the neighbouring SFs at full power, nearest
+// first, until it catches a report.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define ADR_MIN_SF        7
+#define ADR_MAX_SF        12
+#define ADR_MIN_DBM       2
+#define ADR_MAX_DBM       22          // SX1262 PA limit
+#define ADR_BASE_SF       9           // what setupLoRa() boots with
+#define ADR_BASE_DBM      13
+#define ADR_MARGIN_DB     10.0f       // fade margin kept on the weakest link
+#define ADR_PEER_TTL_MS   300000UL    // forget a link after NODE_DOWN_SECS
+#define ADR_HUNT_MS       75000UL     // > two report intervals per SF
+#define ADR_MAX_LOAD_PCT  20          // channel share the whole roster may use
+#define ADR_REPORT_MS     30000UL     // SEND_INTERVAL_MS
+#define ADR_ANNOUNCE_MS   40000UL     // > one report interval
+#define ADR_DOWN_HOLD_MS  600000UL
+#define ADR_REJOIN_MS     900000UL    // left-behind peer not back on our SF
+#define ADR_EMA_ALPHA     0.3f
+
+struct PeerLink {
+    std::string id;
+    float rssi;        // smoothed dBm at our receiver
+    float snr;         // smoothed dB
+    int8_t txDbm;      // what the peer sent at
+    uint8_t wantSf;    // SF the peer's links need (0 = not announced)
+    uint32_t heardMs;
+    uint8_t sf;        // SF the peer announced (0 = not announced)
+};
+
+class LinkAdapt {
+public:
+    LinkAdapt();
+
+    // Back to the base rate, forgetting all links
+    void reset();
+    // Start from the SF the network last used (e.g. saved across a reboot),
+    // at full power until links are measured again
+    void resume(uint8_t sf, uint32_t nowMs);
+
+    // A frame from peer id at our current SF. peerSf == 0 means the peer
+    // did not announce its rate (assume the base power).
+    void onFrame(const std::string &id, float rssi, float snr,
+                 uint8_t peerSf, int8_t peerDbm, uint8_t peerWantSf, uint32_t nowMs);
+
+    // Highest TX power to use, e.g. a site's regulatory limit; "full
+    // power" above means this. Kept across reset(). True if txDbm() had
+    // to come down to it.
+    bool setMaxDbm(int8_t dbm);
+    int8_t maxTxDbm() const { return maxDbm; }
+
+    // Re-plan SF and power; true if sf() or txDbm() changed. rosterPeers:
+    // how many other nodes should be on the air.
+    bool update(uint32_t nowMs, size_t rosterPeers);
+
+    uint8_t sf() const { return curSf; }
+    int8_t txDbm() const { return curDbm; }
+    uint8_t wantSf() const { return want; }
+
+    const PeerLink *find(const std::string &id) const;
+    const std::vector<PeerLink> &links() const { return peers; }
+    // Peers left behind on a higher SF (sf set), or gone quiet on ours
+    const std::vector<PeerLink> &lost() const { return gone; }
+
+    // Highest SF at which this many nodes reporting every ADR_REPORT_MS
+    // stay within ADR_MAX_LOAD_PCT of the channel
+    static uint8_t maxSf(size_t nodes);
+
+    // Margin (dB) our frames would have at peer p for this SF and power,
+    // assuming a symmetric path
+    static float margin(const PeerLink &p, uint8_t sf, int8_t ourDbm);
+
+private:
+    std::vector<PeerLink> peers;
+    std::vector<PeerLink> gone;   // expired links, until heard again
+    uint8_t curSf;
+    int8_t curDbm;
+    uint8_t want;
+    uint8_t lastWant;
+    uint32_t wantSinceMs;
+    uint32_t lastHeardMs;   // last frame, or last hop while hunting
+    bool hunting;
+    uint8_t huntFrom;       // SF we lost the network on
+    uint8_t huntStep;
+    uint32_t lowerSinceMs;
+    bool lowerPending;
+    int8_t maxDbm;
+};
@@ -0,0 +1,474 @@
+#include "LogBlock.h"
+#include "TempLog.h"
+#include <math.h>
+#include <string.h>
+
+// ----- varints -----
+static void putVarint(std::string &out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static bool getVarint(const uint8_t *p, size_t len, size_t &pos, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= len) return false;
+        uint8_t b = p[pos++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool toCenti(float t, int16_t &c)
+{
+    if (isnan(t) || t < -327.0f || t > 327.0f) return false;
+    c = (int16_t)lroundf(t * 100.0f);
+    return true;
+}
+
+// ----- LogBlockWriter -----
+LogBlockWriter::LogBlockWriter() : used(0), newest(0), padding(0), base(0)
+{
+    memset(&st, 0, sizeof(st));
+}
+
+static void newestRow(void *ctx, const LogRow &row)
+{
+    uint32_t &newest = *(uint32_t *)ctx;
+    if (row.epoch > newest) newest = row.epoch;
+}
+
+void LogBlockWriter::begin(size_t fileBytes, const uint8_t *last, size_t lastLen)
+{
+    used = 0;
+    size_t tail = fileBytes % LOGBLOCK_SIZE;
+    padding = tail ? LOGBLOCK_SIZE - tail : 0;
+    // Rows in earlier blocks are at or before the last block's base
+    uint32_t epoch;
+    if (last && LogBlockReader::baseEpoch(last, lastLen, epoch)) {
+        if (epoch > newest) newest = epoch;
+        LogBlockReader::decode(last, lastLen, newestRow, &newest);
+    }
+}
+
+void LogBlockWriter::startBlock(uint32_t epoch, const LogRow *rows, size_t n, std::string &out)
+{
+    // Backfilled rows are older than rows already written, as is
+    // everything after the clock was set back; a block they open takes
+    // the newest epoch instead, and its first delta goes negative
+    if (epoch < newest) epoch = newest;
+    base = 0;
+    for (size_t i = 0; i < n; i++) {
+        int16_t c;
+        if (toCenti(rows[i].temp[0], c)) {
+            base = c;
+            break;
+        }
+    }
+    memset(&st, 0, sizeof(st));
+    st.prevEpoch = epoch - LOG_INTERVAL_SECS;
+
+    const char head[LOGBLOCK_HEADER] = {
+        'K', 'B', LOGBLOCK_VERSION, 0,
+        (char)epoch, (char)(epoch >> 8), (char)(epoch >> 16), (char)(epoch >> 24),
+        (char)base, (char)((uint16_t)base >> 8)
+    };
+    out.append(head, LOGBLOCK_HEADER);
+    used = LOGBLOCK_HEADER;
+}
+
+bool LogBlockWriter::encodeGroup(uint32_t epoch, const LogRow *rows, size_t n, std::string &g)
+{
+    putVarint(g, (uint32_t)n);
+    putVarint(g, zigzag((int32_t)(epoch - st.prevEpoch - LOG_INTERVAL_SECS)));
+    st.prevEpoch = epoch;
+    for (size_t i = 0; i < n; i++) {
+        const char *id = rows[i].id;
+        uint8_t k = 0;
+        while (k < st.nodes && strcmp(st.ids[k], id) != 0) k++;
+        putVarint(g, k);
+        if (k == st.nodes) {
+            if (st.nodes == LOGBLOCK_MAX_NODES) return false;
+            size_t len = strlen(id);
+            if (len > LOGBLOCK_ID_MAX) len = LOGBLOCK_ID_MAX;
+            memcpy(st.ids[k], id, len);
+            st.ids[k][len] = 0;
+            for (int c = 0; c < 3; c++) st.last[k][c] = base;
+            st.nodes++;
+            g += (char)len;
+            g.append(id, len);
+        }
+        for (int c = 0; c < 3; c++) {
+            int16_t v;
+            if (!toCenti(rows[i].temp[c], v)) {
+                g += (char)0;
+                continue;
+            }
+            putVarint(g, 1 + zigzag(v - st.last[k][c]));
+            st.last[k][c] = v;
+        }
+    }
+    return true;
+}
+
+void LogBlockWriter::add(uint32_t epoch, const LogRow *rows, size_t n, std::string &out)
+{
+    if (padding) {
+        out.append(padding, '\0');
+        padding = 0;
+    }
+    std::string &g = group;
+    size_t i = 0;
+    while (i < n) {
+        if (!used) startBlock(epoch, rows + i, n - i, out);
+        // Try the rest as one group; on overflow, a fresh block, then
+        // fewer rows if even that is too small
+        size_t k = n - i;
+        for (;;) {
+            State saved = st;
+            g.clear();
+            if (encodeGroup(epoch, rows + i, k, g) && used + g.size() <= LOGBLOCK_SIZE) break;
+            st = saved;
+            if (used == LOGBLOCK_HEADER) {
+                k--;
+                continue;
+            }
+            out.append(LOGBLOCK_SIZE - used, '\0');
+            startBlock(epoch, rows + i, n - i, out);
+        }
+        out += g;
+        used += g.size();
+        i += k;
+        if (used == LOGBLOCK_SIZE) used = 0;
+    }
+    if (epoch > newest) newest = epoch;
+}
+
+// ----- LogBlockReader -----
+bool LogBlockReader::baseEpoch(const uint8_t *b, size_t len, uint32_t &epoch)
+{
+    if (len < LOGBLOCK_HEADER || b[0] != 'K' || b[1] != 'B' || b[2] != LOGBLOCK_VERSION) return false;
+    epoch = (uint32_t)b[4] | (uint32_t)b[5] << 8 | (uint32_t)b[6] << 16 | (uint32_t)b[7] << 24;
+    return true;
+}
+
+bool LogBlockReader::decode(const uint8_t *b, size_t len, LogRowFn fn, void *ctx)
+{
+    uint32_t epoch;
+    if (!baseEpoch(b, len, epoch)) return false;
+    if (len > LOGBLOCK_SIZE) len = LOGBLOCK_SIZE;
+    int16_t base = (int16_t)(b[8] | b[9] << 8);
+
+    char ids[LOGBLOCK_MAX_NODES][LOGBLOCK_ID_MAX + 1];
+    int16_t last[LOGBLOCK_MAX_NODES][3];
+    uint8_t nodes = 0;
+    uint32_t prev = epoch - LOG_INTERVAL_SECS;
+
+    size_t pos = LOGBLOCK_HEADER;
+    for (;;) {
+        uint32_t rows, dt;
+        if (pos >= len) return true;        // full block, or the open one
+        if (!getVarint(b, len, pos, rows)) return false;
+        if (rows == 0) return true;         // padding
+        if (!getVarint(b, len, pos, dt)) return false;
+        LogRow r;
+        r.epoch = prev + LOG_INTERVAL_SECS + (uint32_t)unzigzag(dt);
+        prev = r.epoch;
+        for (uint32_t i = 0; i < rows; i++) {
+            uint32_t k;
+            if (!getVarint(b, len, pos, k) || k > nodes) return false;
+            if (k == nodes) {
+                if (nodes == LOGBLOCK_MAX_NODES || pos >= len) return false;
+                uint8_t idLen = b[pos++];
+                if (idLen > LOGBLOCK_ID_MAX || pos + idLen > len) return false;
+                memcpy(ids[k], b + pos, idLen);
+                ids[k][idLen] = 0;
+                pos += idLen;
+                for (int c = 0; c < 3; c++) last[k][c] = base;
+                nodes++;
+            }
+            for (int c = 0; c < 3; c++) {
+                uint32_t v;
+                if (!getVarint(b, len, pos, v)) return false;
+                if (v == 0) {
+                    r.temp[c] = NAN;
+                    continue;
+                }
+                last[k][c] = (int16_t)(last[k][c] + unzigzag(v - 1));
+                r.temp[c] = last[k][c] / 100.0f;
+            }
+            r.id = ids[k];
+            fn(ctx, r);
+        }
+    }
+}
+
+size_t LogBlockReader::seek(size_t blocks, uint32_t from, BaseFn baseOf, void *ctx)
+{
+    // First block whose base is >= from, then one back
+    size_t lo = 0, hi = blocks;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (baseOf(ctx, mid) < from) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+// ----- LogBlockMerger -----
+enum class MergeMode : uint8_t { Main, Scout, Fetch };
+
+// State of one decode pass for LogBlockMerger
+struct MergeDecode {
+    LogBlockMerger *m;
+    MergeMode mode;
+    size_t block;
+    uint32_t runMax;        // newest epoch so far, starting from the base
+    uint16_t i;             // index of the row being delivered
+    // Scout
+    bool prevLate;
+    uint32_t prevEpoch;
+    bool full;
+    // Fetch
+    uint16_t want;
+    bool found;
+    bool more;
+    char *id;
+    LogBlockMerger::Row *out;
+    LogBlockMerger::Row *after;
+
+    static void row(void *ctx, const LogRow &r);
+};
+
+void MergeDecode::row(void *ctx, const LogRow &r)
+{
+    MergeDecode &d = *(MergeDecode *)ctx;
+    LogBlockMerger &m = *d.m;
+    bool late = r.epoch < d.runMax;
+    if (r.epoch > d.runMax) d.runMax = r.epoch;
+    uint16_t i = d.i++;
+    LogBlockMerger::Row row = {r.epoch, {r.temp[0], r.temp[1], r.temp[2]}, 0, late};
+
+    switch (d.mode) {
+    case MergeMode::Main: {
+        if (m.nRows == LOGBLOCK_MAX_ROWS) return;
+        uint8_t k = 0;
+        while (k < m.nIds && strcmp(m.ids[k], r.id) != 0) k++;
+        if (k == m.nIds) strcpy(m.ids[m.nIds++], r.id);
+        row.id = k;
+        m.rows[m.nRows++] = row;
+        break;
+    }
+    case MergeMode::Scout:
+        // A late row starts a run unless it carries on the one before it
+        if (!d.full && i >= m.scoutRow && late && !(d.prevLate && r.epoch >= d.prevEpoch)) {
+            if (m.nRuns == LOGBLOCK_MERGE_RUNS) {
+                d.full = true;
+                m.scoutRow = i;
+            } else {
+                LogBlockMerger::Run run = {d.block, i, r.epoch};
+                m.runs[m.nRuns++] = run;
+            }
+        }
+        d.prevLate = late;
+        d.prevEpoch = r.epoch;
+        break;
+    case MergeMode::Fetch:
+        if (i == d.want) {
+            *d.out = row;
+            if (d.id) strcpy(d.id, r.id);
+            d.found = true;
+        } else if (i == d.want + 1) {
+            *d.after = row;
+            d.more = true;
+        }
+        break;
+    }
+}
+
+LogBlockMerger::LogBlockMerger()
+    : read(nullptr), ctx(nullptr), blocks(0), from(0), bufLen(0), bufBlock(0),
+      mainBlock(0), nRows(0), at(0), nIds(0),
+      scouted(0), scoutRow(0), carryLate(false), carryEpoch(0), nRuns(0)
+{
+    outId[0] = 0;
+}
+
+uint32_t LogBlockMerger::baseFn(void *self, size_t block)
+{
+    return ((LogBlockMerger *)self)->baseOf(block);
+}
+
+void LogBlockMerger::begin(size_t n, uint32_t f, ReadFn r, void *c)
+{
+    read = r;
+    ctx = c;
+    blocks = n;
+    from = f;
+    bufBlock = blocks;
+    bufLen = 0;
+    size_t start = from ? LogBlockReader::seek(blocks, from, baseFn, this) : 0;
+    mainBlock = start;
+    nRows = 0;
+    at = 0;
+    nIds = 0;
+    scouted = start;
+    scoutRow = 0;
+    carryLate = false;
+    carryEpoch = 0;
+    nRuns = 0;
+}
+
+size_t LogBlockMerger::readBlock(size_t block)
+{
+    if (bufBlock != block) {
+        bufLen = read(ctx, block, buf);
+        bufBlock = block;
+    }
+    return bufLen;
+}
+
+uint32_t LogBlockMerger::baseOf(size_t block)
+{
+    uint32_t epoch = 0;
+    LogBlockReader::baseEpoch(buf, readBlock(block), epoch);
+    return epoch;
+}
+
+void LogBlockMerger::scoutBlock()
+{
+    MergeDecode d = MergeDecode();
+    d.m = this;
+    d.mode = MergeMode::Scout;
+    d.block = scouted;
+    d.runMax = baseOf(scouted);
+    d.prevLate = carryLate;
+    d.prevEpoch = carryEpoch;
+    LogBlockReader::decode(buf, bufLen, MergeDecode::row, &d);
+    // Out of room for runs: the rest of the block once some have ended
+    if (d.full) return;
+    scouted++;
+    scoutRow = 0;
+    carryLate = d.prevLate;
+    carryEpoch = d.prevEpoch;
+}
+
+LogBlockMerger::MainState LogBlockMerger::loadMain()
+{
+    for (;;) {
+        while (at < nRows && (rows[at].late || rows[at].epoch < from)) at++;
+        if (at < nRows) return MainReady;
+        if (mainBlock >= blocks) return MainEnd;
+        // A block's runs are found before any of its other rows go out
+        if (scouted <= mainBlock) {
+            if (nRuns == LOGBLOCK_MERGE_RUNS) return MainBlocked;
+            scoutBlock();
+            continue;
+        }
+        MergeDecode d = MergeDecode();
+        d.m = this;
+        d.mode = MergeMode::Main;
+        d.block = mainBlock;
+        d.runMax = baseOf(mainBlock);
+        nRows = 0;
+        at = 0;
+        nIds = 0;
+        LogBlockReader::decode(buf, bufLen, MergeDecode::row, &d);
+        mainBlock++;
+    }
+}
+
+bool LogBlockMerger::fetch(size_t block, uint16_t i, Row &out, char *id, bool &more, Row &after)
+{
+    MergeDecode d = MergeDecode();
+    d.m = this;
+    d.mode = MergeMode::Fetch;
+    d.block = block;
+    d.runMax = baseOf(block);
+    d.want = i;
+    d.id = id;
+    d.out = &out;
+    d.after = &after;
+    LogBlockReader::decode(buf, bufLen, MergeDecode::row, &d);
+    more = d.more;
+    return d.found;
+}
+
+bool LogBlockMerger::takeRun(size_t k, LogRow &row)
+{
+    Run &run = runs[k];
+    Row cur, after;
+    bool more;
+    bool ok = fetch(run.block, run.row, cur, outId, more, after);
+    if (ok) {
+        row.epoch = cur.epoch;
+        row.id = outId;
+        for (int c = 0; c < 3; c++) row.temp[c] = cur.temp[c];
+        if (more) {
+            run.row++;
+        } else if (run.block + 1 < blocks) {
+            bool rest;
+            Row skip;
+            more = fetch(run.block + 1, 0, after, nullptr, rest, skip);
+            run.block++;
+            run.row = 0;
+        }
+    }
+    // The run goes on while the rows after it stay late and in order
+    if (ok && more && after.late && after.epoch >= cur.epoch) {
+        run.epoch = after.epoch;
+    } else {
+        memmove(&runs[k], &runs[k + 1], (nRuns - k - 1) * sizeof(Run));
+        nRuns--;
+    }
+    return ok;
+}
+
+bool LogBlockMerger::next(LogRow &row)
+{
+    for (;;) {
+        MainState ms = loadMain();
+        // The earliest run; the first found wins a tie
+        size_t k = nRuns;
+        for (size_t j = 0; j < nRuns; j++) {
+            if (k == nRuns || runs[j].epoch < runs[k].epoch) k = j;
+        }
+        if (ms != MainReady && k == nRuns) return false;
+        bool fromRun = k < nRuns && (ms != MainReady || runs[k].epoch < rows[at].epoch);
+        uint32_t epoch = fromRun ? runs[k].epoch : rows[at].epoch;
+
+        // Scout until no unread row can be older than this one
+        if (scouted < blocks && nRuns < LOGBLOCK_MERGE_RUNS &&
+            baseOf(scouted) <= epoch + LOGBLOCK_MAX_LATE_SECS) {
+            scoutBlock();
+            continue;
+        }
+
+        if (fromRun) {
+            if (!takeRun(k, row) || row.epoch < from) continue;
+            return true;
+        }
+        const Row &r = rows[at++];
+        strcpy(outId, ids[r.id]);
+        row.epoch = r.epoch;
+        row.id = outId;
+        for (int c = 0; c < 3; c++) row.temp[c] = r.temp[c];
+        return true;
+    }
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+// Compact binary encoding of the quarter-hour temperature log.
+//
+// The file is a run of LOGBLOCK_SIZE-byte blocks, so block k starts at
+// k * LOGBLOCK_SIZE and each one decodes without the others. A block
+// begins with a 10-byte header:
+//
+//   "KB", version, 0, base epoch (u32 LE), base centi-degrees (i16 LE)
+//
+// followed by groups of rows that share a timestamp:
+//
+//   varint rows (0 ends the block; the rest is zero padding)
+//   zigzag varint  epoch - previous group's epoch - LOG_INTERVAL_SECS
+//   rows x { varint node index,
+//            [if index is new in this block: length byte, id bytes],
+//            3 x varint channel }
+//
+// The first group's "previous epoch" is base - LOG_INTERVAL_SECS, so a
+// steady quarter-hour cadence costs one byte. The base is the first
+// group's epoch, or the newest epoch written so far if that is later
+// (a block opened by backfilled rows, or after the clock was set back).
+// Bases therefore never decrease, and every row in earlier blocks is at
+// or before a block's base, which is what LogBlockReader::seek relies on.
+// The writer picks the newest epoch up from the last block after a
+// reboot, so this holds across reboots too. A channel is 0 for NAN
+// (no probe, or disconnected), else 1 + zigzag of the change in
+// centi-degrees since that node and channel's last value in the block
+// (initially the base). A steady reading takes one byte.
+//
+// A typical row is 4 bytes against ~40 for its CSV text. The writer only
+// appends; a block that can't take the next group is padded out and a
+// new one started, as is the last block after a reboot.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define LOGBLOCK_SIZE       512
+#define LOGBLOCK_HEADER     10
+#define LOGBLOCK_VERSION    1
+#define LOGBLOCK_MAX_NODES  32      // distinct ids per block
+#define LOGBLOCK_ID_MAX     15
+#define LOGBLOCK_MAX_ROWS   128     // (512 - 10) / 4: a row takes at least 4 bytes
+#define LOGBLOCK_MAX_LATE_SECS 93600UL  // 26 h: how far a backfilled row may trail the newest
+#define LOGBLOCK_MERGE_RUNS 128     // runs of late rows LogBlockMerger follows at once
+
+struct LogRow {
+    uint32_t epoch;
+    const char *id;
+    float temp[3];
+};
+
+class LogBlockWriter {
+public:
+    LogBlockWriter();
+
+    // Continue a file of this many bytes: the first add() pads out its
+    // last block rather than append to it. last/lastLen: that block (the
+    // file from its start), from which the newest epoch so far is read
+    void begin(size_t fileBytes, const uint8_t *last = nullptr, size_t lastLen = 0);
+
+    // Encode rows that share one epoch and append the bytes to out
+    void add(uint32_t epoch, const LogRow *rows, size_t n, std::string &out);
+    // Latest epoch in the file: added, or read by begin()
+    uint32_t latest() const { return newest; }
+
+private:
+    struct State {
+        uint32_t prevEpoch;
+        uint8_t nodes;
+        char ids[LOGBLOCK_MAX_NODES][LOGBLOCK_ID_MAX + 1];
+        int16_t last[LOGBLOCK_MAX_NODES][3];
+    };
+
+    void startBlock(uint32_t epoch, const LogRow *rows, size_t n, std::string &out);
+    // Encode up to n rows as one group; false if a new id won't fit
+    bool encodeGroup(uint32_t epoch, const LogRow *rows, size_t n, std::string &g);
+
+    size_t used;        // bytes in the open block, 0 if none
+    uint32_t newest;    // latest epoch in the file
+    size_t padding;     // owed by begin() to finish a partial block
+    int16_t base;
+    State st;
+    std::string group;  // one group being encoded, kept for its storage
+};
+
+// Called once per row; id is only valid during the call
+typedef void (*LogRowFn)(void *ctx, const LogRow &row);
+
+class LogBlockReader {
+public:
+    // Rows of one block, in file order (time order, apart from backfilled
+    // rows written late: see LogBlockMerger); false if the block is not one
+    // of ours or is cut short (rows before the fault are still delivered)
+    static bool decode(const uint8_t *block, size_t len, LogRowFn fn, void *ctx);
+    static bool baseEpoch(const uint8_t *block, size_t len, uint32_t &epoch);
+
+    // Index of the block to start reading at for rows from epoch 'from'
+    // on: the last block whose base is earlier. baseOf returns a block's
+    // base epoch; bases never decrease (see above).
+    typedef uint32_t (*BaseFn)(void *ctx, size_t block);
+    static size_t seek(size_t blocks, uint32_t from, BaseFn baseOf, void *ctx);
+};
+
+// Rows of a block log in time order, for export.
+//
+// Backfilled rows are written with a later quarter hour (see
+// KicNode::logTick), so they follow newer rows in the file. A row is
+// late if it is older than the block's base or a row before it in the
+// block; consecutive late rows in time order form a run. KicNode keeps
+// late rows within LOGBLOCK_MAX_LATE_SECS of the newest row.
+//
+// The merger reads the file once in order for the rows that are not
+// late, and keeps a cursor on every run it has found. Before it returns
+// a row it scouts ahead until the next unread block's base is more than
+// LOGBLOCK_MAX_LATE_SECS later, so no unread row can be older. Equal
+// times come in file order. The state is fixed size (about 5 KB) and
+// costs one extra block decode per late row.
+//
+// KicNode writes at most one run per quarter hour, so fewer than
+// LOGBLOCK_MERGE_RUNS fall within the look-ahead. With more, and for
+// rows logged after the clock was set back over earlier ones (they trail
+// by more than the look-ahead), every row still comes out once, but
+// some may follow newer rows.
+class LogBlockMerger {
+public:
+    // Read block i into buf (LOGBLOCK_SIZE bytes); bytes read
+    typedef size_t (*ReadFn)(void *ctx, size_t block, uint8_t *buf);
+
+    LogBlockMerger();
+
+    // Rows from epoch 'from' on, out of a log of this many blocks
+    void begin(size_t blocks, uint32_t from, ReadFn read, void *ctx);
+    // The next row; false once there are none left. row.id is valid until
+    // the next call.
+    bool next(LogRow &row);
+
+private:
+    struct Row {
+        uint32_t epoch;
+        float temp[3];
+        uint8_t id;
+        bool late;
+    };
+    struct Run {
+        size_t block;
+        uint16_t row;       // its next row
+        uint32_t epoch;     // that row's epoch
+    };
+    enum MainState { MainReady, MainBlocked, MainEnd };
+
+    MainState loadMain();
+    void scoutBlock();
+    size_t readBlock(size_t block);
+    uint32_t baseOf(size_t block);
+    static uint32_t baseFn(void *self, size_t block);
+    // Row i of a block, its id copied to id unless that is null; more
+    // says whether row i + 1 exists, and after holds it if so
+    bool fetch(size_t block, uint16_t i, Row &out, char *id, bool &more, Row &after);
+    // Return run k's next row and move it on; false if the row is gone
+    bool takeRun(size_t k, LogRow &row);
+
+    ReadFn read;
+    void *ctx;
+    size_t blocks;
+    uint32_t from;
+    uint8_t buf[LOGBLOCK_SIZE];
+    size_t bufLen;
+    size_t bufBlock;            // block held in buf, or blocks if none
+
+    // Rows that are not late, a block at a time
+    size_t mainBlock;           // next block to decode
+    Row rows[LOGBLOCK_MAX_ROWS];
+    uint16_t nRows;
+    uint16_t at;
+    char ids[LOGBLOCK_MAX_NODES][LOGBLOCK_ID_MAX + 1];
+    uint8_t nIds;
+
+    // Runs of late rows, in file order
+    size_t scouted;             // blocks fully scouted
+    uint16_t scoutRow;          // rows of block 'scouted' already scouted
+    bool carryLate;             // the last row of the block before it
+    uint32_t carryEpoch;
+    Run runs[LOGBLOCK_MERGE_RUNS];
+    size_t nRuns;
+
+    char outId[LOGBLOCK_ID_MAX + 1];
+
+    friend struct MergeDecode;
+};
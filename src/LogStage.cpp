@@ -0,0 +1,113 @@
+#include "LogStage.h"
+#include <string.h>
+
+// Header bytes covered by the CRC: fileEnd through spare
+#define LOGSTAGE_HEADER (offsetof(LogStageArea, data) - offsetof(LogStageArea, fileEnd))
+
+StagedLogStore::StagedLogStore(LogStageArea &area, LogStore &flash, Clock &clock)
+    : area(area), flash(flash), clock(clock), writes(0)
+{
+}
+
+uint32_t StagedLogStore::crc32(const uint8_t *data, size_t len, uint32_t crc)
+{
+    // Reflected CRC-32 (poly 0xEDB88320), bitwise: the area is small and
+    // only sealed once per append
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+bool StagedLogStore::valid() const
+{
+    if (area.magic != LOGSTAGE_MAGIC || area.used > LOGSTAGE_BYTES) return false;
+    uint32_t crc = crc32((const uint8_t *)&area.fileEnd, LOGSTAGE_HEADER);
+    return crc32(area.data, area.used, crc) == area.crc;
+}
+
+void StagedLogStore::seal()
+{
+    area.magic = LOGSTAGE_MAGIC;
+    uint32_t crc = crc32((const uint8_t *)&area.fileEnd, LOGSTAGE_HEADER);
+    area.crc = crc32(area.data, area.used, crc);
+}
+
+void StagedLogStore::reset(size_t flashBytes)
+{
+    area.fileEnd = (uint32_t)flashBytes;
+    area.since = 0;
+    area.used = 0;
+    area.spare = 0;
+    seal();
+}
+
+size_t StagedLogStore::begin(size_t flashBytes)
+{
+    // A valid area whose bytes follow on from (or partly overlap) the
+    // file; anything else is power-on noise or a replaced log
+    if (!valid() || flashBytes < area.fileEnd || flashBytes > area.fileEnd + area.used) {
+        reset(flashBytes);
+        return 0;
+    }
+    drop(flashBytes - area.fileEnd);
+    return area.used;
+}
+
+void StagedLogStore::drop(size_t n)
+{
+    if (n == 0) return;
+    memmove(area.data, area.data + n, area.used - n);
+    area.used = (uint16_t)(area.used - n);
+    area.fileEnd += (uint32_t)n;
+    // What's left is at most a block's tail; don't let its age force an
+    // early write
+    area.since = (uint32_t)clock.now();
+    seal();
+}
+
+bool StagedLogStore::write(size_t n)
+{
+    if (n == 0) return true;
+    if (!flash.append((const char *)area.data, n)) return false;
+    writes++;
+    drop(n);
+    return true;
+}
+
+bool StagedLogStore::flush()
+{
+    return write(area.used);
+}
+
+bool StagedLogStore::append(const char *data, size_t len)
+{
+    if (area.used + len > LOGSTAGE_BYTES) {
+        // Whole pages first; the rest only if there still isn't room
+        size_t end = size();
+        size_t cut = end - end % LOGSTAGE_PAGE;
+        if (cut > area.fileEnd && !write(cut - area.fileEnd)) return false;
+        if (area.used + len > LOGSTAGE_BYTES && !flush()) return false;
+    }
+    if (len > LOGSTAGE_BYTES) {
+        // Bigger than the buffer (which is empty by now): straight through
+        if (!flash.append(data, len)) return false;
+        writes++;
+        area.fileEnd += (uint32_t)len;
+        seal();
+        return true;
+    }
+
+    uint32_t now = (uint32_t)clock.now();
+    if (area.used == 0) area.since = now;
+    memcpy(area.data + area.used, data, len);
+    area.used = (uint16_t)(area.used + len);
+    seal();
+
+    // Staged and safe across resets; a write failure here is retried on
+    // the next append
+    if (now - area.since >= LOGSTAGE_MAX_AGE_SECS) flush();
+    return true;
+}
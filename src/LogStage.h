@@ -0,0 +1,73 @@
+#pragma once
+
+// Write-back staging for the temperature log.
+//
+// Quarter-hour appends go into a small buffer instead of straight to
+// LittleFS, which rewrites file metadata on every append. The buffer is
+// written out only when the next append would not fit, when its oldest
+// byte is LOGSTAGE_MAX_AGE_SECS old, or on an orderly shutdown (flush()).
+// A full-buffer write stops at the last LOGSTAGE_PAGE boundary of the
+// file, so flash sees whole log blocks and the tail stays staged.
+//
+// On the ESP32 the area lives in RTC slow memory (RTC_NOINIT_ATTR), which
+// keeps its contents across ESP.restart(), watchdog and brownout resets.
+// A CRC over the area tells a surviving buffer from power-on garbage, and
+// fileEnd records the file size the staged bytes follow, so a reset
+// between the flash write and the buffer update never logs a byte twice.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Hal.h"
+#include "LogBlock.h"
+
+#define LOGSTAGE_BYTES          2048            // RTC slow memory is 8 KB
+#define LOGSTAGE_PAGE           LOGBLOCK_SIZE   // two 256-byte flash pages
+#define LOGSTAGE_MAX_AGE_SECS   (6 * 3600UL)    // bounds a power cut's loss
+#define LOGSTAGE_MAGIC          0x4B4C5354      // "KLST"
+
+struct LogStageArea {
+    uint32_t magic;
+    uint32_t crc;           // CRC-32 of the fields below and data[0, used)
+    uint32_t fileEnd;       // flash log size the staged bytes follow
+    uint32_t since;         // epoch of the oldest staged byte
+    uint16_t used;
+    uint16_t spare;
+    uint8_t data[LOGSTAGE_BYTES];
+};
+
+class StagedLogStore : public LogStore {
+public:
+    StagedLogStore(LogStageArea &area, LogStore &flash, Clock &clock);
+
+    // At boot, with the flash log's size: keep what a valid area still
+    // holds beyond it, else start empty. Returns the bytes kept.
+    size_t begin(size_t flashBytes);
+
+    bool append(const char *data, size_t len) override;
+    // Write out everything staged, e.g. before a restart
+    bool flush();
+
+    // The log as a reader sees it: the flash file, then staged()
+    size_t size() const { return area.fileEnd + area.used; }
+    size_t flashBytes() const { return area.fileEnd; }
+    const uint8_t *staged() const { return area.data; }
+    size_t stagedBytes() const { return area.used; }
+    // Flash appends since boot
+    uint32_t flashWrites() const { return writes; }
+
+    static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+private:
+    bool valid() const;
+    void seal();
+    void reset(size_t flashBytes);
+    // Drop the first n staged bytes, already in the flash file
+    void drop(size_t n);
+    // Append the first n staged bytes to flash
+    bool write(size_t n);
+
+    LogStageArea &area;
+    LogStore &flash;
+    Clock &clock;
+    uint32_t writes;
+};
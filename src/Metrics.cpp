@@ -0,0 +1,150 @@
+#include "Metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t Metrics::bucketBoundsUs[METRICS_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+// The same bounds as Prometheus `le` labels (seconds)
+static const char *const bucketLabels[METRICS_BUCKETS + 1] = {
+    "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+    "0.01", "0.025", "0.05", "0.1", "0.25", "1", "+Inf"
+};
+
+struct MetricInfo {
+    const char *name;
+    const char *help;
+};
+
+static const MetricInfo timerInfo[(int)MetricTimer::Count] = {
+    {"kic_loop_seconds", "Duration of one main loop pass"},
+    {"kic_sensor_seconds", "DS18B20 conversion and read"},
+    {"kic_radio_rx_seconds", "Decrypt, parse and apply one received frame"},
+    {"kic_radio_tx_seconds", "Blocking transmit of one frame"},
+    {"kic_log_write_seconds", "Quarter-hour log append"},
+    {"kic_web_request_seconds", "HTTP request handler"},
+};
+
+static const MetricInfo counterInfo[(int)MetricCounter::Count] = {
+    {"kic_radio_rx_frames_total", "Frames received and decrypted"},
+    {"kic_radio_rx_decrypt_failed_total", "Frames that failed to decrypt"},
+    {"kic_radio_rx_unknown_total", "Decrypted frames with an unknown message"},
+    {"kic_radio_rx_own_total", "Own KIC reports heard back"},
+    {"kic_radio_rx_crc_errors_total", "Frames with a bad CRC (mostly collisions)"},
+    {"kic_radio_rx_errors_total", "Other radio receive errors"},
+    {"kic_radio_tx_frames_total", "Frames transmitted"},
+    {"kic_radio_tx_failed_total", "Failed transmits"},
+    {"kic_log_writes_total", "Log appends"},
+    {"kic_log_failed_total", "Failed log appends"},
+    {"kic_log_flash_writes_total", "Staged log data written to flash"},
+    {"kic_nvs_writes_total", "Preferences (NVS) writes"},
+    {"kic_debug_log_dropped_total", "Debug log lines dropped on a full ring"},
+    {"kic_backfill_requests_total", "Backfill requests sent for gaps in the log"},
+    {"kic_backfill_sent_samples_total", "Own samples sent in answer to backfill requests"},
+    {"kic_backfill_merged_samples_total", "Backfilled peer samples queued for the log"},
+    {"kic_reliable_sent_total", "Control messages sent for acknowledged delivery"},
+    {"kic_reliable_retries_total", "Control message retransmissions"},
+    {"kic_reliable_acked_total", "Control messages acknowledged by every peer"},
+    {"kic_reliable_expired_total", "Control messages given up with peers still unacked"},
+    {"kic_reliable_held_total", "Control message retries skipped on a busy channel"},
+    {"kic_gateway_records_total", "Readings queued for the serial gateway"},
+    {"kic_gateway_dropped_total", "Gateway records dropped on a full ring"},
+    {"kic_uplink_batches_total", "Batches delivered to the site collector"},
+    {"kic_uplink_failures_total", "Failed uplink publish attempts"},
+    {"kic_uplink_dropped_total", "Uplink batches dropped on a full retry queue"},
+    {"kic_sensor_glitches_total", "Probe reads rejected as spikes or failed reads"},
+    {"kic_sleep_seconds_total", "Time spent in light sleep"},
+    {"kic_wakeups_total", "Wakes from light sleep"},
+    {"kic_radio_wakeups_total", "Wakes caused by the radio"},
+};
+
+static const MetricInfo gaugeInfo[(int)MetricGauge::Count] = {
+    {"kic_heap_free_bytes", "Free heap"},
+    {"kic_heap_min_free_bytes", "Lowest free heap since boot"},
+    {"kic_heap_largest_block_bytes", "Largest allocatable heap block"},
+    {"kic_heap_fragmentation_percent", "100 - largest block / free heap"},
+    {"kic_uptime_seconds", "Seconds since boot"},
+    {"kic_nodes", "Nodes in the node table"},
+    {"kic_lora_sf", "Current spreading factor"},
+    {"kic_tx_power_dbm", "Current TX power"},
+    {"kic_backfill_gaps", "Peers with log slots still missing"},
+    {"kic_reliable_pending", "Control messages awaiting acknowledgement"},
+    {"kic_channel_load_percent", "Share of the last minute the channel carried frames we heard or sent"},
+    {"kic_uplink_queued", "Uplink batches waiting to be published"},
+    {"kic_sensor_resolution_bits", "DS18B20 conversion resolution"},
+    {"kic_log_staged_bytes", "Log bytes staged in RTC memory"},
+    {"kic_asleep_percent", "Share of uptime spent in light sleep"},
+    {"kic_average_current_microamps", "Estimated average supply current"},
+};
+
+void Histogram::record(uint32_t us)
+{
+    int i = 0;
+    while (i < METRICS_BUCKETS && us > Metrics::bucketBoundsUs[i]) i++;
+    buckets[i]++;
+    count++;
+    sumUs += us;
+    if (us > maxUs) maxUs = us;
+}
+
+Metrics::Metrics()
+{
+    reset();
+}
+
+void Metrics::reset()
+{
+    memset(hist, 0, sizeof(hist));
+    memset(counters, 0, sizeof(counters));
+    memset(gauges, 0, sizeof(gauges));
+}
+
+// Pass on one snprintf() result, clipped if it did not fit
+static void emit(MetricsWriteFn out, void *ctx, const char *line, int n, size_t cap)
+{
+    if (n < 0) return;
+    out(ctx, line, (size_t)n < cap ? (size_t)n : cap - 1);
+}
+
+void Metrics::render(MetricsWriteFn out, void *ctx) const
+{
+    char line[256];
+    const size_t cap = sizeof(line);
+
+    for (int t = 0; t < (int)MetricTimer::Count; t++) {
+        const char *name = timerInfo[t].name;
+        const Histogram &h = hist[t];
+        emit(out, ctx, line, snprintf(line, cap, "# HELP %s %s\n# TYPE %s histogram\n",
+                                      name, timerInfo[t].help, name), cap);
+        uint32_t cumulative = 0;
+        for (int b = 0; b <= METRICS_BUCKETS; b++) {
+            cumulative += h.buckets[b];
+            emit(out, ctx, line, snprintf(line, cap, "%s_bucket{le=\"%s\"} %lu\n",
+                                          name, bucketLabels[b],
+                                          (unsigned long)cumulative), cap);
+        }
+        emit(out, ctx, line, snprintf(line, cap, "%s_sum %lu.%06lu\n%s_count %lu\n",
+                                      name, (unsigned long)(h.sumUs / 1000000),
+                                      (unsigned long)(h.sumUs % 1000000),
+                                      name, (unsigned long)h.count), cap);
+        // Not part of the histogram type, but the worst case is what we chase
+        emit(out, ctx, line, snprintf(line, cap, "%s_max %lu.%06lu\n", name,
+                                      (unsigned long)(h.maxUs / 1000000),
+                                      (unsigned long)(h.maxUs % 1000000)), cap);
+    }
+
+    for (int c = 0; c < (int)MetricCounter::Count; c++) {
+        const MetricInfo &m = counterInfo[c];
+        emit(out, ctx, line, snprintf(line, cap, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+                                      m.name, m.help, m.name, m.name,
+                                      (unsigned long)counters[c]), cap);
+    }
+
+    for (int g = 0; g < (int)MetricGauge::Count; g++) {
+        const MetricInfo &m = gaugeInfo[g];
+        emit(out, ctx, line, snprintf(line, cap, "# HELP %s %s\n# TYPE %s gauge\n%s %lu\n",
+                                      m.name, m.help, m.name, m.name,
+                                      (unsigned long)gauges[g]), cap);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+// Always-on runtime instrumentation: fixed-bucket latency histograms,
+// monotonic counters and point-in-time gauges, rendered in the Prometheus
+// text exposition format for /api/metrics.
+//
+// Recording is a handful of compares and adds with no allocation. Each
+// histogram/counter has a single writer task; the web task reads them
+// unlocked, so a scrape may see values a few microseconds apart.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Hal.h"
+
+enum class MetricTimer : uint8_t {
+    Loop,        // one pass of the Arduino loop()
+    Sensor,      // DS18B20 conversion + read
+    RadioRx,     // decrypt, parse and apply one received frame
+    RadioTx,     // blocking transmit of one frame
+    LogWrite,    // one quarter-hour log append
+    Web,         // one HTTP request handler
+    Count
+};
+
+enum class MetricCounter : uint8_t {
+    RxFrames,
+    RxDecryptFailed,
+    RxUnknown,
+    RxOwn,
+    RxCrcErrors,   // bad CRC at the radio, mostly collisions
+    RxErrors,      // any other readData() failure
+    TxFrames,
+    TxFailed,
+    LogWrites,
+    LogFailed,
+    LogFlashWrites,    // staged log bytes written to LittleFS
+    NvsWrites,
+    DebugLogDropped,   // lines lost to a full DebugLog ring
+    BackfillRequests,  // BKR frames sent for gaps in our log
+    BackfillSent,      // own samples sent in answer to BKR
+    BackfillMerged,    // peers' backfilled samples queued for the log
+    ReliableSent,      // control messages posted (first transmission)
+    ReliableRetries,
+    ReliableAcked,     // acked by every peer
+    ReliableExpired,   // gave up with peers still missing
+    ReliableHeld,      // retries skipped on a busy channel
+    GatewayRecords,    // readings queued for the serial gateway
+    GatewayDropped,    // lost to a full gateway ring
+    UplinkBatches,     // batches delivered to the site collector
+    UplinkFailures,    // publish attempts that failed (retried)
+    UplinkDropped,     // batches lost to a full retry queue
+    SensorGlitches,    // probe reads rejected by the filter
+    SleepSecs,         // low-power builds only, from here down
+    Wakeups,
+    RadioWakeups,
+    Count
+};
+
+enum class MetricGauge : uint8_t {
+    HeapFree,
+    HeapMinFree,
+    HeapLargestBlock,
+    HeapFragmentation,   // percent: 100 - largest block / free
+    UptimeSecs,
+    Nodes,
+    LoraSf,
+    TxPowerDbm,
+    BackfillGaps,        // peers with log slots still missing
+    ReliablePending,     // control messages awaiting acks
+    ChannelLoad,         // percent of the last minute on air, as we hear it
+    UplinkQueued,        // sealed batches waiting to be published
+    SensorBits,          // DS18B20 conversion resolution
+    LogStaged,           // log bytes in RTC memory, not yet in flash
+    AsleepPercent,
+    AverageCurrentUa,    // estimate from the awake/asleep split
+    Count
+};
+
+// Upper bounds in microseconds; a final +Inf bucket follows
+#define METRICS_BUCKETS 12
+
+struct Histogram {
+    uint32_t buckets[METRICS_BUCKETS + 1];   // non-cumulative
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t sumUs;
+
+    void record(uint32_t us);
+};
+
+// Receives rendered text in pieces (one line or less at a time)
+typedef void (*MetricsWriteFn)(void *ctx, const char *text, size_t len);
+
+class Metrics {
+public:
+    Metrics();
+    void reset();
+
+    void record(MetricTimer t, uint32_t us) { hist[(int)t].record(us); }
+    void count(MetricCounter c, uint32_t n = 1) { counters[(int)c] += n; }
+    // For counters kept elsewhere (e.g. in a HAL driver) and copied in
+    void set(MetricCounter c, uint32_t value) { counters[(int)c] = value; }
+    void set(MetricGauge g, uint32_t value) { gauges[(int)g] = value; }
+
+    const Histogram &histogram(MetricTimer t) const { return hist[(int)t]; }
+    uint32_t get(MetricCounter c) const { return counters[(int)c]; }
+    uint32_t get(MetricGauge g) const { return gauges[(int)g]; }
+
+    void render(MetricsWriteFn out, void *ctx) const;
+
+    static const uint32_t bucketBoundsUs[METRICS_BUCKETS];
+
+private:
+    Histogram hist[(int)MetricTimer::Count];
+    uint32_t counters[(int)MetricCounter::Count];
+    uint32_t gauges[(int)MetricGauge::Count];
+};
+
+// Times the enclosing scope into one histogram
+class MetricScope {
+public:
+    MetricScope(Metrics &metrics, Clock &clock, MetricTimer timer)
+        : metrics(metrics), clock(clock), timer(timer), start(clock.micros()) {}
+    ~MetricScope() { metrics.record(timer, clock.micros() - start); }
+
+private:
+    Metrics &metrics;
+    Clock &clock;
+    MetricTimer timer;
+    uint32_t start;
+};
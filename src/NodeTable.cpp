@@ -0,0 +1,91 @@
+#include "NodeTable.h"
+
+// FNV-1a
+uint32_t NodeTable::keyOf(const std::string &id)
+{
+    uint32_t h = 2166136261u;
+    for (char c : id) h = (h ^ (uint8_t)c) * 16777619u;
+    return h;
+}
+
+int NodeTable::indexOf(const std::string &id) const
+{
+    uint32_t key = keyOf(id);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == key && nodes[i].id == id) return (int)i;
+    }
+    return -1;
+}
+
+NodeTemp *NodeTable::find(const std::string &id)
+{
+    int i = indexOf(id);
+    return i < 0 ? nullptr : &nodes[i];
+}
+
+const NodeTemp *NodeTable::find(const std::string &id) const
+{
+    int i = indexOf(id);
+    return i < 0 ? nullptr : &nodes[i];
+}
+
+bool NodeTable::update(const std::string &id, float temp1, float temp2, float temp3,
+                       time_t lastUpdate, bool hasrtc)
+{
+    NodeTemp *n = find(id);
+    if (n) {
+        n->temp1 = temp1;
+        n->temp2 = temp2;
+        n->temp3 = temp3;
+        n->lastUpdate = lastUpdate;
+        n->hasrtc = hasrtc;
+        return false;
+    }
+    NodeTemp nt = {id, temp1, temp2, temp3, lastUpdate, hasrtc};
+    nodes.push_back(nt);
+    keys.push_back(keyOf(id));
+    return true;
+}
+
+void NodeTable::rename(const std::string &from, const std::string &to)
+{
+    int i = indexOf(from);
+    if (i < 0) return;
+    if (indexOf(to) >= 0) {
+        nodes.erase(nodes.begin() + i);
+        keys.erase(keys.begin() + i);
+        return;
+    }
+    nodes[i].id = to;
+    keys[i] = keyOf(to);
+}
+
+void Roster::set(const std::string &csvList)
+{
+    csv = csvList;
+    list.clear();
+    size_t start = 0;
+    while (start < csv.length()) {
+        size_t comma = csv.find(',', start);
+        if (comma == std::string::npos) comma = csv.length();
+        list.push_back(csv.substr(start, comma - start));
+        start = comma + 1;
+    }
+}
+
+bool Roster::contains(const std::string &id) const
+{
+    for (const auto &nid : list) {
+        if (nid == id) return true;
+    }
+    return false;
+}
+
+bool Roster::add(const std::string &id)
+{
+    if (contains(id)) return false;
+    if (!csv.empty()) csv += ",";
+    csv += id;
+    list.push_back(id);
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Latest known state of every node (self included) and the configured
+// roster of node IDs that should be reporting.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+// ----- Node Data -----
+struct NodeTemp {
+    std::string id;
+    float temp1;
+    float temp2;
+    float temp3;
+    time_t lastUpdate;
+    bool hasrtc;
+};
+
+struct NodeConfig {
+    std::string id;
+    std::string name;
+    bool hasrtc;
+    time_t lastSeen;
+    std::string temp1_name;
+    std::string temp2_name;
+    std::string temp3_name;
+    bool temp1_enabled;
+    bool temp2_enabled;
+    bool temp3_enabled;
+    float temp1_alarm_low;
+    float temp1_alarm_high;
+    float temp2_alarm_low;
+    float temp2_alarm_high;
+    float temp3_alarm_low;
+    float temp3_alarm_high;
+};
+
+class NodeTable {
+public:
+    // Alarm checks look up every roster ID on every pass, so the scan
+    // compares a 32-bit key per entry and only confirms a match by string
+    NodeTemp *find(const std::string &id);
+    const NodeTemp *find(const std::string &id) const;
+
+    // Insert or overwrite the entry for id; returns true if it was new
+    bool update(const std::string &id, float temp1, float temp2, float temp3,
+                time_t lastUpdate, bool hasrtc);
+    // Move from's entry to id to; if to already has one, from's is dropped
+    void rename(const std::string &from, const std::string &to);
+
+    size_t size() const { return nodes.size(); }
+    std::vector<NodeTemp>::iterator begin() { return nodes.begin(); }
+    std::vector<NodeTemp>::iterator end() { return nodes.end(); }
+    std::vector<NodeTemp>::const_iterator begin() const { return nodes.begin(); }
+    std::vector<NodeTemp>::const_iterator end() const { return nodes.end(); }
+    const NodeTemp &operator[](size_t i) const { return nodes[i]; }
+
+private:
+    static uint32_t keyOf(const std::string &id);
+    int indexOf(const std::string &id) const;
+
+    std::vector<NodeTemp> nodes;
+    std::vector<uint32_t> keys;  // keyOf(nodes[i].id)
+};
+
+// Comma-separated list of expected node IDs, as stored in NVS and
+// carried in NODELIST messages
+class Roster {
+public:
+    void set(const std::string &csvList);
+    const std::string &str() const { return csv; }
+
+    // Parsed once on set(); alarm checks walk this every loop pass
+    const std::vector<std::string> &ids() const { return list; }
+    bool contains(const std::string &id) const;
+    // Append id if not already present; returns true if the list changed
+    bool add(const std::string &id);
+
+private:
+    std::string csv;
+    std::vector<std::string> list;
+};
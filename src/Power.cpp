@@ -0,0 +1,38 @@
+#include "Power.h"
+#include <string.h>
+
+PowerStats::PowerStats() : sleepUs(0), totalWakeups(0)
+{
+    memset(byCause, 0, sizeof(byCause));
+}
+
+void PowerStats::slept(uint32_t us, WakeCause cause)
+{
+    sleepUs += us;
+    totalWakeups++;
+    byCause[(int)cause]++;
+}
+
+uint32_t PowerStats::averageUa(uint64_t uptimeUs) const
+{
+    if (uptimeUs == 0) return POWER_AWAKE_UA;
+    uint64_t asleep = sleepUs < uptimeUs ? sleepUs : uptimeUs;
+    uint64_t awake = uptimeUs - asleep;
+    // uA * us stays well inside 64 bits for any realistic uptime
+    uint64_t charge = awake * POWER_AWAKE_UA + asleep * POWER_SLEEP_UA;
+    return (uint32_t)(charge / uptimeUs);
+}
+
+uint32_t PowerStats::asleepPercent(uint64_t uptimeUs) const
+{
+    if (uptimeUs == 0) return 0;
+    uint64_t asleep = sleepUs < uptimeUs ? sleepUs : uptimeUs;
+    return (uint32_t)(asleep * 100 / uptimeUs);
+}
+
+uint32_t PowerStats::sleepMs(uint32_t msUntilNextEvent)
+{
+    if (msUntilNextEvent < LOW_POWER_MIN_SLEEP_MS) return 0;
+    return msUntilNextEvent < LOW_POWER_MAX_SLEEP_MS ? msUntilNextEvent
+                                                     : LOW_POWER_MAX_SLEEP_MS;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Sleep planning and sleep/wake accounting for the low-power profile
+// (KIC_LOW_POWER). main.cpp does the actual ESP32 light sleep; this keeps
+// the bookkeeping and the average-current estimate host-testable.
+
+#include <stdint.h>
+
+#define LOW_POWER_MIN_SLEEP_MS  20UL      // shorter gaps aren't worth the wake cost
+#define LOW_POWER_MAX_SLEEP_MS  60000UL   // bound drift on a missed wake source
+#define LOW_POWER_AP_MS         600000UL  // AP stays up 10 min after a button press
+
+// Rough draw for the estimate: ESP32-S3 at 80 MHz with radio in duty-cycled
+// RX vs. light sleep with the SX1262 sniffing. Override per board.
+#ifndef POWER_AWAKE_UA
+#define POWER_AWAKE_UA 30000UL
+#endif
+#ifndef POWER_SLEEP_UA
+#define POWER_SLEEP_UA 1500UL
+#endif
+
+enum class WakeCause : uint8_t {
+    Timer,
+    Radio,
+    Button,
+    Other,
+    Count
+};
+
+class PowerStats {
+public:
+    PowerStats();
+
+    // Record one light-sleep period and what ended it
+    void slept(uint32_t us, WakeCause cause);
+
+    uint64_t asleepUs() const { return sleepUs; }
+    uint32_t wakeups() const { return totalWakeups; }
+    uint32_t wakeups(WakeCause cause) const { return byCause[(int)cause]; }
+
+    // Estimated average current since boot, from the awake/asleep split
+    uint32_t averageUa(uint64_t uptimeUs) const;
+    // Percent of uptime spent asleep
+    uint32_t asleepPercent(uint64_t uptimeUs) const;
+
+    // How long to sleep given the time to the next scheduled event;
+    // 0 means stay awake
+    static uint32_t sleepMs(uint32_t msUntilNextEvent);
+
+private:
+    uint64_t sleepUs;
+    uint32_t totalWakeups;
+    uint32_t byCause[(int)WakeCause::Count];
+};
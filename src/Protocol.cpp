@@ -0,0 +1,268 @@
+#include "Protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t Protocol::formatKic(const KicReport &r, char *buf, size_t cap,
+                           const RelAck *acks, size_t nAcks)
+{
+    int n;
+    if (r.sf || nAcks) {
+        n = snprintf(buf, cap, "KIC,%s,%.2f,%.2f,%.2f,%lu,%d,%u,%d,%u",
+                     r.id.c_str(), r.temp1, r.temp2, r.temp3,
+                     (unsigned long)r.lastUpdate, r.hasrtc ? 1 : 0,
+                     r.sf, r.txDbm, r.wantSf);
+        for (size_t i = 0; i < nAcks && n >= 0 && (size_t)n < cap; i++) {
+            n += snprintf(buf + n, cap - n, ",%s:%u:%x", acks[i].origin.c_str(),
+                          acks[i].top, acks[i].seen);
+        }
+    } else {
+        n = snprintf(buf, cap, "KIC,%s,%.2f,%.2f,%.2f,%lu,%d",
+                     r.id.c_str(), r.temp1, r.temp2, r.temp3,
+                     (unsigned long)r.lastUpdate, r.hasrtc ? 1 : 0);
+    }
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+size_t Protocol::formatNodeList(const std::string &list, char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "NODELIST,%s", list.c_str());
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+size_t Protocol::formatAlarm(const std::string &from, const std::string &downId,
+                             char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "%s,ALARM,%s", from.c_str(), downId.c_str());
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+size_t Protocol::formatReliable(const std::string &from, uint8_t seq,
+                                const char *inner, size_t innerLen,
+                                char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "REL,%s,%u,%.*s", from.c_str(), seq, (int)innerLen, inner);
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+size_t Protocol::formatBackfill(const std::string &id, const LogSample *samples,
+                                size_t n, char *buf, size_t cap)
+{
+    if (n == 0) return 0;
+    int len = snprintf(buf, cap, "BKF,%s,%lu,%.2f", id.c_str(),
+                       (unsigned long)samples[0].epoch, samples[0].temp);
+    for (size_t i = 1; i < n && len >= 0 && (size_t)len < cap; i++) {
+        len += snprintf(buf + len, cap - len, ",%lu,%.2f",
+                        (unsigned long)(samples[i].epoch - samples[i - 1].epoch),
+                        samples[i].temp);
+    }
+    if (len < 0 || (size_t)len >= cap) return 0;
+    return (size_t)len;
+}
+
+size_t Protocol::formatBackfillRequest(const std::string &from, const std::string &id,
+                                       uint32_t since, uint32_t until,
+                                       char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "BKR,%s,%s,%lu,%lu", from.c_str(), id.c_str(),
+                     (unsigned long)since, (unsigned long)until);
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+// The parsers below read the NUL-terminated copy parse() keeps on the
+// stack and assign() into the Message's strings, so a Message that is
+// reused from one frame to the next keeps their storage
+
+// BKR,<from>,<id>,<since>,<until>
+static bool parseBackfillRequest(const char *in, Message &out)
+{
+    const char *a = strchr(in + 4, ',');
+    if (!a || a == in + 4) return false;
+    const char *b = strchr(a + 1, ',');
+    if (!b || b == a + 1) return false;
+    unsigned long since, until;
+    char tail;
+    if (sscanf(b + 1, "%lu,%lu%c", &since, &until, &tail) != 2) return false;
+    if (since > until) return false;
+    out.sender.assign(in + 4, a - (in + 4));
+    out.arg.assign(a + 1, b - (a + 1));
+    out.since = (uint32_t)since;
+    out.until = (uint32_t)until;
+    return true;
+}
+
+// BKF,<id>,<epoch>,<temp>[,<+secs>,<temp>...]
+static bool parseBackfill(const char *in, Message &out)
+{
+    const char *comma = strchr(in + 4, ',');
+    if (!comma || comma == in + 4) return false;
+    out.samples.clear();
+
+    const char *p = comma;
+    uint32_t epoch = 0;
+    while (*p == ',') {
+        char *end;
+        unsigned long v = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || *end != ',') return false;
+        const char *tp = end + 1;
+        float t = strtof(tp, &end);
+        if (end == tp) return false;
+        epoch = out.samples.empty() ? (uint32_t)v : epoch + (uint32_t)v;
+        LogSample s = {epoch, t};
+        out.samples.push_back(s);
+        p = end;
+    }
+    if (*p != '\0') return false;
+    out.sender.assign(in + 4, comma - (in + 4));
+    return true;
+}
+
+// ,<origin>:<top>:<seen hex>... ; malformed entries end the list
+static void parseAcks(const char *p, std::vector<RelAck> &acks)
+{
+    while (*p == ',') {
+        const char *colon = strchr(p + 1, ':');
+        const char *comma = strchr(p + 1, ',');
+        if (!colon || (comma && comma < colon) || colon == p + 1) return;
+        char *end;
+        unsigned long top = strtoul(colon + 1, &end, 10);
+        if (*end != ':' || top > 255) return;
+        const char *hex = end + 1;
+        unsigned long seen = strtoul(hex, &end, 16);
+        if (end == hex || (*end != ',' && *end != '\0') || seen > 0xFFFF) return;
+        acks.push_back(RelAck());
+        RelAck &a = acks.back();
+        a.origin.assign(p + 1, colon - (p + 1));
+        a.top = (uint8_t)top;
+        a.seen = (uint16_t)seen;
+        p = end;
+    }
+}
+
+// KIC,<id>,<t1>,<t2>,<t3>,<epoch>,<hasrtc>[,<sf>,<dbm>,<wantsf>[,<ack>...]]
+static bool parseKic(const char *in, KicReport &r, std::vector<RelAck> &acks)
+{
+    const char *idx[5];
+    const char *from = in + 4;
+    for (int i = 0; i < 5; i++) {
+        const char *c = strchr(from, ',');
+        if (!c) return false;
+        idx[i] = c;
+        from = c + 1;
+    }
+    r.id.assign(in + 4, idx[0] - (in + 4));
+    r.temp1 = strtof(idx[0] + 1, nullptr);
+    r.temp2 = strtof(idx[1] + 1, nullptr);
+    r.temp3 = strtof(idx[2] + 1, nullptr);
+    r.lastUpdate = (uint32_t)strtoul(idx[3] + 1, nullptr, 10);
+    r.hasrtc = atoi(idx[4] + 1) != 0;
+
+    r.sf = 0;
+    r.txDbm = 0;
+    r.wantSf = 0;
+    acks.clear();
+    const char *c = strchr(idx[4] + 1, ',');
+    if (c) {
+        int sf = 0, dbm = 0, want = 0, used = 0;
+        if (sscanf(c + 1, "%d,%d,%d%n", &sf, &dbm, &want, &used) == 3) {
+            if (sf >= 5 && sf <= 12) {
+                r.sf = (uint8_t)sf;
+                r.txDbm = (int8_t)dbm;
+                r.wantSf = (uint8_t)want;
+            }
+            parseAcks(c + 1 + used, acks);
+        }
+    }
+    return true;
+}
+
+static bool parseText(const char *in, Message &out)
+{
+    // REL,<from>,<seq>,<message>: unwrap and parse the inner message
+    if (strncmp(in, "REL,", 4) == 0) {
+        const char *from = in + 4;
+        const char *a = strchr(from, ',');
+        if (!a || a == from) return false;
+        char *end;
+        unsigned long seq = strtoul(a + 1, &end, 10);
+        if (end == a + 1 || *end != ',' || seq > 255) return false;
+        size_t fromLen = a - from;
+        if (!parseText(end + 1, out)) return false;
+        if (out.type != MsgType::NodeList && out.type != MsgType::Alarm) {
+            out.type = MsgType::Unknown;
+            return false;
+        }
+        if (out.type == MsgType::Alarm &&
+            out.sender.compare(0, out.sender.size(), from, fromLen) != 0) {
+            out.type = MsgType::Unknown;
+            return false;
+        }
+        out.sender.assign(from, fromLen);
+        out.reliable = true;
+        out.seq = (uint8_t)seq;
+        return true;
+    }
+
+    if (strncmp(in, "NODELIST,", 9) == 0) {
+        out.type = MsgType::NodeList;
+        out.arg.assign(in + 9);
+        return true;
+    }
+
+    static const struct { const char *tag; MsgType type; } tagged[] = {
+        { ",TEMP,", MsgType::Temp },
+        { ",HEARTBEAT,", MsgType::Heartbeat },
+        { ",ALARM,", MsgType::Alarm },
+    };
+    for (const auto &t : tagged) {
+        const char *pos = strstr(in, t.tag);
+        if (pos && pos > in) {
+            out.type = t.type;
+            out.sender.assign(in, strchr(in, ',') - in);
+            out.arg.assign(pos + strlen(t.tag));
+            return true;
+        }
+    }
+
+    if (strncmp(in, "BKF,", 4) == 0) {
+        if (!parseBackfill(in, out)) return false;
+        out.type = MsgType::Backfill;
+        return true;
+    }
+
+    if (strncmp(in, "BKR,", 4) == 0) {
+        if (!parseBackfillRequest(in, out)) return false;
+        out.type = MsgType::BackfillRequest;
+        return true;
+    }
+
+    if (strncmp(in, "KIC,", 4) == 0) {
+        if (!parseKic(in, out.kic, out.acks)) return false;
+        out.type = MsgType::Kic;
+        out.sender = out.kic.id;
+        return true;
+    }
+    return false;
+}
+
+bool Protocol::parse(const char *msg, size_t len, Message &out)
+{
+    out.type = MsgType::Unknown;
+    out.sender.clear();
+    out.arg.clear();
+    out.reliable = false;
+    out.acks.clear();
+
+    // Frames are not NUL-terminated; the number parsers need it
+    char in[PROTOCOL_MAX_LEN + 1];
+    len = strnlen(msg, len);
+    if (len > PROTOCOL_MAX_LEN) return false;
+    memcpy(in, msg, len);
+    in[len] = '\0';
+    return parseText(in, out);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// Plaintext LoRa message formats. Frames on air are these strings, AES
+// encrypted.
+//
+//   KIC,<id>,<temp1>,<temp2>,<temp3>,<epoch>,<hasrtc>[,<sf>,<dbm>,<wantsf>[,<ack>...]]
+//   REL,<from>,<seq>,<NODELIST or ALARM message>
+//   BKF,<id>,<epoch>,<temp>[,<+secs>,<temp>...]
+//   BKR,<from>,<id>,<since>,<until>
+//   NODELIST,<id>[,<id>...]
+//   <id>,ALARM,<downid>
+//   <id>,TEMP,<temp>          (legacy, ignored)
+//   <id>,HEARTBEAT,           (legacy, ignored)
+//
+// The optional KIC tail announces the sender's LoRa rate (spreading factor
+// and TX power) and the SF its own links need, for LinkAdapt. Older nodes
+// ignore it; reports without it parse with sf = 0. Each <ack> is
+// <origin>:<top>:<seen hex>, acknowledging the origin's REL messages (see
+// Reliable.h); a report carrying acks but no rate sends 0,0,0 for it.
+//
+// BKR asks node <id> for its quarter-hour samples between two epochs; BKF
+// is the answer, oldest first, each later sample giving its offset in
+// seconds from the one before (see Backfill.h).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define PROTOCOL_MAX_LEN 255   // longest plaintext parse() accepts
+
+enum class MsgType : uint8_t {
+    Unknown,
+    Kic,
+    NodeList,
+    Alarm,
+    Temp,
+    Heartbeat,
+    Backfill,
+    BackfillRequest
+};
+
+struct KicReport {
+    std::string id;
+    float temp1;
+    float temp2;
+    float temp3;
+    uint32_t lastUpdate;
+    bool hasrtc;
+    uint8_t sf;        // 0 = not announced
+    int8_t txDbm;
+    uint8_t wantSf;
+};
+
+struct LogSample {
+    uint32_t epoch;
+    float temp;
+};
+
+struct RelAck {
+    std::string origin;
+    uint8_t top;          // highest sequence seen from origin
+    uint16_t seen;        // bit i: top - i has arrived
+};
+
+struct Message {
+    MsgType type;
+    std::string sender;   // originating node (empty for NODELIST)
+    std::string arg;      // node list / alarmed node id / BKR target
+    KicReport kic;        // valid when type == MsgType::Kic
+    std::vector<LogSample> samples;   // valid when type == MsgType::Backfill
+    uint32_t since;       // BKR range
+    uint32_t until;
+    bool reliable;        // came wrapped in REL; seq is valid
+    uint8_t seq;
+    std::vector<RelAck> acks;         // KIC ack tail
+};
+
+class Protocol {
+public:
+    // Format messages into buf; return length written (0 if it did not fit)
+    static size_t formatKic(const KicReport &r, char *buf, size_t cap,
+                            const RelAck *acks = nullptr, size_t nAcks = 0);
+    // Wrap a NODELIST/ALARM message for acknowledged delivery
+    static size_t formatReliable(const std::string &from, uint8_t seq,
+                                 const char *inner, size_t innerLen,
+                                 char *buf, size_t cap);
+    static size_t formatNodeList(const std::string &list, char *buf, size_t cap);
+    static size_t formatAlarm(const std::string &from, const std::string &downId,
+                              char *buf, size_t cap);
+    // Samples must be in time order
+    static size_t formatBackfill(const std::string &id, const LogSample *samples,
+                                 size_t n, char *buf, size_t cap);
+    static size_t formatBackfillRequest(const std::string &from, const std::string &id,
+                                        uint32_t since, uint32_t until,
+                                        char *buf, size_t cap);
+
+    // Classify and parse a plaintext message. Returns false (type Unknown)
+    // for anything not recognised, a malformed KIC report or a message
+    // longer than PROTOCOL_MAX_LEN. Fields are assigned in place: parsing
+    // into the same Message again reuses its string and vector storage.
+    static bool parse(const char *msg, size_t len, Message &out);
+};
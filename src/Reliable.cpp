@@ -0,0 +1,145 @@
+#include "Reliable.h"
+
+ReliableMsg &ReliableOutbox::post(const std::string &frame,
+                                  const std::vector<std::string> &peers, uint32_t nowMs)
+{
+    if (msgs.size() >= REL_OUTBOX_MAX) msgs.erase(msgs.begin());
+    ReliableMsg m = {nextSeq++, frame, peers, nowMs, nowMs, 0};
+    msgs.push_back(m);
+    return msgs.back();
+}
+
+void ReliableOutbox::sent(uint8_t seq, uint32_t nowMs, uint32_t jitterDraw)
+{
+    for (size_t i = 0; i < msgs.size(); i++) {
+        ReliableMsg &m = msgs[i];
+        if (m.seq != seq) continue;
+        if (m.waiting.empty()) {
+            msgs.erase(msgs.begin() + i);
+            return;
+        }
+        uint32_t backoff = REL_RETRY_MS << (m.tries < 8 ? m.tries : 8);
+        if (backoff > REL_RETRY_MAX_MS) backoff = REL_RETRY_MAX_MS;
+        m.tries++;
+        m.nextMs = nowMs + backoff + jitterDraw % REL_RETRY_JITTER_MS;
+        return;
+    }
+}
+
+ReliableMsg *ReliableOutbox::due(uint32_t nowMs)
+{
+    for (auto &m : msgs) {
+        if (m.tries < REL_MAX_TRIES && (int32_t)(nowMs - m.nextMs) >= 0) return &m;
+    }
+    return nullptr;
+}
+
+bool ReliableOutbox::covers(uint8_t top, uint16_t seen, uint8_t seq)
+{
+    uint8_t back = (uint8_t)(top - seq);
+    return back < REL_WINDOW && (seen >> back) & 1;
+}
+
+void ReliableOutbox::acked(const std::string &peer, uint8_t top, uint16_t seen, uint32_t nowMs)
+{
+    for (size_t i = 0; i < msgs.size();) {
+        ReliableMsg &m = msgs[i];
+        if (covers(top, seen, m.seq)) {
+            for (size_t k = 0; k < m.waiting.size(); k++) {
+                if (m.waiting[k] == peer) {
+                    m.waiting.erase(m.waiting.begin() + k);
+                    break;
+                }
+            }
+        }
+        if (m.waiting.empty() && m.tries > 0) {
+            uint32_t latency = nowMs - m.postedMs;
+            ackedCount++;
+            latencySumMs += latency;
+            if (latency > latencyMaxMs) latencyMaxMs = latency;
+            msgs.erase(msgs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+size_t ReliableOutbox::expire(uint32_t nowMs)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < msgs.size();) {
+        const ReliableMsg &m = msgs[i];
+        if (m.tries >= REL_MAX_TRIES && (int32_t)(nowMs - m.nextMs) >= 0) {
+            msgs.erase(msgs.begin() + i);
+            n++;
+        } else {
+            i++;
+        }
+    }
+    return n;
+}
+
+uint32_t ReliableOutbox::msUntilDue(uint32_t nowMs) const
+{
+    uint32_t wait = 0xFFFFFFFFUL;
+    for (const auto &m : msgs) {
+        int32_t d = (int32_t)(m.nextMs - nowMs);
+        uint32_t w = d > 0 ? (uint32_t)d : 0;
+        if (w < wait) wait = w;
+    }
+    return wait;
+}
+
+bool ReliableInbox::accept(const std::string &id, uint8_t seq, uint32_t nowMs)
+{
+    for (auto &s : senders) {
+        if (s.id != id) continue;
+        s.lastMs = nowMs;
+        s.acksLeft = REL_ACK_REPEATS;
+        int8_t ahead = (int8_t)(seq - s.top);
+        if (ahead > 0) {
+            s.seen = ahead >= REL_WINDOW ? 1 : (uint16_t)((s.seen << ahead) | 1);
+            s.top = seq;
+            return true;
+        }
+        uint8_t back = (uint8_t)-ahead;
+        if (back >= REL_WINDOW || (s.seen >> back) & 1) return false;
+        s.seen |= (uint16_t)(1u << back);
+        return true;
+    }
+    ReliableSender s = {id, seq, 1, nowMs, REL_ACK_REPEATS};
+    senders.push_back(s);
+    return true;
+}
+
+size_t ReliableInbox::acks(RelAck *out, size_t max, uint32_t nowMs) const
+{
+    // Most recently heard first, by insertion into a fixed array: this
+    // runs for every report we send
+    const ReliableSender *recent[REL_MAX_ACKS];
+    if (max > REL_MAX_ACKS) max = REL_MAX_ACKS;
+    size_t n = 0;
+    for (const auto &s : senders) {
+        if (nowMs - s.lastMs > REL_ACK_HOLD_MS || s.acksLeft == 0) continue;
+        size_t i = n < max ? n++ : max;
+        for (; i > 0 && recent[i - 1]->lastMs < s.lastMs; i--) {
+            if (i < max) recent[i] = recent[i - 1];
+        }
+        if (i < max) recent[i] = &s;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i].origin = recent[i]->id;
+        out[i].top = recent[i]->top;
+        out[i].seen = recent[i]->seen;
+    }
+    return n;
+}
+
+void ReliableInbox::reported(const RelAck *acks, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        for (auto &s : senders) {
+            if (s.id == acks[i].origin && s.acksLeft > 0) s.acksLeft--;
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+// Acknowledged delivery for control messages (NODELIST, ALARM).
+//
+// Each control message goes out wrapped as REL,<from>,<seq>,<message> with
+// an 8-bit per-sender sequence number. Receivers keep a window per sender:
+// the highest sequence seen and a 16-bit bitmap of which of the 16 numbers
+// up to it have arrived. Those windows ride on the regular KIC reports as
+// ack entries, so acks cost no frames of their own. A window goes out on
+// REL_ACK_REPEATS reports after each new or repeated frame rather than on
+// every report; if both are lost, the sender's next retry asks again.
+// (Reporting early to ack faster lines up every receiver's report slot and
+// costs far more in collisions than it saves.)
+//
+// The sender expects an ack from every roster peer that was reporting when
+// the message went out. Until all have acked it retransmits after
+// REL_RETRY_MS, doubling each time up to REL_RETRY_MAX_MS, and gives up
+// after REL_MAX_TRIES transmissions. The retries run ahead of the acks, so
+// a message reaches a peer within about two minutes or not at all; acks
+// only cut the retries short. On a busy channel (see ChannelLoad) the node
+// lets a retry pass unsent; it still counts as one of the tries.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Protocol.h"
+
+#define REL_WINDOW          16
+#define REL_RETRY_MS        4000UL
+#define REL_RETRY_MAX_MS    64000UL
+#define REL_RETRY_JITTER_MS 1000UL
+#define REL_MAX_TRIES       6
+#define REL_ACK_HOLD_MS     180000UL   // keep acking a sender this long
+#define REL_ACK_REPEATS     2          // reports per ack, until the sender repeats
+#define REL_MAX_ACKS        4          // ack entries per KIC report
+#define REL_OUTBOX_MAX      8
+
+struct ReliableMsg {
+    uint8_t seq;
+    std::string frame;                 // REL,... plaintext
+    std::vector<std::string> waiting;  // peers yet to ack
+    uint32_t postedMs;
+    uint32_t nextMs;
+    uint8_t tries;
+};
+
+// Our own control messages until every peer has acked them
+class ReliableOutbox {
+public:
+    ReliableOutbox() : nextSeq(0), ackedCount(0), latencySumMs(0), latencyMaxMs(0) {}
+
+    // Continue numbering after a reboot
+    void setNextSeq(uint8_t seq) { nextSeq = seq; }
+    uint8_t peekSeq() const { return nextSeq; }
+
+    // Queue a frame numbered with peekSeq() until peers have acked it.
+    // Returns it for the first transmission, which sent() must follow. A
+    // full outbox drops its oldest message.
+    ReliableMsg &post(const std::string &frame, const std::vector<std::string> &peers,
+                      uint32_t nowMs);
+    // The message went on air: schedule the next try, or forget it if
+    // nobody needs to ack it
+    void sent(uint8_t seq, uint32_t nowMs, uint32_t jitterDraw);
+    // A message whose retry time has come, if any
+    ReliableMsg *due(uint32_t nowMs);
+    // Ack window from peer for our sequence numbers
+    void acked(const std::string &peer, uint8_t top, uint16_t seen, uint32_t nowMs);
+    // Drop messages that have used all their tries (and waited out the
+    // last one); returns how many
+    size_t expire(uint32_t nowMs);
+
+    // Milliseconds until due() has work (0xFFFFFFFF if empty)
+    uint32_t msUntilDue(uint32_t nowMs) const;
+    size_t size() const { return msgs.size(); }
+    const std::vector<ReliableMsg> &pending() const { return msgs; }
+
+    // Delivery statistics: messages acked by everyone and their latency
+    uint32_t acked() const { return ackedCount; }
+    uint64_t latencySum() const { return latencySumMs; }
+    uint32_t latencyMax() const { return latencyMaxMs; }
+
+    // Whether an ack window (top, seen) includes seq
+    static bool covers(uint8_t top, uint16_t seen, uint8_t seq);
+
+private:
+    std::vector<ReliableMsg> msgs;
+    uint8_t nextSeq;
+    uint32_t ackedCount;
+    uint64_t latencySumMs;
+    uint32_t latencyMaxMs;
+};
+
+struct ReliableSender {
+    std::string id;
+    uint8_t top;        // highest sequence seen
+    uint16_t seen;      // bit i: top - i has arrived
+    uint32_t lastMs;    // last control message from this sender
+    uint8_t acksLeft;   // reports still to carry our window
+};
+
+// Sequence windows of the senders we've heard control messages from
+class ReliableInbox {
+public:
+    // Record seq from id; false if it is a repeat (still worth acking)
+    bool accept(const std::string &id, uint8_t seq, uint32_t nowMs);
+    // Ack entries for the next report: senders heard in the last
+    // REL_ACK_HOLD_MS, most recent first, at most REL_MAX_ACKS
+    size_t acks(RelAck *out, size_t max, uint32_t nowMs) const;
+    // These entries went out in a report. Each window rides on
+    // REL_ACK_REPEATS reports. Any frame from the sender after that, even a
+    // repeat, means it missed them and re-arms the window. Ack tails on
+    // every report for the whole hold cost more airtime than the control
+    // messages themselves.
+    void reported(const RelAck *acks, size_t n);
+
+private:
+    std::vector<ReliableSender> senders;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+// millis()-based periodic timers, wrap-safe like the usual
+// `millis() - last > period` idiom.
+
+#include <stdint.h>
+
+class Interval {
+public:
+    explicit Interval(uint32_t periodMs, uint32_t jitterMs = 0)
+        : period(periodMs), jitter(jitterMs), last(0), extra(0) {}
+
+    // True once the period (plus this round's jitter) has elapsed
+    bool due(uint32_t nowMs) const { return nowMs - last > period + extra; }
+
+    // Milliseconds until due() turns true (0 if already due)
+    uint32_t msUntilDue(uint32_t nowMs) const {
+        uint32_t elapsed = nowMs - last;
+        uint32_t limit = period + extra;
+        return elapsed > limit ? 0 : limit - elapsed + 1;
+    }
+
+    // Start the next period; jitterDraw should be random in [0, jitterMs)
+    void restart(uint32_t nowMs, uint32_t jitterDraw = 0) {
+        last = nowMs;
+        extra = jitter ? jitterDraw % jitter : 0;
+    }
+
+    uint32_t jitterMs() const { return jitter; }
+    uint32_t lastMs() const { return last; }
+
+private:
+    uint32_t period;
+    uint32_t jitter;
+    uint32_t last;
+    uint32_t extra;
+};
@@ -0,0 +1,96 @@
+#include "SensorFilter.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define EMA_ONE (1L << SENSOR_EMA_FRAC)
+
+static int16_t median3(int16_t a, int16_t b, int16_t c)
+{
+    if (a > b) {
+        int16_t t = a;
+        a = b;
+        b = t;
+    }
+    // a <= b
+    if (c <= a) return a;
+    if (c >= b) return b;
+    return c;
+}
+
+SensorFilter::SensorFilter()
+{
+    reset();
+}
+
+void SensorFilter::reset()
+{
+    window[0] = window[1] = window[2] = 0;
+    powerOnHeld = false;
+    ema = 0;
+    valid = false;
+    missing = 0;
+    quiet = 0;
+    stepped = false;
+    rejected = false;
+}
+
+float SensorFilter::update(float raw)
+{
+    stepped = false;
+    rejected = false;
+
+    // Outside the DS18B20's range is a bad read too
+    if (isnan(raw) || raw < -55.0f || raw > 125.0f) {
+        rejected = true;
+        if (++missing >= SENSOR_MISSING_READS) {
+            uint8_t m = missing;
+            reset();
+            missing = m;
+        }
+        return value();
+    }
+    missing = 0;
+    int16_t c = (int16_t)lroundf(raw * 100.0f);
+
+    if (!valid) {
+        if (c == SENSOR_POWER_ON_CENTI && !powerOnHeld) {
+            powerOnHeld = true;
+            rejected = true;
+            return value();
+        }
+        window[0] = window[1] = window[2] = c;
+        ema = c * EMA_ONE;
+        valid = true;
+        stepped = true;
+        quiet = 0;
+        return value();
+    }
+
+    window[0] = window[1];
+    window[1] = window[2];
+    window[2] = c;
+    int16_t med = median3(window[0], window[1], window[2]);
+    rejected = abs(c - med) > SENSOR_STEP_CENTI;
+
+    int32_t d = med * EMA_ONE - ema;
+    if (labs(d) > SENSOR_STEP_CENTI * EMA_ONE) {
+        ema = med * EMA_ONE;
+        stepped = true;
+        quiet = 0;
+    } else {
+        ema += d / (1L << SENSOR_EMA_SHIFT);
+        if (quiet < SENSOR_SETTLE_READS) quiet++;
+    }
+    return value();
+}
+
+float SensorFilter::value() const
+{
+    if (!valid) return NAN;
+    return (float)ema / (100.0f * EMA_ONE);
+}
+
+uint8_t SensorFilter::bits() const
+{
+    return quiet >= SENSOR_SETTLE_READS ? SENSOR_BITS_STABLE : SENSOR_BITS_FINE;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Per-probe conditioning of raw DS18B20 readings, in integer centi-degrees.
+//
+// Each read passes through three stages before anything broadcasts, logs
+// or alarms on it:
+//
+//   median of the last 3     a single spike (or the 85.00 C power-on value)
+//                            never gets through; a real step needs 2 reads
+//   power-on check           with no median yet, the first read after boot
+//                            or a reconnect is dropped if it is exactly
+//                            85.00 C; a second 85.00 is taken as real
+//   EMA, alpha 1/4           smooths quantisation and noise
+//   step detection           a median more than SENSOR_STEP_CENTI from the
+//                            EMA resets it, so a door opening shows at once
+//                            instead of crawling in over a minute
+//
+// A failed read (disconnected, bad CRC) holds the last output; only
+// SENSOR_MISSING_READS failures in a row report NAN, i.e. a probe down.
+//
+// bits() picks the conversion resolution for the next read: 12-bit while
+// the reading is moving or has not yet settled, SENSOR_BITS_STABLE once it
+// has been quiet for SENSOR_SETTLE_READS reads. 10-bit conversions take a
+// quarter of the time (and energy) of 12-bit ones.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SENSOR_STEP_CENTI     50     // 0.5 C
+#define SENSOR_EMA_SHIFT      2      // alpha = 1/4
+#define SENSOR_EMA_FRAC       4      // EMA fraction bits below a centi-degree
+#define SENSOR_MISSING_READS  2
+#define SENSOR_SETTLE_READS   12     // a minute at SENSOR_INTERVAL_MS
+#define SENSOR_BITS_FINE      12
+#define SENSOR_BITS_STABLE    10
+#define SENSOR_POWER_ON_CENTI 8500   // DS18B20 value before its first conversion
+
+class SensorFilter {
+public:
+    SensorFilter();
+
+    // Feed one raw reading (NAN for a failed read); the filtered value,
+    // NAN until the first good read or after repeated failures
+    float update(float raw);
+
+    float value() const;
+    // A step was taken by the last update()
+    bool changed() const { return stepped; }
+    // The last update() rejected its input as a glitch
+    bool glitch() const { return rejected; }
+    uint8_t bits() const;
+
+    void reset();
+
+private:
+    int16_t window[3];
+    bool powerOnHeld;        // dropped an 85.00 C first read
+    int32_t ema;             // centi-degrees << SENSOR_EMA_FRAC
+    bool valid;
+    uint8_t missing;
+    uint8_t quiet;
+    bool stepped;
+    bool rejected;
+};
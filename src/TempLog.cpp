@@ -0,0 +1,50 @@
+#include "TempLog.h"
+#include <stdio.h>
+
+time_t TempLog::nextLogEpoch(time_t t)
+{
+    struct tm tmNext;
+    localtime_r(&t, &tmNext);
+
+    int currentMin = tmNext.tm_min;
+
+    // Find the next quarter-hour (0, 15, 30, 45)
+    int nextQuarter = ((currentMin / 15) + 1) * 15;
+    if (nextQuarter >= 60) {
+        tmNext.tm_hour += 1;   // bump hour
+        tmNext.tm_min = 0;     // reset minutes
+    } else {
+        tmNext.tm_min = nextQuarter;
+    }
+    tmNext.tm_sec = 0;         // always align on the minute
+
+    // mktime() normalizes the struct (handles day, month, year rollover)
+    time_t nextEpoch = mktime(&tmNext);
+
+    // In case we're exactly on a boundary but seconds > 0, skip to the next
+    if (nextEpoch <= t) {
+        nextEpoch += LOG_INTERVAL_SECS;
+    }
+    return nextEpoch;
+}
+
+size_t TempLog::formatTimestamp(time_t t, char *buf, size_t cap)
+{
+    struct tm tmT;
+    gmtime_r(&t, &tmT);
+    int n = snprintf(buf, cap, "%02d/%02d/%04d %02d:%02d:%02d",
+                     tmT.tm_mon + 1, tmT.tm_mday, tmT.tm_year + 1900,
+                     tmT.tm_hour, tmT.tm_min, tmT.tm_sec);
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
+
+size_t TempLog::formatRow(const char *tstamp, const std::string &id,
+                          float temp1, float temp2, float temp3,
+                          char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "%s,%s,%.2f,%.2f,%.2f\n",
+                     tstamp, id.c_str(), temp1, temp2, temp3);
+    if (n < 0 || (size_t)n >= cap) return 0;
+    return (size_t)n;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Quarter-hour temperature log: scheduling and CSV row formatting.
+// Rows are "MM/DD/YYYY HH:MM:SS,node,temp1,temp2,temp3".
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "NodeTable.h"
+
+#define LOG_INTERVAL_SECS (15 * 60)
+
+// On-flash encoding: CSV text, or compact blocks (LogBlock.h)
+enum class LogFormat : uint8_t { Csv, Blocks };
+
+class TempLog {
+public:
+    static const char *header() { return "epoch,node,temp1,temp2,temp3\n"; }
+
+    // Next quarter-hour boundary strictly after t
+    static time_t nextLogEpoch(time_t t);
+
+    // "MM/DD/YYYY HH:MM:SS"; returns length written
+    static size_t formatTimestamp(time_t t, char *buf, size_t cap);
+
+    // One CSV row including the trailing newline; 0 if it did not fit
+    static size_t formatRow(const char *tstamp, const std::string &id,
+                            float temp1, float temp2, float temp3,
+                            char *buf, size_t cap);
+};
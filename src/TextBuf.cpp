@@ -0,0 +1,61 @@
+#include "TextBuf.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+TextBuf::TextBuf(char *buf, size_t cap) : buf(buf), cap(cap), len(0), over(cap == 0)
+{
+    if (cap) buf[0] = '\0';
+}
+
+void TextBuf::clear()
+{
+    len = 0;
+    over = cap == 0;
+    if (cap) buf[0] = '\0';
+}
+
+TextBuf &TextBuf::add(const char *s, size_t n)
+{
+    if (over) return *this;
+    if (n > cap - 1 - len) {
+        n = cap - 1 - len;
+        over = true;
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+    buf[len] = '\0';
+    return *this;
+}
+
+TextBuf &TextBuf::add(const char *s)
+{
+    return add(s, strlen(s));
+}
+
+TextBuf &TextBuf::printf(const char *fmt, ...)
+{
+    if (over) return *this;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + len, cap - len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        buf[len] = '\0';
+        over = true;
+    } else if ((size_t)n >= cap - len) {
+        // vsnprintf kept what fit, NUL-terminated
+        len = cap - 1;
+        over = true;
+    } else {
+        len += n;
+    }
+    return *this;
+}
+
+TextBuf &TextBuf::num(float v, int decimals, const char *none)
+{
+    if (isnan(v)) return add(none);
+    return printf("%.*f", decimals, v);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Text assembled in a caller's fixed buffer: the web page and JSON
+// builders that used to grow an Arduino String one += at a time, each
+// step a fresh heap block. Nothing here allocates. Output past the end is
+// dropped and overflowed() says so, letting the caller answer with an
+// error instead of a cut-off page.
+//
+//   char buf[256];
+//   TextBuf t(buf, sizeof(buf));
+//   t.add("<li>").add(id).add(": ").num(temp, 2, "-").add(" C</li>");
+
+#include <stdint.h>
+#include <stddef.h>
+
+class TextBuf {
+public:
+    // cap includes the terminating NUL, which is always kept
+    TextBuf(char *buf, size_t cap);
+
+    TextBuf &add(const char *s);
+    TextBuf &add(const char *s, size_t n);
+    TextBuf &printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    // Fixed decimals, or none for NAN
+    TextBuf &num(float v, int decimals, const char *none);
+
+    void clear();
+    const char *c_str() const { return buf; }
+    size_t size() const { return len; }
+    bool overflowed() const { return over; }
+
+private:
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool over;
+};
@@ -0,0 +1,144 @@
+#include "Trend.h"
+#include <math.h>
+
+// Keep x small enough that n * x^2 stays far inside 64 bits
+#define TREND_REBASE_SECS (1L << 20)
+
+// ----- TrendWindow -----
+TrendWindow::TrendWindow()
+{
+    reset();
+}
+
+void TrendWindow::reset()
+{
+    head = 0;
+    count = 0;
+    base = 0;
+    lastT = 0;
+    sx = sy = sxx = sxy = 0;
+}
+
+void TrendWindow::rebase(int32_t d)
+{
+    // Shift every x by -d; the sums follow without a pass over the ring
+    sxx -= 2 * (int64_t)d * sx - (int64_t)count * d * d;
+    sxy -= (int64_t)d * sy;
+    sx -= (int64_t)count * d;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t k = (uint8_t)((head + TREND_WINDOW - count + i) % TREND_WINDOW);
+        xs[k] -= d;
+    }
+    base += d;
+}
+
+bool TrendWindow::add(time_t t, float temp)
+{
+    if (isnan(temp)) return false;
+    if (count > 0) {
+        if (t - lastT < TREND_STEP_SECS && t >= lastT) return false;
+        // A long gap, or the clock was set back: start again
+        if (t < lastT || t - lastT > TREND_GAP_SECS) reset();
+    }
+    if (count == 0) base = t;
+    if (t - base >= TREND_REBASE_SECS) {
+        uint8_t oldest = (uint8_t)((head + TREND_WINDOW - count) % TREND_WINDOW);
+        rebase(xs[oldest]);
+    }
+
+    if (count == TREND_WINDOW) {
+        int64_t x = xs[head], y = ys[head];
+        sx -= x;
+        sy -= y;
+        sxx -= x * x;
+        sxy -= x * y;
+        count--;
+    }
+    int32_t x = (int32_t)(t - base);
+    int16_t y = (int16_t)lroundf(temp * 100.0f);
+    xs[head] = x;
+    ys[head] = y;
+    head = (uint8_t)((head + 1) % TREND_WINDOW);
+    count++;
+    sx += x;
+    sy += y;
+    sxx += (int64_t)x * x;
+    sxy += (int64_t)x * y;
+    lastT = t;
+    return true;
+}
+
+float TrendWindow::last() const
+{
+    if (count == 0) return NAN;
+    return ys[(head + TREND_WINDOW - 1) % TREND_WINDOW] / 100.0f;
+}
+
+float TrendWindow::slopePerHour() const
+{
+    if (count < TREND_MIN_SAMPLES) return NAN;
+    int64_t den = (int64_t)count * sxx - sx * sx;
+    if (den == 0) return NAN;
+    int64_t num = (int64_t)count * sxy - sx * sy;
+    // centi-degrees per second to degrees per hour
+    return (float)((double)num / (double)den * 36.0);
+}
+
+// ----- TrendTracker -----
+TrendTracker::TrendTracker() : limitC(NAN), horizonMin(TREND_HORIZON_MIN)
+{
+}
+
+const TrendTracker::Entry *TrendTracker::find(const std::string &id) const
+{
+    for (const auto &e : entries) {
+        if (e.id == id) return &e;
+    }
+    return nullptr;
+}
+
+void TrendTracker::add(const std::string &id, const float temps[TREND_CHANNELS], time_t t)
+{
+    Entry *e = nullptr;
+    for (auto &x : entries) {
+        if (x.id == id) e = &x;
+    }
+    if (!e) {
+        entries.push_back(Entry());
+        e = &entries.back();
+        e->id = id;
+    }
+    for (int c = 0; c < TREND_CHANNELS; c++) e->ch[c].add(t, temps[c]);
+}
+
+float TrendTracker::slope(const std::string &id, uint8_t channel) const
+{
+    const Entry *e = find(id);
+    if (!e || channel >= TREND_CHANNELS) return NAN;
+    return e->ch[channel].slopePerHour();
+}
+
+void TrendTracker::setLimit(float limit, uint32_t horizon)
+{
+    limitC = limit;
+    horizonMin = horizon;
+}
+
+void TrendTracker::evaluate(time_t now, std::vector<TrendWarning> &out) const
+{
+    out.clear();
+    if (isnan(limitC)) return;
+    for (const auto &e : entries) {
+        for (uint8_t c = 0; c < TREND_CHANNELS; c++) {
+            const TrendWindow &w = e.ch[c];
+            if (w.size() == 0 || now - w.lastTime() > TREND_GAP_SECS) continue;
+            float s = w.slopePerHour();
+            if (isnan(s) || s < TREND_MIN_SLOPE) continue;
+            float temp = w.last();
+            float mins = temp >= limitC ? 0 : (limitC - temp) / s * 60.0f;
+            if (mins >= (float)horizonMin) continue;
+            TrendWarning tw = {e.id, c, temp, s, (uint32_t)mins};
+            out.push_back(tw);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Early warning of a warming probe: a least-squares slope over the recent
+// readings of every channel of every node, and the time until it reaches
+// a configured limit at that rate.
+//
+// Each channel keeps a ring of its last TREND_WINDOW readings, at most one
+// per TREND_STEP_SECS (so the 5 s local reads and 30 s peer reports cover
+// the same span), and running sums of x, y, x^2 and xy. A reading adds its
+// terms and subtracts those of the one it evicts, so the slope is O(1) per
+// sample whatever the window. Sums are 64-bit integers over seconds and
+// centi-degrees: sliding never accumulates rounding error.
+//
+// A channel warns when it rises faster than TREND_MIN_SLOPE and the
+// projected time to the limit is under the horizon. A gap of more than
+// TREND_GAP_SECS starts the window afresh.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#define TREND_WINDOW        30          // 15 minutes at one sample per step
+#define TREND_STEP_SECS     30
+#define TREND_MIN_SAMPLES   10          // no slope before 5 minutes of data
+#define TREND_GAP_SECS      300
+#define TREND_MIN_SLOPE     0.5f        // C per hour
+#define TREND_HORIZON_MIN   60          // default warning horizon
+#define TREND_CHANNELS      3
+
+class TrendWindow {
+public:
+    TrendWindow();
+
+    // Reading at epoch t; false if it came too soon after the last one
+    bool add(time_t t, float temp);
+    void reset();
+
+    size_t size() const { return count; }
+    time_t lastTime() const { return lastT; }
+    // Latest reading in C, NAN if none
+    float last() const;
+    // Least-squares slope in C per hour, NAN below TREND_MIN_SAMPLES
+    float slopePerHour() const;
+
+private:
+    void rebase(int32_t d);
+
+    int32_t xs[TREND_WINDOW];   // seconds after base
+    int16_t ys[TREND_WINDOW];   // centi-degrees
+    uint8_t head;               // next slot to write
+    uint8_t count;
+    time_t base;
+    time_t lastT;
+    int64_t sx, sy, sxx, sxy;
+};
+
+struct TrendWarning {
+    std::string id;
+    uint8_t channel;            // 0-2 for temp1-temp3
+    float temp;
+    float slope;                // C per hour
+    uint32_t minutes;           // to the limit at this rate; 0 if already there
+};
+
+class TrendTracker {
+public:
+    TrendTracker();
+
+    // Live readings for a node (NAN channels are skipped)
+    void add(const std::string &id, const float temps[TREND_CHANNELS], time_t t);
+    // C per hour, NAN if unknown
+    float slope(const std::string &id, uint8_t channel = 0) const;
+
+    // NAN turns warnings off
+    void setLimit(float limitC, uint32_t horizonMin);
+    float limit() const { return limitC; }
+    uint32_t horizon() const { return horizonMin; }
+
+    // Channels heard in the last TREND_GAP_SECS heading for the limit
+    void evaluate(time_t now, std::vector<TrendWarning> &out) const;
+
+private:
+    struct Entry {
+        std::string id;
+        TrendWindow ch[TREND_CHANNELS];
+    };
+    const Entry *find(const std::string &id) const;
+
+    std::vector<Entry> entries;
+    float limitC;
+    uint32_t horizonMin;
+};
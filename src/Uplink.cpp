@@ -0,0 +1,229 @@
+#include "Uplink.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+
+// A mutex rather than a critical section: batches are copied and queued
+// (heap allocation) while it is held
+static std::mutex uplinkMutex;
+#define UPLINK_LOCK()   uplinkMutex.lock()
+#define UPLINK_UNLOCK() uplinkMutex.unlock()
+
+// ----- UplinkTarget -----
+bool UplinkTarget::parse(const std::string &url, UplinkTarget &out)
+{
+    size_t rest;
+    if (url.compare(0, 7, "http://") == 0) {
+        out.scheme = UplinkScheme::Http;
+        out.port = 80;
+        rest = 7;
+    } else if (url.compare(0, 7, "mqtt://") == 0) {
+        out.scheme = UplinkScheme::Mqtt;
+        out.port = 1883;
+        rest = 7;
+    } else {
+        out.scheme = UplinkScheme::None;
+        return false;
+    }
+
+    size_t slash = url.find('/', rest);
+    std::string hostPort = url.substr(rest, slash == std::string::npos ? std::string::npos : slash - rest);
+    out.path = slash == std::string::npos ? "/" : url.substr(slash);
+    size_t colon = hostPort.find(':');
+    out.host = hostPort.substr(0, colon);
+    if (colon != std::string::npos) {
+        long port = strtol(hostPort.c_str() + colon + 1, nullptr, 10);
+        if (port <= 0 || port > 65535) return false;
+        out.port = (uint16_t)port;
+    }
+    if (out.host.empty()) return false;
+
+    if (out.scheme == UplinkScheme::Mqtt) {
+        out.path.erase(0, 1);
+        if (out.path.empty()) out.path = "kic";
+    }
+    return true;
+}
+
+// ----- Uplink -----
+Uplink::Uplink()
+    : openedMs(0), urgent(false), lastSampleMs(0), sampled(false), probeDown(false),
+      nextSeq(0), retryAtMs(0), backoffMs(0),
+      publishedCount(0), failedCount(0), droppedCount(0)
+{
+}
+
+void Uplink::add(const char *event, const std::string &id, uint32_t epoch, float temp)
+{
+    if (open.size() >= UPLINK_BATCH_MAX) seal();
+    Row r = {event, id, epoch, temp};
+    open.push_back(r);
+    if (event) urgent = true;
+}
+
+void Uplink::sample(const NodeTable &table, uint32_t nowMs)
+{
+    if (sampled && nowMs - lastSampleMs < UPLINK_SAMPLE_MS) return;
+    sampled = true;
+    lastSampleMs = nowMs;
+
+    for (const auto &n : table) {
+        Seen *s = nullptr;
+        for (auto &x : seen) {
+            if (x.id == n.id) s = &x;
+        }
+        if (!s) {
+            Seen fresh = {n.id, 0};
+            seen.push_back(fresh);
+            s = &seen.back();
+        }
+        // Only what arrived since the last sample
+        if (n.lastUpdate <= s->lastUpdate) continue;
+        s->lastUpdate = n.lastUpdate;
+        add(nullptr, n.id, (uint32_t)n.lastUpdate, n.temp1);
+    }
+}
+
+void Uplink::alarms(const AlarmStatus &s, uint32_t epoch)
+{
+    for (const auto &id : s.downNodes) {
+        bool known = false;
+        for (const auto &d : down) known = known || d == id;
+        if (known) continue;
+        // Not heard since boot is not "went down", as for ALARM messages
+        bool heard = false;
+        for (const auto &x : seen) heard = heard || x.id == id;
+        if (!heard) continue;
+        down.push_back(id);
+        add("down", id, epoch, NAN);
+    }
+    for (size_t i = 0; i < down.size();) {
+        bool still = false;
+        for (const auto &id : s.downNodes) still = still || id == down[i];
+        if (still) {
+            i++;
+            continue;
+        }
+        add("up", down[i], epoch, NAN);
+        down.erase(down.begin() + i);
+    }
+    if (s.probeDisconnected != probeDown) {
+        probeDown = s.probeDisconnected;
+        add(probeDown ? "probe" : "probe_ok", nodeID, epoch, NAN);
+    }
+}
+
+void Uplink::tick(uint32_t nowMs)
+{
+    if (open.empty()) {
+        openedMs = nowMs;
+        return;
+    }
+    if (urgent || nowMs - openedMs >= UPLINK_BATCH_MS) seal();
+}
+
+// Node ids come off the air; keep them from breaking the JSON
+static void appendId(std::string &out, const std::string &id)
+{
+    out += '"';
+    for (char c : id) {
+        if (c >= ' ' && c != '"' && c != '\\' && c < 0x7F) out += c;
+    }
+    out += '"';
+}
+
+void Uplink::seal()
+{
+    if (open.empty()) return;
+    uint32_t t0 = open[0].epoch;
+    for (const auto &r : open) {
+        if (r.epoch < t0) t0 = r.epoch;
+    }
+
+    char num[48];
+    Batch b;
+    b.seq = nextSeq++;
+    b.body.reserve(64 + open.size() * 24);
+    b.body = "{\"node\":";
+    appendId(b.body, nodeID);
+    snprintf(num, sizeof(num), ",\"seq\":%lu,\"t0\":%lu", (unsigned long)b.seq, (unsigned long)t0);
+    b.body += num;
+
+    bool any = false;
+    for (const auto &r : open) {
+        if (r.event) continue;
+        b.body += any ? "," : ",\"r\":[";
+        any = true;
+        b.body += '[';
+        appendId(b.body, r.id);
+        if (isnan(r.temp)) snprintf(num, sizeof(num), ",%lu,null]", (unsigned long)(r.epoch - t0));
+        else snprintf(num, sizeof(num), ",%lu,%.2f]", (unsigned long)(r.epoch - t0), r.temp);
+        b.body += num;
+    }
+    if (any) b.body += ']';
+
+    any = false;
+    for (const auto &r : open) {
+        if (!r.event) continue;
+        b.body += any ? "," : ",\"e\":[";
+        any = true;
+        b.body += "[\"";
+        b.body += r.event;
+        b.body += "\",";
+        appendId(b.body, r.id);
+        snprintf(num, sizeof(num), ",%lu]", (unsigned long)(r.epoch - t0));
+        b.body += num;
+    }
+    if (any) b.body += ']';
+    b.body += '}';
+
+    open.clear();
+    urgent = false;
+
+    UPLINK_LOCK();
+    if (queue.size() >= UPLINK_QUEUE_MAX) {
+        queue.erase(queue.begin());
+        droppedCount++;
+    }
+    queue.push_back(std::move(b));
+    UPLINK_UNLOCK();
+}
+
+bool Uplink::publishDue(UplinkTransport &transport, uint32_t nowMs)
+{
+    UPLINK_LOCK();
+    if (queue.empty() || (int32_t)(nowMs - retryAtMs) < 0) {
+        UPLINK_UNLOCK();
+        return false;
+    }
+    Batch b = queue.front();
+    UPLINK_UNLOCK();
+
+    // Outside the lock: the loop keeps sealing batches while we wait on
+    // the network
+    bool ok = transport.publish(b.body.data(), b.body.size());
+
+    UPLINK_LOCK();
+    if (ok) {
+        if (!queue.empty() && queue.front().seq == b.seq) queue.erase(queue.begin());
+        publishedCount++;
+        backoffMs = 0;
+        retryAtMs = nowMs;
+    } else {
+        failedCount++;
+        backoffMs = backoffMs ? backoffMs * 2 : UPLINK_RETRY_MS;
+        if (backoffMs > UPLINK_RETRY_MAX_MS) backoffMs = UPLINK_RETRY_MAX_MS;
+        retryAtMs = nowMs + backoffMs;
+    }
+    UPLINK_UNLOCK();
+    return ok;
+}
+
+size_t Uplink::queued() const
+{
+    UPLINK_LOCK();
+    size_t n = queue.size();
+    UPLINK_UNLOCK();
+    return n;
+}
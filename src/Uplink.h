@@ -0,0 +1,109 @@
+#pragma once
+
+// Batched uplink of readings and alarm events to a site collector (an HTTP
+// endpoint or an MQTT broker on the LAN) from a node in WiFi station mode.
+//
+// The loop samples the node table every UPLINK_SAMPLE_MS, keeping each
+// node's reading only if it is newer than the last one queued, and turns
+// changes in the alarm state into events. Entries gather in an open batch
+// that is sealed after UPLINK_BATCH_MS, when it is full, or at once when it
+// holds an event. A sealed batch is one compact JSON document:
+//
+//   {"node":"A1B2C3","seq":17,"t0":1757599200,
+//    "r":[["B4C5D6",0,-18.25],["A1B2C3",60,-18.31]],
+//    "e":[["down","C7D8E9",95]]}
+//
+// "r" rows are [node, seconds after t0, temp C or null] and "e" rows are
+// [event, node, seconds after t0]. Events: down/up (node-down alarm raised
+// or cleared), probe/probe_ok (our own probe). seq lets the collector drop
+// a batch it receives twice.
+//
+// Sealed batches wait in a bounded queue (oldest dropped when full) for the
+// uplink task, which publishes them in order and backs off after a failure
+// from UPLINK_RETRY_MS, doubling up to UPLINK_RETRY_MAX_MS.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Hal.h"
+#include "NodeTable.h"
+#include "Alarms.h"
+
+#define UPLINK_SAMPLE_MS     60000UL
+#define UPLINK_BATCH_MS      300000UL
+#define UPLINK_BATCH_MAX     64          // rows per batch
+#define UPLINK_QUEUE_MAX     12          // sealed batches; an hour at the default pace
+#define UPLINK_RETRY_MS      5000UL
+#define UPLINK_RETRY_MAX_MS  300000UL
+
+enum class UplinkScheme : uint8_t { None, Http, Mqtt };
+
+// http://host[:port]/path or mqtt://host[:port]/topic
+struct UplinkTarget {
+    UplinkScheme scheme;
+    std::string host;
+    uint16_t port;
+    std::string path;    // HTTP path, or MQTT topic without the leading '/'
+
+    static bool parse(const std::string &url, UplinkTarget &out);
+};
+
+class Uplink {
+public:
+    Uplink();
+
+    void setNodeId(const std::string &id) { nodeID = id; }
+
+    // Loop task: queue new readings from the table (at most every
+    // UPLINK_SAMPLE_MS), alarm changes, and seal the batch when it is due
+    void sample(const NodeTable &table, uint32_t nowMs);
+    void alarms(const AlarmStatus &s, uint32_t epoch);
+    void tick(uint32_t nowMs);
+
+    // Uplink task: publish the oldest sealed batch if its retry time has
+    // come; true if one was delivered
+    bool publishDue(UplinkTransport &transport, uint32_t nowMs);
+
+    size_t queued() const;
+    uint32_t published() const { return publishedCount; }
+    uint32_t failures() const { return failedCount; }
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    struct Row {
+        const char *event;   // nullptr for a reading
+        std::string id;
+        uint32_t epoch;
+        float temp;
+    };
+    struct Batch {
+        uint32_t seq;
+        std::string body;
+    };
+    struct Seen {
+        std::string id;
+        time_t lastUpdate;
+    };
+
+    void add(const char *event, const std::string &id, uint32_t epoch, float temp);
+    void seal();
+
+    std::string nodeID;
+    std::vector<Row> open;
+    uint32_t openedMs;
+    bool urgent;             // holds an event: seal on the next tick
+    uint32_t lastSampleMs;
+    bool sampled;
+    std::vector<Seen> seen;
+    std::vector<std::string> down;
+    bool probeDown;
+
+    std::vector<Batch> queue;
+    uint32_t nextSeq;
+    uint32_t retryAtMs;
+    uint32_t backoffMs;
+    uint32_t publishedCount;
+    uint32_t failedCount;
+    uint32_t droppedCount;
+};
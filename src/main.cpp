@@ -15,7 +15,7 @@
 #include <WiFi.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
-#include <DNSServer.h>
+#include <AsyncUDP.h>
 #include <Preferences.h>
 #include <RadioLib.h>
 #include <SPI.h>
@@ -25,11 +25,35 @@
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <vector>
+#include <mutex>
 #include <Wire.h>
 #include <TimeLib.h>
 #include <DS3231.h>
 #include <LittleFS.h>
-#include "CryptoHelper.h"
+#include "KicNode.h"
+#include "TempLog.h"
+#include "EspHal.h"
+#include "Uplink.h"
+#include "DebugLog.h"
+#include "CommandLine.h"
+#include "CaptiveDns.h"
+#include "LogBlock.h"
+#include "LogStage.h"
+#include "Boot.h"
+#include "TextBuf.h"
+#include "ConfigChange.h"
+#ifdef KIC_LOW_POWER
+#include "Power.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#endif
+#ifdef KIC_BENCH
+#include "BenchSuite.h"
+#endif
+#ifdef KIC_GATEWAY
+#include "Gateway.h"
+#endif
 
 // ----- Pin Definitions -----
 #define OLED_RESET 21
@@ -44,124 +68,159 @@
 #define LORA_BUSY  13
 #define LORA_DIO0  14
 #define LORA_FREQ  915E6 // adjust for region
+// Low-power nodes only hear senders whose preamble outlasts their sniff
+// interval, so every node in a mixed network needs the longer preamble
+#ifndef LORA_PREAMBLE_LEN
+#ifdef KIC_LOW_POWER
+#define LORA_PREAMBLE_LEN 64
+#else
+#define LORA_PREAMBLE_LEN 8
+#endif
+#endif
+#define PRG_BUTTON 0     // Heltec "PRG" button, active low
 
 // ----- Hardware -----
 TwoWire twi = TwoWire(1);
 Adafruit_SSD1306 display(128, 64, &twi, OLED_RESET);
+bool displayReady = false;    // bootDisplay() has run; the buffer exists from then on
 OneWire oneWire(DS18B20_PIN);
 DallasTemperature sensors(&oneWire);
 Preferences preferences;
 AsyncWebServer server(80);
-DNSServer dnsServer;
+AsyncUDP dnsUdp;
+CaptiveDns captiveDns;
 DS3231 rtc;
 
 
-// ----- Node Data -----
-struct NodeTemp {
-  String id;
-  float temp1;
-  float temp2;
-  float temp3;
-  time_t lastUpdate;
-  bool hasrtc;
-};
-struct NodeConfig {
-  String id;
-  String name;
-  bool hasrtc;
-  time_t lastSeen;
-  String temp1_name;
-  String temp2_name;
-  String temp3_name;
-  bool temp1_enabled;
-  bool temp2_enabled;
-  bool temp3_enabled;
-  float temp1_alarm_low;
-  float temp1_alarm_high;
-  float temp2_alarm_low;
-  float temp2_alarm_high;
-  float temp3_alarm_low;
-  float temp3_alarm_high;
-};
-
 String loraPassphrase = "bowman#1";
-uint8_t loraKey[16];
-uint8_t loraIV[16] = {0};
-size_t encLen = 0;
-size_t decLen = 0;
 
-
-std::vector<NodeTemp> nodeTemps;
 String nodeID;
-String nodeList; // Comma-separated
 String wifiSSID = "";
 String wifiPASS = "";
-float myTemp = NAN;
-int16_t lastLoRaStatus = 0;
+String staSSID = "";          // site WiFi for the uplink; empty = AP only
+String staPASS = "";
+String uplinkURL = "";        // http://host[:port]/path or mqtt://host[:port]/topic
+bool staOnly = false;         // no AP once the node is on the site WiFi
 volatile bool loraPacketReceived = false;
-String loraBuffer= "";
+volatile bool restartPending = false;  // web task -> loop(): reboot once the reply is out
+volatile uint32_t restartRequestMs = 0;
+bool apRestartPending = false;         // new AP settings, applied once the reply is out
+uint32_t apRestartMs = 0;
+// Web task -> loop(): a validated change (see ConfigChange.h), a page
+// visit and a silence request. A mutex rather than a critical section, as
+// the strings allocate when moved in.
+std::mutex configMutex;
+bool configPending = false;
+ConfigChange pendingConfig;
+bool checkinPending = false;
+uint32_t silencePendingMs = 0;
+// Held by loop() while it works on the node, and by every web handler (see
+// setupWebServer), so pages never read the node table, roster or metrics
+// mid-change. Take configMutex inside it, never the other way round.
+std::mutex nodeMutex;
 bool doIhaveRTC = false;
-bool needTime = false;
-const char* logFile = "/templog.csv"; // CSV: epoch,temp
-unsigned long lastLog = 0;
-//const unsigned long logInterval = 15UL * 60UL * 1000UL; // 15 minutes in millis
+const char* logFile = "/templog.kbl";     // LogBlock.h blocks
+const char* csvLogFile = "/templog.csv";  // written by older firmware
 
 
 // Create the radio object (Module: NSS, IRQ(DIO1), RST, BUSY)
 Module myModule(LORA_SS, LORA_DIO0, LORA_RST, LORA_BUSY);
 SX1262 radio = SX1262(&myModule);
 
-
-// ----- Timekeeping -----
-unsigned long storedEpoch = 0;    // seconds since epoch
-unsigned long storedMillis = 0;   // millis() when time was set
-time_t nextLog = 0;
+// ----- HAL + node logic -----
+EspClock espClock;
+EspRadio espRadio(radio);
+PreferencesStore prefStore(preferences);
+LittleFsLogStore logFlash(logFile);
+RTC_NOINIT_ATTR LogStageArea logStageArea;   // survives ESP.restart()
+StagedLogStore logStore(logStageArea, logFlash, espClock);
+DallasSensor tempSensor(sensors);
+KicNode node(espClock, espRadio, prefStore, logStore, tempSensor);
+#ifdef KIC_GATEWAY
+GatewayStream gateway;        // binary readings for a host collector
+#endif
+#ifndef KIC_LOW_POWER
+Uplink uplink;
+UplinkTransport *uplinkTransport = nullptr;   // set when an uplink URL is configured
+#endif
+extern BootSequence boot;     // stage table and timing, see Boot
+#ifdef KIC_LOW_POWER
+PowerStats powerStats;
+bool apActive = false;        // AP up on demand
+uint32_t apLastUseMs = 0;     // last button press or web request
+#endif
 
 
+// ----- Timekeeping -----
 struct tm getLocalTime() {
-  //unsigned long secondsSinceSet = (millis() - storedMillis) / 1000;
   time_t tnow = now();
   struct tm t;
   localtime_r(&tnow, &t);
   return t;
 }
-bool isDaytime() {
+#define TIME_STRING_LEN 20
+// "YYYY-MM-DD HH:MM" into buf, which holds TIME_STRING_LEN
+const char *getTimeString(char *buf) {
   struct tm t = getLocalTime();
-  int hour = t.tm_hour;
-  return hour >= 8 && hour < 20;
+  snprintf(buf, TIME_STRING_LEN, "%04d-%02d-%02d %02d:%02d", t.tm_year+1900, t.tm_mon+1, t.tm_mday, t.tm_hour, t.tm_min);
+  return buf;
 }
-String getTimeString() {
-  struct tm t = getLocalTime();
-  char buf[20];
-  sprintf(buf, "%04d-%02d-%02d %02d:%02d", t.tm_year+1900, t.tm_mon+1, t.tm_mday, t.tm_hour, t.tm_min);
-  return String(buf);
+// Local date/time fields to epoch
+time_t localEpoch(int year, int month, int day, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = month - 1;
+  t.tm_mday = day;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_sec = 0;
+  return mktime(&t);
+}
+// Set the clock, and the RTC if fitted (it keeps local time); the log
+// carries on from the new time
+void setClockEpoch(time_t epoch) {
+  espClock.setTime(epoch);
+  node.clockChanged();
+  if (doIhaveRTC) {
+    struct tm t;
+    localtime_r(&epoch, &t);
+    rtc.setClockMode(false);   // 24 h
+    rtc.setYear(t.tm_year + 1900 - 2000);
+    rtc.setMonth(t.tm_mon + 1);
+    rtc.setDate(t.tm_mday);
+    rtc.setHour(t.tm_hour);
+    rtc.setMinute(t.tm_min);
+    rtc.setSecond(t.tm_sec);
+  }
 }
 
-// ----- Alarm/Checkin -----
-unsigned long silenceUntil = 0;
-unsigned long lastWebCheckin = 0;
-void loadSilence() {
-  preferences.begin("probe", false);
-  silenceUntil = preferences.getULong("silenceUntil", 0);
-  preferences.end();
-}
-void setSilence(unsigned long ms) {
-  silenceUntil = millis() + ms;
-  preferences.begin("probe", false);
-  preferences.putULong("silenceUntil", silenceUntil);
-  preferences.end();
-}
-void loadLastWebCheckin() {
-  preferences.begin("probe", false);
-  lastWebCheckin = preferences.getULong("lastWebCheckin", 0);
-  preferences.end();
-}
-void updateWebCheckin() {
-  lastWebCheckin = millis();
-  preferences.begin("probe", false);
-  preferences.putULong("lastWebCheckin", lastWebCheckin);
-  preferences.end();
+// ----- Restart -----
+// Staged log bytes would survive a soft reset anyway; write them out so
+// a power cut before the next flush can't take them
+void restartNode() {
+  logStore.flush();
+  ESP.restart();
+}
+
+// From a web handler: loop() restarts once the reply has gone out
+void requestRestart() {
+  restartRequestMs = millis();
+  restartPending = true;
 }
+
+// New AP name or password without a reboot: clients drop and rejoin,
+// the radio and the log carry on
+void restartAp() {
+#ifdef KIC_LOW_POWER
+  if (!apActive) return;   // apStart() uses the new settings
+#else
+  if (staSSID != "" && staOnly) return;
+#endif
+  WiFi.softAP(wifiSSID.c_str(), wifiPASS.c_str());
+  LOG_I("AP restarted as %s", wifiSSID.c_str());
+}
+
+// ----- Alarm/Checkin -----
 #define DAY_MS 86400000UL
 void buzzAlarm() {
   pinMode(BUZZER_PIN, OUTPUT);
@@ -170,40 +229,6 @@ void buzzAlarm() {
   digitalWrite(BUZZER_PIN, LOW);
 }
 
-// ----- Node List Management -----
-NodeTemp* findNodeById(const String &id) {
-  for (auto &node : nodeTemps) {
-    if (node.id == id) {
-      return &node;  // return pointer to the entry
-    }
-  }
-  return nullptr;  // not found
-}
-
-void loadNodeList() {
-  preferences.begin("probe", false);
-  nodeList = preferences.getString("nodelist", "");
-  preferences.end();
-  if (!nodeList.length()) nodeList = nodeID;
-}
-void saveNodeList(const String& list) {
-  preferences.begin("probe", false);
-  preferences.putString("nodelist", list);
-  preferences.end();
-  nodeList = list;
-}
-std::vector<String> getNodeIDs() {
-  std::vector<String> ids;
-  int start = 0;
-  while (start < nodeList.length()) {
-    int comma = nodeList.indexOf(',', start);
-    String nid = nodeList.substring(start, comma == -1 ? nodeList.length() : comma);
-    ids.push_back(nid);
-    start = (comma == -1 ? nodeList.length() : comma + 1);
-  }
-  return ids;
-}
-
 // ----- WiFi/NodeID Config -----
 String getDefaultNodeID() {
   uint8_t mac[6];
@@ -213,50 +238,118 @@ String getDefaultNodeID() {
   return String(nodeid);
 }
 void loadConfig() {
-  preferences.begin("probe", false);
-  nodeID = preferences.getString("nodeid", "");
-  wifiSSID = preferences.getString("ssid", "");
-  wifiPASS = preferences.getString("pass", "");
-  preferences.end();
+  nodeID = prefStore.getString("nodeid", "").c_str();
+  wifiSSID = prefStore.getString("ssid", "").c_str();
+  wifiPASS = prefStore.getString("pass", "").c_str();
+  staSSID = prefStore.getString("staSsid", "").c_str();
+  staPASS = prefStore.getString("staPass", "").c_str();
+  uplinkURL = prefStore.getString("uplink", "").c_str();
+  staOnly = prefStore.getULong("staOnly", 0) != 0;
   if (nodeID == "" || nodeID.length() != 6) {
     nodeID = getDefaultNodeID();
-    preferences.begin("probe", false);
-    preferences.putString("nodeid", nodeID);
-    preferences.end();
+    prefStore.putString("nodeid", nodeID.c_str());
   }
   if (wifiSSID == "") {
     wifiSSID = "KIC-" + nodeID;
-    preferences.begin("probe", false);
-    preferences.putString("ssid", wifiSSID);
-    preferences.end();
+    prefStore.putString("ssid", wifiSSID.c_str());
   } 
   
   if (wifiPASS == "" || wifiPASS.length() < 8) {
     wifiPASS = "KeepItCold";
-    preferences.begin("probe", false);
-    preferences.putString("pass", wifiPASS);
-    preferences.end();
+    prefStore.putString("pass", wifiPASS.c_str());
   }
 }
 void saveNodeID(const String& id) {
-  preferences.begin("probe", false);
-  preferences.putString("nodeid", id);
-  String curPass = preferences.getString("pass", "");
+  prefStore.putString("nodeid", id.c_str());
+  String curPass = prefStore.getString("pass", "").c_str();
   if (curPass == nodeID || curPass == "" || curPass.length() < 6) {
-    preferences.putString("pass", id);
+    prefStore.putString("pass", id.c_str());
     wifiPASS = id;
   }
-  preferences.end();
   nodeID = id;
+  // Peers would otherwise keep expecting reports from the old ID
+  if (node.setNodeId(id.c_str())) node.broadcastNodeList();
+#ifndef KIC_LOW_POWER
+  uplink.setNodeId(id.c_str());
+#endif
 }
 void saveWiFi(const String& ssid, const String& pass) {
-  preferences.begin("probe", false);
-  preferences.putString("ssid", ssid);
-  preferences.putString("pass", pass);
-  preferences.end();
+  prefStore.putString("ssid", ssid.c_str());
+  prefStore.putString("pass", pass.c_str());
   wifiSSID = ssid;
   wifiPASS = pass;
 }
+void saveUplink(const String& ssid, const String& pass, const String& url, bool only) {
+  prefStore.putString("staSsid", ssid.c_str());
+  prefStore.putString("staPass", pass.c_str());
+  prefStore.putString("uplink", url.c_str());
+  prefStore.putULong("staOnly", only ? 1 : 0);
+  staSSID = ssid;
+  staPASS = pass;
+  uplinkURL = url;
+  staOnly = only;
+}
+
+// Apply a validated change in one pass, from loop(). A key is written to
+// NVS only if its value differs; only the site WiFi and uplink need a
+// restart, which waits for the reply to go out.
+void applyConfig(const ConfigChange &c) {
+  if (c.has(CfgNodeId) && nodeID != c.nodeId.c_str()) saveNodeID(c.nodeId.c_str());
+  if (c.has(CfgApSsid | CfgApPass)) {
+    String ssid = c.has(CfgApSsid) ? String(c.apSsid.c_str()) : wifiSSID;
+    String pass = c.has(CfgApPass) ? String(c.apPass.c_str()) : wifiPASS;
+    if (ssid != wifiSSID || pass != wifiPASS) {
+      saveWiFi(ssid, pass);
+      apRestartMs = millis();
+      apRestartPending = true;
+    }
+  }
+#ifndef KIC_LOW_POWER
+  if (c.needsRestart()) {
+    String ssid = c.has(CfgStaSsid) ? String(c.staSsid.c_str()) : staSSID;
+    String pass = c.has(CfgStaPass) ? String(c.staPass.c_str()) : staPASS;
+    String url = c.has(CfgUplink) ? String(c.uplink.c_str()) : uplinkURL;
+    bool only = c.has(CfgStaOnly) ? c.staOnly : staOnly;
+    if (ssid != staSSID || pass != staPASS || url != uplinkURL || only != staOnly) {
+      saveUplink(ssid, pass, url, only);
+      requestRestart();
+    }
+  }
+#endif
+  if (c.has(CfgRoster) && c.roster != node.roster().str()) {
+    node.setNodeList(c.roster);
+    node.broadcastNodeList();
+  }
+  if (c.has(CfgTrendLimit | CfgTrendHorizon)) {
+    float limit = c.has(CfgTrendLimit) ? c.trendLimit : node.trend().limit();
+    uint32_t horizon = c.has(CfgTrendHorizon) ? c.trendHorizon : node.trend().horizon();
+    float was = node.trend().limit();
+    bool sameLimit = isnan(limit) ? isnan(was) : limit == was;
+    if (!sameLimit || horizon != node.trend().horizon()) node.setTrendLimit(limit, horizon);
+  }
+  if (c.has(CfgTime)) setClockEpoch((time_t)c.time);
+  if (c.has(CfgMaxDbm) && c.maxDbm != node.linkAdapt().maxTxDbm()) node.setMaxTxDbm(c.maxDbm);
+}
+
+// Take the web task's requests, if any, and apply them outside the lock
+void applyPendingConfig() {
+  ConfigChange c;
+  bool change, checkin;
+  uint32_t silenceMs;
+  {
+    std::lock_guard<std::mutex> lock(configMutex);
+    change = configPending;
+    if (change) std::swap(c, pendingConfig);
+    configPending = false;
+    checkin = checkinPending;
+    checkinPending = false;
+    silenceMs = silencePendingMs;
+    silencePendingMs = 0;
+  }
+  if (checkin) node.webCheckin();
+  if (silenceMs) node.silence(silenceMs);
+  if (change) applyConfig(c);
+}
 
 // ----- LoRa -----
 void setLoraFlag(void) {
@@ -264,33 +357,29 @@ void setLoraFlag(void) {
 }
 
 void setupLoRa() {
-  // generate encryption key
-  CryptoHelper::deriveKey(loraPassphrase, loraKey);
-
-
-
   Serial.println("SPI begin");
   //SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS);
   SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI);
-//  Serial.println("LoRa setPins");
-//  LoRa.setPins(LORA_SS, LORA_RST, LORA_DIO0);
   Serial.println("LoRa begin");
-  lastLoRaStatus = radio.begin(915.0);
+  int16_t status = radio.begin(915.0, 125.0, ADR_BASE_SF);
 
-  if (lastLoRaStatus == RADIOLIB_ERR_NONE) {
+  if (status == RADIOLIB_ERR_NONE) {
     Serial.println("LoRa init OK");
   } else {
     Serial.print("LoRa init failed: ");
-    Serial.println(lastLoRaStatus);
+    Serial.println(status);
   }
-  radio.setOutputPower(13);
-  
+  radio.setOutputPower(ADR_BASE_DBM);
+  radio.setPreambleLength(LORA_PREAMBLE_LEN);
+#ifdef KIC_LOW_POWER
+  espRadio.setDutyCycle(LORA_PREAMBLE_LEN);
+#endif
+
   Serial.println("LoRa setup done");
-//  Serial.println(lastLoRaStatus);
 
   // attach call back
   radio.setDio1Action(setLoraFlag);
-  int16_t state = radio.startReceive();
+  int16_t state = espRadio.listen();
   if (state == RADIOLIB_ERR_NONE) { 
     Serial.println("LoRa RX started");
   } else {
@@ -299,299 +388,459 @@ void setupLoRa() {
   } 
 }
 
-
-void broadcastNodeList() {
-  String msg = "NODELIST," + nodeList;
-  int16_t state = radio.transmit(msg);
-  if(state == RADIOLIB_ERR_NONE){
-    Serial.println("Node list sent: " + msg);
-  } else {
-    Serial.print("Node list failed, code: ");
-    Serial.println(state);
+// ----- OLED Display -----
+void showOLED() {
+  if (!displayReady) return;
+  display.clearDisplay();
+  display.setCursor(0,0);
+  display.print("Node: "); display.println(nodeID);
+  display.print("Temp: "); display.print(node.myTemp(),1); display.print(" C");
+  float slope = node.trend().slope(nodeID.c_str());
+  if (!isnan(slope)) display.printf(" %+.1f/h", slope);
+  display.println();
+  display.print("WiFi: "); display.println(wifiSSID);
+  display.print("PASS: "); display.println(wifiPASS);
+  char ts[TIME_STRING_LEN];
+  display.print(getTimeString(ts)); display.println();
+  int y = 56;
+  for (auto& n : node.table()) {
+    display.setCursor(0, y);
+    display.print(n.id.c_str()); display.print(": ");
+    if (!isnan(n.temp1)) display.print(n.temp1,1); else display.print("-");
+    display.print("C");
+    y -= 8; if (y < 40) break;
   }
+  display.display();
 }
 
-void broadcastAlarm(const String& downNodeID) {
-  String msg = nodeID + ",ALARM," + downNodeID;
-  int16_t state = radio.transmit(msg);
-  if(state == RADIOLIB_ERR_NONE){
-    Serial.println("Alarm sent: " + msg);
-  } else {
-    Serial.print("Alarm failed, code: ");
-    Serial.println(state);
+// ----- Log export -----
+// One /log at a time, from static state: the staged tail copied at
+// request time, the merger that puts backfilled rows back in time order,
+// and the CSV of the rows it last gave. A second request meanwhile gets
+// 503.
+#define LOG_EXPORT_TEXT 1024
+#define LOG_EXPORT_ROW  96   // longest CSV row
+
+struct LogExport {
+  File file;
+  size_t fileEnd;     // then the staged bytes
+  uint8_t staged[LOGSTAGE_BYTES];
+  size_t stagedLen;
+  LogBlockMerger rows;
+  char text[LOG_EXPORT_TEXT];   // CSV not yet sent
+  size_t textLen;
+  size_t sent;
+};
+static LogExport logExport;
+static bool logExportBusy = false;   // only touched on the async_tcp task
+
+// Bytes of the log as if the staged tail were already in the file
+size_t logExportRead(LogExport &e, size_t off, uint8_t *buf, size_t len) {
+  size_t n = 0;
+  if (off < e.fileEnd) {
+    e.file.seek(off);
+    n = e.file.read(buf, off + len <= e.fileEnd ? len : e.fileEnd - off);
+    if (off + n < e.fileEnd) return n;
+  }
+  size_t s = off + n - e.fileEnd;
+  if (s < e.stagedLen) {
+    size_t m = e.stagedLen - s < len - n ? e.stagedLen - s : len - n;
+    memcpy(buf + n, e.staged + s, m);
+    n += m;
   }
+  return n;
 }
 
-void broadcastKIC() {
-  NodeTemp* nt = findNodeById(nodeID);
-  if (!nt) return;   // safety check
-
-  String msg = "KIC," +
-               nt->id + "," +
-               String(nt->temp1, 2) + "," +
-               String(nt->temp2, 2) + "," +
-               String(nt->temp3, 2) + "," +
-               String((unsigned long)nt->lastUpdate) + "," +
-               String(nt->hasrtc ? 1 : 0);
-  
-  // Convert to bytes
-  size_t len = msg.length();
-  //size_t paddedLen = ((len + 15) / 16) * 16; // AES-CBC block padding
-  uint8_t input[len];
-  memcpy(input, msg.c_str(), len);
-
-  uint8_t output[256];
-  size_t outLen = 0;
-
-
-  //memset(input, 0, paddedLen);
-
-  // Encrypt
-  //CryptoHelper::aesEncrypt(loraKey, loraIV, input, paddedLen, output);
-  CryptoHelper::aesEncrypt(loraKey, input, len, output, outLen);
-
-  if (outLen == 0) {
-    Serial.println("Encryption failed, skipping send.");
-    return;
-  }
+size_t logExportBlock(void *ctx, size_t block, uint8_t *buf) {
+  return logExportRead(*(LogExport *)ctx, block * LOGBLOCK_SIZE, buf, LOGBLOCK_SIZE);
+}
 
-  //int16_t state = radio.transmit(msg);
-  int16_t state = radio.transmit(output, outLen);
-  if (state == RADIOLIB_ERR_NONE) {
-    Serial.println("Send NodeTemp: " + msg);
-    Serial.print("Send Encrypted (hex): ");
-    for (size_t i = 0; i < outLen; i++) {
-      if (output[i] < 16) Serial.print("0");
-      Serial.print(output[i], HEX);
+size_t logExportFill(LogExport &e, uint8_t *buf, size_t maxLen) {
+  if (e.sent == e.textLen) {
+    e.textLen = 0;
+    e.sent = 0;
+    LogRow r;
+    char tstamp[24];
+    while (e.textLen + LOG_EXPORT_ROW <= sizeof(e.text) && e.rows.next(r)) {
+      TempLog::formatTimestamp((time_t)r.epoch, tstamp, sizeof(tstamp));
+      e.textLen += TempLog::formatRow(tstamp, r.id, r.temp[0], r.temp[1], r.temp[2],
+                                      e.text + e.textLen, sizeof(e.text) - e.textLen);
+    }
+    if (e.textLen == 0) {
+      e.file.close();
+      return 0;
     }
-    Serial.println();
-  } else {
-    Serial.print("Send failed: ");
-    Serial.println(state);
   }
+  size_t n = e.textLen - e.sent;
+  if (n > maxLen) n = maxLen;
+  memcpy(buf, e.text + e.sent, n);
+  e.sent += n;
+  return n;
+}
 
-  // Ensure we always go back into RX mode
-  radio.startReceive();
+// ----- Web Server -----
+// Pages, JSON and metrics are rendered into one static buffer and sent
+// from it without a copy, instead of growing Strings on the heap. It is
+// held until the response has gone out; a request meanwhile gets 503.
+// The metrics are the largest, at about 10 KB.
+#define WEB_PAGE_BYTES 12288
+static char webPage[WEB_PAGE_BYTES];
+static bool webPageBusy = false;   // only touched on the async_tcp task
+
+bool claimWebPage(AsyncWebServerRequest *request) {
+  if (webPageBusy) {
+    request->send(503, "text/plain", "Busy, try again");
+    return false;
+  }
+  webPageBusy = true;
+  request->onDisconnect([]() { webPageBusy = false; });
+  return true;
 }
 
-void updateNodeTemp(String id, float temp, float temp2, float temp3, bool hasRTC) {
-  for (auto& n : nodeTemps) {
-    if (n.id == id) {
-      n.temp1 = temp;
-      n.temp2 = temp2;
-      n.temp3 = temp3;
-      n.lastUpdate = now();
-      n.hasrtc = hasRTC;
-      return;
-    }
+void sendWebPage(AsyncWebServerRequest *request, const char *type, const TextBuf &page) {
+  if (page.overflowed()) {
+    request->send(500, "text/plain", "Page too large");
+    return;
   }
-  NodeTemp nt = {id, temp, temp2, temp3, now(), hasRTC};
-  nodeTemps.push_back(nt);
+  request->send(request->beginResponse(200, type, (const uint8_t *)page.c_str(), page.size()));
 }
 
-void handleLoRaPacket(String incoming) {
-  if (incoming.startsWith("NODELIST,")) {
-    String newList = incoming.substring(9);
-    if (nodeList != newList) {
-      saveNodeList(newList);
+void WebServerRoot(AsyncWebServerRequest *request){
+    {
+      std::lock_guard<std::mutex> lock(configMutex);
+      checkinPending = true;
     }
-  } else if (incoming.indexOf(",TEMP,") > 0) {
-    int idx1 = incoming.indexOf(",");
-    int idx2 = incoming.indexOf(",TEMP,");
-    String peerID = incoming.substring(0, idx1);
-    float temp = incoming.substring(idx2 + 6).toFloat();
-//    updateNodeTemp(peerID, temp);
-  } else if (incoming.indexOf(",HEARTBEAT,") > 0) {
-    int idx1 = incoming.indexOf(",");
-    String peerID = incoming.substring(0, idx1);
-//    updateNodeTemp(peerID, NAN); // update heartbeat timestamp only
-  } else if (incoming.indexOf(",ALARM,") > 0) {
-    // Optionally handle remote alarms
-  } else if (incoming.startsWith("KIC,")) {
-    // parse node temp struct
-    int idx1 = incoming.indexOf(",", 4);
-    if (idx1 < 0) return;
-    int idx2 = incoming.indexOf(",", idx1 + 1);
-    if (idx2 < 0) return;
-    int idx3 = incoming.indexOf(",", idx2 + 1);
-    if (idx3 < 0) return;
-    int idx4 = incoming.indexOf(",", idx3 + 1);
-    if (idx4 < 0) return;
-    int idx5 = incoming.indexOf(",", idx4 + 1);
-    if (idx5 < 0) return;
-    String peerID = incoming.substring(4, idx1);
-    float temp1 = incoming.substring(idx1 + 1, idx2).toFloat();
-    float temp2 = incoming.substring(idx2 + 1, idx3).toFloat();
-    float temp3 = incoming.substring(idx3 + 1, idx4).toFloat();
-    unsigned long lu = incoming.substring(idx4 + 1, idx5).toInt();
-    bool hasrtc = incoming.substring(idx5 + 1).toInt() != 0;
-    // ignoe the local node for updateing data
-    if (peerID == nodeID) {
-      Serial.println("Ignoring my own KIC msg");
-      return;
+    if (!claimWebPage(request)) return;
+    TextBuf html(webPage, sizeof(webPage));
+    char ts[TIME_STRING_LEN];
+    html.add("<h2>Keep It Cold Node</h2>");
+    html.printf("<p>NodeID: <b>%s</b></p>", nodeID.c_str());
+    html.add("<p>Temperature: <b>").num(node.myTemp(), 2, "nan").add(" C</b></p>");
+    html.printf("<p>WiFi SSID: <b>%s</b> PASS: <b>%s</b></p>", wifiSSID.c_str(), wifiPASS.c_str());
+    html.printf("<p>System Time: <b>%s</b></p>", getTimeString(ts));
+    html.printf("<form method='POST' action='/setnodeid'>NodeID: <input name='nodeid' value='%s' maxlength='6'><button type='submit'>Set NodeID</button></form>", nodeID.c_str());
+    html.printf("<form method='POST' action='/setwifi'>WiFi SSID: <input name='ssid' value='%s'> PASS: <input name='pass' value='%s'><button type='submit'>Set WiFi</button></form>", wifiSSID.c_str(), wifiPASS.c_str());
+#ifndef KIC_LOW_POWER
+    html.add("<p>Site WiFi: <b>");
+    if (staSSID == "") {
+      html.add("off");
+    } else if (WiFi.status() == WL_CONNECTED) {
+      IPAddress ip = WiFi.localIP();
+      html.printf("%s (%u.%u.%u.%u)", staSSID.c_str(), ip[0], ip[1], ip[2], ip[3]);
+    } else {
+      html.printf("%s (not connected)", staSSID.c_str());
     }
-    // update existing node entry
-    for (auto& n : nodeTemps) {
-      if (n.id == peerID) {
-        n.temp1 = temp1;
-        n.temp2 = temp2;
-        n.temp3 = temp3;
-        n.lastUpdate = lu;
-        n.hasrtc = hasrtc;
-        return;
-      }
+    html.add("</b>");
+    if (uplinkTransport) html.printf(" Uplink: <b>%s</b>, %lu sent, %lu queued", uplinkURL.c_str(), (unsigned long)uplink.published(), (unsigned long)uplink.queued());
+    html.add("</p>");
+    html.printf("<form method='POST' action='/setuplink'>Site SSID: <input name='stassid' value='%s'> PASS: <input name='stapass' value='%s'> Uplink URL: <input name='uplink' value='%s' placeholder='mqtt://192.168.1.10/kic'> <label><input type='checkbox' name='staonly' value='1'%s>No AP</label><button type='submit'>Set Uplink</button></form>", staSSID.c_str(), staPASS.c_str(), uplinkURL.c_str(), staOnly ? " checked" : "");
+#endif
+    html.add("<form method='POST' action='/silence'><button type='submit'>Silence Alarms (1h)</button></form>");
+    html.add("<form method='POST' action='/settrend'>Warn when rising to <input name='limit' size='5' value='").num(node.trend().limit(), 1, "");
+    html.printf("'> C within <input name='horizon' size='4' value='%lu'> min (blank: off)<button type='submit'>Set Trend Warning</button></form>", (unsigned long)node.trend().horizon());
+    html.add("<form method='POST' action='/settime'>Year: <input name='year' size='4'> Month: <input name='month' size='2'> Day: <input name='day' size='2'> Hour: <input name='hour' size='2'> Min: <input name='min' size='2'><button type='submit'>Set Time</button></form>");
+    // Node List
+    html.add("<h3>Node List</h3><ul>");
+    for (auto& nid : node.roster().ids()) html.printf("<li>%s</li>", nid.c_str());
+    html.add("</ul><form method='POST' action='/addnode'>Add NodeID: <input name='newnode' maxlength='6'><button type='submit'>Add</button></form>");
+    // Temps
+    html.add("<h3>Node Temperatures</h3><ul>");
+    for (auto& n : node.table()) {
+      float slope = node.trend().slope(n.id);
+      html.printf("<li>%s: ", n.id.c_str()).num(n.temp1, 2, "-").add(" C");
+      if (!isnan(slope)) html.printf(" (%.1f C/h)", slope);
+      html.add("</li>");
     }
-    // creata new node entry
-    NodeTemp nt = {peerID, temp1, temp2, temp3, lu, hasrtc};
-    nodeTemps.push_back(nt);
+    html.add("</ul>");
+    html.add("<p>REST API: <a href='/api/temps'>/api/temps</a></p>");
+    html.add("<p>Log File (CSV): <a href='/log'>/log</a></p>");
+    sendWebPage(request, "text/html", html);
+}
 
-    // if a remote node has RTC and we don't, update time sync
-    if (peerID != nodeID && hasrtc && !doIhaveRTC && needTime) {
-      // update local time from lu
-      Serial.println("Updating local time from " + peerID + " to " + String(lu));
-      setTime((time_t)lu);
+// ----- Config API -----
+// POST /api/config and the settings forms validate here on the web task
+// and leave the change for loop() to apply. The JSON body arrives in
+// chunks before the request handler runs; it is collected in a fixed
+// buffer, one request at a time.
+#define CONFIG_BODY_MAX 1024
+static char configBody[CONFIG_BODY_MAX];
+static size_t configBodyLen = 0;
+static AsyncWebServerRequest *configBodyFrom = nullptr;
+
+// HTTP status: 200 queued, 400 invalid, 503 the last change is still
+// waiting for loop()
+int queueConfig(const ConfigChange &c, ConfigError &err) {
+  if (!c.validate(err)) return 400;
+#ifdef KIC_LOW_POWER
+  if (c.needsRestart()) {
+    snprintf(err.key, sizeof(err.key), "%s", "uplink");
+    err.reason = "no site WiFi or uplink in the low-power build";
+    return 400;
+  }
+#endif
+  std::lock_guard<std::mutex> lock(configMutex);
+  if (configPending) {
+    err.key[0] = '\0';
+    err.reason = "busy, try again";
+    return 503;
+  }
+  pendingConfig = c;
+  configPending = true;
+  return 200;
+}
 
-      needTime = false;
-    }
-  } else {
-    Serial.println("Unknown LoRa msg: " + incoming);
+// A settings form: back to the page, or the reason it was refused
+void submitForm(AsyncWebServerRequest *request, const ConfigChange &c) {
+  ConfigError err;
+  int status = queueConfig(c, err);
+  if (status == 200) {
+    request->redirect("/");
+    return;
   }
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s%s%s", err.key, err.key[0] ? ": " : "", err.reason);
+  request->send(status, "text/plain", msg);
 }
 
-// ----- OLED Display -----
-void showOLED() {
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.print("Node: "); display.println(nodeID);
-  display.print("Temp: "); display.print(myTemp,1); display.println(" C");
-  display.print("WiFi: "); display.println(wifiSSID);
-  display.print("PASS: "); display.println(wifiPASS);
-  display.print(getTimeString()); display.println();
-  int y = 56;
-  for (auto& n : nodeTemps) {
-    display.setCursor(0, y);
-    display.print(n.id); display.print(": ");
-    if (!isnan(n.temp1)) display.print(n.temp1,1); else display.print("-");
-    display.print("C");
-    y -= 8; if (y < 40) break;
+void configBodyChunk(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (total > CONFIG_BODY_MAX) return;
+  if (index == 0) {
+    if (configBodyFrom) return;
+    configBodyFrom = request;
+    configBodyLen = 0;
+    request->onDisconnect([request]() {
+      if (configBodyFrom == request) configBodyFrom = nullptr;
+    });
   }
-  display.display();
+  if (configBodyFrom != request || index + len > total) return;
+  memcpy(configBody + index, data, len);
+  configBodyLen = index + len;
 }
 
-// ----- Web Server -----
-void WebServerRoot(AsyncWebServerRequest *request){
-    //String newID = request->getParam("nodeid", true)->value();
-    updateWebCheckin();
-    String html = "<h2>Keep It Cold Node</h2>";
-    html += "<p>NodeID: <b>" + nodeID + "</b></p>";
-    html += "<p>Temperature: <b>" + String(myTemp, 2) + " C</b></p>";
-    html += "<p>WiFi SSID: <b>" + wifiSSID + "</b> PASS: <b>" + wifiPASS + "</b></p>";
-    html += "<p>System Time: <b>" + getTimeString() + "</b></p>";
-    html += "<form method='POST' action='/setnodeid'>NodeID: <input name='nodeid' value='" + nodeID + "' maxlength='6'><button type='submit'>Set NodeID</button></form>";
-    html += "<form method='POST' action='/setwifi'>WiFi SSID: <input name='ssid' value='" + wifiSSID + "'> PASS: <input name='pass' value='" + wifiPASS + "'><button type='submit'>Set WiFi</button></form>";
-    html += "<form method='POST' action='/silence'><button type='submit'>Silence Alarms (1h)</button></form>";
-    html += "<form method='POST' action='/settime'>Year: <input name='year' size='4'> Month: <input name='month' size='2'> Day: <input name='day' size='2'> Hour: <input name='hour' size='2'> Min: <input name='min' size='2'><button type='submit'>Set Time</button></form>";
-    // Node List
-    html += "<h3>Node List</h3><ul>";
-    for (auto& nid : getNodeIDs()) html += "<li>" + nid + "</li>";
-    html += "</ul><form method='POST' action='/addnode'>Add NodeID: <input name='newnode' maxlength='6'><button type='submit'>Add</button></form>";
-    // Temps
-    html += "<h3>Node Temperatures</h3><ul>";
-    for (auto& n : nodeTemps) {
-      html += "<li>" + n.id + ": " + (isnan(n.temp1) ? String("-") : String(n.temp1,2)) + " C</li>";
-    }
-    html += "</ul>";
-    html += "<p>REST API: <a href='/api/temps'>/api/temps</a></p>";
-    html += "<p>Log File (CSV): <a href='/log'>/log</a></p>";
-  
+void handleConfig(AsyncWebServerRequest *request) {
+  ConfigChange c;
+  ConfigError err;
+  int status;
+  if (request->contentLength() > CONFIG_BODY_MAX) {
+    err.key[0] = '\0';
+    err.reason = "body too large";
+    status = 413;
+  } else if (request->contentLength() && configBodyFrom != request) {
+    err.key[0] = '\0';
+    err.reason = "busy, try again";
+    status = 503;
+  } else {
+    size_t len = configBodyFrom == request ? configBodyLen : 0;
+    configBodyFrom = nullptr;
+    status = ConfigChange::parse(configBody, len, c, err) ? queueConfig(c, err) : 400;
+  }
+  char reply[256];
+  TextBuf out(reply, sizeof(reply));
+  if (status == 200) {
+    out.add("{\"ok\":true,\"fields\":[");
+    c.names(out);
+    out.printf("],\"restart\":%s}", c.needsRestart() ? "true" : "false");
+  } else {
+    out.printf("{\"ok\":false,\"key\":\"%s\",\"error\":\"%s\"}", err.key, err.reason);
+  }
+  request->send(status, "application/json", reply);
+}
 
-    //String html = "<!DOCTYPE html><html><head><title>Keep It Cold Node</title></head><body>";
-    //html += "<h2>Keep It Cold Node</h2>";
-    request->send(200, "text/html", html);
+// Copy gauges and externally kept counters in before rendering
+void refreshMetrics() {
+  Metrics &m = node.metrics();
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largest = ESP.getMaxAllocHeap();
+  m.set(MetricGauge::HeapFree, freeHeap);
+  m.set(MetricGauge::HeapMinFree, ESP.getMinFreeHeap());
+  m.set(MetricGauge::HeapLargestBlock, largest);
+  m.set(MetricGauge::HeapFragmentation, freeHeap ? 100 - (uint32_t)((uint64_t)largest * 100 / freeHeap) : 0);
+  m.set(MetricGauge::UptimeSecs, millis() / 1000);
+  m.set(MetricGauge::Nodes, node.table().size());
+  m.set(MetricGauge::LoraSf, node.linkAdapt().sf());
+  m.set(MetricGauge::TxPowerDbm, node.linkAdapt().txDbm());
+  m.set(MetricGauge::BackfillGaps, node.backfillGaps().size());
+  m.set(MetricGauge::ReliablePending, node.reliableOutbox().size());
+  m.set(MetricGauge::ChannelLoad, node.channelLoad());
+  m.set(MetricGauge::SensorBits, node.sensorBits());
+  m.set(MetricCounter::NvsWrites, prefStore.writes());
+  m.set(MetricCounter::LogFlashWrites, logStore.flashWrites());
+  m.set(MetricGauge::LogStaged, logStore.stagedBytes());
+  m.set(MetricCounter::DebugLogDropped, DebugLog::dropped());
+#ifndef KIC_LOW_POWER
+  m.set(MetricCounter::UplinkBatches, uplink.published());
+  m.set(MetricCounter::UplinkFailures, uplink.failures());
+  m.set(MetricCounter::UplinkDropped, uplink.dropped());
+  m.set(MetricGauge::UplinkQueued, uplink.queued());
+#endif
+#ifdef KIC_LOW_POWER
+  uint64_t uptimeUs = (uint64_t)esp_timer_get_time();
+  m.set(MetricCounter::SleepSecs, (uint32_t)(powerStats.asleepUs() / 1000000));
+  m.set(MetricCounter::Wakeups, powerStats.wakeups());
+  m.set(MetricCounter::RadioWakeups, powerStats.wakeups(WakeCause::Radio));
+  m.set(MetricGauge::AsleepPercent, powerStats.asleepPercent(uptimeUs));
+  m.set(MetricGauge::AverageCurrentUa, powerStats.averageUa(uptimeUs));
+#endif
+}
+
+void metricsWrite(void *ctx, const char *text, size_t len) {
+  static_cast<TextBuf *>(ctx)->add(text, len);
 }
 
 void setupWebServer() {
+  // Time every handler for the web latency histogram. Handlers read node
+  // state that loop() changes, so they run under nodeMutex.
+  server.addMiddleware([](AsyncWebServerRequest *request, ArMiddlewareNext next) {
+    std::lock_guard<std::mutex> lock(nodeMutex);
+    MetricScope timing(node.metrics(), espClock, MetricTimer::Web);
+#ifdef KIC_LOW_POWER
+    apLastUseMs = millis();
+#endif
+    next();
+  });
+
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
     request->redirect("/brr");
   });
 
+  // CSV, decoded a block at a time as the client reads; ?from=<epoch>
+  // skips straight to that point
   server.on("/log", HTTP_GET, [](AsyncWebServerRequest *request){
-    String logfile = "/templog.csv";
-    if (LittleFS.exists(logFile)) {
-      File file = LittleFS.open(logFile, "r");
-      if (file) {
-        String content = file.readString();
-        file.close();
-        request->send(200, "text/csv", content);
-        return;
-      }
+    if (logExportBusy) {
+      request->send(503, "text/plain", "Busy, try again");
+      return;
+    }
+    LogExport &e = logExport;
+    e.file = LittleFS.open(logFile, "r");
+    if (!e.file) {
+      request->send(404, "text/plain", "Log file not found");
+      return;
+    }
+    logExportBusy = true;
+    request->onDisconnect([]() {
+      logExport.file.close();
+      logExportBusy = false;
+    });
+    e.fileEnd = logStore.flashBytes();
+    e.stagedLen = logStore.stagedBytes();
+    memcpy(e.staged, logStore.staged(), e.stagedLen);
+    uint32_t from = request->hasParam("from") ? (uint32_t)request->getParam("from")->value().toInt() : 0;
+    e.rows.begin((e.fileEnd + e.stagedLen + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE, from, logExportBlock, &e);
+    e.textLen = snprintf(e.text, sizeof(e.text), "%s", TempLog::header());
+    e.sent = 0;
+    request->send(request->beginChunkedResponse("text/csv", [](uint8_t *buf, size_t maxLen, size_t) {
+      return logExportFill(logExport, buf, maxLen);
+    }));
+  });
+
+  server.on("/log.csv", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!LittleFS.exists(csvLogFile)) {
+      request->send(404, "text/plain", "No CSV log");
+      return;
     }
-    request->send(404, "text/plain", "Log file not found");
+    request->send(LittleFS, csvLogFile, "text/csv");
   });
 
 
   server.on("/brr", HTTP_GET, WebServerRoot);
 
+  server.on("/api/config", HTTP_POST, handleConfig, nullptr, configBodyChunk);
+
+  // The forms take the same path as /api/config
   server.on("/setnodeid", HTTP_POST, [](AsyncWebServerRequest *request){
-    String newID = request->getParam("nodeid", true)->value();
-    if (newID.length() == 6) {
-      saveNodeID(newID);
-      request->redirect("/");
-      return;
-    }
-    request->send(400, "text/plain", "Invalid NodeID");
+    ConfigChange c;
+    c.fields = CfgNodeId;
+    c.nodeId = request->getParam("nodeid", true)->value().c_str();
+    submitForm(request, c);
   });
 
   server.on("/setwifi", HTTP_POST, [](AsyncWebServerRequest *request){
-    String ssid = request->getParam("ssid", true)->value();
-    String pass = request->getParam("pass", true)->value();
-    saveWiFi(ssid, pass);
-    request->redirect("/");
-    delay(1000);
-    ESP.restart();
+    ConfigChange c;
+    c.fields = CfgApSsid | CfgApPass;
+    c.apSsid = request->getParam("ssid", true)->value().c_str();
+    c.apPass = request->getParam("pass", true)->value().c_str();
+    submitForm(request, c);
   });
 
+#ifndef KIC_LOW_POWER
+  server.on("/setuplink", HTTP_POST, [](AsyncWebServerRequest *request){
+    ConfigChange c;
+    c.fields = CfgStaSsid | CfgStaPass | CfgUplink | CfgStaOnly;
+    c.staSsid = request->getParam("stassid", true)->value().c_str();
+    c.staPass = request->getParam("stapass", true)->value().c_str();
+    c.uplink = request->getParam("uplink", true)->value().c_str();
+    c.staOnly = request->hasParam("staonly", true);
+    submitForm(request, c);
+  });
+#endif
+
   server.on("/silence", HTTP_POST, [](AsyncWebServerRequest *request){
-    setSilence(3600000UL); // 1 hour
+    {
+      std::lock_guard<std::mutex> lock(configMutex);
+      silencePendingMs = 3600000UL; // 1 hour
+    }
     request->redirect("/");
   });
 
+  server.on("/settrend", HTTP_POST, [](AsyncWebServerRequest *request){
+    String limit = request->getParam("limit", true)->value();
+    limit.trim();
+    ConfigChange c;
+    c.fields = CfgTrendLimit | CfgTrendHorizon;
+    c.trendLimit = limit == "" ? NAN : limit.toFloat();
+    long horizon = request->getParam("horizon", true)->value().toInt();
+    c.trendHorizon = horizon > 0 ? (uint32_t)horizon : 0;
+    submitForm(request, c);
+  });
+
   server.on("/settime", HTTP_POST, [](AsyncWebServerRequest *request){
     int year = request->getParam("year", true)->value().toInt();
     int month = request->getParam("month", true)->value().toInt();
     int day = request->getParam("day", true)->value().toInt();
     int hour = request->getParam("hour", true)->value().toInt();
     int min = request->getParam("min", true)->value().toInt();
-    struct tm t = {0};
-    t.tm_year = year - 1900;
-    t.tm_mon = month - 1;
-    t.tm_mday = day;
-    t.tm_hour = hour;
-    t.tm_min = min;
-    t.tm_sec = 0;
-    time_t epoch = mktime(&t);
-//    saveTime(epoch);
-    request->redirect("/");
+    time_t epoch = localEpoch(year, month, day, hour, min);
+    ConfigChange c;
+    c.fields = CfgTime;
+    c.time = epoch > 0 ? (uint32_t)epoch : 0;
+    submitForm(request, c);
   });
 
   server.on("/addnode", HTTP_POST, [](AsyncWebServerRequest *request){
     String newnode = request->getParam("newnode", true)->value();
-    if (newnode.length() == 6 && nodeList.indexOf(newnode) == -1) {
-      nodeList += "," + newnode;
-      saveNodeList(nodeList);
-//      broadcastNodeList();
+    if (node.roster().contains(newnode.c_str())) {
+      request->redirect("/");
+      return;
     }
-    request->redirect("/");
+    ConfigChange c;
+    c.fields = CfgRoster;
+    c.roster = node.roster().str();
+    if (!c.roster.empty()) c.roster += ",";
+    c.roster += newnode.c_str();
+    submitForm(request, c);
   });
 
   server.on("/api/temps", HTTP_GET, [](AsyncWebServerRequest *request){
-    String json = "[";
-    for (size_t i = 0; i < nodeTemps.size(); i++) {
-      if (i > 0) json += ",";
-      json += "{\"id\":\"" + nodeTemps[i].id + "\",\"temp\":" + String(nodeTemps[i].temp1,2) + "}";
+    if (!claimWebPage(request)) return;
+    TextBuf json(webPage, sizeof(webPage));
+    json.add("[");
+    for (size_t i = 0; i < node.table().size(); i++) {
+      const NodeTemp &n = node.table()[i];
+      if (i > 0) json.add(",");
+      json.printf("{\"id\":\"%s\",\"temp\":", n.id.c_str()).num(n.temp1, 2, "null");
+      json.add(",\"slope\":").num(node.trend().slope(n.id), 2, "null").add("}");
     }
-    json += "]";
-    request->send(200, "application/json", json);
+    json.add("]");
+    sendWebPage(request, "application/json", json);
+  });
+
+  server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!claimWebPage(request)) return;
+    refreshMetrics();
+    TextBuf text(webPage, sizeof(webPage));
+    node.metrics().render(metricsWrite, &text);
+    boot.render(metricsWrite, &text);
+    sendWebPage(request, "text/plain; version=0.0.4", text);
   });
 
   // critical for captave portal to work
@@ -612,135 +861,194 @@ void setupWebServer() {
 //  });
 //}
 
-// ----- Temperature Logging -----
-void setupLogFile() {
-  Serial.println("Mounting LittleFS...");
-  if(!LittleFS.begin(true)){
-    Serial.println("LittleFS Mount Failed");
-    while(1);
-  }
-  if (!LittleFS.exists(logFile)) {
-    File file = LittleFS.open(logFile, "w");
-    if (file) {
-      file.println("epoch,node,temp1,temp2,temp3");
-      file.close();
-    }
+// ----- Captive-portal DNS -----
+// Answered in the AsyncUDP callback (network task), not polled by loop()
+void dnsStart() {
+  IPAddress ip = WiFi.softAPIP();
+  uint8_t addr[4] = {ip[0], ip[1], ip[2], ip[3]};
+  captiveDns.setAddress(addr);
+  if (!dnsUdp.listen(DNS_PORT)) {
+    LOG_W("DNS listen failed");
+    return;
   }
+  dnsUdp.onPacket([](AsyncUDPPacket &packet) {
+    uint8_t reply[DNS_PACKET_MAX];
+    size_t n = captiveDns.answer(packet.data(), packet.length(), reply, sizeof(reply));
+    if (n) packet.write(reply, n);
+  });
 }
 
-String timeAsYMDHMS(time_t t) {
-  char buf[25];
-  snprintf(buf, sizeof(buf), "%02d/%02d/%04d %02d:%02d:%02d",
-           month(t), day(t), year(t),
-           hour(t), minute(t), second(t));
-  return String(buf);
+void dnsStop() {
+  dnsUdp.close();
 }
 
-time_t nextLogEpoch() {
-  time_t t = now();  // current epoch in seconds
-  
-  struct tm tmNext;
-  localtime_r(&t, &tmNext);
+#ifdef KIC_LOW_POWER
+// ----- Low power -----
+// WiFi stays off and the CPU light-sleeps between node events; the
+// SX1262 sniffs for preambles on its own and wakes us on DIO1. The PRG
+// button brings the AP (and OLED) up for LOW_POWER_AP_MS after last use.
+void apStart() {
+  WiFi.mode(WIFI_AP);
+  WiFi.softAP(wifiSSID.c_str(), wifiPASS.c_str());
+  dnsStart();
+  display.ssd1306_command(SSD1306_DISPLAYON);
+  showOLED();
+  apActive = true;
+  apLastUseMs = millis();
+  LOG_I("AP up on demand: %s", WiFi.softAPIP().toString().c_str());
+}
 
-  int currentMin = tmNext.tm_min;
+void apStop() {
+  dnsStop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_OFF);
+  display.ssd1306_command(SSD1306_DISPLAYOFF);
+  apActive = false;
+  LOG_I("AP off");
+}
 
-  // Find the next quarter-hour (0, 15, 30, 45)
-  int nextQuarter = ((currentMin / 15) + 1) * 15;
-  if(nextQuarter >= 60) {
-    tmNext.tm_hour += 1;   // bump hour
-    tmNext.tm_min = 0;     // reset minutes
-  } else {
-    tmNext.tm_min = nextQuarter;
+void lowPowerBegin() {
+  pinMode(PRG_BUTTON, INPUT_PULLUP);
+  WiFi.mode(WIFI_OFF);
+  display.ssd1306_command(SSD1306_DISPLAYOFF);
+  // node.join()'s blocking conversion left a valid reading for the
+  // first async read
+  tempSensor.setAsync(true);
+  gpio_wakeup_enable((gpio_num_t)LORA_DIO0, GPIO_INTR_HIGH_LEVEL);
+  gpio_wakeup_enable((gpio_num_t)PRG_BUTTON, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+}
+
+// Sleep until the next node event, a received frame or a button press
+void lowPowerSleep() {
+  if (!apActive && digitalRead(PRG_BUTTON) == LOW) apStart();
+  if (apActive) {
+    if (millis() - apLastUseMs > LOW_POWER_AP_MS) apStop();
+    return;   // stay awake while the AP is serving
+  }
+  if (loraPacketReceived) return;
+  uint32_t ms = PowerStats::sleepMs(node.msUntilNextEvent());
+  if (ms == 0) return;
+
+  Serial.flush();
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+  int64_t t0 = esp_timer_get_time();
+  esp_light_sleep_start();
+  uint32_t sleptUs = (uint32_t)(esp_timer_get_time() - t0);
+
+  WakeCause cause = WakeCause::Other;
+  esp_sleep_wakeup_cause_t why = esp_sleep_get_wakeup_cause();
+  if (why == ESP_SLEEP_WAKEUP_TIMER) {
+    cause = WakeCause::Timer;
+  } else if (why == ESP_SLEEP_WAKEUP_GPIO) {
+    if (digitalRead(LORA_DIO0) == HIGH) {
+      cause = WakeCause::Radio;
+      loraPacketReceived = true;   // don't rely on the ISR having run yet
+    } else if (digitalRead(PRG_BUTTON) == LOW) {
+      cause = WakeCause::Button;
+    }
   }
-  tmNext.tm_sec = 0;       // always align on the minute
+  powerStats.slept(sleptUs, cause);
+}
+#endif
 
-  // mktime() normalizes the struct (handles day, month, year rollover)
-  time_t nextEpoch = mktime(&tmNext);
+// ----- Logging -----
+// Lowest-priority task that moves DebugLog lines (and gateway frames) to
+// the UART, so a slow Serial never stalls the radio path
+uint32_t logMillis() {
+  return millis();
+}
 
-  // In case we're exactly on a boundary but seconds > 0, skip to the next
-  if(nextEpoch <= t) {
-    nextEpoch += 15 * 60;
+void logDrainTask(void *) {
+  char chunk[128];
+  for (;;) {
+    size_t n = 0;
+#ifdef KIC_GATEWAY
+    n = gateway.drain((uint8_t *)chunk, sizeof(chunk));
+#endif
+    if (n == 0) n = DebugLog::drain(chunk, sizeof(chunk));
+    if (n > 0) {
+      Serial.write((const uint8_t *)chunk, n);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(20));
+    }
   }
+}
 
-  return nextEpoch;
+#ifndef KIC_LOW_POWER
+// ----- Uplink -----
+// Publishing waits on the network, so it runs in its own low-priority task;
+// loop() only samples readings into batches
+#define UPLINK_POLL_MS 250
+
+void uplinkTask(void *) {
+  for (;;) {
+    uplinkTransport->poll();
+    while (uplink.publishDue(*uplinkTransport, millis())) {}
+    vTaskDelay(pdMS_TO_TICKS(UPLINK_POLL_MS));
+  }
 }
 
-void logloop() {
-  time_t t = now();
+void setupUplink() {
+  UplinkTarget target;
+  if (uplinkURL == "" || !UplinkTarget::parse(uplinkURL.c_str(), target)) return;
+  if (staSSID == "") {
+    LOG_W("uplink needs the site WiFi, not started");
+    return;
+  }
+  if (target.scheme == UplinkScheme::Mqtt) {
+    uplinkTransport = new MqttUplink(target, ("kic-" + nodeID).c_str());
+  } else {
+    uplinkTransport = new HttpUplink(target);
+  }
+  uplink.setNodeId(nodeID.c_str());
+  xTaskCreate(uplinkTask, "uplink", 6144, nullptr, 1, nullptr);
+  LOG_I("uplink to %s", uplinkURL.c_str());
+}
+#endif
+
+#ifdef KIC_BENCH
+// ----- Benchmarks -----
+// CCOUNT is 32 bits (~18 s at 240 MHz); extend it so long cases don't wrap
+uint64_t benchCycles() {
+  static uint32_t last = 0;
+  static uint64_t high = 0;
+  uint32_t c = ESP.getCycleCount();
+  if (c < last) high += 1ULL << 32;
+  last = c;
+  return high | c;
+}
 
-  // get t into month/day/year hour:min:sec format
-  String tstamp = timeAsYMDHMS(t);
-
-  if(nextLog == 0) {
-    nextLog = nextLogEpoch();
-    Serial.println("Next log at epoch: " + String(nextLog) + " (" + tstamp + ")");
-  }
-
-  if(t >= nextLog) {
-    Serial.println("Logging temperature at epoch: " + String(t) + " (" + tstamp + ")");  
-    // Read temperature
-    sensors.requestTemperatures();
-    float temp = sensors.getTempCByIndex(0);
-    if(temp == DEVICE_DISCONNECTED_C) temp = NAN;
-
-    // Append to LittleFS CSV
-    File f = LittleFS.open("/templog.csv", FILE_APPEND);
-    if(f){
-      // fora all the node data we have in nodeTemps
-      for (auto& n : nodeTemps) {
-        if (n.id == nodeID) {
-          // use myTemp for self entry
-          f.printf("%s,%s,%.2f,%.2f,%.2f\n", tstamp, n.id.c_str(), temp, n.temp2, n.temp3);
-        } else {
-          // use stored temps for other nodes
-          f.printf("%s,%s,%.2f,%.2f,%.2f\n", tstamp, n.id.c_str(), n.temp1, n.temp2, n.temp3);
-        }
-      }
-      f.close();
-      Serial.printf("Logged: %02d:%02d -> %.2f\n", hour(t), minute(t), temp);
-    }
+void benchWrite(const char *line) {
+  Serial.println(line);
+}
 
-    // Schedule next log
-    nextLog = nextLogEpoch(); // next quarter-hour
-    Serial.println("Next log at epoch: " + String(nextLog) + " (" + String(year(nextLog)) + "-" + String(month(nextLog)) + "-" + String(day(nextLog)) + " " + String(hour(nextLog)) + ":" + String(minute(nextLog)) + ":" + String(second(nextLog)) + ")");
-  }
+void runBenchmarks() {
+  LittleFsLogStore scratch("/bench.csv");
+  Bench bench(benchCycles, "cycles", benchWrite);
+  bench.header("esp32s3", __DATE__ " " __TIME__);
+  BenchSuite::run(bench, scratch, 200);
+  LittleFS.remove("/bench.csv");
 }
+#endif
 
 // ----- Setup & Main Loop -----
-void setup() {
-  Serial.begin(115200);
-  Serial.println("Keep It Cold Node Starting...");
+// ----- Boot -----
+// Stages in BootSequence order (see Boot.h): everything the first report
+// needs, then the rest once it is on air
 
-  // OLED power control (Heltec Vext pin)
+void bootPower() {
+  // OLED power (Heltec Vext). Heltec waits 100 ms before talking to the
+  // display; the radio and first conversion take longer than that.
   pinMode(Vext, OUTPUT);
   digitalWrite(Vext, LOW);
-  // Heltec delays for 100ms in their example
-  delay(100);
-
-
-  twi.begin(SDA_OLED, SCL_OLED);
-  
-  display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
-    Serial.println(F("OLED display not found!"));
-    while (true); // Stop here if display is not found
-  }
-  //display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
-  //display.begin();
-  display.clearDisplay();
-  display.setTextSize(1);
-  //display.setTextColor(SSD1306_WHITE);
-  display.setTextColor(WHITE);
-  display.setCursor(0,0);
-  display.println("Keep It Cold");
-  display.display();
+}
 
-  // setup rtc
+void bootTime() {
   Wire.begin(42,41);
   if (rtc.getSecond()> 60){
     Serial.println("Couldn't find RTC");
     Serial.println("we should ask one of the nodes for the time");
-    needTime = true;
   } else {
     doIhaveRTC = true;
     bool h12, pm;
@@ -754,53 +1062,148 @@ void setup() {
       2000 + rtc.getYear()
     );
   }
-  time_t epoch = now();
-  Serial.print("year: "); Serial.println(year(epoch));
-  Serial.print("month: "); Serial.println(month(epoch));
-  Serial.print("day: "); Serial.println(day(epoch));
-  Serial.print("hour: "); Serial.println(hour(epoch));
-  Serial.print("min: "); Serial.println(minute(epoch));
-  Serial.print("sec: "); Serial.println(second(epoch));
+  char ts[TIME_STRING_LEN];
+  Serial.printf("Time: %s\n", getTimeString(ts));
+}
 
+void bootNode() {
   loadConfig();
-  loadNodeList();
-  loadSilence();
-  loadLastWebCheckin();
-
+  node.begin(nodeID.c_str(), doIhaveRTC, loraPassphrase.c_str()); // adds self to node table
+#ifndef KIC_FIXED_RATE
+  node.setAdaptiveRate(true);   // after setupLoRa(), which starts at the base rate
+#endif
+#ifdef KIC_GATEWAY
+  node.setGateway(&gateway);
+#endif
   Serial.println("NodeID: " + nodeID);
-  Serial.println("WiFi SSID: " + wifiSSID + " PASS: " + wifiPASS);
-  Serial.println("Node List: " + nodeList);
-  Serial.println("Stored Time: " + getTimeString());
-  Serial.println("Silence Until: " + String(silenceUntil) + " Last Web Checkin: " + String(lastWebCheckin));
-  showOLED();
-
-  Serial.println("Starting WiFi AP...");
-  WiFi.mode(WIFI_AP);
-  WiFi.softAP(wifiSSID.c_str(), wifiPASS.c_str());
-  //WiFi.softAP(wifiSSID.c_str());
-  delay(1000); // Wait for AP to start
-  Serial.println("AP IP address: " + WiFi.softAPIP().toString());
+  Serial.println("Node List: " + String(node.roster().str().c_str()));
+}
 
-  Serial.println("Starting LoRa...");
-  setupLoRa();
-  Serial.println("Starting sensors...");
+void bootSensor() {
   sensors.begin();
-  Serial.println("Starting web server...");
-  setupWebServer();
+  node.join();
+}
 
-  Serial.println("Starting DNS server...");
-  dnsServer.start(53, "*", WiFi.softAPIP());
+void bootStorage() {
+  // Before the first quarter-hour append; LittleFS formats only on the
+  // very first boot
+  if (!logFlash.begin("")) {
+    while(1);
+  }
+  size_t kept = logStore.begin(logFlash.size());
+  if (kept) LOG_I("log: %u staged bytes kept over the reset", (unsigned)kept);
+
+  // The writer carries on from the newest row in the last block. /log
+  // isn't served yet, so its buffers do the reading.
+  LogExport &e = logExport;
+  uint8_t last[LOGBLOCK_SIZE];
+  size_t size = logStore.size();
+  size_t len = 0;
+  if (size > 0) {
+    e.file = LittleFS.open(logFile, "r");
+    e.fileEnd = logStore.flashBytes();
+    e.stagedLen = logStore.stagedBytes();
+    memcpy(e.staged, logStore.staged(), e.stagedLen);
+    size_t off = (size - 1) / LOGBLOCK_SIZE * LOGBLOCK_SIZE;
+    if (e.file || off >= e.fileEnd) len = logExportRead(e, off, last, size - off);
+    if (e.file) e.file.close();
+  }
+  node.setLogFormat(LogFormat::Blocks, size, last, len);
+}
 
-  // Mount LittleFS
-  setupLogFile();
+void bootDisplay() {
+  twi.begin(SDA_OLED, SCL_OLED);
+  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+    Serial.println(F("OLED display not found!"));
+    while (true); // Stop here if display is not found
+  }
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(WHITE);
+  displayReady = true;
+  showOLED();
+}
 
-  Serial.println("Update own temp...");
-  updateNodeTemp(nodeID, NAN, NAN, NAN, doIhaveRTC); // Add self to nodeTemps
+#ifndef KIC_LOW_POWER
+void bootWifi() {
+  Serial.println("WiFi SSID: " + wifiSSID + " PASS: " + wifiPASS);
+  if (staSSID != "") {
+    Serial.println("Joining site WiFi " + staSSID + "...");
+    WiFi.mode(staOnly ? WIFI_STA : WIFI_AP_STA);
+    WiFi.setAutoReconnect(true);
+    WiFi.begin(staSSID.c_str(), staPASS.c_str());
+  } else {
+    WiFi.mode(WIFI_AP);
+  }
+  if (staSSID == "" || !staOnly) {
+    Serial.println("Starting WiFi AP...");
+    // The AP comes up in the background; the web server and DNS don't
+    // need it to have finished
+    WiFi.softAP(wifiSSID.c_str(), wifiPASS.c_str());
+    Serial.println("AP IP address: " + WiFi.softAPIP().toString());
+  }
+}
 
-  Serial.println("Setup complete.");
+void bootDns() {
+  if (staSSID == "" || !staOnly) {
+    Serial.println("Starting DNS server...");
+    dnsStart();
+  }
+}
+#endif
+
+const BootStage bootStages[] = {
+  {"power", bootPower, false},
+  {"time", bootTime, false},
+  {"radio", setupLoRa, false},
+  {"node", bootNode, false},
+  {"sensor", bootSensor, false},
+  {"storage", bootStorage, false},
+  {"display", bootDisplay, true},
+#ifdef KIC_LOW_POWER
+  {"lowpower", lowPowerBegin, true},
+#else
+  {"wifi", bootWifi, true},
+#endif
+  {"web", setupWebServer, true},
+#ifndef KIC_LOW_POWER
+  {"dns", bootDns, true},
+  {"uplink", setupUplink, true},
+#endif
+};
+BootSequence boot(bootStages, sizeof(bootStages) / sizeof(bootStages[0]), espClock);
+
+void setup() {
+#ifdef KIC_GATEWAY
+  Serial.begin(GATEWAY_BAUD);
+#else
+  Serial.begin(115200);
+#endif
+  Serial.println("Keep It Cold Node Starting...");
+  DebugLog::begin(logMillis);
+  xTaskCreate(logDrainTask, "log", 2048, nullptr, 1, nullptr);
+#ifdef KIC_LOW_POWER
+  setCpuFrequencyMhz(80);
+#endif
+
+  // The first report goes out from loop() once its join jitter is up;
+  // bootDeferred() then brings up the rest
+  boot.runImmediate();
 }
 
-unsigned long lastSend = 0, lastRead = 0, lastHeartbeat = 0;
+// One deferred boot stage per loop pass, after the first report
+void bootDeferred(bool reportSent) {
+  if (boot.finished()) return;
+  if (reportSent) boot.reportSent();
+  if (!boot.runDeferred() || !boot.finished()) return;
+
+  LOG_I("boot: first report at %lu ms, ready at %lu ms", (unsigned long)boot.firstReportUs() / 1000,
+        (unsigned long)boot.finishedUs() / 1000);
+  Serial.println("Setup complete.");
+#ifdef KIC_BENCH_ON_BOOT
+  runBenchmarks();
+#endif
+}
 
 void radioloop() {
   if (loraPacketReceived) {
@@ -810,59 +1213,33 @@ void radioloop() {
     int16_t state = radio.readData(incoming, len);
 
     if (state == RADIOLIB_ERR_NONE) {
-      //size_t len = sizeof(incoming);
-      // packet received successfully
-      //Serial.println("Received: " + incoming);
-      Serial.println("Receive LoRa packet");
-      Serial.print("Receive Raw bytes: ");
-      for (int i = 0; i < len; i++) {
-        Serial.printf("%02X ", incoming[i]);
+      LOG_HEX_D("rx", incoming, len);
+
+      RxResult res = node.onRadioFrame(incoming, len, radio.getRSSI(), radio.getSNR());
+      if (res == RxResult::DecryptFailed) {
+        LOG_W("rx decrypt failed");
+      } else if (res == RxResult::Own) {
+        LOG_D("rx own KIC report, ignored");
+      } else if (res == RxResult::Unknown) {
+        LOG_W("rx unknown message");
       }
-      Serial.println();
-
-      //decrypt
-      uint8_t decrypted[256];
-      //CryptoHelper::aesDecrypt(loraKey, loraIV, incoming, len, decrypted);
-      CryptoHelper::aesDecrypt(loraKey, incoming, len, decrypted, decLen);
-
-      // Convert to String using known length
-      String msg = "";
-      unsigned int dlen = sizeof(decrypted);
-      for (int i = 0; i < dlen; i++) {
-        if (decrypted[i] == 0) break; // stop at null if there is one
-        msg += (char)decrypted[i];
-      }
-
-      Serial.println("Receive Decrypted msg: " + msg);
-      Serial.println("Receive length: " + String(msg.length()));
-      handleLoRaPacket(msg);
     } else {
-      Serial.print("Receive failed, code: ");
-      Serial.println(state);
+      node.metrics().count(state == RADIOLIB_ERR_CRC_MISMATCH ? MetricCounter::RxCrcErrors
+                                                              : MetricCounter::RxErrors);
+      LOG_W("rx failed, code %d", state);
     }
     // start listening again
-    int16_t state2 = radio.startReceive();
-    if (state2 == RADIOLIB_ERR_NONE) { 
-      //Serial.println("LoRa RX started");
-    } else {
-      Serial.print("Receive LoRa RX failed, code ");
-      Serial.println(state2);
-    } 
+    int16_t state2 = espRadio.listen();
+    if (state2 != RADIOLIB_ERR_NONE) {
+      LOG_E("startReceive failed, code %d", state2);
+    }
   }
 
 
-  // send struct every ~ 30s
-  int randomDelay = random(0,5000);
-  if (millis() - lastSend > 30000+randomDelay) {
-    Serial.println("Sending Broadcasting struct...");
-    //broadcastStruct();
-    broadcastKIC();
-    lastSend = millis();
-  }
 //  // Send LoRa temp every 10s
 //  if (millis() - lastSend > 10000) {
 //    Serial.println("Broadcasting temp...");
-//    broadcastTemperature(myTemp);
+//    broadcastTemperature(node.myTemp());
 //    lastSend = millis();
 //  }
 
@@ -874,82 +1251,249 @@ void radioloop() {
 //  }
 }
 
-void processSerialCommands() {
-  // Serial config (for debugging/config)
-  if (Serial.available()) {
-    String cmd = Serial.readStringUntil('\n');
-    cmd.trim();
-    if (cmd.startsWith("SETNODEID:") && cmd.length() == 15) {
-      String newID = cmd.substring(10, 16);
-      saveNodeID(newID);
-      Serial.println("NodeID updated to: " + nodeID);
-    }
-    if (cmd.startsWith("SETWIFI:")) {
-      int sep = cmd.indexOf(',',8);
-      if (sep > 8) {
-        String ssid = cmd.substring(8, sep);
-        String pass = cmd.substring(sep+1);
-        saveWiFi(ssid, pass);
-        Serial.println("WiFi updated, rebooting...");
-        delay(1000);
-        ESP.restart();
-      }
+// ----- Serial console -----
+#define SERIAL_BYTES_PER_LOOP 64   // bound the console's share of a loop pass
+
+LineAssembler serialLine;
+
+// The console runs in loop(), so a change is applied straight away
+bool applySerialConfig(const ConfigChange &c) {
+  ConfigError err;
+  if (!c.validate(err)) {
+    Serial.printf("ERR %s: %s\n", err.key, err.reason);
+    return false;
+  }
+#ifdef KIC_LOW_POWER
+  if (c.needsRestart()) {
+    Serial.println("ERR uplink: no site WiFi or uplink in the low-power build");
+    return false;
+  }
+#endif
+  applyConfig(c);
+  return true;
+}
+
+// Same checks as the web form and CONFIG:{"nodeid":...}
+void cmdSetNodeId(char *args) {
+  if (!*args) {
+    Serial.println("ERR usage: SETNODEID:ABCDEF");
+    return;
+  }
+  ConfigChange c;
+  c.fields = CfgNodeId;
+  c.nodeId = args;
+  if (applySerialConfig(c)) Serial.printf("NodeID updated to: %s\n", nodeID.c_str());
+}
+
+void cmdSetWifi(char *args) {
+  char *f[2];
+  if (CommandLine::split(args, ',', f, 2) != 2 || !f[0][0]) {
+    Serial.println("ERR usage: SETWIFI:ssid,pass");
+    return;
+  }
+  ConfigChange c;
+  c.fields = CfgApSsid | CfgApPass;
+  c.apSsid = f[0];
+  c.apPass = f[1];
+  if (applySerialConfig(c)) Serial.println("WiFi updated, AP restarting");
+}
+
+void cmdSetTime(char *args) {
+  char *f[5];
+  long y, mo, d, h, mi;
+  if (CommandLine::split(args, ',', f, 5) != 5 ||
+      !CommandLine::toInt(f[0], 2020, 2099, y) || !CommandLine::toInt(f[1], 1, 12, mo) ||
+      !CommandLine::toInt(f[2], 1, 31, d) || !CommandLine::toInt(f[3], 0, 23, h) ||
+      !CommandLine::toInt(f[4], 0, 59, mi)) {
+    Serial.println("ERR usage: SETTIME:YYYY,MM,DD,HH,mm");
+    return;
+  }
+  time_t epoch = localEpoch(y, mo, d, h, mi);
+  setClockEpoch(epoch);
+  char ts[TIME_STRING_LEN];
+  Serial.printf("Time updated: %lu (%s)\n", (unsigned long)epoch, getTimeString(ts));
+}
+
+void cmdConfig(char *args) {
+  if (*args) {
+    ConfigChange c;
+    ConfigError err;
+    if (!ConfigChange::parse(args, strlen(args), c, err)) {
+      Serial.printf("ERR %s%s%s\n", err.key, err.key[0] ? ": " : "", err.reason);
+    } else if (applySerialConfig(c)) {
+      Serial.printf("OK%s\n", c.needsRestart() ? ", restarting" : "");
     }
-    if (cmd.startsWith("SETTIME:")) {
-      // SETTIME:YYYY,MM,DD,HH,mm
-      int y = cmd.substring(8,12).toInt();
-      int m = cmd.substring(13,15).toInt();
-      int d = cmd.substring(16,18).toInt();
-      int h = cmd.substring(19,21).toInt();
-      int mi = cmd.substring(22,24).toInt();
-      struct tm t = {0};
-      t.tm_year = y-1900; t.tm_mon = m-1; t.tm_mday = d; t.tm_hour = h; t.tm_min = mi; t.tm_sec = 0;
-      time_t epoch = mktime(&t);
-//      saveTime(epoch);
-      Serial.println("Time updated: " + String(epoch));
+    return;
+  }
+  Serial.printf("nodeid %s\n", nodeID.c_str());
+  Serial.printf("ap %s\n", wifiSSID.c_str());
+  Serial.printf("sta %s%s\n", staSSID.c_str(), WiFi.status() == WL_CONNECTED ? " connected" : "");
+  Serial.printf("uplink %s\n", uplinkURL.c_str());
+  Serial.printf("roster %s\n", node.roster().str().c_str());
+  Serial.printf("time %lu rtc %d\n", (unsigned long)now(), doIhaveRTC ? 1 : 0);
+  Serial.printf("lora sf %u dbm %d max %d\n", node.linkAdapt().sf(), node.linkAdapt().txDbm(),
+                node.linkAdapt().maxTxDbm());
+  Serial.printf("trend limit %.1f horizon %lu min\n", node.trend().limit(), (unsigned long)node.trend().horizon());
+}
+
+void serialMetricsWrite(void *, const char *text, size_t len) {
+  Serial.write((const uint8_t *)text, len);
+}
+
+void cmdMetrics(char *) {
+  refreshMetrics();
+  node.metrics().render(serialMetricsWrite, nullptr);
+  boot.render(serialMetricsWrite, nullptr);
+}
+
+void cmdRoster(char *) {
+  time_t t = now();
+  for (const auto &id : node.roster().ids()) {
+    const NodeTemp *n = node.table().find(id);
+    if (!n) {
+      Serial.printf("%s never heard\n", id.c_str());
+    } else {
+      Serial.printf("%s %.2f C %+.2f C/h, %lds ago%s\n", id.c_str(), n->temp1, node.trend().slope(id),
+                    (long)(t - n->lastUpdate), t - n->lastUpdate >= NODE_DOWN_SECS ? " DOWN" : "");
     }
   }
+}
 
+void cmdLogStatus(char *) {
+  Serial.printf("log %s %lu bytes, %u staged, %lu flash writes\n", logFile, (unsigned long)logStore.size(),
+                (unsigned)logStore.stagedBytes(), (unsigned long)logStore.flashWrites());
+  const Metrics &m = node.metrics();
+  Serial.printf("writes %lu failed %lu next %lu\n", (unsigned long)m.get(MetricCounter::LogWrites),
+                (unsigned long)m.get(MetricCounter::LogFailed), (unsigned long)node.nextLogEpoch());
+  Serial.printf("backlog %u samples, %u peers with gaps\n", (unsigned)node.backlog().size(),
+                (unsigned)node.backfillGaps().size());
 }
 
+#ifdef KIC_LOW_POWER
+void cmdPower(char *) {
+  uint64_t uptimeUs = (uint64_t)esp_timer_get_time();
+  Serial.printf("asleep %lu%%, wakeups %lu (timer %lu, radio %lu, button %lu), avg ~%lu uA\n",
+                (unsigned long)powerStats.asleepPercent(uptimeUs),
+                (unsigned long)powerStats.wakeups(),
+                (unsigned long)powerStats.wakeups(WakeCause::Timer),
+                (unsigned long)powerStats.wakeups(WakeCause::Radio),
+                (unsigned long)powerStats.wakeups(WakeCause::Button),
+                (unsigned long)powerStats.averageUa(uptimeUs));
+}
+#endif
 
-void loop() {
-  dnsServer.processNextRequest();
-  processSerialCommands();
+#ifdef KIC_BENCH
+void cmdBench(char *) {
+  runBenchmarks();
+}
+#endif
+
+void cmdHelp(char *);
+
+const Command serialCommands[] = {
+  {"SETNODEID", cmdSetNodeId, "SETNODEID:ABCDEF"},
+  {"SETWIFI", cmdSetWifi, "SETWIFI:ssid,pass (restarts the AP)"},
+  {"SETTIME", cmdSetTime, "SETTIME:YYYY,MM,DD,HH,mm"},
+  {"CONFIG", cmdConfig, "CONFIG - node id, WiFi, uplink, roster, time; CONFIG:{json} sets"},
+  {"METRICS", cmdMetrics, "METRICS - same as /api/metrics"},
+  {"ROSTER", cmdRoster, "ROSTER - last reading of every roster node"},
+  {"LOG", cmdLogStatus, "LOG - log file, writes, backfill state"},
+#ifdef KIC_LOW_POWER
+  {"POWER", cmdPower, "POWER - sleep/wake accounting"},
+#endif
+#ifdef KIC_BENCH
+  {"BENCH", cmdBench, "BENCH - run the benchmark suite"},
+#endif
+  {"HELP", cmdHelp, "HELP"},
+};
 
-  bool tempprobedisconnected = false;
-  // Read DS18B20 every 5s
-  if (millis() - lastRead > 5000) {
-    sensors.requestTemperatures();
-    myTemp = sensors.getTempCByIndex(0);
-    if (myTemp == DEVICE_DISCONNECTED_C) {
-      myTemp = NAN;
-      tempprobedisconnected = true;
+void cmdHelp(char *) {
+  for (const auto &c : serialCommands) Serial.println(c.usage);
+}
+
+void processSerialCommands() {
+  // Only bytes that have already arrived: a partial line waits in
+  // serialLine for the next pass instead of stalling the loop
+  for (int i = 0; i < SERIAL_BYTES_PER_LOOP && Serial.available() > 0; i++) {
+    if (!serialLine.feed((char)Serial.read())) continue;
+    if (serialLine.overflowed()) {
+      Serial.println("ERR line too long");
+      continue;
     }
-    updateNodeTemp(nodeID, myTemp, NAN, NAN, doIhaveRTC);
-    lastRead = millis();
-    showOLED();
+    CommandResult res = CommandLine::dispatch(serialCommands, sizeof(serialCommands) / sizeof(serialCommands[0]),
+                                              serialLine.line());
+    if (res == CommandResult::Unknown) Serial.println("ERR unknown command, try HELP");
   }
+}
+
 
+// One pass over the node, under nodeMutex; true if the buzzer should sound
+bool loopPass() {
+  processSerialCommands();
+
+  // Sensor read, KIC send and quarter-hour log run inside the node logic
   radioloop();
-  logloop();
+  applyPendingConfig();
+  LoopEvents ev = node.loop();
+  bootDeferred(ev.sent);
+  if (restartPending && millis() - restartRequestMs > 1000) restartNode();
+  if (apRestartPending && millis() - apRestartMs > 1000) {
+    apRestartPending = false;
+    restartAp();
+  }
+#ifdef KIC_LOW_POWER
+  if (ev.sensorRead && apActive) showOLED();
+#else
+  if (ev.sensorRead) showOLED();
+#endif
+  if (ev.logged) {
+    LOG_I("logged, next at epoch %lu", (unsigned long)node.nextLogEpoch());
+  }
+  bool tempprobedisconnected = ev.sensorRead && node.probeDisconnected();
 
   // Node-down and checkin alarms
-  bool silenceActive = millis() < silenceUntil;
-  bool noWebCheckin = (millis() - lastWebCheckin) > DAY_MS;
-  std::vector<String> ids = getNodeIDs();
-  for (auto& nid : ids) {
-    if (nid == nodeID) continue;
-    bool found = false;
-    for (auto& n : nodeTemps) {
-      if (n.id == nid && (now() - n.lastUpdate < 300)) found = true;
-    }
-    if (!found && !silenceActive) {
+  AlarmStatus alarms;
+  node.evaluateAlarms(alarms);
+  // Nothing is shown or sounded before the display stage, which waits for
+  // the first report: the buzzer's 1 s would hold that report back
+  bool silenceActive = alarms.silenced || !displayReady;
+#ifndef KIC_LOW_POWER
+  if (uplinkTransport) {
+    uplink.sample(node.table(), millis());
+    uplink.alarms(alarms, (uint32_t)now());
+    uplink.tick(millis());
+  }
+#endif
+  bool noWebCheckin = (millis() - node.lastWebCheckin()) > DAY_MS;
+  bool buzz = false;
+  for (auto& nid : alarms.downNodes) {
+    if (!silenceActive) {
       display.clearDisplay();
       display.setCursor(0,0);
       display.println("ALARM! Node Down:");
-      display.println(nid);
-      if (isDaytime()) buzzAlarm();
+      display.println(nid.c_str());
+      if (alarms.daytime) buzz = true;
+    }
+  }
+  // A peer has lost a node we heard recently: warn, the buzzer is for
+  // what we see ourselves
+  for (auto& nid : alarms.reportedDown) {
+    if (!silenceActive) {
+      display.clearDisplay();
+      display.setCursor(0,0);
+      display.println("Peer reports down:");
+      display.println(nid.c_str());
+    }
+  }
+  // Rising trend: the door may be open, warn before the limit is reached
+  for (auto& w : alarms.rising) {
+    if (!silenceActive) {
+      display.clearDisplay();
+      display.setCursor(0,0);
+      display.println("WARN! Rising temp:");
+      display.println(w.id.c_str());
+      display.printf("%.1fC %+.1fC/h\n", w.temp, w.slope);
+      display.printf("limit in %lu min\n", (unsigned long)w.minutes);
     }
   }
   // Temp probe disconnected alarm
@@ -958,7 +1502,7 @@ void loop() {
     display.setCursor(0,0);
     display.println("ALARM! Temp Probe");
     display.println("Disconnected!");
-    if (isDaytime()) buzzAlarm();
+    if (alarms.daytime) buzz = true;
   }
 /*
   if (!silenceActive && noWebCheckin) {
@@ -970,4 +1514,19 @@ void loop() {
     if (isDaytime()) buzzAlarm();
   }
 */
+  return buzz;
+}
+
+void loop() {
+#ifdef KIC_LOW_POWER
+  if (boot.finished()) lowPowerSleep();   // outside the loop timing
+#endif
+  bool buzz;
+  {
+    std::lock_guard<std::mutex> lock(nodeMutex);
+    MetricScope loopTiming(node.metrics(), espClock, MetricTimer::Loop);
+    buzz = loopPass();
+  }
+  // Its 1 s would otherwise hold every web page up
+  if (buzz) buzzAlarm();
 }
@@ -0,0 +1,84 @@
+#pragma once
+
+// In-memory HAL used by the native unit tests.
+
+#include <math.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Hal.h"
+
+class FakeClock : public Clock {
+public:
+    uint32_t ms = 0;
+    time_t epoch = 1757599200;   // 2025-09-11 14:00:00 UTC
+    uint32_t millis() override { return ms; }
+    time_t now() override { return epoch; }
+    void setTime(time_t e) override { epoch = e; }
+    uint32_t random(uint32_t max) override { return max ? 1234 % max : 0; }
+
+    void advance(uint32_t deltaMs) {
+        ms += deltaMs;
+        epoch += deltaMs / 1000;
+    }
+};
+
+class FakeRadio : public Radio {
+public:
+    std::vector<std::vector<uint8_t>> sent;
+    int16_t status = 0;
+    uint8_t sf = 0;      // last setRate(); 0 = never called
+    int8_t dbm = 0;
+    int16_t transmit(const uint8_t *data, size_t len) override {
+        sent.push_back(std::vector<uint8_t>(data, data + len));
+        return status;
+    }
+    int16_t setRate(uint8_t s, int8_t d) override {
+        sf = s;
+        dbm = d;
+        return 0;
+    }
+};
+
+class FakeStore : public KeyValueStore {
+public:
+    std::map<std::string, std::string> strings;
+    std::map<std::string, uint32_t> ulongs;
+    std::string getString(const char *key, const char *def) override {
+        auto it = strings.find(key);
+        return it == strings.end() ? def : it->second;
+    }
+    void putString(const char *key, const std::string &value) override { strings[key] = value; }
+    uint32_t getULong(const char *key, uint32_t def) override {
+        auto it = ulongs.find(key);
+        return it == ulongs.end() ? def : it->second;
+    }
+    void putULong(const char *key, uint32_t value) override { ulongs[key] = value; }
+};
+
+class FakeLog : public LogStore {
+public:
+    std::string data;
+    int appends = 0;
+    bool fail = false;
+    bool append(const char *d, size_t len) override {
+        if (fail) return false;
+        data.append(d, len);
+        appends++;
+        return true;
+    }
+};
+
+class FakeSensor : public TempSensor {
+public:
+    float value = 4.0f;
+    int conversions = 0;
+    uint8_t bits = 12;
+    uint8_t convertedBits = 0;   // resolution of the last conversion
+    void requestConversion() override {
+        conversions++;
+        convertedBits = bits;
+    }
+    float readC(uint8_t index) override { return index == 0 ? value : NAN; }
+    void setResolution(uint8_t b) override { bits = b; }
+};
@@ -0,0 +1,99 @@
+#include <unity.h>
+#include "Backfill.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_backlog_ring(void)
+{
+    Backlog b;
+    for (uint32_t i = 0; i < BACKFILL_MAX_SAMPLES + 4; i++) b.push(1000 + i * 900, (float)i);
+    TEST_ASSERT_EQUAL(BACKFILL_MAX_SAMPLES, b.size());
+
+    // The four oldest were overwritten
+    LogSample out[BACKFILL_BATCH];
+    TEST_ASSERT_EQUAL(BACKFILL_BATCH, b.collect(0, 0xFFFFFFFFUL, out, BACKFILL_BATCH));
+    TEST_ASSERT_EQUAL_UINT32(1000 + 4 * 900, out[0].epoch);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, out[0].temp);
+
+    TEST_ASSERT_EQUAL(2, b.collect(1000 + 10 * 900, 1000 + 11 * 900, out, BACKFILL_BATCH));
+    TEST_ASSERT_EQUAL_FLOAT(11.0f, out[1].temp);
+
+    // 1% duty: 99 ms of silence per ms on air
+    TEST_ASSERT_EQUAL(19800, Backlog::paceMs(200000));
+}
+
+void test_gap_lifecycle(void)
+{
+    BackfillGaps g;
+    g.missed("AAAAAA", 900);
+    g.missed("AAAAAA", 1800);
+    g.missed("AAAAAA", 1800);      // same slot twice
+    TEST_ASSERT_NULL(g.due(0));    // not heard from yet
+    g.heard("AAAAAA");
+    const BackfillGap *d = g.due(0);
+    TEST_ASSERT_NOT_NULL(d);
+    TEST_ASSERT_EQUAL(2, d->slots.size());
+    TEST_ASSERT_EQUAL_UINT32(900, d->since());
+    TEST_ASSERT_EQUAL_UINT32(1800, d->until());
+
+    // A request for part of the gap doesn't stand in for ours
+    g.asked("AAAAAA", 1800, 1800, 0);
+    TEST_ASSERT_NOT_NULL(g.due(0));
+    g.asked("AAAAAA", 900, 1800, 0);
+    TEST_ASSERT_NULL(g.due(BACKFILL_RETRY_MS - 1));
+    TEST_ASSERT_NOT_NULL(g.due(BACKFILL_RETRY_MS));
+
+    TEST_ASSERT_TRUE(g.wants("AAAAAA", 900));
+    TEST_ASSERT_FALSE(g.wants("AAAAAA", 1000));
+    TEST_ASSERT_FALSE(g.wants("BBBBBB", 900));
+    g.filled("AAAAAA", 0, 900, 10);
+    TEST_ASSERT_FALSE(g.wants("AAAAAA", 900));
+    TEST_ASSERT_EQUAL(1, g.size());
+    g.filled("AAAAAA", 1800, 1800, 20);
+    TEST_ASSERT_EQUAL(0, g.size());
+}
+
+void test_gap_gives_up(void)
+{
+    BackfillGaps g;
+    g.missed("AAAAAA", 900);
+    g.heard("AAAAAA");
+    uint32_t ms = 0;
+    for (int i = 0; i < BACKFILL_TRIES; i++) {
+        TEST_ASSERT_NOT_NULL(g.due(ms));
+        g.asked("AAAAAA", 900, 900, ms);
+        g.expire(ms);
+        ms += BACKFILL_RETRY_MS;
+    }
+    TEST_ASSERT_EQUAL(1, g.size());
+    g.expire(ms);
+    TEST_ASSERT_EQUAL(0, g.size());
+}
+
+void test_merge_sorted_and_deduped(void)
+{
+    BackfillMerge m;
+    LogSample s1 = {1800, 2.0f}, s0 = {900, 1.0f};
+    TEST_ASSERT_TRUE(m.add("AAAAAA", s1));
+    TEST_ASSERT_TRUE(m.add("BBBBBB", s0));
+    TEST_ASSERT_TRUE(m.add("AAAAAA", s0));
+    TEST_ASSERT_FALSE(m.add("AAAAAA", s1));
+    std::vector<BackfillRow> rows;
+    m.take(rows);
+    TEST_ASSERT_EQUAL(0, m.size());
+    TEST_ASSERT_EQUAL(3, rows.size());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", rows[0].id.c_str());
+    TEST_ASSERT_EQUAL_STRING("AAAAAA", rows[1].id.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1800, rows[2].s.epoch);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_backlog_ring);
+    RUN_TEST(test_gap_lifecycle);
+    RUN_TEST(test_gap_gives_up);
+    RUN_TEST(test_merge_sorted_and_deduped);
+    return UNITY_END();
+}
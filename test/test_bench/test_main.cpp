@@ -0,0 +1,52 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+static uint64_t fakeTime = 0;
+static uint64_t fakeClock() { return fakeTime; }
+
+static std::vector<std::string> lines;
+static void capture(const char *line) { lines.push_back(line); }
+
+void setUp(void) { lines.clear(); }
+void tearDown(void) {}
+
+void test_summarize(void)
+{
+    uint64_t s[100];
+    for (int i = 0; i < 100; i++) s[i] = 100 - i;   // 100..1, unsorted
+    BenchResult r;
+    Bench::summarize(s, 100, r);
+    TEST_ASSERT_EQUAL(1, r.min);
+    TEST_ASSERT_EQUAL(51, r.median);
+    TEST_ASSERT_EQUAL(99, r.p99);
+
+    uint64_t one = 7;
+    Bench::summarize(&one, 1, r);
+    TEST_ASSERT_EQUAL(7, r.min);
+    TEST_ASSERT_EQUAL(7, r.p99);
+}
+
+void test_run_reports_json(void)
+{
+    Bench bench(fakeClock, "ns", capture);
+    uint64_t step = 0;
+    BenchResult r = bench.run("case.one", 10, [&]() { fakeTime += ++step; });
+    // warm-up call took step 1; measured iterations 2..11
+    TEST_ASSERT_EQUAL(2, r.min);
+    TEST_ASSERT_EQUAL(11, r.p99);
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_TRUE(lines[0].find("\"bench\":\"case.one\"") != std::string::npos);
+    TEST_ASSERT_TRUE(lines[0].find("\"median\":7") != std::string::npos);
+    TEST_ASSERT_TRUE(lines[0].find("\"allocs_per_op\":null") != std::string::npos);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_summarize);
+    RUN_TEST(test_run_reports_json);
+    return UNITY_END();
+}
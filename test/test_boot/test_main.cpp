@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "../FakeHal.h"
+#include "Boot.h"
+
+static FakeClock fakeClock;
+static std::string order;
+
+// Each stage notes itself and takes a known time
+static void power() { order += "p"; fakeClock.advance(1); }
+static void radio() { order += "r"; fakeClock.advance(40); }
+static void sensor() { order += "s"; fakeClock.advance(190); }
+static void display() { order += "d"; fakeClock.advance(30); }
+static void wifi() { order += "w"; fakeClock.advance(120); }
+
+static const BootStage stages[] = {
+    {"power", power, false},
+    {"radio", radio, false},
+    {"sensor", sensor, false},
+    {"display", display, true},
+    {"wifi", wifi, true},
+};
+
+static void collect(void *ctx, const char *text, size_t len)
+{
+    ((std::string *)ctx)->append(text, len);
+}
+
+void setUp(void)
+{
+    fakeClock = FakeClock();
+    order.clear();
+}
+void tearDown(void) {}
+
+void test_immediate_then_deferred(void)
+{
+    BootSequence boot(stages, sizeof(stages) / sizeof(stages[0]), fakeClock);
+    fakeClock.advance(5);
+    boot.runImmediate();
+    TEST_ASSERT_EQUAL_STRING("prs", order.c_str());
+
+    // Nothing deferred runs before the first report
+    TEST_ASSERT_FALSE(boot.runDeferred());
+    fakeClock.advance(250);
+    boot.reportSent();
+    fakeClock.advance(30000);
+    boot.reportSent();
+    TEST_ASSERT_EQUAL(486000, boot.firstReportUs());
+
+    TEST_ASSERT_TRUE(boot.runDeferred());
+    TEST_ASSERT_EQUAL_STRING("prsd", order.c_str());
+    TEST_ASSERT_FALSE(boot.finished());
+    TEST_ASSERT_TRUE(boot.runDeferred());
+    TEST_ASSERT_TRUE(boot.finished());
+    TEST_ASSERT_FALSE(boot.runDeferred());
+    TEST_ASSERT_EQUAL_STRING("prsdw", order.c_str());
+
+    TEST_ASSERT_EQUAL(6000, boot.startUs(1));
+    TEST_ASSERT_EQUAL(40000, boot.durationUs(1));
+    TEST_ASSERT_EQUAL(120000, boot.durationUs(4));
+    TEST_ASSERT_EQUAL(fakeClock.micros(), boot.finishedUs());
+}
+
+void test_render(void)
+{
+    BootSequence boot(stages, sizeof(stages) / sizeof(stages[0]), fakeClock);
+    boot.runImmediate();
+    std::string text;
+    boot.render(collect, &text);
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "# TYPE kic_boot_stage_seconds gauge\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "kic_boot_stage_seconds{stage=\"sensor\"} 0.190000\n"));
+    // Stages still to come are left out; no report yet reads as zero
+    TEST_ASSERT_NULL(strstr(text.c_str(), "stage=\"wifi\""));
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "kic_boot_first_report_seconds 0.000000\n"));
+
+    fakeClock.advance(250);
+    boot.reportSent();
+    while (boot.runDeferred()) {}
+    text.clear();
+    boot.render(collect, &text);
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "kic_boot_stage_seconds{stage=\"wifi\"} 0.120000\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "kic_boot_first_report_seconds 0.481000\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text.c_str(), "kic_boot_finished_seconds 0.631000\n"));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_immediate_then_deferred);
+    RUN_TEST(test_render);
+    return UNITY_END();
+}
@@ -0,0 +1,103 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "CaptiveDns.h"
+
+static const uint8_t apIp[4] = {192, 168, 4, 1};
+
+// Query for name (dotted) with qtype, RD set, optional EDNS OPT record
+static std::vector<uint8_t> makeQuery(const char *name, uint16_t qtype, bool edns)
+{
+    std::vector<uint8_t> q = {0x12, 0x34, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, (uint8_t)(edns ? 1 : 0)};
+    const char *p = name;
+    while (*p) {
+        const char *dot = strchr(p, '.');
+        size_t n = dot ? (size_t)(dot - p) : strlen(p);
+        q.push_back((uint8_t)n);
+        q.insert(q.end(), p, p + n);
+        p += n + (dot ? 1 : 0);
+    }
+    q.push_back(0);
+    q.push_back(qtype >> 8);
+    q.push_back(qtype & 0xFF);
+    q.push_back(0);
+    q.push_back(1);
+    if (edns) {
+        const uint8_t opt[] = {0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0};
+        q.insert(q.end(), opt, opt + sizeof(opt));
+    }
+    return q;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_a_query_gets_ap_address(void)
+{
+    CaptiveDns dns;
+    dns.setAddress(apIp);
+    std::vector<uint8_t> q = makeQuery("connectivitycheck.gstatic.com", 1, true);
+    uint8_t out[DNS_PACKET_MAX];
+    size_t n = dns.answer(q.data(), q.size(), out, sizeof(out));
+
+    size_t qlen = q.size() - 11;   // without the OPT record
+    TEST_ASSERT_EQUAL(qlen + DNS_ANSWER_LEN, n);
+    TEST_ASSERT_EQUAL_HEX8(0x12, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, out[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x85, out[2]);   // response, AA, RD
+    TEST_ASSERT_EQUAL_HEX8(0x00, out[3]);
+    TEST_ASSERT_EQUAL(1, out[5]);
+    TEST_ASSERT_EQUAL(1, out[7]);
+    TEST_ASSERT_EQUAL(0, out[11]);
+    TEST_ASSERT_EQUAL_MEMORY(q.data() + DNS_HEADER_LEN, out + DNS_HEADER_LEN, qlen - DNS_HEADER_LEN);
+    TEST_ASSERT_EQUAL_HEX8(0xC0, out[qlen]);
+    TEST_ASSERT_EQUAL_HEX8(0x0C, out[qlen + 1]);
+    TEST_ASSERT_EQUAL(DNS_TTL_SECS, out[qlen + 9]);
+    TEST_ASSERT_EQUAL_MEMORY(apIp, out + n - 4, 4);
+}
+
+void test_other_types_get_empty_reply(void)
+{
+    CaptiveDns dns;
+    dns.setAddress(apIp);
+    std::vector<uint8_t> q = makeQuery("captive.apple.com", 28, false);
+    uint8_t out[DNS_PACKET_MAX];
+    size_t n = dns.answer(q.data(), q.size(), out, sizeof(out));
+    TEST_ASSERT_EQUAL(q.size(), n);
+    TEST_ASSERT_EQUAL_HEX8(0x85, out[2]);
+    TEST_ASSERT_EQUAL(0, out[7]);
+}
+
+void test_bad_packets_dropped(void)
+{
+    CaptiveDns dns;
+    dns.setAddress(apIp);
+    uint8_t out[DNS_PACKET_MAX];
+
+    std::vector<uint8_t> q = makeQuery("kic.local", 1, false);
+    TEST_ASSERT_EQUAL(0, dns.answer(q.data(), DNS_HEADER_LEN - 1, out, sizeof(out)));
+    TEST_ASSERT_EQUAL(0, dns.answer(q.data(), q.size() - 1, out, sizeof(out)));   // cut short
+    TEST_ASSERT_EQUAL(0, dns.answer(q.data(), q.size(), out, q.size()));         // no room
+
+    std::vector<uint8_t> r = q;
+    r[2] |= 0x80;                   // a response, not a query
+    TEST_ASSERT_EQUAL(0, dns.answer(r.data(), r.size(), out, sizeof(out)));
+    r = q;
+    r[5] = 2;                       // two questions
+    TEST_ASSERT_EQUAL(0, dns.answer(r.data(), r.size(), out, sizeof(out)));
+    r = q;
+    r[DNS_HEADER_LEN] = 0xC0;       // compressed name in the question
+    TEST_ASSERT_EQUAL(0, dns.answer(r.data(), r.size(), out, sizeof(out)));
+    r = q;
+    r[DNS_HEADER_LEN] = 60;         // label runs past the end
+    TEST_ASSERT_EQUAL(0, dns.answer(r.data(), r.size(), out, sizeof(out)));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_a_query_gets_ap_address);
+    RUN_TEST(test_other_types_get_empty_reply);
+    RUN_TEST(test_bad_packets_dropped);
+    return UNITY_END();
+}
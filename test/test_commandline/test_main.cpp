@@ -0,0 +1,113 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "CommandLine.h"
+
+static std::string lastRun;
+static std::string lastArgs;
+
+static void runA(char *args) { lastRun = "A"; lastArgs = args; }
+static void runB(char *args) { lastRun = "B"; lastArgs = args; }
+
+static const Command table[] = {
+    {"SETTIME", runA, "SETTIME:..."},
+    {"ROSTER", runB, "ROSTER"},
+};
+
+void setUp(void)
+{
+    lastRun.clear();
+    lastArgs.clear();
+}
+void tearDown(void) {}
+
+// Feed a string; the number of lines it completed
+static int feedAll(LineAssembler &la, const char *s)
+{
+    int lines = 0;
+    for (; *s; s++) lines += la.feed(*s) ? 1 : 0;
+    return lines;
+}
+
+void test_line_arrives_in_pieces(void)
+{
+    LineAssembler la;
+    TEST_ASSERT_EQUAL(0, feedAll(la, "  SETTI"));
+    TEST_ASSERT_EQUAL(0, feedAll(la, "ME:2025,9"));
+    TEST_ASSERT_EQUAL(1, feedAll(la, ",11 \r\n"));
+    TEST_ASSERT_EQUAL_STRING("SETTIME:2025,9,11", la.line());
+    TEST_ASSERT_FALSE(la.overflowed());
+
+    TEST_ASSERT_EQUAL(1, feedAll(la, "\r\n"));
+    TEST_ASSERT_EQUAL_STRING("", la.line());
+}
+
+void test_overlong_line_is_dropped(void)
+{
+    LineAssembler la;
+    std::string big(CMD_LINE_MAX + 10, 'x');
+    TEST_ASSERT_EQUAL(0, feedAll(la, big.c_str()));
+    TEST_ASSERT_EQUAL(1, feedAll(la, "\n"));
+    TEST_ASSERT_TRUE(la.overflowed());
+    TEST_ASSERT_EQUAL_STRING("", la.line());
+
+    // The next line is unaffected
+    TEST_ASSERT_EQUAL(1, feedAll(la, "ROSTER\n"));
+    TEST_ASSERT_FALSE(la.overflowed());
+    TEST_ASSERT_EQUAL_STRING("ROSTER", la.line());
+}
+
+void test_dispatch(void)
+{
+    char l1[] = "settime:2025,09,11,14,00";
+    TEST_ASSERT_EQUAL(CommandResult::Ran, CommandLine::dispatch(table, 2, l1));
+    TEST_ASSERT_EQUAL_STRING("A", lastRun.c_str());
+    TEST_ASSERT_EQUAL_STRING("2025,09,11,14,00", lastArgs.c_str());
+
+    char l2[] = "ROSTER";
+    TEST_ASSERT_EQUAL(CommandResult::Ran, CommandLine::dispatch(table, 2, l2));
+    TEST_ASSERT_EQUAL_STRING("B", lastRun.c_str());
+    TEST_ASSERT_EQUAL_STRING("", lastArgs.c_str());
+
+    char l3[] = "ROSTER all";
+    TEST_ASSERT_EQUAL(CommandResult::Ran, CommandLine::dispatch(table, 2, l3));
+    TEST_ASSERT_EQUAL_STRING("all", lastArgs.c_str());
+
+    char l4[] = "ROST";
+    char l5[] = "";
+    lastRun.clear();
+    TEST_ASSERT_EQUAL(CommandResult::Unknown, CommandLine::dispatch(table, 2, l4));
+    TEST_ASSERT_EQUAL(CommandResult::Empty, CommandLine::dispatch(table, 2, l5));
+    TEST_ASSERT_TRUE(lastRun.empty());
+}
+
+void test_split_and_toint(void)
+{
+    char s[] = "MySSID,pa,ss";
+    char *f[2];
+    TEST_ASSERT_EQUAL(2, CommandLine::split(s, ',', f, 2));
+    TEST_ASSERT_EQUAL_STRING("MySSID", f[0]);
+    TEST_ASSERT_EQUAL_STRING("pa,ss", f[1]);
+
+    char t[] = "2025,09";
+    char *g[5];
+    TEST_ASSERT_EQUAL(2, CommandLine::split(t, ',', g, 5));
+
+    long v = -1;
+    TEST_ASSERT_TRUE(CommandLine::toInt("09", 1, 12, v));
+    TEST_ASSERT_EQUAL(9, v);
+    TEST_ASSERT_FALSE(CommandLine::toInt("13", 1, 12, v));
+    TEST_ASSERT_FALSE(CommandLine::toInt("9x", 1, 12, v));
+    TEST_ASSERT_FALSE(CommandLine::toInt("", 1, 12, v));
+    TEST_ASSERT_EQUAL(9, v);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_line_arrives_in_pieces);
+    RUN_TEST(test_overlong_line_is_dropped);
+    RUN_TEST(test_dispatch);
+    RUN_TEST(test_split_and_toint);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "ConfigChange.h"
+#include "LinkAdapt.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static bool parse(const char *json, ConfigChange &c, ConfigError &err)
+{
+    return ConfigChange::parse(json, strlen(json), c, err);
+}
+
+void test_parse_batch(void)
+{
+    ConfigChange c;
+    ConfigError err;
+    TEST_ASSERT_TRUE(parse(" { \"roster\" : \"A1B2C3,B2C3D4\", \"trend_limit\": -12.5,\n"
+                           "\"time\":1757599200, \"max_dbm\":14, \"sta_only\":true,"
+                           "\"ap_ssid\":\"Walk-in \\\"2\\\"\\u0021\"}\r\n", c, err));
+    TEST_ASSERT_EQUAL(CfgRoster | CfgTrendLimit | CfgTime | CfgMaxDbm | CfgStaOnly | CfgApSsid, c.fields);
+    TEST_ASSERT_EQUAL_STRING("A1B2C3,B2C3D4", c.roster.c_str());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -12.5f, c.trendLimit);
+    TEST_ASSERT_EQUAL(1757599200UL, c.time);
+    TEST_ASSERT_EQUAL(14, c.maxDbm);
+    TEST_ASSERT_TRUE(c.staOnly);
+    TEST_ASSERT_EQUAL_STRING("Walk-in \"2\"!", c.apSsid.c_str());
+    TEST_ASSERT_TRUE(c.needsRestart());
+    TEST_ASSERT_TRUE(c.validate(err));
+
+    TEST_ASSERT_TRUE(parse("{\"trend_limit\":null}", c, err));
+    TEST_ASSERT_EQUAL(CfgTrendLimit, c.fields);
+    TEST_ASSERT_TRUE(isnan(c.trendLimit));
+    TEST_ASSERT_FALSE(c.needsRestart());
+
+    TEST_ASSERT_TRUE(parse("{}", c, err));
+    TEST_ASSERT_EQUAL(0, c.fields);
+}
+
+void test_parse_errors(void)
+{
+    ConfigChange c;
+    ConfigError err;
+    TEST_ASSERT_FALSE(parse("", c, err));
+    TEST_ASSERT_EQUAL_STRING("", err.key);
+    TEST_ASSERT_FALSE(parse("{\"roster\":\"A1B2C3\"", c, err));
+    TEST_ASSERT_FALSE(parse("{\"roster\":\"A1B2C3\"} x", c, err));
+    TEST_ASSERT_FALSE(parse("{\"max_dbm\":14,}", c, err));
+
+    TEST_ASSERT_FALSE(parse("{\"colour\":\"red\"}", c, err));
+    TEST_ASSERT_EQUAL_STRING("colour", err.key);
+    TEST_ASSERT_EQUAL_STRING("unknown key", err.reason);
+    TEST_ASSERT_FALSE(parse("{\"time\":1757599200,\"time\":1757599201}", c, err));
+    TEST_ASSERT_EQUAL_STRING("repeated key", err.reason);
+    TEST_ASSERT_FALSE(parse("{\"max_dbm\":\"14\"}", c, err));
+    TEST_ASSERT_EQUAL_STRING("max_dbm", err.key);
+    TEST_ASSERT_FALSE(parse("{\"max_dbm\":14.5}", c, err));
+    TEST_ASSERT_FALSE(parse("{\"roster\":null}", c, err));
+    TEST_ASSERT_FALSE(parse("{\"sta_only\":1}", c, err));
+
+    // The key goes back in the reply as is; nothing in it needs escaping
+    TEST_ASSERT_FALSE(parse("{\"<b>\\\"x\":1}", c, err));
+    TEST_ASSERT_EQUAL_STRING("?b??x", err.key);
+}
+
+void test_validate(void)
+{
+    ConfigChange c;
+    ConfigError err;
+    TEST_ASSERT_TRUE(parse("{\"roster\":\"A1B2C3,A1B2C3\"}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+    TEST_ASSERT_EQUAL_STRING("roster", err.key);
+    c.roster = "A1B2C3,B2C3D";
+    TEST_ASSERT_FALSE(c.validate(err));
+    c.roster = "";
+    TEST_ASSERT_TRUE(c.validate(err));
+
+    // One bad field fails the batch
+    TEST_ASSERT_TRUE(parse("{\"nodeid\":\"A1B2C3\",\"ap_pass\":\"short\"}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+    TEST_ASSERT_EQUAL_STRING("ap_pass", err.key);
+
+    TEST_ASSERT_TRUE(parse("{\"uplink\":\"ftp://host\"}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+    c.uplink = "";
+    TEST_ASSERT_TRUE(c.validate(err));
+
+    TEST_ASSERT_TRUE(parse("{\"time\":86400}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+    TEST_ASSERT_TRUE(parse("{\"trend_horizon\":0}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+    TEST_ASSERT_TRUE(parse("{\"trend_limit\":80}", c, err));
+    TEST_ASSERT_FALSE(c.validate(err));
+
+    c = ConfigChange();
+    c.fields = CfgMaxDbm;
+    c.maxDbm = ADR_MAX_DBM + 1;
+    TEST_ASSERT_FALSE(c.validate(err));
+    c.maxDbm = ADR_MIN_DBM;
+    TEST_ASSERT_TRUE(c.validate(err));
+}
+
+void test_names(void)
+{
+    ConfigChange c;
+    ConfigError err;
+    TEST_ASSERT_TRUE(parse("{\"max_dbm\":10,\"roster\":\"\"}", c, err));
+    char buf[64];
+    TextBuf out(buf, sizeof(buf));
+    c.names(out);
+    TEST_ASSERT_EQUAL_STRING("\"roster\",\"max_dbm\"", buf);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_batch);
+    RUN_TEST(test_parse_errors);
+    RUN_TEST(test_validate);
+    RUN_TEST(test_names);
+    return UNITY_END();
+}
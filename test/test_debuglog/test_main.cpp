@@ -0,0 +1,95 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "DebugLog.h"
+
+static uint32_t fakeMs = 0;
+static uint32_t fakeMillis() { return fakeMs; }
+
+static std::string drainAll()
+{
+    std::string s;
+    char chunk[64];
+    size_t n;
+    while ((n = DebugLog::drain(chunk, sizeof(chunk))) > 0) s.append(chunk, n);
+    return s;
+}
+
+void setUp(void)
+{
+    fakeMs = 0;
+    DebugLog::begin(fakeMillis);
+    drainAll();
+}
+void tearDown(void) {}
+
+void test_ring_whole_lines(void)
+{
+    LogRing ring;
+    char big[LOG_RING_SIZE - 4];
+    memset(big, 'x', sizeof(big));
+    TEST_ASSERT_TRUE(ring.push(big, sizeof(big)));
+    TEST_ASSERT_FALSE(ring.push("hello", 5));   // no partial lines
+    char out[LOG_RING_SIZE];
+    TEST_ASSERT_EQUAL(sizeof(big), ring.pop(out, sizeof(out)));
+    // Wraps around the end of the buffer
+    TEST_ASSERT_TRUE(ring.push("hello", 5));
+    TEST_ASSERT_EQUAL(5, ring.pop(out, sizeof(out)));
+    TEST_ASSERT_EQUAL(0, memcmp(out, "hello", 5));
+    TEST_ASSERT_EQUAL(0, ring.used());
+}
+
+void test_levels_and_format(void)
+{
+    fakeMs = 1234;
+    LOG_W("rx failed, code %d", -7);
+    LOG_D("compiled out at the default level");
+    TEST_ASSERT_EQUAL_STRING("[1234] W: rx failed, code -7\n", drainAll().c_str());
+}
+
+void test_rate_limit_per_site(void)
+{
+    for (int i = 0; i < 20; i++) {
+        LOG_I("flood %d", i);
+    }
+    LOG_I("other site");
+    std::string out = drainAll();
+    TEST_ASSERT_TRUE(out.find("flood 4") != std::string::npos);
+    TEST_ASSERT_TRUE(out.find("flood 5") == std::string::npos);
+    TEST_ASSERT_TRUE(out.find("other site") != std::string::npos);
+}
+
+void test_suppressed_count(void)
+{
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 8; i++) {
+            LOG_E("burst");
+        }
+        if (round == 0) {
+            drainAll();
+            fakeMs += LOG_RATE_WINDOW_MS;
+        }
+    }
+    std::string out = drainAll();
+    TEST_ASSERT_TRUE(out.find("burst (+3 suppressed)") != std::string::npos);
+}
+
+void test_hex(void)
+{
+    const uint8_t data[] = {0x00, 0xA5, 0xFF};
+    char out[16];
+    TEST_ASSERT_EQUAL_STRING("00 A5 FF", DebugLog::hex(data, 3, out, sizeof(out)));
+    char small[7];
+    TEST_ASSERT_EQUAL_STRING("00 A5", DebugLog::hex(data, 3, small, sizeof(small)));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_whole_lines);
+    RUN_TEST(test_levels_and_format);
+    RUN_TEST(test_rate_limit_per_site);
+    RUN_TEST(test_suppressed_count);
+    RUN_TEST(test_hex);
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "Gateway.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static GatewayRecord sample()
+{
+    GatewayRecord r = GatewayRecord::make(GatewayKind::Report, "A1B2C3", 123456, 1700000000);
+    r.temp[0] = GatewayRecord::fixed(-18.25f, 100.0f);
+    r.rssi = GatewayRecord::fixed(-97.5f, 10.0f);
+    r.snr = GatewayRecord::fixed(6.25f, 10.0f);
+    r.sf = 9;
+    r.txDbm = 13;
+    return r;
+}
+
+void test_crc16_check_value(void)
+{
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, Gateway::crc16((const uint8_t *)"123456789", 9));
+}
+
+void test_cobs_round_trip(void)
+{
+    uint8_t in[300], enc[310], dec[300];
+    // Zeros at the ends and in the middle, and a run past 254 bytes
+    for (size_t i = 0; i < sizeof(in); i++) in[i] = (i % 97 == 0) ? 0 : (uint8_t)i;
+    memset(in + 1, 0x55, 280);
+    size_t n = Gateway::cobsEncode(in, sizeof(in), enc);
+    for (size_t i = 0; i < n; i++) TEST_ASSERT_NOT_EQUAL(0, enc[i]);
+    TEST_ASSERT_EQUAL(sizeof(in), Gateway::cobsDecode(enc, n, dec, sizeof(dec)));
+    TEST_ASSERT_EQUAL(0, memcmp(in, dec, sizeof(in)));
+
+    const uint8_t zeros[2] = {0, 0};
+    n = Gateway::cobsEncode(zeros, 2, enc);
+    TEST_ASSERT_EQUAL(3, n);
+    TEST_ASSERT_EQUAL(2, Gateway::cobsDecode(enc, n, dec, sizeof(dec)));
+    // A length byte running past the end
+    const uint8_t bad[2] = {5, 1};
+    TEST_ASSERT_EQUAL(0, Gateway::cobsDecode(bad, 2, dec, sizeof(dec)));
+}
+
+void test_record_round_trip(void)
+{
+    GatewayRecord r = sample();
+    r.seq = 0xBEEF;
+    uint8_t frame[GATEWAY_FRAME_MAX];
+    size_t n = Gateway::encode(r, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(n > 0 && n <= GATEWAY_FRAME_MAX);
+    TEST_ASSERT_EQUAL(0, frame[0]);
+    TEST_ASSERT_EQUAL(0, frame[n - 1]);
+
+    GatewayRecord out;
+    TEST_ASSERT_TRUE(Gateway::decode(frame + 1, n - 2, out));
+    TEST_ASSERT_EQUAL(GatewayKind::Report, out.kind);
+    TEST_ASSERT_EQUAL(0xBEEF, out.seq);
+    TEST_ASSERT_EQUAL(123456, out.ms);
+    TEST_ASSERT_EQUAL(1700000000, out.epoch);
+    TEST_ASSERT_EQUAL(0, memcmp("A1B2C3", out.id, GATEWAY_ID_LEN));
+    TEST_ASSERT_EQUAL(-1825, out.temp[0]);
+    TEST_ASSERT_EQUAL(GATEWAY_NO_VALUE, out.temp[1]);
+    TEST_ASSERT_EQUAL(-975, out.rssi);
+    TEST_ASSERT_EQUAL(63, out.snr);
+    TEST_ASSERT_EQUAL(9, out.sf);
+    TEST_ASSERT_EQUAL(13, out.txDbm);
+
+    // One flipped bit fails the CRC
+    frame[10] ^= 0x04;
+    TEST_ASSERT_FALSE(Gateway::decode(frame + 1, n - 2, out));
+}
+
+void test_reader_skips_text(void)
+{
+    GatewayStream stream;
+    TEST_ASSERT_TRUE(stream.push(sample()));
+    TEST_ASSERT_TRUE(stream.push(sample()));
+    uint8_t frames[2 * GATEWAY_FRAME_MAX];
+    size_t n = stream.drain(frames, sizeof(frames));
+
+    // Debug text before, between and after the frames
+    const char *text = "[1234] I: logged\n";
+    uint8_t wire[256];
+    size_t len = 0;
+    memcpy(wire + len, text, strlen(text)); len += strlen(text);
+    memcpy(wire + len, frames, n / 2); len += n / 2;
+    memcpy(wire + len, text, strlen(text)); len += strlen(text);
+    memcpy(wire + len, frames + n / 2, n / 2); len += n / 2;
+
+    GatewayReader reader;
+    GatewayRecord rec;
+    int records = 0, junk = 0;
+    uint16_t seqs[2] = {0, 0};
+    for (size_t i = 0; i < len; i++) {
+        GatewayReader::Result res = reader.feed(wire[i], rec);
+        if (res == GatewayReader::Record) seqs[records++] = rec.seq;
+        if (res == GatewayReader::Junk) junk++;
+    }
+    TEST_ASSERT_EQUAL(2, records);
+    TEST_ASSERT_EQUAL(2, junk);
+    TEST_ASSERT_EQUAL(0, seqs[0]);
+    TEST_ASSERT_EQUAL(1, seqs[1]);
+}
+
+void test_stream_full_keeps_numbering(void)
+{
+    GatewayStream stream;
+    int pushed = 0;
+    while (stream.push(sample())) pushed++;
+    TEST_ASSERT_EQUAL(1, stream.dropped());
+    TEST_ASSERT_TRUE(pushed * GATEWAY_FRAME_MAX >= LOG_RING_SIZE - GATEWAY_FRAME_MAX);
+
+    uint8_t buf[LOG_RING_SIZE];
+    stream.drain(buf, sizeof(buf));
+    TEST_ASSERT_TRUE(stream.push(sample()));
+    size_t n = stream.drain(buf, sizeof(buf));
+    GatewayRecord rec;
+    TEST_ASSERT_TRUE(Gateway::decode(buf + 1, n - 2, rec));
+    // The dropped record used a number, so the host sees the gap
+    TEST_ASSERT_EQUAL(pushed + 1, rec.seq);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc16_check_value);
+    RUN_TEST(test_cobs_round_trip);
+    RUN_TEST(test_record_round_trip);
+    RUN_TEST(test_reader_skips_text);
+    RUN_TEST(test_stream_full_keeps_numbering);
+    return UNITY_END();
+}
@@ -0,0 +1,213 @@
+#include <unity.h>
+#include "LinkAdapt.h"
+#include "Airtime.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Reports from every peer, each heard at the given RSSI/SNR
+static void hearAll(LinkAdapt &la, const char *const *ids, size_t n,
+                    float rssi, float snr, uint8_t sf, uint8_t want, uint32_t ms)
+{
+    for (size_t i = 0; i < n; i++) la.onFrame(ids[i], rssi, snr, sf, 13, want, ms);
+}
+
+static const char *const PEERS[] = { "AAAAAA", "BBBBBB", "CCCCCC" };
+
+void test_strong_links_lower_rate(void)
+{
+    LinkAdapt la;
+    uint32_t ms = 1000;
+    hearAll(la, PEERS, 3, -60.0f, 10.0f, 9, 7, ms);
+    la.update(ms, 3);
+    // Power drops at once; the SF waits out the hold
+    TEST_ASSERT_EQUAL(9, la.sf());
+    TEST_ASSERT_EQUAL(ADR_MIN_DBM, la.txDbm());
+    TEST_ASSERT_EQUAL(7, la.wantSf());
+
+    for (ms += 30000; ms < 1000 + ADR_DOWN_HOLD_MS + 60000; ms += 30000) {
+        hearAll(la, PEERS, 3, -60.0f, 10.0f, 9, 7, ms);
+        la.update(ms, 3);
+    }
+    TEST_ASSERT_EQUAL(7, la.sf());
+}
+
+void test_weak_peer_raises_after_announcing(void)
+{
+    LinkAdapt la;
+    uint32_t ms = 1000;
+    // Even at full power SF10 is the first with 10 dB to spare
+    hearAll(la, PEERS, 3, -130.0f, -13.0f, 9, 9, ms);
+    la.update(ms, 3);
+    TEST_ASSERT_EQUAL(10, la.wantSf());
+    // Not before our reports have carried the request...
+    TEST_ASSERT_EQUAL(9, la.sf());
+    TEST_ASSERT_EQUAL(ADR_MAX_DBM, la.txDbm());
+
+    ms += ADR_ANNOUNCE_MS;
+    hearAll(la, PEERS, 3, -130.0f, -13.0f, 9, 9, ms);
+    la.update(ms, 3);
+    TEST_ASSERT_EQUAL(10, la.sf());
+
+    // SF11 would do for a weaker link, but four nodes at SF11 would take
+    // over a quarter of the channel
+    hearAll(la, PEERS, 3, -132.0f, -15.0f, 10, 10, ms);
+    la.update(ms + ADR_ANNOUNCE_MS, 3);
+    TEST_ASSERT_EQUAL(10, la.wantSf());
+
+    // A peer's announced need moves us straight away
+    LinkAdapt other;
+    hearAll(other, PEERS, 3, -60.0f, 10.0f, 9, 9, ms);
+    other.onFrame("CCCCCC", -60.0f, 10.0f, 9, 13, 10, ms);
+    TEST_ASSERT_TRUE(other.update(ms, 3));
+    TEST_ASSERT_EQUAL(10, other.sf());
+}
+
+void test_missing_peer_holds_rate(void)
+{
+    LinkAdapt la;
+    uint32_t ms = 1000;
+    for (; ms < 1000 + 2 * ADR_DOWN_HOLD_MS; ms += 30000) {
+        hearAll(la, PEERS, 2, -60.0f, 10.0f, 9, 7, ms);
+        la.update(ms, 3);
+    }
+    // CCCCCC may need SF9 and full power to get back in
+    TEST_ASSERT_EQUAL(9, la.sf());
+    TEST_ASSERT_EQUAL(ADR_MAX_DBM, la.txDbm());
+}
+
+void test_quiet_peer_changes_nothing(void)
+{
+    LinkAdapt la;
+    uint32_t ms = 1000;
+    hearAll(la, PEERS, 3, -60.0f, 10.0f, 9, 7, ms);
+    // CCCCCC goes down; the other two carry on
+    for (ms += 30000; ms < 1000 + ADR_PEER_TTL_MS + ADR_DOWN_HOLD_MS + 60000; ms += 30000) {
+        hearAll(la, PEERS, 2, -60.0f, 10.0f, 9, 7, ms);
+        la.update(ms, 3);
+    }
+    TEST_ASSERT_NULL(la.find("CCCCCC"));
+    TEST_ASSERT_EQUAL(1, la.lost().size());
+    TEST_ASSERT_EQUAL(7, la.sf());
+    TEST_ASSERT_TRUE(la.txDbm() < ADR_BASE_DBM);
+}
+
+void test_split_rejoins_highest(void)
+{
+    LinkAdapt la;
+    uint32_t ms = 1000;
+    for (; la.sf() == 9; ms += 30000) {
+        hearAll(la, PEERS, 3, -60.0f, 10.0f, 9, 7, ms);
+        la.update(ms, 3);
+    }
+    uint32_t lastC = ms - 30000;
+
+    // AAAAAA and BBBBBB lowered with us; CCCCCC said it would but never shows
+    for (; ms < lastC + ADR_REJOIN_MS; ms += 30000) {
+        hearAll(la, PEERS, 2, -60.0f, 10.0f, 7, 7, ms);
+        la.update(ms, 3);
+        TEST_ASSERT_EQUAL(7, la.sf());
+    }
+    hearAll(la, PEERS, 2, -60.0f, 10.0f, 7, 7, ms);
+    TEST_ASSERT_TRUE(la.update(ms, 3));
+    TEST_ASSERT_EQUAL(9, la.sf());
+    TEST_ASSERT_TRUE(la.txDbm() < ADR_MAX_DBM);
+
+    // Back on its SF and still silent: it is down, not left behind, so
+    // the next lowering sticks
+    for (ms += 30000; la.sf() == 9; ms += 30000) {
+        hearAll(la, PEERS, 2, -60.0f, 10.0f, 9, 7, ms);
+        la.update(ms, 3);
+    }
+    uint32_t lowered = ms;
+    for (; ms < lowered + 2 * ADR_REJOIN_MS; ms += 30000) {
+        hearAll(la, PEERS, 2, -60.0f, 10.0f, 7, 7, ms);
+        la.update(ms, 3);
+        TEST_ASSERT_EQUAL(7, la.sf());
+    }
+}
+
+void test_load_cap(void)
+{
+    TEST_ASSERT_EQUAL(ADR_MAX_SF, LinkAdapt::maxSf(1));
+    // Ten 513 ms reports every 30 s is 17% of the channel; SF10 would be 30%
+    TEST_ASSERT_EQUAL(9, LinkAdapt::maxSf(10));
+    TEST_ASSERT_EQUAL(ADR_MIN_SF, LinkAdapt::maxSf(1000));
+}
+
+void test_lost_node_hunts(void)
+{
+    LinkAdapt la;
+    la.resume(8, 0);
+    TEST_ASSERT_EQUAL(8, la.sf());
+    TEST_ASSERT_EQUAL(ADR_MAX_DBM, la.txDbm());
+
+    // Nearest SFs first: up, down, two up...
+    uint32_t ms = 0;
+    const uint8_t order[] = { 9, 7, 10, 11, 12, 8 };
+    for (size_t i = 0; i < sizeof(order); i++) {
+        ms += ADR_HUNT_MS + 1;
+        TEST_ASSERT_TRUE(la.update(ms, 3));
+        TEST_ASSERT_EQUAL(order[i], la.sf());
+    }
+
+    // Caught a report: stay
+    la.onFrame("AAAAAA", -60.0f, 10.0f, 8, 13, 8, ms);
+    la.update(ms + ADR_HUNT_MS, 3);
+    TEST_ASSERT_EQUAL(8, la.sf());
+
+    // Alone in the roster: nothing to hunt for
+    LinkAdapt solo;
+    TEST_ASSERT_FALSE(solo.update(10 * ADR_HUNT_MS, 0));
+    TEST_ASSERT_EQUAL(ADR_BASE_SF, solo.sf());
+}
+
+void test_power_step_rereferenced(void)
+{
+    LinkAdapt la;
+    la.onFrame("AAAAAA", -80.0f, 8.0f, 9, 13, 9, 0);
+    // Same path, peer now sends 6 dB hotter
+    la.onFrame("AAAAAA", -74.0f, 14.0f, 9, 19, 9, 1000);
+    const PeerLink *p = la.find("AAAAAA");
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -74.0f, p->rssi);
+    TEST_ASSERT_EQUAL(19, p->txDbm);
+    // Margin only depends on the path: SNR-limited, as at 13 dBm
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 8.0f - Airtime::requiredSnrDb(9),
+                             LinkAdapt::margin(*p, 9, 13));
+}
+
+void test_power_cap(void)
+{
+    LinkAdapt la;
+    TEST_ASSERT_EQUAL(ADR_MAX_DBM, la.maxTxDbm());
+    TEST_ASSERT_FALSE(la.setMaxDbm(17));   // above the base power
+    TEST_ASSERT_EQUAL(ADR_BASE_DBM, la.txDbm());
+    TEST_ASSERT_TRUE(la.setMaxDbm(10));
+    TEST_ASSERT_EQUAL(10, la.txDbm());
+    TEST_ASSERT_TRUE(la.setMaxDbm(0));     // clamped to the radio's range
+    TEST_ASSERT_EQUAL(ADR_MIN_DBM, la.maxTxDbm());
+    TEST_ASSERT_EQUAL(ADR_MIN_DBM, la.txDbm());
+
+    // Hunting for a lost node goes no higher than the cap
+    la.setMaxDbm(16);
+    la.resume(ADR_BASE_SF, 0);
+    TEST_ASSERT_EQUAL(16, la.txDbm());
+    la.reset();
+    TEST_ASSERT_EQUAL(ADR_BASE_DBM, la.txDbm());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_strong_links_lower_rate);
+    RUN_TEST(test_weak_peer_raises_after_announcing);
+    RUN_TEST(test_missing_peer_holds_rate);
+    RUN_TEST(test_quiet_peer_changes_nothing);
+    RUN_TEST(test_split_rejoins_highest);
+    RUN_TEST(test_load_cap);
+    RUN_TEST(test_lost_node_hunts);
+    RUN_TEST(test_power_step_rereferenced);
+    RUN_TEST(test_power_cap);
+    return UNITY_END();
+}
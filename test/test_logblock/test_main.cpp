@@ -0,0 +1,427 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "LogBlock.h"
+#include "TempLog.h"
+
+static const uint32_t T0 = 1757599200;
+
+struct Decoded {
+    uint32_t epoch;
+    std::string id;
+    float temp[3];
+};
+
+static void collect(void *ctx, const LogRow &r)
+{
+    Decoded d = {r.epoch, r.id, {r.temp[0], r.temp[1], r.temp[2]}};
+    ((std::vector<Decoded> *)ctx)->push_back(d);
+}
+
+// Every block of a file, in order
+static bool decodeAll(const std::string &file, std::vector<Decoded> &out)
+{
+    for (size_t off = 0; off < file.size(); off += LOGBLOCK_SIZE) {
+        size_t len = file.size() - off < LOGBLOCK_SIZE ? file.size() - off : LOGBLOCK_SIZE;
+        if (!LogBlockReader::decode((const uint8_t *)file.data() + off, len, collect, &out)) return false;
+    }
+    return true;
+}
+
+static uint32_t baseOf(void *ctx, size_t block)
+{
+    const std::string &file = *(const std::string *)ctx;
+    uint32_t e = 0;
+    LogBlockReader::baseEpoch((const uint8_t *)file.data() + block * LOGBLOCK_SIZE, LOGBLOCK_HEADER, e);
+    return e;
+}
+
+// A day per node of a freezer wobbling around -18 C, ten nodes
+static void writeDays(LogBlockWriter &w, int slots, std::string &file, std::vector<Decoded> &expect)
+{
+    static const char *ids[] = {"A1B2C3", "B2C3D4", "C3D4E5", "D4E5F6", "E5F6A1",
+                                "F6A1B2", "A2B3C4", "B3C4D5", "C4D5E6", "D5E6F1"};
+    for (int s = 0; s < slots; s++) {
+        uint32_t t = T0 + s * LOG_INTERVAL_SECS + (s % 3);   // wake jitter
+        LogRow rows[10];
+        for (int n = 0; n < 10; n++) {
+            float temp = -18.0f + ((s * 7 + n * 3) % 11) * 0.06f;
+            if (n == 4 && s % 50 == 7) temp = NAN;          // probe glitch
+            rows[n].epoch = t;
+            rows[n].id = ids[n];
+            rows[n].temp[0] = roundf(temp * 100.0f) / 100.0f;
+            rows[n].temp[1] = NAN;
+            rows[n].temp[2] = NAN;
+            Decoded d = {t, ids[n], {rows[n].temp[0], NAN, NAN}};
+            expect.push_back(d);
+        }
+        w.add(t, rows, 10, file);
+    }
+}
+
+static void assertSame(const std::vector<Decoded> &expect, const std::vector<Decoded> &got)
+{
+    TEST_ASSERT_EQUAL(expect.size(), got.size());
+    for (size_t i = 0; i < expect.size(); i++) {
+        TEST_ASSERT_EQUAL(expect[i].epoch, got[i].epoch);
+        TEST_ASSERT_EQUAL_STRING(expect[i].id.c_str(), got[i].id.c_str());
+        for (int c = 0; c < 3; c++) {
+            if (isnan(expect[i].temp[c])) TEST_ASSERT_TRUE(isnan(got[i].temp[c]));
+            else TEST_ASSERT_EQUAL_FLOAT(expect[i].temp[c], got[i].temp[c]);
+        }
+    }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_round_trip_and_size(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    std::vector<Decoded> expect, got;
+    writeDays(w, 96 * 7, file, expect);
+    TEST_ASSERT_TRUE(decodeAll(file, got));
+    assertSame(expect, got);
+
+    // Against the CSV rows the same data used to take
+    size_t csv = 0;
+    char ts[24], row[96];
+    for (const auto &d : expect) {
+        TempLog::formatTimestamp(d.epoch, ts, sizeof(ts));
+        csv += TempLog::formatRow(ts, d.id, d.temp[0], d.temp[1], d.temp[2], row, sizeof(row));
+    }
+    printf("  %u rows: csv %u bytes, blocks %u bytes (%.1f bytes/row)\n",
+           (unsigned)expect.size(), (unsigned)csv, (unsigned)file.size(),
+           (double)file.size() / expect.size());
+    TEST_ASSERT_TRUE(file.size() * 8 < csv);
+}
+
+void test_blocks_decode_alone(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    std::vector<Decoded> expect;
+    writeDays(w, 300, file, expect);
+    size_t blocks = (file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE;
+    TEST_ASSERT_TRUE(blocks > 3);
+
+    // Any one block, from its own start, yields a run of the rows
+    std::vector<Decoded> got;
+    size_t off = 2 * LOGBLOCK_SIZE;
+    TEST_ASSERT_TRUE(LogBlockReader::decode((const uint8_t *)file.data() + off, LOGBLOCK_SIZE, collect, &got));
+    TEST_ASSERT_TRUE(got.size() > 0);
+    size_t first = 0;
+    while (first < expect.size() && !(expect[first].epoch == got[0].epoch && expect[first].id == got[0].id)) first++;
+    std::vector<Decoded> slice(expect.begin() + first, expect.begin() + first + got.size());
+    assertSame(slice, got);
+
+    // Seeking by time lands on the block holding it
+    uint32_t from = T0 + 200 * LOG_INTERVAL_SECS;
+    size_t k = LogBlockReader::seek(blocks, from, baseOf, &file);
+    TEST_ASSERT_TRUE(baseOf(&file, k) < from);
+    TEST_ASSERT_TRUE(k + 1 == blocks || baseOf(&file, k + 1) >= from);
+    TEST_ASSERT_EQUAL(0, LogBlockReader::seek(blocks, T0, baseOf, &file));
+
+    // Garbage is not a block
+    std::string junk(LOGBLOCK_SIZE, 'x');
+    TEST_ASSERT_FALSE(LogBlockReader::decode((const uint8_t *)junk.data(), junk.size(), collect, &got));
+}
+
+void test_reboot_and_backfill(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    LogRow a[2] = {{T0, "A1B2C3", {4.0f, NAN, -20.5f}}, {T0, "B2C3D4", {3.5f, NAN, NAN}}};
+    w.add(T0, a, 2, file);
+    TEST_ASSERT_TRUE(file.size() < LOGBLOCK_SIZE);
+
+    // After a reboot the partial block is closed and a new one begun
+    LogBlockWriter w2;
+    w2.begin(file.size());
+    LogRow late[1] = {{T0 - 3 * LOG_INTERVAL_SECS, "C3D4E5", {-18.0f, NAN, NAN}}};
+    LogRow b[1] = {{T0 + LOG_INTERVAL_SECS, "A1B2C3", {4.25f, NAN, -20.0f}}};
+    w2.add(late[0].epoch, late, 1, file);
+    w2.add(b[0].epoch, b, 1, file);
+    TEST_ASSERT_TRUE(file.size() > LOGBLOCK_SIZE);
+
+    std::vector<Decoded> got;
+    TEST_ASSERT_TRUE(decodeAll(file, got));
+    TEST_ASSERT_EQUAL(4, got.size());
+    TEST_ASSERT_EQUAL_FLOAT(-20.5f, got[0].temp[2]);
+    TEST_ASSERT_EQUAL(T0 - 3 * LOG_INTERVAL_SECS, got[2].epoch);
+    TEST_ASSERT_EQUAL_STRING("C3D4E5", got[2].id.c_str());
+    TEST_ASSERT_EQUAL(T0 + LOG_INTERVAL_SECS, got[3].epoch);
+    TEST_ASSERT_EQUAL_FLOAT(4.25f, got[3].temp[0]);
+    TEST_ASSERT_TRUE(isnan(got[3].temp[1]));
+}
+
+// Rows at or after from, starting at the block seek() picks
+static void readFrom(const std::string &file, uint32_t from, std::vector<Decoded> &out)
+{
+    size_t blocks = (file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE;
+    std::vector<Decoded> all;
+    for (size_t k = LogBlockReader::seek(blocks, from, baseOf, (void *)&file); k < blocks; k++) {
+        size_t off = k * LOGBLOCK_SIZE;
+        size_t len = file.size() - off < LOGBLOCK_SIZE ? file.size() - off : LOGBLOCK_SIZE;
+        LogBlockReader::decode((const uint8_t *)file.data() + off, len, collect, &all);
+    }
+    for (const auto &d : all) {
+        if (d.epoch >= from) out.push_back(d);
+    }
+}
+
+void test_seek_past_backfill_block(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    std::vector<Decoded> expect;
+    writeDays(w, 40, file, expect);
+
+    // A day of one peer's samples arrives after an outage, too many for
+    // the open block; the block it opens must not claim an older base
+    std::vector<LogRow> late;
+    for (int s = 0; s < 96; s++) {
+        LogRow r = {T0 - (96 - s) * LOG_INTERVAL_SECS, "E6F1A2", {-17.5f + (s % 5) * 0.25f, NAN, NAN}};
+        late.push_back(r);
+    }
+    size_t before = file.size();
+    for (size_t i = 0; i < late.size(); i++) {
+        w.add(late[i].epoch, &late[i], 1, file);
+        Decoded d = {late[i].epoch, late[i].id, {late[i].temp[0], NAN, NAN}};
+        expect.push_back(d);
+    }
+    TEST_ASSERT_TRUE(file.size() / LOGBLOCK_SIZE > before / LOGBLOCK_SIZE);
+    uint32_t newest = T0 + 39 * LOG_INTERVAL_SECS;
+    size_t blocks = (file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE;
+    for (size_t k = 1; k < blocks; k++) TEST_ASSERT_TRUE(baseOf(&file, k) >= baseOf(&file, k - 1));
+
+    std::vector<Decoded> all;
+    TEST_ASSERT_TRUE(decodeAll(file, all));
+    assertSame(expect, all);
+
+    // Every starting point returns every row at or after it
+    for (uint32_t from = T0 - 97 * LOG_INTERVAL_SECS; from <= newest + 1; from += LOG_INTERVAL_SECS / 3) {
+        std::vector<Decoded> want, got;
+        for (const auto &d : all) {
+            if (d.epoch >= from) want.push_back(d);
+        }
+        readFrom(file, from, got);
+        TEST_ASSERT_EQUAL(want.size(), got.size());
+    }
+}
+
+static size_t readBlock(void *ctx, size_t block, uint8_t *buf)
+{
+    const std::string &file = *(const std::string *)ctx;
+    size_t off = block * LOGBLOCK_SIZE;
+    size_t len = file.size() - off < LOGBLOCK_SIZE ? file.size() - off : LOGBLOCK_SIZE;
+    memcpy(buf, file.data() + off, len);
+    return len;
+}
+
+static LogBlockMerger merger;   // about 5 KB
+
+static void merged(const std::string &file, uint32_t from, std::vector<Decoded> &out)
+{
+    merger.begin((file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE, from, readBlock, (void *)&file);
+    LogRow r;
+    while (merger.next(r)) collect(&out, r);
+}
+
+// The rows of a file from 'from' on, in time order, ties in file order
+static void sorted(const std::string &file, uint32_t from, std::vector<Decoded> &out)
+{
+    std::vector<Decoded> all;
+    TEST_ASSERT_TRUE(decodeAll(file, all));
+    for (const auto &d : all) {
+        if (d.epoch >= from) out.push_back(d);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const Decoded &a, const Decoded &b) { return a.epoch < b.epoch; });
+}
+
+static void add(LogBlockWriter &w, const std::vector<LogRow> &rows, std::string &file)
+{
+    for (size_t i = 0, j; i < rows.size(); i = j) {
+        for (j = i + 1; j < rows.size() && rows[j].epoch == rows[i].epoch; j++) {}
+        w.add(rows[i].epoch, &rows[i], j - i, file);
+    }
+}
+
+void test_merge_backfill_in_time_order(void)
+{
+    static const char *ids[] = {"A1B2C3", "B2C3D4", "C3D4E5", "D4E5F6", "E5F6A1",
+                                "F6A1B2", "A2B3C4", "B3C4D5", "C4D5E6", "D5E6F1"};
+    // Node, first slot missed, slots missed; backfilled the slot after it
+    // is back, ahead of that slot's rows, as KicNode writes it
+    static const int outages[][3] = {
+        {3, 20, 4}, {5, 30, 80}, {6, 30, 80}, {1, 150, 1}, {2, 151, 2},
+        {7, 190, 90}, {0, 210, 3}, {4, 212, 1}, {9, 250, 30},
+    };
+    const int slots = 3 * 96;
+    LogBlockWriter w;
+    std::string file;
+    for (int s = 0; s < slots; s++) {
+        std::vector<LogRow> rows;
+        for (const auto &o : outages) {
+            if (s != o[1] + o[2] + 1) continue;
+            for (int k = o[1]; k < o[1] + o[2]; k++) {
+                LogRow r = {T0 + k * LOG_INTERVAL_SECS, ids[o[0]], {-18.0f + (k % 7) * 0.25f, NAN, NAN}};
+                rows.push_back(r);
+            }
+        }
+        std::stable_sort(rows.begin(), rows.end(),
+                         [](const LogRow &a, const LogRow &b) { return a.epoch < b.epoch; });
+        uint32_t t = T0 + s * LOG_INTERVAL_SECS + (s % 3);
+        for (int n = 0; n < 10; n++) {
+            bool out = false;
+            for (const auto &o : outages) out = out || (o[0] == n && s >= o[1] && s < o[1] + o[2]);
+            if (out) continue;
+            LogRow r = {t, ids[n], {-18.0f + ((s + n) % 9) * 0.125f, NAN, 2.5f}};
+            rows.push_back(r);
+        }
+        add(w, rows, file);
+    }
+    TEST_ASSERT_TRUE(file.size() > 10 * LOGBLOCK_SIZE);
+
+    std::vector<Decoded> want, got;
+    TEST_ASSERT_TRUE(decodeAll(file, got));
+    sorted(file, 0, want);
+    TEST_ASSERT_FALSE(std::equal(want.begin(), want.end(), got.begin(),
+                                 [](const Decoded &a, const Decoded &b) { return a.epoch == b.epoch; }));
+    got.clear();
+    TEST_ASSERT_EQUAL(slots * 10, want.size());
+    merged(file, 0, got);
+    assertSame(want, got);
+
+    // From any point: every row at or after it, still in time order
+    for (uint32_t from = T0 - 1; from < T0 + slots * LOG_INTERVAL_SECS; from += 7 * LOG_INTERVAL_SECS + 1) {
+        want.clear();
+        got.clear();
+        sorted(file, from, want);
+        merged(file, from, got);
+        assertSame(want, got);
+    }
+}
+
+void test_merge_more_runs_than_it_follows(void)
+{
+    // Far more interleaved late rows than LOGBLOCK_MERGE_RUNS within the
+    // look-ahead: every row still comes out exactly once
+    LogBlockWriter w;
+    std::string file;
+    for (int s = 0; s < 4 * 96; s++) {
+        uint32_t t = T0 + s * LOG_INTERVAL_SECS;
+        for (int k = 0; k < 6; k++) {
+            LogRow live = {t, "A1B2C3", {-18.0f, NAN, NAN}};
+            LogRow late = {t - 3600 - k, "B2C3D4", {-17.0f + k * 0.5f, NAN, NAN}};
+            w.add(live.epoch, &live, 1, file);
+            w.add(late.epoch, &late, 1, file);
+        }
+    }
+    std::vector<Decoded> want, got;
+    sorted(file, 0, want);
+    merged(file, 0, got);
+    TEST_ASSERT_EQUAL(want.size(), got.size());
+    std::vector<std::pair<uint32_t, std::string> > a, b;
+    for (const auto &d : want) a.push_back(std::make_pair(d.epoch, d.id));
+    for (const auto &d : got) b.push_back(std::make_pair(d.epoch, d.id));
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    TEST_ASSERT_TRUE(a == b);
+}
+
+// Bases never go down, and seek() finds every row from any point on
+static void assertSeekable(const std::string &file, uint32_t first, uint32_t last)
+{
+    size_t blocks = (file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE;
+    for (size_t k = 1; k < blocks; k++) TEST_ASSERT_TRUE(baseOf((void *)&file, k) >= baseOf((void *)&file, k - 1));
+    std::vector<Decoded> all;
+    TEST_ASSERT_TRUE(decodeAll(file, all));
+    for (uint32_t from = first; from <= last + 1; from += LOG_INTERVAL_SECS / 3) {
+        size_t want = 0;
+        for (const auto &d : all) want += d.epoch >= from;
+        std::vector<Decoded> got;
+        readFrom(file, from, got);
+        TEST_ASSERT_EQUAL(want, got.size());
+    }
+}
+
+void test_reboot_keeps_newest(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    std::vector<Decoded> expect;
+    writeDays(w, 40, file, expect);
+    TEST_ASSERT_TRUE(file.size() % LOGBLOCK_SIZE != 0);
+
+    // The new writer reads the newest epoch back from the last block, so
+    // the block an older row opens (backfill, or an RTC that lost time)
+    // still takes the newest as its base
+    LogBlockWriter w2;
+    size_t off = (file.size() - 1) / LOGBLOCK_SIZE * LOGBLOCK_SIZE;
+    w2.begin(file.size(), (const uint8_t *)file.data() + off, file.size() - off);
+    TEST_ASSERT_EQUAL(w.latest(), w2.latest());
+    std::vector<LogRow> rows;
+    for (int s = 0; s < 40; s++) {
+        LogRow r = {T0 - 86400 + s * LOG_INTERVAL_SECS, "A1B2C3", {-18.0f, NAN, NAN}};
+        rows.push_back(r);
+    }
+    add(w2, rows, file);
+    TEST_ASSERT_EQUAL(w.latest(), w2.latest());
+    TEST_ASSERT_EQUAL(w.latest(), baseOf(&file, off / LOGBLOCK_SIZE + 1));
+    assertSeekable(file, T0 - 86400 - 1, w.latest());
+
+    // A fresh file has nothing to read back
+    LogBlockWriter w3;
+    w3.begin(0);
+    TEST_ASSERT_EQUAL(0, w3.latest());
+}
+
+void test_clock_set_back(void)
+{
+    LogBlockWriter w;
+    std::string file;
+    std::vector<Decoded> expect;
+    writeDays(w, 40, file, expect);
+    uint32_t newest = w.latest();
+
+    // Two days back: the blocks written after it keep the old newest as
+    // their base until the clock passes it again
+    std::vector<LogRow> rows;
+    for (int s = 0; s < 200; s++) {
+        LogRow r = {T0 - 2 * 86400 + s * LOG_INTERVAL_SECS, "B2C3D4", {-17.0f + (s % 4) * 0.5f, NAN, NAN}};
+        rows.push_back(r);
+    }
+    size_t blocks = (file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE;
+    add(w, rows, file);
+    TEST_ASSERT_TRUE((file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE > blocks + 1);
+    TEST_ASSERT_EQUAL(newest, w.latest());
+    TEST_ASSERT_EQUAL(newest, baseOf(&file, blocks));
+    assertSeekable(file, T0 - 2 * 86400 - 1, newest);
+
+    // Every row comes out of the merger once
+    std::vector<Decoded> want, got;
+    sorted(file, 0, want);
+    merged(file, 0, got);
+    TEST_ASSERT_EQUAL(want.size(), got.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_and_size);
+    RUN_TEST(test_blocks_decode_alone);
+    RUN_TEST(test_reboot_and_backfill);
+    RUN_TEST(test_seek_past_backfill_block);
+    RUN_TEST(test_merge_backfill_in_time_order);
+    RUN_TEST(test_merge_more_runs_than_it_follows);
+    RUN_TEST(test_reboot_keeps_newest);
+    RUN_TEST(test_clock_set_back);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "../FakeHal.h"
+#include "LogStage.h"
+#include "LogBlock.h"
+#include "TempLog.h"
+
+static LogStageArea area;
+
+// One quarter-hour log append for ten nodes, as KicNode writes it
+static void logSlot(LogBlockWriter &w, uint32_t t, int s, std::string &out)
+{
+    static const char *ids[] = {"A1B2C3", "B2C3D4", "C3D4E5", "D4E5F6", "E5F6A1",
+                                "F6A1B2", "A2B3C4", "B3C4D5", "C4D5E6", "D5E6F1"};
+    LogRow rows[10];
+    for (int n = 0; n < 10; n++) {
+        rows[n].epoch = t;
+        rows[n].id = ids[n];
+        rows[n].temp[0] = -18.0f + ((s * 7 + n * 3) % 11) * 0.06f;
+        rows[n].temp[1] = NAN;
+        rows[n].temp[2] = NAN;
+    }
+    w.add(t, rows, 10, out);
+}
+
+static std::string logical(const FakeLog &flash, const StagedLogStore &st)
+{
+    return flash.data + std::string((const char *)st.staged(), st.stagedBytes());
+}
+
+void setUp(void)
+{
+    // Power-on RTC memory is noise
+    memset(&area, 0xA5, sizeof(area));
+}
+void tearDown(void) {}
+
+void test_day_of_slots_few_writes(void)
+{
+    FakeClock clock;
+    FakeLog flash;
+    StagedLogStore st(area, flash, clock);
+    TEST_ASSERT_EQUAL(0, st.begin(0));
+
+    LogBlockWriter w;
+    std::string expect;
+    for (int s = 0; s < 96; s++) {
+        std::string out;
+        logSlot(w, (uint32_t)clock.now(), s, out);
+        expect += out;
+        size_t before = flash.data.size();
+        TEST_ASSERT_TRUE(st.append(out.data(), out.size()));
+        // A write that leaves bytes staged ends on a block boundary
+        if (flash.data.size() != before && st.stagedBytes()) {
+            TEST_ASSERT_EQUAL(0, flash.data.size() % LOGSTAGE_PAGE);
+        }
+        clock.advance(LOG_INTERVAL_SECS * 1000UL);
+    }
+    TEST_ASSERT_EQUAL(expect.size(), st.size());
+    TEST_ASSERT_TRUE(expect == logical(flash, st));
+    // 96 appends a day became a handful of flash writes
+    printf("  96 appends, %d flash writes, %u bytes staged\n", flash.appends, (unsigned)st.stagedBytes());
+    TEST_ASSERT_TRUE(flash.appends * 10 <= 96);
+    TEST_ASSERT_EQUAL(flash.appends, st.flashWrites());
+
+    // Orderly shutdown
+    TEST_ASSERT_TRUE(st.flush());
+    TEST_ASSERT_EQUAL(0, st.stagedBytes());
+    TEST_ASSERT_TRUE(expect == flash.data);
+}
+
+void test_survives_reset(void)
+{
+    FakeClock clock;
+    FakeLog flash;
+    flash.data = std::string(700, 'x');    // written before this boot
+    StagedLogStore st(area, flash, clock);
+    st.begin(flash.data.size());
+    std::string a(300, 'a');
+    st.append(a.data(), a.size());
+
+    // ESP.restart(): RAM is gone, the area is not
+    {
+        StagedLogStore again(area, flash, clock);
+        TEST_ASSERT_EQUAL(300, again.begin(flash.data.size()));
+        TEST_ASSERT_EQUAL(1000, again.size());
+        TEST_ASSERT_TRUE(std::string(700, 'x') + a == logical(flash, again));
+    }
+
+    // Reset after the flash write but before the area caught up: the
+    // written part is not logged twice
+    LogStageArea before = area;
+    TEST_ASSERT_TRUE(st.flush());
+    area = before;
+    {
+        StagedLogStore again(area, flash, clock);
+        TEST_ASSERT_EQUAL(0, again.begin(flash.data.size()));
+        TEST_ASSERT_EQUAL(1000, again.size());
+        std::string b(10, 'b');
+        again.append(b.data(), b.size());
+        again.flush();
+        TEST_ASSERT_TRUE(std::string(700, 'x') + a + b == flash.data);
+    }
+
+    // A corrupted area, or a log file replaced since, is not replayed
+    st.begin(flash.data.size());
+    st.append(a.data(), a.size());
+    area.data[5] ^= 1;
+    {
+        StagedLogStore again(area, flash, clock);
+        TEST_ASSERT_EQUAL(0, again.begin(flash.data.size()));
+        TEST_ASSERT_EQUAL(flash.data.size(), again.size());
+    }
+    st.begin(flash.data.size());
+    st.append(a.data(), a.size());
+    {
+        StagedLogStore again(area, flash, clock);
+        TEST_ASSERT_EQUAL(0, again.begin(0));
+        TEST_ASSERT_EQUAL(0, again.size());
+    }
+}
+
+void test_age_and_failures(void)
+{
+    FakeClock clock;
+    FakeLog flash;
+    StagedLogStore st(area, flash, clock);
+    st.begin(0);
+
+    // A trickle is written out once its oldest byte is old enough
+    std::string row(20, 'r');
+    uint32_t appends = 0;
+    while (flash.appends == 0) {
+        st.append(row.data(), row.size());
+        appends++;
+        clock.advance(LOG_INTERVAL_SECS * 1000UL);
+    }
+    TEST_ASSERT_EQUAL(LOGSTAGE_MAX_AGE_SECS / LOG_INTERVAL_SECS + 1, appends);
+    TEST_ASSERT_EQUAL(0, st.stagedBytes());
+
+    // Flash failing: the buffer holds what it can, then refuses
+    flash.fail = true;
+    size_t fits = LOGSTAGE_BYTES / row.size();
+    for (size_t i = 0; i < fits; i++) TEST_ASSERT_TRUE(st.append(row.data(), row.size()));
+    TEST_ASSERT_FALSE(st.append(row.data(), row.size()));
+    flash.fail = false;
+    TEST_ASSERT_TRUE(st.append(row.data(), row.size()));
+    TEST_ASSERT_EQUAL(row.size() * (appends + fits + 1), st.size());
+
+    // Larger than the buffer goes straight to flash
+    st.flush();
+    std::string big(LOGSTAGE_BYTES + 1, 'B');
+    TEST_ASSERT_TRUE(st.append(big.data(), big.size()));
+    TEST_ASSERT_EQUAL(0, st.stagedBytes());
+    TEST_ASSERT_EQUAL(flash.data.size(), st.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_day_of_slots_few_writes);
+    RUN_TEST(test_survives_reset);
+    RUN_TEST(test_age_and_failures);
+    return UNITY_END();
+}
@@ -0,0 +1,57 @@
+#include <unity.h>
+#include <string>
+#include "Metrics.h"
+
+static void appendTo(void *ctx, const char *text, size_t len)
+{
+    static_cast<std::string *>(ctx)->append(text, len);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_histogram_buckets(void)
+{
+    Metrics m;
+    m.record(MetricTimer::Loop, 50);        // <= 100us
+    m.record(MetricTimer::Loop, 100);       // boundary is inclusive
+    m.record(MetricTimer::Loop, 3000);      // <= 5ms
+    m.record(MetricTimer::Loop, 5000000);   // +Inf
+    const Histogram &h = m.histogram(MetricTimer::Loop);
+    TEST_ASSERT_EQUAL(2, h.buckets[0]);
+    TEST_ASSERT_EQUAL(1, h.buckets[5]);
+    TEST_ASSERT_EQUAL(1, h.buckets[METRICS_BUCKETS]);
+    TEST_ASSERT_EQUAL(4, h.count);
+    TEST_ASSERT_EQUAL(5000000, h.maxUs);
+    TEST_ASSERT_EQUAL(5003150, (uint32_t)h.sumUs);
+}
+
+void test_render_prometheus(void)
+{
+    Metrics m;
+    m.record(MetricTimer::RadioTx, 200);
+    m.record(MetricTimer::RadioTx, 1500000);
+    m.count(MetricCounter::RxCrcErrors, 3);
+    m.set(MetricGauge::HeapFree, 123456);
+
+    std::string text;
+    m.render(appendTo, &text);
+    TEST_ASSERT_TRUE(text.find("# TYPE kic_radio_tx_seconds histogram\n") != std::string::npos);
+    // buckets are cumulative
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_bucket{le=\"0.0001\"} 0\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_bucket{le=\"0.00025\"} 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_bucket{le=\"1\"} 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_bucket{le=\"+Inf\"} 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_sum 1.500200\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_tx_seconds_count 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_radio_rx_crc_errors_total 3\n") != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("kic_heap_free_bytes 123456\n") != std::string::npos);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_histogram_buckets);
+    RUN_TEST(test_render_prometheus);
+    return UNITY_END();
+}
@@ -0,0 +1,814 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../FakeHal.h"
+#include "KicNode.h"
+#include "TempLog.h"
+
+void setUp(void)
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+}
+void tearDown(void) {}
+
+void test_roster(void)
+{
+    Roster r;
+    r.set("AAAAAA");
+    TEST_ASSERT_TRUE(r.add("BBBBBB"));
+    TEST_ASSERT_FALSE(r.add("BBBBBB"));
+    TEST_ASSERT_FALSE(r.contains("BBBB"));
+    TEST_ASSERT_EQUAL_STRING("AAAAAA,BBBBBB", r.str().c_str());
+    TEST_ASSERT_EQUAL(2, r.ids().size());
+}
+
+void test_node_table_update(void)
+{
+    NodeTable t;
+    TEST_ASSERT_TRUE(t.update("AAAAAA", 1, 2, 3, 100, false));
+    TEST_ASSERT_FALSE(t.update("AAAAAA", 4, 5, 6, 200, true));
+    TEST_ASSERT_EQUAL(1, t.size());
+    const NodeTemp *n = t.find("AAAAAA");
+    TEST_ASSERT_NOT_NULL(n);
+    TEST_ASSERT_EQUAL_FLOAT(4, n->temp1);
+    TEST_ASSERT_EQUAL(200, n->lastUpdate);
+    TEST_ASSERT_NULL(t.find("BBBBBB"));
+}
+
+void test_alarm_node_down(void)
+{
+    Roster r;
+    r.set("AAAAAA,BBBBBB,CCCCCC");
+    NodeTable t;
+    t.update("AAAAAA", 1, NAN, NAN, 1000, false);
+    t.update("BBBBBB", 1, NAN, NAN, 1000 - NODE_DOWN_SECS, false);
+    AlarmStatus s;
+    Alarms::evaluate(r, t, "AAAAAA", 1000, NODE_DOWN_SECS, false, false, s);
+    TEST_ASSERT_EQUAL(2, s.downNodes.size());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", s.downNodes[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("CCCCCC", s.downNodes[1].c_str());
+    TEST_ASSERT_TRUE(s.active());
+}
+
+void test_daytime(void)
+{
+    TEST_ASSERT_TRUE(Alarms::isDaytime(1757599200));    // 14:00
+    TEST_ASSERT_FALSE(Alarms::isDaytime(1757566800));   // 05:00
+}
+
+void test_next_log_epoch(void)
+{
+    TEST_ASSERT_EQUAL(1757599200 + 900, TempLog::nextLogEpoch(1757599200));
+    TEST_ASSERT_EQUAL(1757599200 + 900, TempLog::nextLogEpoch(1757599200 + 1));
+    TEST_ASSERT_EQUAL(1757599200 + 3600, TempLog::nextLogEpoch(1757599200 + 2700 + 59));
+}
+
+void test_log_row(void)
+{
+    char ts[24], row[96];
+    TempLog::formatTimestamp(1757599200, ts, sizeof(ts));
+    TEST_ASSERT_EQUAL_STRING("09/11/2025 14:00:00", ts);
+    TempLog::formatRow(ts, "AAAAAA", 4.5f, NAN, -20, row, sizeof(row));
+    TEST_ASSERT_EQUAL_STRING("09/11/2025 14:00:00,AAAAAA,4.50,nan,-20.00\n", row);
+}
+
+struct Rig {
+    FakeClock clock;
+    FakeRadio radio;
+    FakeStore prefs;
+    FakeLog log;
+    FakeSensor sensor;
+    KicNode node;
+    Rig() : node(clock, radio, prefs, log, sensor) {}
+};
+
+// Two sensor reads, so the median filter passes a step in the reading
+static void settle(Rig &r)
+{
+    for (int i = 0; i < 2; i++) {
+        r.clock.advance(SENSOR_INTERVAL_MS + 1);
+        r.node.loop();
+    }
+}
+
+void test_node_sends_and_peer_receives(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", false, "bowman#1");
+
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    LoopEvents ev = a.node.loop();
+    TEST_ASSERT_TRUE(ev.sensorRead);
+    TEST_ASSERT_FALSE(ev.sent);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, a.node.myTemp());
+
+    a.clock.advance(SEND_INTERVAL_MS + SEND_JITTER_MS);
+    ev = a.node.loop();
+    TEST_ASSERT_TRUE(ev.sent);
+    TEST_ASSERT_EQUAL(1, a.radio.sent.size());
+
+    const std::vector<uint8_t> &frame = a.radio.sent[0];
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(frame.data(), frame.size()));
+    const NodeTemp *n = b.node.table().find("AAAAAA");
+    TEST_ASSERT_NOT_NULL(n);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, n->temp1);
+    // B has no RTC, so it takes A's time
+    TEST_ASSERT_EQUAL(n->lastUpdate, b.clock.now());
+
+    TEST_ASSERT_EQUAL(RxResult::Own, a.node.onRadioFrame(frame.data(), frame.size()));
+}
+
+void test_join_reports_at_once(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", false, "bowman#1");
+    a.sensor.value = -18.5f;
+
+    // One quick conversion, and a reading to report straight away
+    a.node.join();
+    TEST_ASSERT_EQUAL(1, a.sensor.conversions);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_STABLE, a.sensor.convertedBits);
+    TEST_ASSERT_EQUAL_FLOAT(-18.5f, a.node.myTemp());
+    TEST_ASSERT_FALSE(a.node.loop().sent);
+    a.clock.advance(JOIN_JITTER_MS);
+    LoopEvents ev = a.node.loop();
+    TEST_ASSERT_TRUE(ev.sent);
+    TEST_ASSERT_FALSE(ev.sensorRead);
+    TEST_ASSERT_EQUAL(1, a.radio.sent.size());
+    const std::vector<uint8_t> &frame = a.radio.sent[0];
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(frame.data(), frame.size()));
+    TEST_ASSERT_EQUAL_FLOAT(-18.5f, b.node.table().find("AAAAAA")->temp1);
+
+    // Then full resolution and the usual report interval
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    TEST_ASSERT_TRUE(a.node.loop().sensorRead);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_FINE, a.sensor.convertedBits);
+    a.clock.advance(SEND_INTERVAL_MS - SENSOR_INTERVAL_MS - 1);
+    TEST_ASSERT_FALSE(a.node.loop().sent);
+    a.clock.advance(SEND_JITTER_MS);
+    TEST_ASSERT_TRUE(a.node.loop().sent);
+}
+
+void test_no_alarm_before_first_report(void)
+{
+    Rig a;
+    a.prefs.strings["nodelist"] = "AAAAAA,BBBBBB,CCCCCC";
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.join();
+    AlarmStatus s;
+    a.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(0, s.downNodes.size());
+    TEST_ASSERT_FALSE(s.active());
+    a.clock.advance(JOIN_JITTER_MS);
+    TEST_ASSERT_TRUE(a.node.loop().sent);
+    a.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(0, s.downNodes.size());
+
+    // Peers never heard at all are down once the grace has passed
+    a.clock.advance(NODE_DOWN_SECS * 1000UL);
+    a.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(2, s.downNodes.size());
+    // Not heard since boot is not "went down": no ALARM on air
+    a.node.loop();
+    TEST_ASSERT_EQUAL(0, a.node.metrics().get(MetricCounter::ReliableSent));
+}
+
+void test_wrong_key_rejected(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", false, "other");
+    a.node.broadcastKIC();
+    const std::vector<uint8_t> &frame = a.radio.sent[0];
+    RxResult res = b.node.onRadioFrame(frame.data(), frame.size());
+    TEST_ASSERT_TRUE(res != RxResult::Handled);
+    TEST_ASSERT_NULL(b.node.table().find("AAAAAA"));
+}
+
+void test_radio_counters(void)
+{
+    Rig a, b, c;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    c.node.begin("CCCCCC", true, "other");
+    a.node.broadcastKIC();
+    a.radio.status = -5;
+    a.node.broadcastKIC();
+    const std::vector<uint8_t> &frame = a.radio.sent[0];
+    b.node.onRadioFrame(frame.data(), frame.size());
+    c.node.onRadioFrame(frame.data(), frame.size());
+    a.node.onRadioFrame(frame.data(), frame.size());
+
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::TxFrames));
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::TxFailed));
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::RxOwn));
+    TEST_ASSERT_EQUAL(1, b.node.metrics().get(MetricCounter::RxFrames));
+    TEST_ASSERT_EQUAL(1, b.node.metrics().histogram(MetricTimer::RadioRx).count);
+    // CBC has no MAC: about one wrong-key frame in 16 passes the padding
+    // check and is then dropped by the parser instead
+    const Metrics &cm = c.node.metrics();
+    TEST_ASSERT_EQUAL(1, cm.get(MetricCounter::RxDecryptFailed) + cm.get(MetricCounter::RxUnknown));
+    TEST_ASSERT_EQUAL(cm.get(MetricCounter::RxUnknown), cm.get(MetricCounter::RxFrames));
+    TEST_ASSERT_NULL(c.node.table().find("AAAAAA"));
+}
+
+void test_gateway_records(void)
+{
+    Rig a, b;
+    GatewayStream gw;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    b.node.setGateway(&gw);
+
+    // B's own read, then A's report with its link quality
+    b.clock.advance(SENSOR_INTERVAL_MS + 1);
+    b.node.loop();
+    a.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent[0].data(), a.radio.sent[0].size(), -101.5f, 4.0f);
+
+    uint8_t buf[4 * GATEWAY_FRAME_MAX];
+    size_t n = gw.drain(buf, sizeof(buf));
+    GatewayReader reader;
+    GatewayRecord recs[2];
+    int count = 0;
+    for (size_t i = 0; i < n && count < 2; i++) {
+        if (reader.feed(buf[i], recs[count]) == GatewayReader::Record) count++;
+    }
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL(GatewayKind::Local, recs[0].kind);
+    TEST_ASSERT_EQUAL(0, memcmp("BBBBBB", recs[0].id, GATEWAY_ID_LEN));
+    TEST_ASSERT_EQUAL(400, recs[0].temp[0]);
+    TEST_ASSERT_EQUAL(GatewayKind::Report, recs[1].kind);
+    TEST_ASSERT_EQUAL(0, memcmp("AAAAAA", recs[1].id, GATEWAY_ID_LEN));
+    TEST_ASSERT_EQUAL(-1015, recs[1].rssi);
+    TEST_ASSERT_EQUAL(40, recs[1].snr);
+    TEST_ASSERT_EQUAL(2, b.node.metrics().get(MetricCounter::GatewayRecords));
+}
+
+void test_adaptive_rate(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    a.node.addNode("BBBBBB");
+    b.node.addNode("AAAAAA");
+    a.node.setAdaptiveRate(true);
+    b.node.setAdaptiveRate(true);
+    TEST_ASSERT_EQUAL(0, b.radio.sf);   // nothing saved: stays at setupLoRa()'s rate
+
+    // Strong link both ways for longer than the hold time
+    for (int i = 0; i < 30; i++) {
+        a.clock.advance(SEND_INTERVAL_MS + SEND_JITTER_MS);
+        b.clock.advance(SEND_INTERVAL_MS + SEND_JITTER_MS);
+        a.node.broadcastKIC();
+        b.node.broadcastKIC();
+        b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size(), -50.0f, 10.0f);
+        a.node.onRadioFrame(b.radio.sent.back().data(), b.radio.sent.back().size(), -50.0f, 10.0f);
+        a.node.loop();
+        b.node.loop();
+    }
+    TEST_ASSERT_EQUAL(ADR_MIN_SF, b.radio.sf);
+    TEST_ASSERT_EQUAL(ADR_MIN_DBM, b.radio.dbm);
+    TEST_ASSERT_EQUAL(ADR_MIN_SF, b.node.linkAdapt().find("AAAAAA")->wantSf);
+
+    // A reboot resumes on the saved SF
+    TEST_ASSERT_EQUAL(ADR_MIN_SF, b.prefs.ulongs["loraSf"]);
+    KicNode again(b.clock, b.radio, b.prefs, b.log, b.sensor);
+    b.radio.sf = 0;
+    again.begin("BBBBBB", true, "bowman#1");
+    again.setAdaptiveRate(true);
+    TEST_ASSERT_EQUAL(ADR_MIN_SF, b.radio.sf);
+    TEST_ASSERT_EQUAL(ADR_MAX_DBM, b.radio.dbm);
+}
+
+void test_nodelist_persisted(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    TEST_ASSERT_TRUE(a.node.addNode("BBBBBB"));
+    a.node.broadcastNodeList();
+    const std::vector<uint8_t> &frame = a.radio.sent[0];
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(frame.data(), frame.size()));
+    TEST_ASSERT_EQUAL_STRING("AAAAAA,BBBBBB", b.prefs.strings["nodelist"].c_str());
+}
+
+void test_node_id_change(void)
+{
+    Rig a, b;
+    a.prefs.strings["nodelist"] = "AAAAAA,BBBBBB";
+    b.prefs.strings["nodelist"] = "AAAAAA,BBBBBB";
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    settle(a);
+
+    TEST_ASSERT_TRUE(a.node.setNodeId("DDDDDD"));
+    TEST_ASSERT_FALSE(a.node.setNodeId("DDDDDD"));
+    TEST_ASSERT_EQUAL_STRING("DDDDDD,BBBBBB", a.prefs.strings["nodelist"].c_str());
+    TEST_ASSERT_NULL(a.node.table().find("AAAAAA"));
+    TEST_ASSERT_NOT_NULL(a.node.table().find("DDDDDD"));
+    a.node.broadcastNodeList();
+    const std::vector<uint8_t> &frame = a.radio.sent.back();
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(frame.data(), frame.size()));
+    TEST_ASSERT_EQUAL_STRING("DDDDDD,BBBBBB", b.node.roster().str().c_str());
+
+    // The old ID is not a peer that went quiet
+    for (uint32_t t = 0; t <= NODE_DOWN_SECS * 1000UL + SENSOR_INTERVAL_MS; t += SENSOR_INTERVAL_MS) {
+        a.clock.advance(SENSOR_INTERVAL_MS);
+        a.node.loop();
+    }
+    AlarmStatus s;
+    a.node.evaluateAlarms(s);
+    for (const auto &d : s.downNodes) TEST_ASSERT_NOT_EQUAL(0, d.compare("AAAAAA"));
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableSent));
+}
+
+void test_alarm_acked(void)
+{
+    Rig a, b, c;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    c.node.begin("CCCCCC", true, "bowman#1");
+    a.node.setNodeList("AAAAAA,BBBBBB,CCCCCC");
+    b.node.setNodeList("AAAAAA,BBBBBB,CCCCCC");
+    a.node.broadcastKIC();
+    c.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    a.node.onRadioFrame(c.radio.sent.back().data(), c.radio.sent.back().size());
+    b.node.onRadioFrame(c.radio.sent.back().data(), c.radio.sent.back().size());
+
+    // A loses C but still hears B; B still hears C. A's ALARM waits out
+    // its hold-off.
+    a.clock.advance(NODE_DOWN_SECS * 1000UL + SENSOR_INTERVAL_MS);
+    a.node.table().update("BBBBBB", 4.0f, NAN, NAN, a.clock.now(), true);
+    a.node.loop();
+    TEST_ASSERT_EQUAL(0, a.node.metrics().get(MetricCounter::ReliableSent));
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    size_t before = a.radio.sent.size();
+    a.node.loop();
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableSent));
+    TEST_ASSERT_EQUAL(1, a.node.reliableOutbox().size());
+    TEST_ASSERT_EQUAL(1, a.node.reliableOutbox().pending()[0].waiting.size());
+    TEST_ASSERT_TRUE(a.radio.sent.size() > before);
+
+    // The first ALARM is lost; the retry gets through
+    a.clock.advance(REL_RETRY_MS + REL_RETRY_JITTER_MS);
+    a.node.loop();
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableRetries));
+    const std::vector<uint8_t> retry = a.radio.sent.back();
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(retry.data(), retry.size()));
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(retry.data(), retry.size()));
+    AlarmStatus s;
+    b.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(0, s.downNodes.size());
+    TEST_ASSERT_EQUAL(1, s.reportedDown.size());
+    TEST_ASSERT_EQUAL_STRING("CCCCCC", s.reportedDown[0].c_str());
+    // Nor does B repeat the ALARM itself
+    TEST_ASSERT_EQUAL(0, b.node.metrics().get(MetricCounter::ReliableSent));
+
+    // B's next report carries the ack
+    size_t bSent = b.radio.sent.size();
+    b.clock.advance(SEND_INTERVAL_MS + SEND_JITTER_MS);
+    LoopEvents ev = b.node.loop();
+    TEST_ASSERT_TRUE(ev.sent);
+    TEST_ASSERT_EQUAL(bSent + 1, b.radio.sent.size());
+    a.node.onRadioFrame(b.radio.sent.back().data(), b.radio.sent.back().size());
+    TEST_ASSERT_EQUAL(0, a.node.reliableOutbox().size());
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableAcked));
+
+    // Hearing C clears the peer's report
+    c.node.broadcastKIC();
+    b.node.onRadioFrame(c.radio.sent.back().data(), c.radio.sent.back().size());
+    b.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(0, s.reportedDown.size());
+}
+
+// Keep B on A's table as if its reports kept arriving
+static void hearB(Rig &a)
+{
+    a.node.table().update("BBBBBB", 4.0f, NAN, NAN, a.clock.now(), true);
+}
+
+// C missing for NODE_DOWN_SECS, then A's hold-off runs out
+static void loseC(Rig &a)
+{
+    a.clock.advance(NODE_DOWN_SECS * 1000UL + SENSOR_INTERVAL_MS);
+    hearB(a);
+    a.node.loop();
+    a.clock.advance(ALARM_HOLDOFF_MS + SENSOR_INTERVAL_MS);
+    hearB(a);
+    a.node.loop();
+}
+
+void test_alarm_once_per_hold(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.setNodeList("AAAAAA,BBBBBB,CCCCCC");
+    a.node.table().update("CCCCCC", 4.0f, NAN, NAN, a.clock.now(), true);
+    loseC(a);
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableSent));
+
+    // C flaps back and is lost again: once per hold is enough
+    a.node.table().update("CCCCCC", 4.0f, NAN, NAN, a.clock.now(), true);
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    a.node.loop();
+    loseC(a);
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableSent));
+
+    // Back for good, then lost once the hold has passed: raised again
+    a.clock.advance(ALARM_REPEAT_MS);
+    a.node.table().update("CCCCCC", 4.0f, NAN, NAN, a.clock.now(), true);
+    hearB(a);
+    a.node.loop();
+    loseC(a);
+    TEST_ASSERT_EQUAL(2, a.node.metrics().get(MetricCounter::ReliableSent));
+
+    // A peer's ALARM counts the same as ours, even once the node has been
+    // heard in between
+    Rig b, c, d;
+    b.node.begin("BBBBBB", true, "bowman#1");
+    c.node.begin("CCCCCC", true, "bowman#1");
+    d.node.begin("AAAAAA", true, "bowman#1");
+    b.node.setNodeList("AAAAAA,BBBBBB,CCCCCC");
+    c.node.broadcastAlarm("AAAAAA");
+    b.node.onRadioFrame(c.radio.sent.back().data(), c.radio.sent.back().size());
+    d.node.broadcastKIC();
+    b.node.onRadioFrame(d.radio.sent.back().data(), d.radio.sent.back().size());
+    AlarmStatus s;
+    b.node.evaluateAlarms(s);
+    TEST_ASSERT_EQUAL(0, s.reportedDown.size());
+    b.clock.advance(NODE_DOWN_SECS * 1000UL + SENSOR_INTERVAL_MS);
+    b.node.table().update("CCCCCC", 4.0f, NAN, NAN, b.clock.now(), true);
+    b.node.loop();
+    b.clock.advance(ALARM_HOLDOFF_MS + SENSOR_INTERVAL_MS);
+    b.node.table().update("CCCCCC", 4.0f, NAN, NAN, b.clock.now(), true);
+    b.node.loop();
+    TEST_ASSERT_EQUAL(0, b.node.metrics().get(MetricCounter::ReliableSent));
+}
+
+void test_busy_channel_holds_alarm(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    a.node.setNodeList("AAAAAA,BBBBBB,CCCCCC");
+    a.node.table().update("CCCCCC", 4.0f, NAN, NAN, a.clock.now(), true);
+    b.node.broadcastKIC();
+    const std::vector<uint8_t> report = b.radio.sent.back();
+
+    // Reports filling well over CHANNEL_BUSY_PCT of the last minute
+    a.clock.advance(NODE_DOWN_SECS * 1000UL + SENSOR_INTERVAL_MS);
+    for (int i = 0; i < 40; i++) a.node.onRadioFrame(report.data(), report.size());
+    TEST_ASSERT_TRUE(a.node.channelLoad() >= CHANNEL_BUSY_PCT);
+    hearB(a);
+    a.node.loop();
+    a.clock.advance(ALARM_HOLDOFF_MS + SENSOR_INTERVAL_MS);
+    for (int i = 0; i < 40; i++) a.node.onRadioFrame(report.data(), report.size());
+    hearB(a);
+    a.node.loop();
+    TEST_ASSERT_EQUAL(0, a.node.metrics().get(MetricCounter::ReliableSent));
+
+    // C still missing after the longer wait: raised regardless
+    a.clock.advance(ALARM_BUSY_WAIT_MS);
+    for (int i = 0; i < 40; i++) a.node.onRadioFrame(report.data(), report.size());
+    hearB(a);
+    a.node.loop();
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableSent));
+
+    // No retry while it stays busy
+    size_t sent = a.radio.sent.size();
+    a.clock.advance(REL_RETRY_MS + REL_RETRY_JITTER_MS);
+    hearB(a);
+    a.node.loop();
+    TEST_ASSERT_EQUAL(0, a.node.metrics().get(MetricCounter::ReliableRetries));
+    TEST_ASSERT_EQUAL(1, a.node.metrics().get(MetricCounter::ReliableHeld));
+    TEST_ASSERT_EQUAL(sent, a.radio.sent.size());
+}
+
+void test_quarter_hour_log(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.table().update("CCCCCC", -20.0f, NAN, NAN, a.clock.now(), false);
+    a.node.loop();   // schedules first log
+    TEST_ASSERT_EQUAL(1757599200 + 900, a.node.nextLogEpoch());
+    a.clock.epoch += 900;
+    // B reported just now; C has been silent since the start, so its
+    // last value is stale and left for backfill
+    a.node.table().update("BBBBBB", -18.0f, NAN, NAN, a.clock.now(), false);
+    LoopEvents ev = a.node.loop();
+    TEST_ASSERT_TRUE(ev.logged);
+    TEST_ASSERT_EQUAL_STRING("09/11/2025 14:15:00,AAAAAA,4.00,nan,nan\n"
+                             "09/11/2025 14:15:00,BBBBBB,-18.00,nan,nan\n",
+                             a.log.data.c_str());
+}
+
+static void csvRow(void *ctx, const LogRow &r)
+{
+    char ts[24], row[96];
+    TempLog::formatTimestamp(r.epoch, ts, sizeof(ts));
+    ((std::string *)ctx)->append(row, TempLog::formatRow(ts, r.id, r.temp[0], r.temp[1], r.temp[2],
+                                                         row, sizeof(row)));
+}
+
+void test_log_blocks(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.setLogFormat(LogFormat::Blocks, 0);
+    a.node.loop();
+    a.clock.epoch += 900;
+    a.node.table().update("BBBBBB", -18.0f, NAN, NAN, a.clock.now(), false);
+    TEST_ASSERT_TRUE(a.node.loop().logged);
+    a.clock.epoch += 900;
+    a.node.table().update("BBBBBB", -18.5f, NAN, NAN, a.clock.now(), false);
+    TEST_ASSERT_TRUE(a.node.loop().logged);
+    TEST_ASSERT_TRUE(a.log.data.size() < 50);   // 160 bytes as CSV
+
+    std::string csv;
+    TEST_ASSERT_TRUE(LogBlockReader::decode((const uint8_t *)a.log.data.data(), a.log.data.size(),
+                                            csvRow, &csv));
+    TEST_ASSERT_EQUAL_STRING("09/11/2025 14:15:00,AAAAAA,4.00,nan,nan\n"
+                             "09/11/2025 14:15:00,BBBBBB,-18.00,nan,nan\n"
+                             "09/11/2025 14:30:00,AAAAAA,4.00,nan,nan\n"
+                             "09/11/2025 14:30:00,BBBBBB,-18.50,nan,nan\n",
+                             csv.c_str());
+}
+
+void test_backfill_after_outage(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    a.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    a.node.loop();   // schedule the first logs
+    b.node.loop();
+
+    // B hears nothing from A across two log slots and leaves its rows out
+    a.sensor.value = 3.0f;
+    a.clock.epoch += 900;
+    b.clock.epoch += 900;
+    a.node.loop();
+    b.node.loop();
+    a.sensor.value = 5.0f;
+    settle(a);
+    a.clock.epoch += 900;
+    b.clock.epoch += 900;
+    a.node.loop();
+    b.node.loop();
+    TEST_ASSERT_EQUAL(2, a.node.backlog().size());
+    TEST_ASSERT_EQUAL(1, b.node.backfillGaps().size());
+    TEST_ASSERT_EQUAL(-1, b.node.requestBackfill());   // A is still silent
+
+    // A is back: B asks for the missing slots and A answers in one batch
+    a.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    TEST_ASSERT_EQUAL(0, b.node.requestBackfill());
+    TEST_ASSERT_EQUAL(RxResult::Handled,
+                      a.node.onRadioFrame(b.radio.sent.back().data(), b.radio.sent.back().size()));
+    TEST_ASSERT_EQUAL(0, a.node.sendBackfill());
+    TEST_ASSERT_EQUAL(-1, a.node.sendBackfill());      // all served
+    TEST_ASSERT_EQUAL(2, a.node.metrics().get(MetricCounter::BackfillSent));
+
+    const std::vector<uint8_t> bkf = a.radio.sent.back();
+    TEST_ASSERT_EQUAL(RxResult::Handled, b.node.onRadioFrame(bkf.data(), bkf.size()));
+    TEST_ASSERT_EQUAL(2, b.node.metrics().get(MetricCounter::BackfillMerged));
+    TEST_ASSERT_EQUAL(0, b.node.backfillGaps().size());
+    // A repeat, or an answer to someone else's request, adds nothing
+    b.node.onRadioFrame(bkf.data(), bkf.size());
+    TEST_ASSERT_EQUAL(2, b.node.metrics().get(MetricCounter::BackfillMerged));
+
+    // B writes A's samples, oldest first, ahead of its next rows (A has
+    // gone quiet again, so its 14:45 row waits for the next round)
+    b.log.data.clear();
+    b.clock.epoch += 900;
+    b.node.loop();
+    TEST_ASSERT_EQUAL_STRING("09/11/2025 14:15:00,AAAAAA,3.00,nan,nan\n"
+                             "09/11/2025 14:30:00,AAAAAA,5.00,nan,nan\n"
+                             "09/11/2025 14:45:00,BBBBBB,4.00,nan,nan\n",
+                             b.log.data.c_str());
+}
+
+static size_t readLogBlock(void *ctx, size_t block, uint8_t *buf)
+{
+    const std::string &file = *(const std::string *)ctx;
+    size_t off = block * LOGBLOCK_SIZE;
+    size_t len = file.size() - off < LOGBLOCK_SIZE ? file.size() - off : LOGBLOCK_SIZE;
+    memcpy(buf, file.data() + off, len);
+    return len;
+}
+
+// Backfilled rows follow newer ones in the file; the export merges them
+// back in time order
+void test_backfilled_log_order(void)
+{
+    Rig a, b;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    b.node.begin("BBBBBB", true, "bowman#1");
+    b.node.setLogFormat(LogFormat::Blocks, 0);
+    a.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    a.node.loop();
+    b.node.loop();
+
+    // A is out of range for three slots
+    for (int i = 0; i < 3; i++) {
+        a.clock.epoch += 900;
+        b.clock.epoch += 900;
+        a.node.loop();
+        b.node.loop();
+    }
+    a.node.broadcastKIC();
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    TEST_ASSERT_EQUAL(0, b.node.requestBackfill());
+    a.node.onRadioFrame(b.radio.sent.back().data(), b.radio.sent.back().size());
+    TEST_ASSERT_EQUAL(0, a.node.sendBackfill());
+    b.node.onRadioFrame(a.radio.sent.back().data(), a.radio.sent.back().size());
+    b.clock.epoch += 900;
+    b.node.loop();
+
+    static LogBlockMerger merge;
+    const std::string &file = b.log.data;
+    merge.begin((file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE, 0, readLogBlock, (void *)&file);
+    const uint32_t t0 = 1757599200;
+    const uint32_t want[][2] = {
+        {t0 + 900, 'B'}, {t0 + 900, 'A'}, {t0 + 1800, 'B'}, {t0 + 1800, 'A'},
+        {t0 + 2700, 'B'}, {t0 + 2700, 'A'}, {t0 + 3600, 'B'},
+    };
+    LogRow r;
+    size_t n = 0;
+    while (merge.next(r)) {
+        TEST_ASSERT_TRUE(n < 7);
+        TEST_ASSERT_EQUAL(want[n][0], r.epoch);
+        TEST_ASSERT_EQUAL(want[n][1], r.id[0]);
+        n++;
+    }
+    TEST_ASSERT_EQUAL(7, n);
+
+    // From the middle of the outage on
+    merge.begin((file.size() + LOGBLOCK_SIZE - 1) / LOGBLOCK_SIZE, t0 + 1800, readLogBlock, (void *)&file);
+    n = 2;
+    while (merge.next(r)) {
+        TEST_ASSERT_EQUAL(want[n][0], r.epoch);
+        TEST_ASSERT_EQUAL(want[n][1], r.id[0]);
+        n++;
+    }
+    TEST_ASSERT_EQUAL(7, n);
+}
+
+void test_sensor_filter(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    settle(a);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, a.node.myTemp());
+
+    // A bad CRC and a spike are both held off, and don't count as a
+    // disconnected probe
+    a.sensor.value = NAN;
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    a.node.loop();
+    a.sensor.value = 4.0f;
+    settle(a);
+    a.sensor.value = 85.0f;
+    a.clock.advance(SENSOR_INTERVAL_MS + 1);
+    a.node.loop();
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, a.node.myTemp());
+    TEST_ASSERT_FALSE(a.node.probeDisconnected());
+    TEST_ASSERT_EQUAL(2, a.node.metrics().get(MetricCounter::SensorGlitches));
+    a.sensor.value = 4.0f;
+
+    // Quiet for a while: conversions drop to the coarse resolution
+    TEST_ASSERT_EQUAL(12, a.sensor.bits);
+    for (int i = 0; i < SENSOR_SETTLE_READS; i++) settle(a);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_STABLE, a.sensor.bits);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_STABLE, a.node.sensorBits());
+    a.sensor.value = 8.0f;
+    settle(a);
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, a.node.myTemp());
+    TEST_ASSERT_EQUAL(SENSOR_BITS_FINE, a.sensor.bits);
+
+    a.sensor.value = NAN;
+    settle(a);
+    TEST_ASSERT_TRUE(a.node.probeDisconnected());
+}
+
+void test_rising_trend_warning(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.setTrendLimit(-10.0f, 90);
+    a.sensor.value = -18.0f;
+    AlarmStatus st;
+    for (int i = 0; i < 20; i++) {
+        // 6 C/h, read every 5 s
+        for (int k = 0; k < 6; k++) {
+            a.sensor.value += 0.05f / 6;
+            a.clock.advance(SENSOR_INTERVAL_MS + 1);
+            a.node.loop();
+        }
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 6.0f, a.node.trend().slope("AAAAAA"));
+    a.node.evaluateAlarms(st);
+    TEST_ASSERT_EQUAL(1, st.rising.size());
+    TEST_ASSERT_EQUAL_STRING("AAAAAA", st.rising[0].id.c_str());
+    TEST_ASSERT_FALSE(st.active());   // a warning, not an alarm
+
+    // The limit survives a reboot; blank turns it off
+    Rig b;
+    b.prefs = a.prefs;
+    b.node.begin("AAAAAA", true, "bowman#1");
+    TEST_ASSERT_EQUAL_FLOAT(-10.0f, b.node.trend().limit());
+    TEST_ASSERT_EQUAL(90, b.node.trend().horizon());
+    b.node.setTrendLimit(NAN, 60);
+    TEST_ASSERT_EQUAL_STRING("", b.prefs.strings["trendLimit"].c_str());
+}
+
+void test_silence(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.silence(1000);
+    TEST_ASSERT_TRUE(a.node.silenced());
+    TEST_ASSERT_EQUAL(1000, a.prefs.ulongs["silenceUntil"]);
+    a.clock.advance(1000);
+    TEST_ASSERT_FALSE(a.node.silenced());
+}
+
+void test_clock_change_keeps_logging(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.loop();
+    TEST_ASSERT_EQUAL(1757599200 + 900, a.node.nextLogEpoch());
+
+    // Set back a day: the next slot is the next quarter hour, not tomorrow's
+    a.clock.epoch -= 86400 - 60;
+    a.node.clockChanged();
+    TEST_ASSERT_EQUAL(1757599200 - 86400 + 900, a.node.nextLogEpoch());
+
+    // A small step forward leaves the slot it made due
+    a.clock.epoch += 900;
+    a.node.clockChanged();
+    TEST_ASSERT_EQUAL(1757599200 - 86400 + 900, a.node.nextLogEpoch());
+    TEST_ASSERT_TRUE(a.node.loop().logged);
+
+    // Far forward, the slot moves up instead of logging under an old time
+    a.clock.epoch += 86400;
+    a.node.clockChanged();
+    TEST_ASSERT_EQUAL(1757599200 + 1800, a.node.nextLogEpoch());
+}
+
+void test_tx_power_cap(void)
+{
+    Rig a;
+    a.node.begin("AAAAAA", true, "bowman#1");
+    a.node.setMaxTxDbm(8);
+    TEST_ASSERT_EQUAL(8, a.radio.dbm);
+    TEST_ASSERT_EQUAL(8, a.prefs.ulongs["loraMaxDbm"]);
+
+    // Kept across a reboot
+    Rig b;
+    b.prefs.ulongs["loraMaxDbm"] = 8;
+    b.node.begin("BBBBBB", true, "bowman#1");
+    TEST_ASSERT_EQUAL(8, b.node.linkAdapt().maxTxDbm());
+    TEST_ASSERT_EQUAL(8, b.radio.dbm);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_roster);
+    RUN_TEST(test_node_table_update);
+    RUN_TEST(test_alarm_node_down);
+    RUN_TEST(test_daytime);
+    RUN_TEST(test_next_log_epoch);
+    RUN_TEST(test_log_row);
+    RUN_TEST(test_node_sends_and_peer_receives);
+    RUN_TEST(test_join_reports_at_once);
+    RUN_TEST(test_no_alarm_before_first_report);
+    RUN_TEST(test_wrong_key_rejected);
+    RUN_TEST(test_radio_counters);
+    RUN_TEST(test_gateway_records);
+    RUN_TEST(test_adaptive_rate);
+    RUN_TEST(test_nodelist_persisted);
+    RUN_TEST(test_node_id_change);
+    RUN_TEST(test_alarm_acked);
+    RUN_TEST(test_alarm_once_per_hold);
+    RUN_TEST(test_busy_channel_holds_alarm);
+    RUN_TEST(test_quarter_hour_log);
+    RUN_TEST(test_log_blocks);
+    RUN_TEST(test_backfill_after_outage);
+    RUN_TEST(test_backfilled_log_order);
+    RUN_TEST(test_sensor_filter);
+    RUN_TEST(test_rising_trend_warning);
+    RUN_TEST(test_silence);
+    RUN_TEST(test_clock_change_keeps_logging);
+    RUN_TEST(test_tx_power_cap);
+    return UNITY_END();
+}
@@ -0,0 +1,39 @@
+#include <unity.h>
+#include "Power.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_sleep_plan(void)
+{
+    TEST_ASSERT_EQUAL(0, PowerStats::sleepMs(0));
+    TEST_ASSERT_EQUAL(0, PowerStats::sleepMs(LOW_POWER_MIN_SLEEP_MS - 1));
+    TEST_ASSERT_EQUAL(4000, PowerStats::sleepMs(4000));
+    TEST_ASSERT_EQUAL(LOW_POWER_MAX_SLEEP_MS, PowerStats::sleepMs(3600000UL));
+}
+
+void test_accounting(void)
+{
+    PowerStats p;
+    // 10 s uptime, 9 s of it asleep
+    p.slept(4500000, WakeCause::Timer);
+    p.slept(4500000, WakeCause::Radio);
+    uint64_t uptime = 10000000;
+    TEST_ASSERT_EQUAL(2, p.wakeups());
+    TEST_ASSERT_EQUAL(1, p.wakeups(WakeCause::Radio));
+    TEST_ASSERT_EQUAL(0, p.wakeups(WakeCause::Button));
+    TEST_ASSERT_EQUAL(90, p.asleepPercent(uptime));
+    TEST_ASSERT_EQUAL((POWER_AWAKE_UA + 9 * POWER_SLEEP_UA) / 10, p.averageUa(uptime));
+
+    // Never slept: awake draw throughout
+    PowerStats idle;
+    TEST_ASSERT_EQUAL(POWER_AWAKE_UA, idle.averageUa(uptime));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sleep_plan);
+    RUN_TEST(test_accounting);
+    return UNITY_END();
+}
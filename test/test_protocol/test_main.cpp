@@ -0,0 +1,247 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "Protocol.h"
+#include "CryptoHelper.h"
+#include "Airtime.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_kic_roundtrip(void)
+{
+    KicReport r = {"ABC123", 4.25f, NAN, -18.5f, 1757599200UL, true, 0, 0, 0};
+    char buf[128];
+    size_t len = Protocol::formatKic(r, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("KIC,ABC123,4.25,nan,-18.50,1757599200,1", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::Kic, m.type);
+    TEST_ASSERT_EQUAL_STRING("ABC123", m.kic.id.c_str());
+    TEST_ASSERT_EQUAL_FLOAT(4.25f, m.kic.temp1);
+    TEST_ASSERT_FLOAT_IS_NAN(m.kic.temp2);
+    TEST_ASSERT_EQUAL_FLOAT(-18.5f, m.kic.temp3);
+    TEST_ASSERT_EQUAL_UINT32(1757599200UL, m.kic.lastUpdate);
+    TEST_ASSERT_TRUE(m.kic.hasrtc);
+}
+
+void test_kic_rate_tail(void)
+{
+    KicReport r = {"ABC123", 4.25f, NAN, NAN, 1757599200UL, true, 7, -3, 8};
+    char buf[128];
+    size_t len = Protocol::formatKic(r, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("KIC,ABC123,4.25,nan,nan,1757599200,1,7,-3,8", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(7, m.kic.sf);
+    TEST_ASSERT_EQUAL(-3, m.kic.txDbm);
+    TEST_ASSERT_EQUAL(8, m.kic.wantSf);
+    TEST_ASSERT_TRUE(m.kic.hasrtc);
+
+    // Older firmware: no tail, rate not announced
+    const char *old = "KIC,ABC123,4.25,nan,nan,1757599200,1";
+    TEST_ASSERT_TRUE(Protocol::parse(old, strlen(old), m));
+    TEST_ASSERT_EQUAL(0, m.kic.sf);
+    // A garbled tail is ignored, not fatal
+    const char *bad = "KIC,ABC123,4.25,nan,nan,1757599200,1,99,3,9";
+    TEST_ASSERT_TRUE(Protocol::parse(bad, strlen(bad), m));
+    TEST_ASSERT_EQUAL(0, m.kic.sf);
+}
+
+void test_kic_ack_tail(void)
+{
+    // Fixed rate: the ack list still needs the rate fields ahead of it
+    KicReport r = {"ABC123", 4.25f, NAN, NAN, 1757599200UL, true, 0, 0, 0};
+    RelAck acks[2] = { {"AAAAAA", 3, 0x000F}, {"BBBBBB", 250, 0x8001} };
+    char buf[128];
+    size_t len = Protocol::formatKic(r, buf, sizeof(buf), acks, 2);
+    TEST_ASSERT_EQUAL_STRING("KIC,ABC123,4.25,nan,nan,1757599200,1,0,0,0,"
+                             "AAAAAA:3:f,BBBBBB:250:8001", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(0, m.kic.sf);
+    TEST_ASSERT_EQUAL(2, m.acks.size());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", m.acks[1].origin.c_str());
+    TEST_ASSERT_EQUAL(250, m.acks[1].top);
+    TEST_ASSERT_EQUAL_HEX16(0x8001, m.acks[1].seen);
+
+    // A malformed entry ends the list; the report itself still counts
+    const char *bad = "KIC,ABC123,4.25,nan,nan,1757599200,1,7,-3,8,AAAAAA:3:f,BBBBBB:x:1";
+    TEST_ASSERT_TRUE(Protocol::parse(bad, strlen(bad), m));
+    TEST_ASSERT_EQUAL(7, m.kic.sf);
+    TEST_ASSERT_EQUAL(1, m.acks.size());
+}
+
+void test_kic_truncated_is_rejected(void)
+{
+    const char *msg = "KIC,ABC123,4.25,nan";
+    Message m;
+    TEST_ASSERT_FALSE(Protocol::parse(msg, strlen(msg), m));
+    TEST_ASSERT_EQUAL(MsgType::Unknown, m.type);
+}
+
+void test_format_too_small(void)
+{
+    KicReport r = {"ABC123", 1, 2, 3, 4, false, 0, 0, 0};
+    char buf[10];
+    TEST_ASSERT_EQUAL(0, Protocol::formatKic(r, buf, sizeof(buf)));
+}
+
+void test_nodelist_and_alarm(void)
+{
+    char buf[64];
+    size_t len = Protocol::formatNodeList("AAAAAA,BBBBBB", buf, sizeof(buf));
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::NodeList, m.type);
+    TEST_ASSERT_EQUAL_STRING("AAAAAA,BBBBBB", m.arg.c_str());
+
+    len = Protocol::formatAlarm("AAAAAA", "BBBBBB", buf, sizeof(buf));
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::Alarm, m.type);
+    TEST_ASSERT_EQUAL_STRING("AAAAAA", m.sender.c_str());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", m.arg.c_str());
+}
+
+void test_reliable_wrapper(void)
+{
+    char inner[64], buf[96];
+    size_t n = Protocol::formatAlarm("AAAAAA", "BBBBBB", inner, sizeof(inner));
+    size_t len = Protocol::formatReliable("AAAAAA", 200, inner, n, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("REL,AAAAAA,200,AAAAAA,ALARM,BBBBBB", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::Alarm, m.type);
+    TEST_ASSERT_TRUE(m.reliable);
+    TEST_ASSERT_EQUAL(200, m.seq);
+    TEST_ASSERT_EQUAL_STRING("AAAAAA", m.sender.c_str());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", m.arg.c_str());
+
+    n = Protocol::formatNodeList("AAAAAA,BBBBBB", inner, sizeof(inner));
+    len = Protocol::formatReliable("BBBBBB", 0, inner, n, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::NodeList, m.type);
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", m.sender.c_str());
+    TEST_ASSERT_EQUAL_STRING("AAAAAA,BBBBBB", m.arg.c_str());
+
+    // Only control messages are wrapped; an ALARM can't claim another sender
+    const char *bad[] = { "REL,AAAAAA,1,KIC,ABC123,4.25,nan,nan,1757599200,1",
+                          "REL,AAAAAA,1,CCCCCC,ALARM,BBBBBB", "REL,AAAAAA,256,NODELIST,A",
+                          "REL,AAAAAA,,NODELIST,A", "REL,AAAAAA,1" };
+    for (const char *b : bad) TEST_ASSERT_FALSE(Protocol::parse(b, strlen(b), m));
+    // Plain messages are not reliable
+    len = Protocol::formatNodeList("AAAAAA", buf, sizeof(buf));
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_FALSE(m.reliable);
+}
+
+void test_backfill(void)
+{
+    LogSample s[3] = { {1757599200UL, -18.5f}, {1757600100UL, -18.25f}, {1757601900UL, NAN} };
+    char buf[128];
+    size_t len = Protocol::formatBackfill("ABC123", s, 3, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("BKF,ABC123,1757599200,-18.50,900,-18.25,1800,nan", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::Backfill, m.type);
+    TEST_ASSERT_EQUAL_STRING("ABC123", m.sender.c_str());
+    TEST_ASSERT_EQUAL(3, m.samples.size());
+    TEST_ASSERT_EQUAL_UINT32(1757600100UL, m.samples[1].epoch);
+    TEST_ASSERT_EQUAL_FLOAT(-18.25f, m.samples[1].temp);
+    TEST_ASSERT_EQUAL_UINT32(1757601900UL, m.samples[2].epoch);
+    TEST_ASSERT_FLOAT_IS_NAN(m.samples[2].temp);
+
+    const char *bad[] = { "BKF,ABC123", "BKF,ABC123,1757599200", "BKF,,1,2",
+                          "BKF,ABC123,1757599200,-18.5,900", "BKF,ABC123,1,,2,3" };
+    for (const char *b : bad) TEST_ASSERT_FALSE(Protocol::parse(b, strlen(b), m));
+    TEST_ASSERT_EQUAL(0, Protocol::formatBackfill("ABC123", s, 3, buf, 20));
+}
+
+void test_backfill_request(void)
+{
+    char buf[64];
+    size_t len = Protocol::formatBackfillRequest("BBBBBB", "ABC123", 1757599200UL,
+                                                 1757600100UL, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("BKR,BBBBBB,ABC123,1757599200,1757600100", buf);
+
+    Message m;
+    TEST_ASSERT_TRUE(Protocol::parse(buf, len, m));
+    TEST_ASSERT_EQUAL(MsgType::BackfillRequest, m.type);
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", m.sender.c_str());
+    TEST_ASSERT_EQUAL_STRING("ABC123", m.arg.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1757599200UL, m.since);
+    TEST_ASSERT_EQUAL_UINT32(1757600100UL, m.until);
+
+    const char *bad[] = { "BKR,BBBBBB,ABC123,1757599200", "BKR,BBBBBB,,1,2",
+                          "BKR,BBBBBB,ABC123,2,1", "BKR,BBBBBB,ABC123,1,2,3" };
+    for (const char *b : bad) TEST_ASSERT_FALSE(Protocol::parse(b, strlen(b), m));
+}
+
+void test_unknown(void)
+{
+    const char *msg = "hello world";
+    Message m;
+    TEST_ASSERT_FALSE(Protocol::parse(msg, strlen(msg), m));
+}
+
+void test_crypto_roundtrip(void)
+{
+    uint8_t key[32];
+    CryptoHelper::deriveKey("bowman#1", 8, key);
+
+    const char *msg = "KIC,ABC123,4.25,nan,nan,1757599200,1";
+    uint8_t enc[256];
+    size_t encLen = 0;
+    CryptoHelper::aesEncrypt(key, (const uint8_t *)msg, strlen(msg), enc, encLen);
+    TEST_ASSERT_EQUAL(16 + 48, encLen);
+
+    uint8_t dec[256];
+    size_t decLen = 0;
+    TEST_ASSERT_TRUE(CryptoHelper::aesDecrypt(key, enc, encLen, dec, decLen));
+    TEST_ASSERT_EQUAL(strlen(msg), decLen);
+    TEST_ASSERT_EQUAL_MEMORY(msg, dec, decLen);
+
+    uint8_t other[32];
+    CryptoHelper::deriveKey("wrong", 5, other);
+    bool ok = CryptoHelper::aesDecrypt(other, enc, encLen, dec, decLen);
+    TEST_ASSERT_TRUE(!ok || decLen != strlen(msg) || memcmp(msg, dec, decLen) != 0);
+}
+
+void test_airtime(void)
+{
+    // Reference values from the Semtech LoRa calculator
+    LoRaParams sf7 = { 7, 125.0f, 5, 8, true, true };
+    TEST_ASSERT_UINT32_WITHIN(5, 41216, Airtime::timeOnAirUs(sf7, 10));
+    LoRaParams sf12 = { 12, 125.0f, 5, 8, true, true };
+    TEST_ASSERT_UINT32_WITHIN(5, 991232, Airtime::timeOnAirUs(sf12, 10));
+    // Our encrypted KIC report: 64 bytes at the firmware defaults
+    LoRaParams def = LORA_DEFAULT_PARAMS;
+    TEST_ASSERT_UINT32_WITHIN(5, 513024, Airtime::timeOnAirUs(def, 64));
+
+    TEST_ASSERT_EQUAL_FLOAT(-124.0f, Airtime::sensitivityDbm(7, 125.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, -134.0f, Airtime::sensitivityDbm(12, 250.0f));
+    TEST_ASSERT_EQUAL_FLOAT(-20.0f, Airtime::requiredSnrDb(12));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_kic_roundtrip);
+    RUN_TEST(test_kic_rate_tail);
+    RUN_TEST(test_kic_ack_tail);
+    RUN_TEST(test_kic_truncated_is_rejected);
+    RUN_TEST(test_format_too_small);
+    RUN_TEST(test_nodelist_and_alarm);
+    RUN_TEST(test_reliable_wrapper);
+    RUN_TEST(test_backfill);
+    RUN_TEST(test_backfill_request);
+    RUN_TEST(test_unknown);
+    RUN_TEST(test_crypto_roundtrip);
+    RUN_TEST(test_airtime);
+    return UNITY_END();
+}
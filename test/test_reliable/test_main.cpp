@@ -0,0 +1,154 @@
+#include <unity.h>
+#include "Reliable.h"
+#include "Airtime.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_inbox_window(void)
+{
+    ReliableInbox in;
+    TEST_ASSERT_TRUE(in.accept("AAAAAA", 10, 0));
+    TEST_ASSERT_FALSE(in.accept("AAAAAA", 10, 0));   // repeat
+    TEST_ASSERT_TRUE(in.accept("AAAAAA", 12, 0));    // 11 lost for now
+    TEST_ASSERT_TRUE(in.accept("AAAAAA", 11, 0));    // late retry fills it
+    TEST_ASSERT_FALSE(in.accept("AAAAAA", 11, 0));
+    TEST_ASSERT_FALSE(in.accept("AAAAAA", 12 - REL_WINDOW, 0));   // out of the window
+
+    RelAck a[REL_MAX_ACKS];
+    TEST_ASSERT_EQUAL(1, in.acks(a, REL_MAX_ACKS, 0));
+    TEST_ASSERT_EQUAL(12, a[0].top);
+    TEST_ASSERT_EQUAL_HEX16(0x0007, a[0].seen);
+
+    // Wraps from 255 to 0
+    TEST_ASSERT_TRUE(in.accept("BBBBBB", 255, 1000));
+    TEST_ASSERT_TRUE(in.accept("BBBBBB", 1, 2000));
+    TEST_ASSERT_EQUAL(2, in.acks(a, REL_MAX_ACKS, 2000));
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", a[0].origin.c_str());   // newest first
+    TEST_ASSERT_EQUAL(1, a[0].top);
+    TEST_ASSERT_EQUAL_HEX16(0x0005, a[0].seen);
+    TEST_ASSERT_EQUAL(1, in.acks(a, 1, 2000));
+
+    // More senders than fit: the most recent ones, newest first
+    in.accept("CCCCCC", 1, 1500);
+    in.accept("DDDDDD", 1, 3000);
+    in.accept("EEEEEE", 1, 2500);
+    TEST_ASSERT_EQUAL(REL_MAX_ACKS, in.acks(a, REL_MAX_ACKS, 3000));
+    const char *order[REL_MAX_ACKS] = {"DDDDDD", "EEEEEE", "BBBBBB", "CCCCCC"};
+    for (int i = 0; i < REL_MAX_ACKS; i++) TEST_ASSERT_EQUAL_STRING(order[i], a[i].origin.c_str());
+
+    // Quiet senders drop off the report
+    TEST_ASSERT_EQUAL(3, in.acks(a, REL_MAX_ACKS, 1500 + REL_ACK_HOLD_MS + 1));
+    TEST_ASSERT_EQUAL(0, in.acks(a, REL_MAX_ACKS, 3000 + REL_ACK_HOLD_MS + 1));
+}
+
+void test_inbox_ack_repeats(void)
+{
+    ReliableInbox in;
+    RelAck a[REL_MAX_ACKS];
+    in.accept("AAAAAA", 1, 0);
+    for (int i = 0; i < REL_ACK_REPEATS; i++) {
+        size_t n = in.acks(a, REL_MAX_ACKS, 1000);
+        TEST_ASSERT_EQUAL(1, n);
+        in.reported(a, n);
+    }
+    TEST_ASSERT_EQUAL(0, in.acks(a, REL_MAX_ACKS, 2000));
+
+    // A retry means our acks were lost: carry the window again
+    TEST_ASSERT_FALSE(in.accept("AAAAAA", 1, 3000));
+    TEST_ASSERT_EQUAL(1, in.acks(a, REL_MAX_ACKS, 3000));
+    TEST_ASSERT_EQUAL(1, a[0].top);
+}
+
+void test_channel_load(void)
+{
+    ChannelLoad load;
+    TEST_ASSERT_EQUAL(0, load.percent(0));
+    // 6 s on air in the first window: 10%
+    for (int i = 0; i < 12; i++) load.add(500000, 1000 + i * 1000);
+    TEST_ASSERT_EQUAL(10, load.percent(30000));
+    // Half of that window has slid out by 1.5 windows in
+    load.add(0, CHANNEL_WINDOW_MS + 1000);
+    TEST_ASSERT_EQUAL(5, load.percent(CHANNEL_WINDOW_MS + CHANNEL_WINDOW_MS / 2));
+    // Quiet for two windows
+    TEST_ASSERT_EQUAL(0, load.percent(1000 + 2 * CHANNEL_WINDOW_MS));
+    load.add(3000000, 10 * CHANNEL_WINDOW_MS);
+    TEST_ASSERT_EQUAL(5, load.percent(10 * CHANNEL_WINDOW_MS));
+}
+
+void test_covers(void)
+{
+    TEST_ASSERT_TRUE(ReliableOutbox::covers(12, 0x0005, 12));
+    TEST_ASSERT_FALSE(ReliableOutbox::covers(12, 0x0005, 11));
+    TEST_ASSERT_TRUE(ReliableOutbox::covers(12, 0x0005, 10));
+    TEST_ASSERT_FALSE(ReliableOutbox::covers(12, 0xFFFF, 13));
+    TEST_ASSERT_TRUE(ReliableOutbox::covers(1, 0x0004, 255));
+}
+
+void test_outbox_backoff_and_give_up(void)
+{
+    ReliableOutbox out;
+    std::vector<std::string> peers(1, "BBBBBB");
+    out.post("REL,AAAAAA,0,NODELIST,AAAAAA", peers, 0);
+    TEST_ASSERT_EQUAL(1, out.peekSeq());
+    out.sent(0, 0, 0);
+
+    uint32_t ms = 0, wait = REL_RETRY_MS;
+    for (int i = 1; i < REL_MAX_TRIES; i++) {
+        TEST_ASSERT_NULL(out.due(ms + wait - 1));
+        TEST_ASSERT_EQUAL(1, out.msUntilDue(ms + wait - 1));
+        ms += wait;
+        TEST_ASSERT_NOT_NULL(out.due(ms));
+        out.sent(0, ms, 0);
+        wait = wait * 2 > REL_RETRY_MAX_MS ? REL_RETRY_MAX_MS : wait * 2;
+    }
+    // Out of tries: no more retries, dropped once the last has had its time
+    TEST_ASSERT_NULL(out.due(ms + wait));
+    TEST_ASSERT_EQUAL(0, out.expire(ms + wait - 1));
+    TEST_ASSERT_EQUAL(1, out.expire(ms + wait));
+    TEST_ASSERT_EQUAL(0, out.size());
+    TEST_ASSERT_EQUAL(0, out.acked());
+}
+
+void test_outbox_acks(void)
+{
+    ReliableOutbox out;
+    out.setNextSeq(255);
+    std::vector<std::string> peers;
+    peers.push_back("BBBBBB");
+    peers.push_back("CCCCCC");
+    out.post("REL,AAAAAA,255,...", peers, 0);
+    out.sent(255, 0, 0);
+    out.post("REL,AAAAAA,0,...", peers, 100);
+    out.sent(0, 100, 0);
+
+    // B has both, C only the newer one
+    out.acked("BBBBBB", 0, 0x0003, 1500);
+    out.acked("CCCCCC", 0, 0x0001, 2000);
+    TEST_ASSERT_EQUAL(1, out.size());
+    TEST_ASSERT_EQUAL(255, out.pending()[0].seq);
+    TEST_ASSERT_EQUAL(1, out.acked());
+    TEST_ASSERT_EQUAL(1900, out.latencyMax());
+
+    out.acked("CCCCCC", 1, 0x0007, 6000);
+    TEST_ASSERT_EQUAL(0, out.size());
+    TEST_ASSERT_EQUAL(2, out.acked());
+    TEST_ASSERT_EQUAL(6000, out.latencyMax());
+
+    // Nobody to wait for: sent once and forgotten
+    out.post("REL,AAAAAA,1,...", std::vector<std::string>(), 7000);
+    out.sent(1, 7000, 0);
+    TEST_ASSERT_EQUAL(0, out.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_inbox_window);
+    RUN_TEST(test_inbox_ack_repeats);
+    RUN_TEST(test_channel_load);
+    RUN_TEST(test_covers);
+    RUN_TEST(test_outbox_backoff_and_give_up);
+    RUN_TEST(test_outbox_acks);
+    return UNITY_END();
+}
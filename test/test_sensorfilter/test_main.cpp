@@ -0,0 +1,112 @@
+#include <unity.h>
+#include <math.h>
+#include "SensorFilter.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_spike_rejected(void)
+{
+    SensorFilter f;
+    TEST_ASSERT_TRUE(isnan(f.value()));
+    TEST_ASSERT_EQUAL_FLOAT(-18.0f, f.update(-18.0f));
+    TEST_ASSERT_TRUE(f.changed());
+    f.update(-18.0f);
+
+    // DS18B20 power-on value for one read
+    TEST_ASSERT_EQUAL_FLOAT(-18.0f, f.update(85.0f));
+    TEST_ASSERT_TRUE(f.glitch());
+    TEST_ASSERT_FALSE(f.changed());
+    TEST_ASSERT_EQUAL_FLOAT(-18.0f, f.update(-18.0f));
+    TEST_ASSERT_FALSE(f.glitch());
+}
+
+void test_step_passes_on_second_read(void)
+{
+    SensorFilter f;
+    f.update(-18.0f);
+    f.update(-18.0f);
+    TEST_ASSERT_EQUAL_FLOAT(-18.0f, f.update(-10.0f));
+    TEST_ASSERT_FALSE(f.changed());
+    TEST_ASSERT_EQUAL_FLOAT(-10.0f, f.update(-10.0f));
+    TEST_ASSERT_TRUE(f.changed());
+}
+
+void test_ema_smooths_small_changes(void)
+{
+    SensorFilter f;
+    f.update(4.0f);
+    f.update(4.0f);
+    f.update(4.25f);
+    float v = f.update(4.25f);   // median 4.25: a quarter of the way there
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 4.0625f, v);
+    TEST_ASSERT_FALSE(f.changed());
+    for (int i = 0; i < 30; i++) v = f.update(4.25f);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 4.25f, v);
+}
+
+void test_failed_reads(void)
+{
+    SensorFilter f;
+    f.update(4.0f);
+    // One bad CRC holds the last value
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, f.update(NAN));
+    TEST_ASSERT_TRUE(f.glitch());
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, f.update(4.0f));
+    // Two in a row is a disconnected probe
+    f.update(NAN);
+    TEST_ASSERT_TRUE(isnan(f.update(-127.0f)));
+    TEST_ASSERT_TRUE(isnan(f.update(NAN)));
+    // Reconnected: the first good read counts at once
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, f.update(5.0f));
+}
+
+void test_resolution_follows_stability(void)
+{
+    SensorFilter f;
+    TEST_ASSERT_EQUAL(SENSOR_BITS_FINE, f.bits());
+    f.update(-18.0f);
+    for (int i = 0; i < SENSOR_SETTLE_READS - 1; i++) f.update(-18.0f);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_FINE, f.bits());
+    f.update(-18.25f);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_STABLE, f.bits());
+
+    // A step goes back to full resolution until it settles again
+    f.update(-12.0f);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_STABLE, f.bits());   // one read is a spike
+    f.update(-12.0f);
+    TEST_ASSERT_EQUAL(SENSOR_BITS_FINE, f.bits());
+}
+
+void test_power_on_value_after_reset(void)
+{
+    SensorFilter f;
+    // Boot: the probe's first conversion is the power-on value
+    TEST_ASSERT_TRUE(isnan(f.update(85.0f)));
+    TEST_ASSERT_TRUE(f.glitch());
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, f.update(4.0f));
+
+    // Reconnected after a dropout
+    f.update(NAN);
+    f.update(NAN);
+    TEST_ASSERT_TRUE(isnan(f.update(85.0f)));
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, f.update(4.0f));
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, f.update(4.0f));
+
+    // 85.00 twice is a real reading
+    f.reset();
+    TEST_ASSERT_TRUE(isnan(f.update(85.0f)));
+    TEST_ASSERT_EQUAL_FLOAT(85.0f, f.update(85.0f));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_spike_rejected);
+    RUN_TEST(test_step_passes_on_second_read);
+    RUN_TEST(test_ema_smooths_small_changes);
+    RUN_TEST(test_failed_reads);
+    RUN_TEST(test_resolution_follows_stability);
+    RUN_TEST(test_power_on_value_after_reset);
+    return UNITY_END();
+}
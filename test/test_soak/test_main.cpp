@@ -0,0 +1,172 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "../FakeHal.h"
+#include "KicNode.h"
+#include "TextBuf.h"
+
+// Packets for the long run; raise it for an overnight soak:
+//   -DSOAK_PACKETS=100000000
+#ifndef SOAK_PACKETS
+#define SOAK_PACKETS 2000000UL
+#endif
+
+#define SOAK_NODES 6
+
+// Every operator new in the process is counted
+static unsigned long heapAllocs = 0;
+static unsigned long heapFrees = 0;
+
+void *operator new(size_t size)
+{
+    heapAllocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p) return;
+    heapFrees++;
+    free(p);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+#endif
+
+// Frames go into fixed slots until the network delivers them
+class AirRadio : public Radio {
+public:
+    uint8_t frame[8][MAX_FRAME_LEN];
+    size_t len[8];
+    size_t count = 0;
+    int16_t transmit(const uint8_t *data, size_t n) override {
+        if (count == 8 || n > MAX_FRAME_LEN) return -1;
+        memcpy(frame[count], data, n);
+        len[count++] = n;
+        return 0;
+    }
+};
+
+// Counts what would have gone to flash
+class CountingLog : public LogStore {
+public:
+    size_t bytes = 0;
+    bool append(const char *d, size_t n) override {
+        bytes += n;
+        return true;
+    }
+};
+
+struct SoakNode {
+    FakeClock clock;
+    AirRadio radio;
+    FakeStore prefs;
+    CountingLog log;
+    FakeSensor sensor;
+    KicNode node;
+    SoakNode() : node(clock, radio, prefs, log, sensor) {}
+};
+
+static SoakNode *net[SOAK_NODES];
+static unsigned long packets = 0;
+
+// One second of the network: every node runs, then each frame sent
+// reaches every other node
+static void step()
+{
+    for (int i = 0; i < SOAK_NODES; i++) {
+        net[i]->clock.advance(1000);
+        net[i]->sensor.value = 3.0f + ((net[i]->clock.epoch / 60 + i) % 7) * 0.25f;
+        net[i]->node.loop();
+    }
+    for (int i = 0; i < SOAK_NODES; i++) {
+        AirRadio &r = net[i]->radio;
+        for (size_t f = 0; f < r.count; f++) {
+            for (int j = 0; j < SOAK_NODES; j++) {
+                if (j == i) continue;
+                net[j]->node.onRadioFrame(r.frame[f], r.len[f], -90.0f - j, 6.0f);
+                packets++;
+            }
+        }
+        r.count = 0;
+    }
+}
+
+void setUp(void)
+{
+    static const char *ids[SOAK_NODES] = {"A1B2C3", "B2C3D4", "C3D4E5",
+                                          "D4E5F6", "E5F6A1", "F6A1B2"};
+    for (int i = 0; i < SOAK_NODES; i++) {
+        net[i] = new SoakNode();
+        net[i]->node.begin(ids[i], i == 0, "bowman#1");
+        net[i]->node.setNodeList("A1B2C3,B2C3D4,C3D4E5,D4E5F6,E5F6A1,F6A1B2");
+        net[i]->node.setAdaptiveRate(true);
+        // Both log encodings; the roster broadcast below puts ack tails
+        // in the reports
+        net[i]->node.setLogFormat(i % 2 ? LogFormat::Blocks : LogFormat::Csv, 0);
+    }
+    net[0]->node.broadcastNodeList();
+    packets = 0;
+}
+
+void tearDown(void)
+{
+    for (int i = 0; i < SOAK_NODES; i++) delete net[i];
+}
+
+void test_steady_state_allocates_nothing(void)
+{
+    // Warm up: a day of traffic grows every buffer to its working size
+    for (int s = 0; s < 86400; s++) step();
+    TEST_ASSERT_TRUE(packets > 10000);
+    TEST_ASSERT_TRUE(net[1]->log.bytes > 0);
+    TEST_ASSERT_EQUAL(0, net[3]->node.metrics().get(MetricCounter::RxUnknown));
+
+    unsigned long allocs0 = heapAllocs, frees0 = heapFrees, packets0 = packets;
+    unsigned long logged0 = net[0]->log.bytes;
+    uint32_t seconds = 0;
+    while (packets - packets0 < SOAK_PACKETS) {
+        step();
+        seconds++;
+    }
+    unsigned long n = packets - packets0;
+    printf("  %lu packets over %lu simulated hours: %lu allocations, %lu frees\n",
+           n, (unsigned long)seconds / 3600, heapAllocs - allocs0, heapFrees - frees0);
+    TEST_ASSERT_TRUE(net[0]->log.bytes > logged0);
+    TEST_ASSERT_EQUAL(0, heapAllocs - allocs0);
+    TEST_ASSERT_EQUAL(0, heapFrees - frees0);
+}
+
+void test_text_buffer(void)
+{
+    unsigned long allocs0 = heapAllocs;
+    char buf[24];
+    TextBuf t(buf, sizeof(buf));
+    t.add("<li>").add("A1B2C3").add(": ").num(NAN, 2, "-").add(" C</li>");
+    TEST_ASSERT_EQUAL_STRING("<li>A1B2C3: - C</li>", t.c_str());
+    TEST_ASSERT_FALSE(t.overflowed());
+
+    // What does not fit is dropped, and stays dropped
+    t.clear();
+    t.printf("{\"temp\":%.2f}", -18.25f).add(",").printf("{\"temp\":%.2f}", 4.5f).add("]");
+    TEST_ASSERT_EQUAL_STRING("{\"temp\":-18.25},{\"temp\"", t.c_str());
+    TEST_ASSERT_EQUAL(sizeof(buf) - 1, t.size());
+    TEST_ASSERT_TRUE(t.overflowed());
+    TEST_ASSERT_EQUAL(0, heapAllocs - allocs0);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_state_allocates_nothing);
+    RUN_TEST(test_text_buffer);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "Trend.h"
+
+static const time_t T0 = 1757599200;
+
+// Straightforward least squares over the same points, in C per hour
+static double slopeOf(const std::vector<double> &x, const std::vector<double> &y)
+{
+    double n = x.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        sx += x[i];
+        sy += y[i];
+        sxx += x[i] * x[i];
+        sxy += x[i] * y[i];
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx) * 3600.0;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_linear_slope(void)
+{
+    TrendWindow w;
+    // -18 C warming at 6 C/h, one reading every 30 s
+    for (int i = 0; i < TREND_MIN_SAMPLES - 1; i++) {
+        TEST_ASSERT_TRUE(w.add(T0 + i * 30, -18.0f + i * 0.05f));
+    }
+    TEST_ASSERT_TRUE(isnan(w.slopePerHour()));
+    w.add(T0 + (TREND_MIN_SAMPLES - 1) * 30, -18.0f + (TREND_MIN_SAMPLES - 1) * 0.05f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 6.0f, w.slopePerHour());
+
+    // Readings closer than a step apart are skipped
+    TEST_ASSERT_FALSE(w.add(T0 + (TREND_MIN_SAMPLES - 1) * 30 + 5, 0.0f));
+    TEST_ASSERT_EQUAL(TREND_MIN_SAMPLES, w.size());
+}
+
+void test_sliding_matches_full_fit(void)
+{
+    TrendWindow w;
+    std::vector<double> xs, ys;
+    time_t t = T0;
+    for (int i = 0; i < 200; i++) {
+        // Irregular spacing and a wobble on a slow cooling trend
+        t += TREND_STEP_SECS + (i * 7) % 20;
+        float temp = 4.0f - i * 0.01f + ((i * 13) % 5) * 0.03f;
+        TEST_ASSERT_TRUE(w.add(t, temp));
+        xs.push_back((double)(t - T0));
+        ys.push_back(roundf(temp * 100.0f) / 100.0);
+    }
+    TEST_ASSERT_EQUAL(TREND_WINDOW, w.size());
+    std::vector<double> lx(xs.end() - TREND_WINDOW, xs.end());
+    std::vector<double> ly(ys.end() - TREND_WINDOW, ys.end());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)slopeOf(lx, ly), w.slopePerHour());
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, ys.back(), w.last());
+}
+
+void test_long_run_and_gaps(void)
+{
+    TrendWindow w;
+    // Weeks of readings cross the rebase point without drift
+    std::vector<double> xs, ys;
+    time_t t = T0;
+    for (long i = 0; i < 50000; i++) {
+        t += TREND_STEP_SECS;
+        float temp = -18.0f + (i % 2) * 0.25f + (i % 7) * 0.01f;
+        w.add(t, temp);
+        if (i >= 50000 - TREND_WINDOW) {
+            xs.push_back((double)(t - T0));
+            ys.push_back(roundf(temp * 100.0f) / 100.0);
+        }
+    }
+    TEST_ASSERT_TRUE(t - T0 > (1L << 20));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)slopeOf(xs, ys), w.slopePerHour());
+
+    // An outage starts the window again
+    w.add(t + TREND_GAP_SECS + 1, -10.0f);
+    TEST_ASSERT_EQUAL(1, w.size());
+    TEST_ASSERT_TRUE(isnan(w.slopePerHour()));
+}
+
+void test_tracker_warns_before_limit(void)
+{
+    TrendTracker tr;
+    std::vector<TrendWarning> out;
+    time_t t = T0;
+    for (int i = 0; i < 20; i++, t += 30) {
+        float a[TREND_CHANNELS] = {-18.0f + i * 0.05f, NAN, NAN};   // 6 C/h
+        float b[TREND_CHANNELS] = {4.0f, NAN, -20.0f + i * 0.01f};   // steady, 1.2 C/h
+        tr.add("AAAAAA", a, t);
+        tr.add("BBBBBB", b, t);
+    }
+    t -= 30;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 6.0f, tr.slope("AAAAAA"));
+    TEST_ASSERT_TRUE(isnan(tr.slope("BBBBBB", 1)));
+    TEST_ASSERT_TRUE(isnan(tr.slope("CCCCCC")));
+
+    // Off until a limit is set
+    tr.evaluate(t, out);
+    TEST_ASSERT_EQUAL(0, out.size());
+
+    // A reaches -10 C in about 70 minutes; B's third probe takes hours,
+    // and its steady first probe never warns, even above the limit
+    tr.setLimit(-10.0f, 60);
+    tr.evaluate(t, out);
+    TEST_ASSERT_EQUAL(0, out.size());
+    tr.setLimit(-10.0f, 90);
+    tr.evaluate(t, out);
+    TEST_ASSERT_EQUAL(1, out.size());
+    TEST_ASSERT_EQUAL_STRING("AAAAAA", out[0].id.c_str());
+    TEST_ASSERT_EQUAL(0, out[0].channel);
+    TEST_ASSERT_EQUAL(70, out[0].minutes);
+
+    tr.setLimit(-16.0f, 240);
+    tr.evaluate(t, out);
+    TEST_ASSERT_EQUAL(2, out.size());
+    TEST_ASSERT_EQUAL_STRING("BBBBBB", out[1].id.c_str());
+    TEST_ASSERT_EQUAL(2, out[1].channel);
+    TEST_ASSERT_EQUAL(190, out[1].minutes);
+
+    // Nothing heard for a while: no warning on stale data
+    tr.evaluate(t + TREND_GAP_SECS + 1, out);
+    TEST_ASSERT_EQUAL(0, out.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_linear_slope);
+    RUN_TEST(test_sliding_matches_full_fit);
+    RUN_TEST(test_long_run_and_gaps);
+    RUN_TEST(test_tracker_warns_before_limit);
+    return UNITY_END();
+}
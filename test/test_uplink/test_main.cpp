@@ -0,0 +1,154 @@
+#include <unity.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "Uplink.h"
+
+// Stand-in collector: records what it is sent, or refuses it
+class FakeCollector : public UplinkTransport {
+public:
+    bool up = true;
+    std::vector<std::string> got;
+    bool publish(const char *data, size_t len) override {
+        if (!up) return false;
+        got.push_back(std::string(data, len));
+        return true;
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_target_parse(void)
+{
+    UplinkTarget t;
+    TEST_ASSERT_TRUE(UplinkTarget::parse("mqtt://192.168.1.10/site/kic", t));
+    TEST_ASSERT_EQUAL(UplinkScheme::Mqtt, t.scheme);
+    TEST_ASSERT_EQUAL_STRING("192.168.1.10", t.host.c_str());
+    TEST_ASSERT_EQUAL(1883, t.port);
+    TEST_ASSERT_EQUAL_STRING("site/kic", t.path.c_str());
+
+    TEST_ASSERT_TRUE(UplinkTarget::parse("http://historian.lan:8080/ingest", t));
+    TEST_ASSERT_EQUAL(UplinkScheme::Http, t.scheme);
+    TEST_ASSERT_EQUAL(8080, t.port);
+    TEST_ASSERT_EQUAL_STRING("/ingest", t.path.c_str());
+
+    TEST_ASSERT_TRUE(UplinkTarget::parse("mqtt://broker", t));
+    TEST_ASSERT_EQUAL_STRING("kic", t.path.c_str());
+    TEST_ASSERT_FALSE(UplinkTarget::parse("https://x/y", t));
+    TEST_ASSERT_FALSE(UplinkTarget::parse("http://:80/y", t));
+    TEST_ASSERT_FALSE(UplinkTarget::parse("http://x:99999/y", t));
+}
+
+void test_batches_new_readings(void)
+{
+    Uplink up;
+    up.setNodeId("AAAAAA");
+    NodeTable table;
+    table.update("AAAAAA", 4.0f, NAN, NAN, 1000, true);
+    table.update("BBBBBB", -18.25f, NAN, NAN, 990, true);
+
+    uint32_t ms = 0;
+    up.sample(table, ms);
+    up.tick(ms);
+    // B is quiet; only A's reading is new a minute later
+    ms += UPLINK_SAMPLE_MS;
+    table.update("AAAAAA", 4.5f, NAN, NAN, 1060, true);
+    up.sample(table, ms);
+    up.tick(ms);
+    TEST_ASSERT_EQUAL(0, up.queued());
+
+    ms = UPLINK_BATCH_MS;
+    up.sample(table, ms);
+    up.tick(ms);
+    TEST_ASSERT_EQUAL(1, up.queued());
+
+    FakeCollector c;
+    TEST_ASSERT_TRUE(up.publishDue(c, ms));
+    TEST_ASSERT_EQUAL(1, c.got.size());
+    TEST_ASSERT_EQUAL_STRING("{\"node\":\"AAAAAA\",\"seq\":0,\"t0\":990,"
+                             "\"r\":[[\"AAAAAA\",10,4.00],[\"BBBBBB\",0,-18.25],[\"AAAAAA\",70,4.50]]}",
+                             c.got[0].c_str());
+    TEST_ASSERT_EQUAL(0, up.queued());
+    TEST_ASSERT_FALSE(up.publishDue(c, ms));
+}
+
+void test_alarm_events_sent_at_once(void)
+{
+    Uplink up;
+    up.setNodeId("AAAAAA");
+    NodeTable table;
+    table.update("BBBBBB", 4.0f, NAN, NAN, 1000, true);
+    up.sample(table, 0);
+    up.tick(0);
+    up.tick(UPLINK_BATCH_MS);
+    FakeCollector c;
+    while (up.publishDue(c, UPLINK_BATCH_MS)) {}
+    TEST_ASSERT_EQUAL(1, c.got.size());
+
+    AlarmStatus s = AlarmStatus();
+    s.downNodes.push_back("BBBBBB");
+    s.downNodes.push_back("CCCCCC");   // never heard: not an event
+    up.alarms(s, 1400);
+    up.alarms(s, 1405);                // no change, no repeat
+    uint32_t ms = UPLINK_BATCH_MS + 1000;
+    up.tick(ms);
+    TEST_ASSERT_TRUE(up.publishDue(c, ms));
+    TEST_ASSERT_EQUAL_STRING("{\"node\":\"AAAAAA\",\"seq\":1,\"t0\":1400,\"e\":[[\"down\",\"BBBBBB\",0]]}",
+                             c.got[1].c_str());
+
+    s.downNodes.clear();
+    s.probeDisconnected = true;
+    up.alarms(s, 1500);
+    up.tick(ms + 1000);
+    TEST_ASSERT_TRUE(up.publishDue(c, ms + 1000));
+    TEST_ASSERT_EQUAL_STRING("{\"node\":\"AAAAAA\",\"seq\":2,\"t0\":1500,"
+                             "\"e\":[[\"up\",\"BBBBBB\",0],[\"probe\",\"AAAAAA\",0]]}",
+                             c.got[2].c_str());
+}
+
+void test_retry_backoff_and_bounded_queue(void)
+{
+    Uplink up;
+    up.setNodeId("AAAAAA");
+    NodeTable table;
+    FakeCollector c;
+    c.up = false;
+
+    uint32_t ms = 0;
+    for (int i = 0; i < UPLINK_QUEUE_MAX + 2; i++) {
+        table.update("AAAAAA", 4.0f, NAN, NAN, 1000 + i, true);
+        up.sample(table, ms);
+        up.tick(ms);
+        ms += UPLINK_BATCH_MS;
+        up.tick(ms);
+    }
+    TEST_ASSERT_EQUAL(UPLINK_QUEUE_MAX, up.queued());
+    TEST_ASSERT_EQUAL(2, up.dropped());
+
+    // Failures back off 5 s, 10 s, ...
+    TEST_ASSERT_FALSE(up.publishDue(c, ms));
+    TEST_ASSERT_FALSE(up.publishDue(c, ms + UPLINK_RETRY_MS - 1));
+    TEST_ASSERT_EQUAL(1, up.failures());
+    TEST_ASSERT_FALSE(up.publishDue(c, ms + UPLINK_RETRY_MS));
+    TEST_ASSERT_FALSE(up.publishDue(c, ms + 3 * UPLINK_RETRY_MS - 1));
+    TEST_ASSERT_EQUAL(2, up.failures());
+
+    // Back up: the queue drains in order, oldest surviving batch first
+    c.up = true;
+    uint32_t t = ms + 3 * UPLINK_RETRY_MS;
+    while (up.publishDue(c, t)) {}
+    TEST_ASSERT_EQUAL(UPLINK_QUEUE_MAX, c.got.size());
+    TEST_ASSERT_EQUAL(0, c.got[0].find("{\"node\":\"AAAAAA\",\"seq\":2,"));
+    TEST_ASSERT_EQUAL(UPLINK_QUEUE_MAX, up.published());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_target_parse);
+    RUN_TEST(test_batches_new_readings);
+    RUN_TEST(test_alarm_events_sent_at_once);
+    RUN_TEST(test_retry_backoff_and_bounded_queue);
+    return UNITY_END();
+}
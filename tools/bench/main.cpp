@@ -0,0 +1,57 @@
+/*
+  keep_it_cold host benchmarks
+
+  Runs the shared BenchSuite with a nanosecond clock and C++ allocation
+  counting, printing one JSON object per line:
+
+    pio run -e bench && .pio/build/bench/program --iters 2000 > bench.jsonl
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "BenchSuite.h"
+
+static uint64_t hostNanos()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void writeLine(const char *line)
+{
+    puts(line);
+}
+
+// Appends to a scratch file, like LittleFsLogStore does on the device
+class FileLogStore : public LogStore {
+public:
+    explicit FileLogStore(const char *path) : path(path) {}
+    bool append(const char *data, size_t len) override {
+        FILE *f = fopen(path, "ab");
+        if (!f) return false;
+        size_t written = fwrite(data, 1, len, f);
+        fclose(f);
+        return written == len;
+    }
+    const char *path;
+};
+
+int main(int argc, char **argv)
+{
+    uint32_t iters = 1000;
+    const char *scratch = "bench_log.csv";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--iters")) iters = (uint32_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--scratch")) scratch = argv[i + 1];
+    }
+
+    setenv("TZ", "UTC0", 1);
+    FileLogStore log(scratch);
+    Bench bench(hostNanos, "ns", writeLine);
+    bench.header("host", __DATE__ " " __TIME__);
+    BenchSuite::run(bench, log, iters);
+    remove(scratch);
+    return 0;
+}
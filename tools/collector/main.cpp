@@ -0,0 +1,185 @@
+/*
+  keep_it_cold gateway collector
+
+  Reads the binary stream of a gateway node (heltec_gateway build) from a
+  serial port or file and appends one CSV row per reading. Debug text on
+  the port is skipped, or echoed to stderr with --text 1. Ctrl-C prints
+  the totals, including records lost on the node or the wire (gaps in the
+  sequence numbers).
+
+    pio run -e collector && .pio/build/collector/program --port /dev/ttyUSB0 --out readings.csv
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include "Gateway.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int)
+{
+    stop = 1;
+}
+
+static void usage()
+{
+    printf("usage: program [options]\n"
+           "  --port DEV         serial device, opened raw at --baud\n"
+           "  --in FILE          read a captured stream instead (- for stdin)\n"
+           "  --baud N           (921600)\n"
+           "  --out FILE         CSV to append to (readings.csv)\n"
+           "  --text 0|1         echo debug text to stderr (0)\n");
+}
+
+static speed_t baudConst(long baud)
+{
+    switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return (speed_t)baud;   // macOS takes the number itself
+    }
+}
+
+static int openPort(const char *dev, long baud)
+{
+    int fd = open(dev, O_RDONLY | O_NOCTTY);
+    if (fd < 0) return -1;
+    struct termios t;
+    if (tcgetattr(fd, &t) != 0) { close(fd); return -1; }
+    cfmakeraw(&t);
+    t.c_cflag |= CLOCAL | CREAD;
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    cfsetispeed(&t, baudConst(baud));
+    cfsetospeed(&t, baudConst(baud));
+    if (tcsetattr(fd, TCSANOW, &t) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+static const char *kindName(GatewayKind k)
+{
+    switch (k) {
+    case GatewayKind::Local: return "local";
+    case GatewayKind::Report: return "report";
+    case GatewayKind::Backfill: return "backfill";
+    default: return "unknown";
+    }
+}
+
+// Fixed-point field as a decimal, empty when missing
+static void field(FILE *f, int16_t v, int scale)
+{
+    if (v == GATEWAY_NO_VALUE) fputc(',', f);
+    else fprintf(f, ",%.*f", scale == 100 ? 2 : 1, (double)v / scale);
+}
+
+static void writeRow(FILE *f, const GatewayRecord &r)
+{
+    char id[GATEWAY_ID_LEN + 1];
+    memcpy(id, r.id, GATEWAY_ID_LEN);
+    id[GATEWAY_ID_LEN] = 0;
+    fprintf(f, "%ld,%s,%s,%u,%lu,%lu", (long)time(nullptr), id, kindName(r.kind),
+            (unsigned)r.seq, (unsigned long)r.ms, (unsigned long)r.epoch);
+    for (int i = 0; i < 3; i++) field(f, r.temp[i], 100);
+    field(f, r.rssi, 10);
+    field(f, r.snr, 10);
+    fprintf(f, ",%u,%d\n", (unsigned)r.sf, (int)r.txDbm);
+}
+
+int main(int argc, char **argv)
+{
+    const char *port = nullptr;
+    const char *in = nullptr;
+    const char *out = "readings.csv";
+    long baud = GATEWAY_BAUD;
+    bool text = false;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "-h") || !strcmp(a, "--help")) { usage(); return 0; }
+        if (!v) { usage(); return 1; }
+        if (!strcmp(a, "--port")) port = v;
+        else if (!strcmp(a, "--in")) in = v;
+        else if (!strcmp(a, "--baud")) baud = atol(v);
+        else if (!strcmp(a, "--out")) out = v;
+        else if (!strcmp(a, "--text")) text = atoi(v) != 0;
+        else { usage(); return 1; }
+        i++;
+    }
+    if (!port == !in) { usage(); return 1; }
+
+    int fd;
+    if (port) fd = openPort(port, baud);
+    else fd = strcmp(in, "-") ? open(in, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(port ? port : in);
+        return 1;
+    }
+
+    struct stat st;
+    bool fresh = stat(out, &st) != 0 || st.st_size == 0;
+    FILE *csv = fopen(out, "a");
+    if (!csv) {
+        perror(out);
+        return 1;
+    }
+    if (fresh) {
+        fputs("host_time,node,kind,seq,uptime_ms,epoch,temp1,temp2,temp3,rssi,snr,sf,tx_dbm\n", csv);
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    GatewayReader reader;
+    GatewayRecord rec;
+    unsigned long records = 0, junk = 0, lost = 0;
+    bool haveSeq = false;
+    uint16_t expect = 0;
+    char line[256];
+    size_t lineLen = 0;
+    uint8_t buf[512];
+    while (!stop) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (ssize_t i = 0; i < n; i++) {
+            uint8_t b = buf[i];
+            if (text && b != 0) {
+                if (lineLen < sizeof(line) - 1) line[lineLen++] = (char)b;
+            }
+            GatewayReader::Result res = reader.feed(b, rec);
+            if (res == GatewayReader::Record) {
+                // A jump back means the node rebooted
+                if (haveSeq && rec.seq != expect && (uint16_t)(rec.seq - expect) < 0x8000) {
+                    lost += (uint16_t)(rec.seq - expect);
+                }
+                haveSeq = true;
+                expect = rec.seq + 1;
+                writeRow(csv, rec);
+                records++;
+            } else if (res == GatewayReader::Junk) {
+                junk++;
+                if (text) fwrite(line, 1, lineLen, stderr);
+            }
+            if (b == 0) lineLen = 0;
+        }
+        fflush(csv);
+    }
+
+    fclose(csv);
+    if (fd != STDIN_FILENO) close(fd);
+    fprintf(stderr, "%lu records, %lu lost, %lu junk segments\n", records, lost, junk);
+    return 0;
+}
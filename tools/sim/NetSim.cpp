@@ -0,0 +1,411 @@
+#include "NetSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <map>
+
+#define SIM_BASE_EPOCH 1757599200   // 2025-09-11 14:00:00 UTC
+
+// ----- Per-node HAL shims -----
+class SimClock : public Clock {
+public:
+    SimClock(NetSim &sim, uint32_t seed) : sim(sim), gen(seed), bootUs(0), offsetS(0) {}
+    uint32_t millis() override { return (uint32_t)((sim.nowUs() - bootUs) / 1000); }
+    time_t now() override { return (time_t)(SIM_BASE_EPOCH + offsetS + sim.nowUs() / 1000000); }
+    void setTime(time_t epoch) override {
+        offsetS = (int64_t)epoch - (int64_t)(SIM_BASE_EPOCH + sim.nowUs() / 1000000);
+    }
+    uint32_t random(uint32_t max) override { return max ? gen() % max : 0; }
+
+    NetSim &sim;
+    std::mt19937 gen;
+    uint64_t bootUs;
+    int64_t offsetS;
+};
+
+class SimRadio : public Radio {
+public:
+    SimRadio(NetSim &sim, uint32_t node) : sim(sim), node(node), sf(0), dbm(0) {}
+    int16_t transmit(const uint8_t *data, size_t len) override {
+        sim.startTx(node, data, len);
+        return 0;
+    }
+    int16_t setRate(uint8_t s, int8_t d) override {
+        sf = s;
+        dbm = d;
+        sim.rateChanged();
+        return 0;
+    }
+    NetSim &sim;
+    uint32_t node;
+    uint8_t sf;
+    float dbm;
+};
+
+class SimStore : public KeyValueStore {
+public:
+    std::map<std::string, std::string> strings;
+    std::map<std::string, uint32_t> ulongs;
+    std::string getString(const char *key, const char *def) override {
+        auto it = strings.find(key);
+        return it == strings.end() ? def : it->second;
+    }
+    void putString(const char *key, const std::string &value) override { strings[key] = value; }
+    uint32_t getULong(const char *key, uint32_t def) override {
+        auto it = ulongs.find(key);
+        return it == ulongs.end() ? def : it->second;
+    }
+    void putULong(const char *key, uint32_t value) override { ulongs[key] = value; }
+};
+
+class SimLog : public LogStore {
+public:
+    uint64_t bytes = 0;
+    uint64_t appends = 0;
+    uint64_t rows = 0;
+    bool append(const char *data, size_t len) override {
+        bytes += len;
+        appends++;
+        for (size_t i = 0; i < len; i++) rows += data[i] == '\n';
+        return true;
+    }
+};
+
+class SimSensor : public TempSensor {
+public:
+    explicit SimSensor(float base) : base(base), value(base) {}
+    void requestConversion() override { value = base + 0.01f * (float)(conversions++ % 7); }
+    float readC(uint8_t index) override { return index == 0 ? value : NAN; }
+    float base;
+    float value;
+    uint32_t conversions = 0;
+};
+
+struct NetSim::SimNode {
+    SimNode(NetSim &sim, uint32_t idx, uint32_t seed)
+        : clock(sim, seed), radio(sim, idx), sensor(-18.0f + (float)(idx % 5)) {}
+
+    void boot(const std::string &nid, bool hasRtc, const SimConfig &cfg) {
+        // setupLoRa() state after a reboot
+        radio.sf = cfg.adaptiveRate ? ADR_BASE_SF : cfg.lora.sf;
+        radio.dbm = cfg.adaptiveRate ? ADR_BASE_DBM : cfg.txPowerDbm;
+        node.reset(new KicNode(clock, radio, prefs, log, sensor));
+        node->begin(nid, hasRtc, cfg.passphrase);
+        node->setAdaptiveRate(cfg.adaptiveRate);
+    }
+
+    SimClock clock;
+    SimRadio radio;
+    SimStore prefs;
+    SimLog log;
+    SimSensor sensor;
+    std::unique_ptr<KicNode> node;
+
+    std::string id;
+    double x = 0, y = 0;
+    bool hasRtc = true;
+    bool up = true;
+    uint64_t upSince = 0;
+    uint64_t txUntil = 0;
+    double fadeDb = 0;
+    uint64_t wakeGen = 0;
+    std::vector<bool> peerDown;
+};
+
+NetSim::NetSim(const SimConfig &c)
+    : cfg(c), now(0), busyUntil(0), nextTxId(1), gen(c.seed)
+{
+    endUs = (uint64_t)(cfg.hours * 3600.0 * 1e6);
+    std::uniform_real_distribution<double> pos(0.0, cfg.areaM);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::string roster;
+    for (uint32_t i = 0; i < cfg.nodes; i++) {
+        nodes.emplace_back(new SimNode(*this, i, cfg.seed * 7919 + i));
+        SimNode &n = *nodes.back();
+        char nid[12];
+        snprintf(nid, sizeof(nid), "%06X", i + 1);
+        n.id = nid;
+        n.x = pos(gen);
+        n.y = pos(gen);
+        n.hasRtc = unit(gen) < cfg.rtcFraction;
+        n.clock.offsetS = (int64_t)lround((unit(gen) * 2 - 1) * cfg.clockSkewS);
+        n.peerDown.assign(cfg.nodes, false);
+        if (!roster.empty()) roster += ",";
+        roster += n.id;
+    }
+
+    // Static link budget with symmetric shadowing
+    std::normal_distribution<double> shadow(0.0, cfg.shadowingDb);
+    loss.assign((size_t)cfg.nodes * cfg.nodes, 0.0);
+    for (uint32_t a = 0; a < cfg.nodes; a++) {
+        for (uint32_t b = a + 1; b < cfg.nodes; b++) {
+            double d = hypot(nodes[a]->x - nodes[b]->x, nodes[a]->y - nodes[b]->y);
+            if (d < 1.0) d = 1.0;
+            double pl = 40.0 + 10.0 * cfg.pathLossExp * log10(d) + shadow(gen);
+            loss[a * cfg.nodes + b] = loss[b * cfg.nodes + a] = pl;
+        }
+    }
+
+    // Staggered power-on within the first report period
+    std::uniform_int_distribution<uint64_t> start(0, SEND_INTERVAL_MS * 1000ULL);
+    for (uint32_t i = 0; i < cfg.nodes; i++) {
+        SimNode &n = *nodes[i];
+        n.prefs.putString("nodelist", roster);
+        uint64_t t = start(gen);
+        n.clock.bootUs = t;
+        n.upSince = t;
+        n.up = false;
+        events.push(Event{t, 3, i, 0});
+    }
+}
+
+NetSim::~NetSim() {}
+
+double NetSim::pathLoss(uint32_t from, uint32_t to) const
+{
+    return loss[(size_t)from * cfg.nodes + to] + nodes[from]->fadeDb + nodes[to]->fadeDb;
+}
+
+void NetSim::scheduleOutage(uint32_t i)
+{
+    if (cfg.outagesPerDay <= 0) return;
+    std::exponential_distribution<double> gap(cfg.outagesPerDay / 86400.0);
+    events.push(Event{now + (uint64_t)(gap(gen) * 1e6), 2, i, 0});
+}
+
+void NetSim::scheduleFade(uint32_t i)
+{
+    if (cfg.fadesPerDay <= 0) return;
+    std::exponential_distribution<double> gap(cfg.fadesPerDay / 86400.0);
+    events.push(Event{now + (uint64_t)(gap(gen) * 1e6), 4, i, 0});
+}
+
+// Fold a node's control-message counters into the totals; they live in the
+// KicNode instance, which a reboot replaces
+void NetSim::harvest(const SimNode &n)
+{
+    if (!n.node) return;   // not powered on yet
+    Metrics &m = n.node->metrics();
+    const ReliableOutbox &out = n.node->reliableOutbox();
+    st.ctlSent += m.get(MetricCounter::ReliableSent);
+    st.ctlRetries += m.get(MetricCounter::ReliableRetries);
+    st.ctlHeld += m.get(MetricCounter::ReliableHeld);
+    st.ctlAcked += m.get(MetricCounter::ReliableAcked);
+    st.ctlExpired += m.get(MetricCounter::ReliableExpired);
+    st.ctlLatencySumMs += out.latencySum();
+    if (out.latencyMax() > st.ctlLatencyMaxMs) st.ctlLatencyMaxMs = out.latencyMax();
+}
+
+void NetSim::startTx(uint32_t i, const uint8_t *data, size_t len)
+{
+    SimNode &n = *nodes[i];
+    LoRaParams lp = cfg.lora;
+    lp.sf = n.radio.sf;
+    uint32_t toa = Airtime::timeOnAirUs(lp, len);
+    Tx tx;
+    if (!spare.empty()) {
+        tx = std::move(spare.back());
+        spare.pop_back();
+        tx.overlaps.clear();
+    }
+    tx.id = nextTxId++;
+    tx.sender = i;
+    tx.data.assign(data, data + len);
+
+    // transmit() blocks on the real radio, so back-to-back frames from one
+    // node go out one after the other
+    if (n.txUntil > now) {
+        events.push(Event{n.txUntil, 6, i, tx.id});
+        n.txUntil += toa;
+        queued.push_back(std::move(tx));
+        return;
+    }
+    n.txUntil = now + toa;
+    beginTx(tx);
+}
+
+void NetSim::beginTx(Tx &tx)
+{
+    const SimRadio &radio = nodes[tx.sender]->radio;
+    LoRaParams lp = cfg.lora;
+    lp.sf = radio.sf;
+    uint32_t toa = Airtime::timeOnAirUs(lp, tx.data.size());
+    tx.sf = radio.sf;
+    tx.dbm = radio.dbm;
+    tx.start = now;
+    tx.end = now + toa;
+    for (auto &a : active) {
+        if (a.sender == tx.sender) continue;   // its previous frame, ending now
+        a.overlaps.push_back(Overlap{tx.sender, tx.sf, tx.dbm});
+        tx.overlaps.push_back(Overlap{a.sender, a.sf, a.dbm});
+    }
+
+    st.txFrames++;
+    st.txBytes += tx.data.size();
+    st.airtimeUs += toa;
+    if (tx.end > busyUntil) {
+        st.busyUs += tx.end - (now > busyUntil ? now : busyUntil);
+        busyUntil = tx.end;
+    }
+    events.push(Event{tx.end, 1, tx.sender, tx.id});
+    active.push_back(std::move(tx));
+}
+
+void NetSim::endTx(uint64_t id)
+{
+    size_t k = 0;
+    while (k < active.size() && active[k].id != id) k++;
+    if (k == active.size()) return;
+    Tx tx = std::move(active[k]);
+    if (k + 1 < active.size()) active[k] = std::move(active.back());
+    active.pop_back();
+
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    float sens = Airtime::sensitivityDbm(tx.sf, cfg.lora.bwKHz);
+    // Thermal noise + 6 dB noise figure; the SX126x reports SNR up to ~+10 dB
+    double noise = -174.0 + 10.0 * log10(cfg.lora.bwKHz * 1000.0) + 6.0;
+
+    for (uint32_t r = 0; r < cfg.nodes; r++) {
+        SimNode &rx = *nodes[r];
+        if (r == tx.sender || !rx.up) continue;
+        st.rxAttempts++;
+
+        double p = tx.dbm - pathLoss(tx.sender, r);
+        if (p < sens) { st.lostRange++; continue; }
+
+        bool halfDuplex = false, collided = false, overlapped = false;
+        for (const Overlap &o : tx.overlaps) {
+            if (o.sender == r) { halfDuplex = true; break; }
+            if (o.sf != tx.sf) continue;      // other SFs are near-orthogonal
+            double pi = o.dbm - pathLoss(o.sender, r);
+            if (pi < sens - 10.0) continue;   // too weak to matter
+            overlapped = true;
+            if (p - pi < cfg.captureDb) collided = true;
+        }
+        if (halfDuplex) { st.lostHalfDuplex++; continue; }
+        if (rx.radio.sf != tx.sf) { st.lostRate++; continue; }
+        if (collided) { st.lostCollision++; continue; }
+        if (overlapped) st.captured++;
+        if (cfg.lossProb > 0 && unit(gen) < cfg.lossProb) { st.lostRandom++; continue; }
+
+        st.delivered++;
+        double snr = p - noise < 10.0 ? p - noise : 10.0;
+        if (rx.node->onRadioFrame(tx.data.data(), tx.data.size(), (float)p, (float)snr) ==
+            RxResult::DecryptFailed) {
+            st.decryptFailed++;
+        }
+    }
+    spare.push_back(std::move(tx));
+}
+
+// Node-down onsets, as the firmware's own alarm evaluation reports them
+void NetSim::checkAlarms(uint32_t i)
+{
+    SimNode &n = *nodes[i];
+    AlarmStatus &s = alarmScratch;
+    n.node->evaluateAlarms(s);
+
+    std::vector<bool> &down = downScratch;
+    down.assign(cfg.nodes, false);
+    for (const auto &nid : s.downNodes) {
+        uint32_t p = (uint32_t)strtoul(nid.c_str(), nullptr, 16) - 1;
+        if (p < cfg.nodes) down[p] = true;
+    }
+    for (uint32_t p = 0; p < cfg.nodes; p++) {
+        if (down[p] && !n.peerDown[p]) {
+            st.alarmOnsets++;
+            const SimNode &peer = *nodes[p];
+            if (peer.up && now - peer.upSince >= NODE_DOWN_SECS * 1000000ULL) st.falseAlarms++;
+        }
+        n.peerDown[p] = down[p];
+    }
+}
+
+void NetSim::wake(uint32_t i)
+{
+    SimNode &n = *nodes[i];
+    st.wakeups++;
+    n.node->loop();
+    checkAlarms(i);
+
+    uint64_t wait = n.node->msUntilNextEvent();
+    if (wait == 0) wait = 1;
+    events.push(Event{now + wait * 1000ULL, 0, i, n.wakeGen});
+}
+
+void NetSim::run()
+{
+    std::exponential_distribution<double> outage(1.0 / cfg.outageMeanS);
+    std::exponential_distribution<double> fade(1.0 / cfg.fadeMeanS);
+    for (uint32_t i = 0; i < cfg.nodes; i++) scheduleFade(i);
+
+    while (!events.empty()) {
+        Event e = events.top();
+        if (e.t > endUs) break;
+        events.pop();
+        now = e.t;
+        SimNode &n = *nodes[e.node];
+
+        switch (e.kind) {
+        case 0:
+            if (n.up && e.id == n.wakeGen) wake(e.node);
+            break;
+        case 1:
+            endTx(e.id);
+            break;
+        case 2:
+            if (!n.up) break;
+            n.up = false;
+            n.wakeGen++;
+            st.outages++;
+            events.push(Event{now + (uint64_t)(outage(gen) * 1e6), 3, e.node, 0});
+            break;
+        case 3:
+            // Power on: fresh firmware state, NVS survives. Without a
+            // DS3231 the clock restarts at epoch 0 until a peer syncs it.
+            n.up = true;
+            n.upSince = now;
+            n.clock.bootUs = now;
+            if (!n.hasRtc) n.clock.setTime(0);
+            n.peerDown.assign(cfg.nodes, false);
+            harvest(n);
+            n.boot(n.id, n.hasRtc, cfg);
+            n.wakeGen++;
+            events.push(Event{now, 0, e.node, n.wakeGen});
+            scheduleOutage(e.node);
+            break;
+        case 4:
+            n.fadeDb = cfg.fadeDb;
+            st.fades++;
+            events.push(Event{now + (uint64_t)(fade(gen) * 1e6), 5, e.node, 0});
+            break;
+        case 5:
+            n.fadeDb = 0;
+            scheduleFade(e.node);
+            break;
+        case 6:
+            for (size_t k = 0; k < queued.size(); k++) {
+                if (queued[k].id != e.id) continue;
+                Tx tx = std::move(queued[k]);
+                if (k + 1 < queued.size()) queued[k] = std::move(queued.back());
+                queued.pop_back();
+                if (n.up) beginTx(tx);
+                else spare.push_back(std::move(tx));
+                break;
+            }
+            break;
+        }
+    }
+    now = endUs;
+    st.simSeconds = endUs / 1e6;
+
+    double dbm = 0;
+    for (const auto &n : nodes) {
+        harvest(*n);
+        st.logRows += n->log.rows;
+        st.logSlots += n->log.appends * cfg.nodes;
+        if (n->radio.sf <= 12) st.sfCount[n->radio.sf]++;
+        dbm += n->radio.dbm;
+    }
+    st.meanTxDbm = dbm / cfg.nodes;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+// Discrete-event simulator running N KicNode instances against a shared
+// virtual clock and a modelled LoRa channel (time-on-air, half-duplex,
+// collisions with capture effect, path loss, random loss and temporary
+// per-node fades such as a closed freezer door).
+
+#include <stdint.h>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "Airtime.h"
+#include "KicNode.h"
+
+struct SimConfig {
+    uint32_t nodes = 10;
+    double hours = 24.0;
+    uint32_t seed = 1;
+    LoRaParams lora = LORA_DEFAULT_PARAMS;
+    float txPowerDbm = 13.0f;        // fixed-rate power; LinkAdapt starts at ADR_BASE_DBM
+    bool adaptiveRate = true;        // KicNode::setAdaptiveRate, as the firmware ships
+    double areaM = 300.0;            // nodes placed uniformly in an area x area square
+    double pathLossExp = 2.7;        // log-distance model, 40 dB at 1 m
+    double shadowingDb = 4.0;        // per-link log-normal shadowing sigma
+    double lossProb = 0.0;           // extra random frame loss per receiver
+    double captureDb = 6.0;          // stronger frame survives overlap by this margin
+    double rtcFraction = 1.0;        // share of nodes with a DS3231
+    double clockSkewS = 0.0;         // +- wall-clock error of each node's RTC
+    double outagesPerDay = 0.0;      // mean node power outages per node per day
+    double outageMeanS = 600.0;      // mean outage length
+    double fadesPerDay = 0.0;        // mean link fades per node per day
+    double fadeMeanS = 1800.0;       // mean fade length
+    double fadeDb = 30.0;            // extra path loss on all the node's links
+    const char *passphrase = "bowman#1";
+};
+
+struct SimStats {
+    uint64_t txFrames = 0;
+    uint64_t txBytes = 0;
+    uint64_t rxAttempts = 0;         // (frame, live receiver) pairs
+    uint64_t delivered = 0;
+    uint64_t lostRange = 0;
+    uint64_t lostCollision = 0;
+    uint64_t captured = 0;           // survived an overlap thanks to capture
+    uint64_t lostHalfDuplex = 0;
+    uint64_t lostRate = 0;           // receiver on a different SF
+    uint64_t lostRandom = 0;
+    uint64_t decryptFailed = 0;
+    uint64_t airtimeUs = 0;          // sum of all frames' time on air
+    uint64_t busyUs = 0;             // time at least one frame was on air
+    uint64_t alarmOnsets = 0;
+    uint64_t falseAlarms = 0;        // onset while the peer had been up the whole window
+    uint64_t outages = 0;
+    uint64_t fades = 0;
+    uint64_t logRows = 0;            // rows written to all nodes' logs
+    uint64_t logSlots = 0;           // rows a complete log would hold
+    uint64_t ctlSent = 0;            // acknowledged control messages (ALARM, NODELIST)
+    uint64_t ctlRetries = 0;
+    uint64_t ctlHeld = 0;            // retries skipped on a busy channel
+    uint64_t ctlAcked = 0;           // acked by every peer
+    uint64_t ctlExpired = 0;
+    uint64_t ctlLatencySumMs = 0;    // post to last ack, acked messages only
+    uint32_t ctlLatencyMaxMs = 0;
+    uint64_t wakeups = 0;
+    uint64_t rateChanges = 0;
+    uint32_t sfCount[13] = {0};      // nodes per SF at the end of the run
+    double meanTxDbm = 0;            // across nodes at the end of the run
+    double simSeconds = 0;
+
+    double deliveryRatio() const { return rxAttempts ? (double)delivered / rxAttempts : 0; }
+    double channelUtilisation() const { return simSeconds ? busyUs / (simSeconds * 1e6) : 0; }
+};
+
+class NetSim {
+public:
+    explicit NetSim(const SimConfig &cfg);
+    ~NetSim();
+
+    void run();
+    const SimStats &stats() const { return st; }
+
+    // Used by the per-node HAL shims
+    uint64_t nowUs() const { return now; }
+    void startTx(uint32_t node, const uint8_t *data, size_t len);
+    void rateChanged() { st.rateChanges++; }
+
+private:
+    struct SimNode;
+    struct Overlap {
+        uint32_t sender;
+        uint8_t sf;
+        float dbm;
+    };
+    struct Tx {
+        uint64_t id;
+        uint32_t sender;
+        uint8_t sf;
+        float dbm;
+        uint64_t start;
+        uint64_t end;
+        std::vector<uint8_t> data;
+        std::vector<Overlap> overlaps;    // frames that overlapped this one
+    };
+    struct Event {
+        uint64_t t;
+        uint32_t kind;   // 0 = node wake, 1 = tx end, 2 = outage start, 3 = outage end,
+                         // 4 = fade start, 5 = fade end, 6 = queued tx start
+        uint32_t node;
+        uint64_t id;
+        bool operator>(const Event &o) const { return t > o.t; }
+    };
+
+    void wake(uint32_t i);
+    void beginTx(Tx &tx);
+    void endTx(uint64_t id);
+    void checkAlarms(uint32_t i);
+    void scheduleOutage(uint32_t i);
+    void scheduleFade(uint32_t i);
+    void harvest(const SimNode &n);
+    double pathLoss(uint32_t from, uint32_t to) const;
+
+    SimConfig cfg;
+    SimStats st;
+    uint64_t now;
+    uint64_t endUs;
+    uint64_t busyUntil;
+    uint64_t nextTxId;
+    std::mt19937 gen;
+    std::vector<std::unique_ptr<SimNode>> nodes;
+    std::vector<double> loss;                 // nodes x nodes path loss (dB)
+    std::vector<Tx> active;
+    std::vector<Tx> queued;                   // waiting for the sender's radio
+    std::vector<Tx> spare;                    // finished frames, buffers reused
+    AlarmStatus alarmScratch;
+    std::vector<bool> downScratch;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+};
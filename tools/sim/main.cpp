@@ -0,0 +1,125 @@
+/*
+  keep_it_cold network simulator
+
+  Runs N copies of the firmware node logic (KicNode) against a virtual
+  clock and a modelled LoRa channel, then prints delivery, collision,
+  alarm and airtime figures.
+
+    pio run -e sim && .pio/build/sim/program --nodes 20 --hours 100
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "NetSim.h"
+
+static void usage()
+{
+    printf("usage: program [options]\n"
+           "  --nodes N          number of nodes (10)\n"
+           "  --hours H          simulated hours (24)\n"
+           "  --seed S           random seed (1)\n"
+           "  --sf SF            spreading factor 7..12 with --adr 0 (9)\n"
+           "  --bw KHZ           bandwidth 125/250/500 (125)\n"
+           "  --cr N             coding rate denominator 5..8 (7)\n"
+           "  --preamble N       preamble symbols; 64 for low-power nodes (8)\n"
+           "  --power DBM        TX power with --adr 0 (13)\n"
+           "  --adr 0|1          adaptive SF/power (1)\n"
+           "  --area M           side of the square nodes are placed in (300)\n"
+           "  --loss P           extra random loss probability (0)\n"
+           "  --capture DB       capture threshold (6)\n"
+           "  --rtc F            fraction of nodes with an RTC (1)\n"
+           "  --skew S           +- RTC clock error in seconds (0)\n"
+           "  --outages N        power outages per node per day (0)\n"
+           "  --outage-len S     mean outage length in seconds (600)\n"
+           "  --fades N          link fades per node per day (0)\n"
+           "  --fade-len S       mean fade length in seconds (1800)\n"
+           "  --fade-db DB       extra path loss during a fade (30)\n");
+}
+
+int main(int argc, char **argv)
+{
+    SimConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "-h") || !strcmp(a, "--help")) { usage(); return 0; }
+        if (!v) { usage(); return 1; }
+        if (!strcmp(a, "--nodes")) cfg.nodes = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--hours")) cfg.hours = atof(v);
+        else if (!strcmp(a, "--seed")) cfg.seed = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--sf")) cfg.lora.sf = (uint8_t)atoi(v);
+        else if (!strcmp(a, "--bw")) cfg.lora.bwKHz = (float)atof(v);
+        else if (!strcmp(a, "--cr")) cfg.lora.cr = (uint8_t)atoi(v);
+        else if (!strcmp(a, "--preamble")) cfg.lora.preamble = (uint16_t)atoi(v);
+        else if (!strcmp(a, "--power")) cfg.txPowerDbm = (float)atof(v);
+        else if (!strcmp(a, "--adr")) cfg.adaptiveRate = atoi(v) != 0;
+        else if (!strcmp(a, "--area")) cfg.areaM = atof(v);
+        else if (!strcmp(a, "--loss")) cfg.lossProb = atof(v);
+        else if (!strcmp(a, "--capture")) cfg.captureDb = atof(v);
+        else if (!strcmp(a, "--rtc")) cfg.rtcFraction = atof(v);
+        else if (!strcmp(a, "--skew")) cfg.clockSkewS = atof(v);
+        else if (!strcmp(a, "--outages")) cfg.outagesPerDay = atof(v);
+        else if (!strcmp(a, "--outage-len")) cfg.outageMeanS = atof(v);
+        else if (!strcmp(a, "--fades")) cfg.fadesPerDay = atof(v);
+        else if (!strcmp(a, "--fade-len")) cfg.fadeMeanS = atof(v);
+        else if (!strcmp(a, "--fade-db")) cfg.fadeDb = atof(v);
+        else { usage(); return 1; }
+        i++;
+    }
+    if (cfg.nodes < 2 || cfg.lora.sf < 7 || cfg.lora.sf > 12) { usage(); return 1; }
+
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    clock_t t0 = clock();
+    NetSim sim(cfg);
+    sim.run();
+    double wall = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    const SimStats &s = sim.stats();
+
+    printf("nodes              %u\n", cfg.nodes);
+    printf("simulated hours    %.1f\n", cfg.hours);
+    if (cfg.adaptiveRate) {
+        printf("lora               adaptive BW%.0f CR4/%u (%llu rate changes)\n",
+               cfg.lora.bwKHz, cfg.lora.cr, (unsigned long long)s.rateChanges);
+        printf("  final rates     ");
+        for (int sf = 7; sf <= 12; sf++) {
+            if (s.sfCount[sf]) printf(" SF%d x%u", sf, s.sfCount[sf]);
+        }
+        printf(", mean %.1f dBm\n", s.meanTxDbm);
+    } else {
+        printf("lora               SF%u BW%.0f CR4/%u %.0f dBm\n",
+               cfg.lora.sf, cfg.lora.bwKHz, cfg.lora.cr, cfg.txPowerDbm);
+    }
+    printf("frames sent        %llu (%llu bytes)\n",
+           (unsigned long long)s.txFrames, (unsigned long long)s.txBytes);
+    printf("delivery ratio     %.4f (%llu / %llu)\n", s.deliveryRatio(),
+           (unsigned long long)s.delivered, (unsigned long long)s.rxAttempts);
+    printf("  lost range       %llu\n", (unsigned long long)s.lostRange);
+    printf("  lost collision   %llu\n", (unsigned long long)s.lostCollision);
+    printf("  lost half-duplex %llu\n", (unsigned long long)s.lostHalfDuplex);
+    printf("  lost rate        %llu\n", (unsigned long long)s.lostRate);
+    printf("  lost random      %llu\n", (unsigned long long)s.lostRandom);
+    printf("  captured         %llu\n", (unsigned long long)s.captured);
+    printf("  decrypt failed   %llu\n", (unsigned long long)s.decryptFailed);
+    printf("airtime per frame  %.1f ms\n", s.txFrames ? s.airtimeUs / 1000.0 / s.txFrames : 0.0);
+    printf("channel busy       %.4f%% (airtime sum %.4f%%)\n",
+           100.0 * s.channelUtilisation(), 100.0 * s.airtimeUs / (s.simSeconds * 1e6));
+    printf("node outages       %llu\n", (unsigned long long)s.outages);
+    printf("link fades         %llu\n", (unsigned long long)s.fades);
+    printf("log rows           %llu of %llu (%.2f%%)\n",
+           (unsigned long long)s.logRows, (unsigned long long)s.logSlots,
+           s.logSlots ? 100.0 * s.logRows / s.logSlots : 0.0);
+    printf("node-down alarms   %llu (false %llu)\n",
+           (unsigned long long)s.alarmOnsets, (unsigned long long)s.falseAlarms);
+    printf("control messages   %llu sent, %llu acked, %llu expired, %llu retries, %llu held\n",
+           (unsigned long long)s.ctlSent, (unsigned long long)s.ctlAcked,
+           (unsigned long long)s.ctlExpired, (unsigned long long)s.ctlRetries,
+           (unsigned long long)s.ctlHeld);
+    printf("  ack latency      %.1f s mean, %.1f s max\n",
+           s.ctlAcked ? s.ctlLatencySumMs / 1000.0 / s.ctlAcked : 0.0, s.ctlLatencyMaxMs / 1000.0);
+    printf("wall time          %.2f s (%llu wakeups)\n", wall, (unsigned long long)s.wakeups);
+    return 0;
+}